@@ -0,0 +1,18 @@
+#!/bin/sh
+# builds & runs tests of portable modules with gcc, "bench" also runs benchmarks
+
+cd "$(dirname "$0")/.." || exit 1
+mkdir -p output/tests
+
+failed=0
+for test in tests/test_*.c; do
+	name=$(basename "$test" .c)
+	if ! gcc -std=c11 -O2 -g -Wall -Wextra -Wno-unused-function -Wno-unused-parameter -Isrc \
+		 -Itests "$test" -o "output/tests/$name" -lpthread -lm; then
+		failed=1
+		continue
+	fi
+	"output/tests/$name" "$@" || failed=1
+done
+
+exit $failed
@@ -11,7 +11,7 @@ DEFINE_GUID(IID_IAudioCaptureClient,
 DEFINE_GUID(IID_IAudioRenderClient,
 			0xf294acfc, 0x3146, 0x4483, 0xa7, 0xbf, 0xad, 0xdc, 0xa7, 0xc2, 0x60, 0xe2);
 
-static bool AudioCaptureStart(audio_capture *ac, u64 duration_100ns) {
+static bool AudioCaptureStart(audio_capture *ac, u64 duration_100ns, HANDLE event) {
 	bool result = false;
 	
 	IMMDeviceEnumerator *enumerator;
@@ -52,8 +52,11 @@ static bool AudioCaptureStart(audio_capture *ac, u64 duration_100ns) {
 			
 			WAVEFORMATEX *format;
 			IAudioClient_GetMixFormat(client, &format);
-			IAudioClient_Initialize(client, AUDCLNT_SHAREMODE_SHARED, AUDCLNT_STREAMFLAGS_LOOPBACK,
-									duration_100ns, 0, format, 0);
+			// event driven, so buffer only has to cover time until pump thread wakes up
+			DWORD streamFlags = AUDCLNT_STREAMFLAGS_LOOPBACK | AUDCLNT_STREAMFLAGS_EVENTCALLBACK;
+			IAudioClient_Initialize(client, AUDCLNT_SHAREMODE_SHARED, streamFlags, duration_100ns,
+									0, format, 0);
+			IAudioClient_SetEventHandle(client, event);
 			IAudioClient_GetService(client, &IID_IAudioCaptureClient, (void *) &ac->capture);
 			IAudioClient_Start(client);
 			
@@ -108,12 +111,15 @@ static bool AudioCaptureGetData(audio_capture *ac, audio_capture_data *acd, u64
 		return false;
 	}
 	
+	time_rate qpc = TimeRate(ac->freq, 1);
+	timestamp = TimeConvert(timestamp, TIME_RATE_MF, qpc, TIME_NEAREST);
+	
 	if (ac->firstTime) {
 		// first time we check if device timestamp is resonable -
 		// not more than 500 msec away from expected
 		if (expectedTimestamp) {
-			int64_t delta = 1000 * (expectedTimestamp - timestamp);
-			int64_t maxDelta = 500 * ac->freq;
+			int64_t delta = expectedTimestamp - timestamp;
+			int64_t maxDelta = ac->freq / 2;
 			
 			if (delta < -maxDelta || delta > +maxDelta) {
 				ac->useDeviceTimestamp = false;
@@ -127,14 +133,17 @@ static bool AudioCaptureGetData(audio_capture *ac, audio_capture_data *acd, u64
 	}
 	
 	if (ac->useDeviceTimestamp) {
-		acd->time = MFllMulDiv(timestamp, ac->freq, MF_UNITS_PER_SECOND, 0);
+		acd->time = timestamp;
 	} else {
-		acd->time = ac->startQpc + MFllMulDiv(position - ac->startPos, ac->freq,
-													ac->format->nSamplesPerSec, 0);
+		time_rate sampleRate = TimeRate(ac->format->nSamplesPerSec, 1);
+		acd->time = ac->startQpc + TimeConvert(position - ac->startPos, sampleRate, qpc,
+											   TIME_NEAREST);
 	}
 
-	acd->samples = buffer;
+	acd->samples = (flags & AUDCLNT_BUFFERFLAGS_SILENT) ? 0 : buffer;
 	acd->count = frames;
+	acd->position = position;
+	acd->discontinuity = (flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) != 0;
 	return true;
 }
 
@@ -6,6 +6,8 @@
 #include <mfapi.h>
 #include <initguid.h>
 
+#include "timebase.h"
+
 // MF works with 100nsec units
 #define MF_UNITS_PER_SECOND 10000000ULL
 
@@ -22,11 +24,14 @@ typedef struct {
 typedef struct {
 	void *samples;
 	udm count;
-	u64 time; // compatible with QPC 
+	u64 time; // in QPC ticks
+	u64 position; // device frames from start of stream
+	bool discontinuity; // packet doesn't follow previous one
 } audio_capture_data;
 
 // make sure CoInitializeEx has been called before calling Start()
-static bool AudioCaptureStart(audio_capture *ac, u64 duration_100ns);
+// event is set whenever device has new packet, it must be auto reset
+static bool AudioCaptureStart(audio_capture *ac, u64 duration_100ns, HANDLE event);
 static void AudioCaptureStop(audio_capture *ac);
 static void AudioCaptureFlush(audio_capture *ac);
 
@@ -0,0 +1,114 @@
+#include "audio_pump.h"
+
+// true when signaled, false on timeout
+static bool AudioPumpWait(audio_pump *p) {
+	u32 timeout = p->config.timeout;
+#ifdef _WIN32
+	DWORD msec = timeout == AUDIO_PUMP_WAIT_FOREVER ? INFINITE : timeout;
+	return WaitForSingleObject(p->event, msec) == WAIT_OBJECT_0;
+#else
+	bool forever = timeout == AUDIO_PUMP_WAIT_FOREVER;
+	u64 deadline = BOGTimeMsec() + timeout;
+	bool result = false;
+
+	// signaling thread checks flag after it counts signal, so either it sees flag or we see signal
+	BOGAtomicStore(&p->waiting, 1);
+	for (;;) {
+		s32 signals = BOGAtomicLoad(&p->signals);
+		if (signals != p->seen) {
+			p->seen = signals;
+			result = true;
+			break;
+		}
+
+		if (forever) {
+			BOGWaitOnAddress(&p->signals, signals);
+		} else {
+			u64 now = BOGTimeMsec();
+			if (now >= deadline) break;
+			BOGWaitOnAddressTimeout(&p->signals, signals, (u32) (deadline - now));
+		}
+	}
+	BOGAtomicStore(&p->waiting, 0);
+
+	return result;
+#endif
+}
+
+static BOG_THREAD_PROC(AudioPumpThread) {
+	audio_pump *p = (audio_pump *) arg;
+
+#ifdef _WIN32
+	// WASAPI & media foundation are free threaded, data must be taken before device period ends
+	CoInitializeEx(0, COINIT_MULTITHREADED);
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#endif
+
+	for (;;) {
+		bool signaled = AudioPumpWait(p);
+		if (BOGAtomicLoad(&p->quit)) break;
+
+		if (signaled) {
+			p->wakeups++;
+		} else {
+			p->timeouts++;
+		}
+		p->config.drain(p->config.user);
+	}
+
+#ifdef _WIN32
+	CoUninitialize();
+#endif
+	return 0;
+}
+
+static bool AudioPumpCreate(audio_pump *p) {
+	p->running = false;
+	p->quit = 0;
+#ifdef _WIN32
+	p->event = CreateEventW(0, FALSE, FALSE, 0);
+	return p->event != 0;
+#else
+	p->signals = 0;
+	p->waiting = 0;
+	p->seen = 0;
+	return true;
+#endif
+}
+
+static void AudioPumpDestroy(audio_pump *p) {
+	AudioPumpStop(p);
+#ifdef _WIN32
+	if (p->event) CloseHandle(p->event);
+	p->event = 0;
+#endif
+}
+
+static bool AudioPumpStart(audio_pump *p, const audio_pump_config *config) {
+	if (p->running) return false;
+
+	p->config = *config;
+	p->quit = 0;
+	p->wakeups = 0;
+	p->timeouts = 0;
+	p->running = BOGThreadCreate(&p->thread, AudioPumpThread, p);
+	return p->running;
+}
+
+static void AudioPumpStop(audio_pump *p) {
+	if (!p->running) return;
+
+	BOGAtomicStore(&p->quit, 1);
+	AudioPumpSignal(p);
+	BOGThreadJoin(p->thread);
+	p->running = false;
+}
+
+static void AudioPumpSignal(audio_pump *p) {
+#ifdef _WIN32
+	SetEvent(p->event);
+#else
+	BOGAtomicAdd(&p->signals, 1);
+	if (BOGAtomicLoad(&p->waiting)) BOGWakeAll(&p->signals);
+#endif
+}
@@ -0,0 +1,58 @@
+#ifndef AUDIO_PUMP_H
+#define AUDIO_PUMP_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_thread.h"
+
+// drains audio source on its own thread as soon as source signals new data, so packets go on
+// in device period sized steps instead of bursts of timer interval & UI thread stalls don't hold
+// them up, that lets source get by with much smaller buffer
+// on windows source signals event handle, which WASAPI does by itself in event driven mode,
+// elsewhere AudioPumpSignal does it, so any source can drive pump
+// pump also drains after timeout without signal, in case source stops signaling
+
+#define AUDIO_PUMP_WAIT_FOREVER 0xFFFFFFFF
+
+// interface
+
+// reads everything source has, on pump thread
+typedef void audio_pump_func(void *user);
+
+typedef struct {
+	audio_pump_func *drain;
+	void *user;
+	u32 timeout;       // msec, AUDIO_PUMP_WAIT_FOREVER drains only after signal
+} audio_pump_config;
+
+typedef struct {
+	audio_pump_config config;
+	bog_thread thread;
+	bool running;
+	volatile s32 quit;
+#ifdef _WIN32
+	HANDLE event;      // auto reset, for IAudioClient_SetEventHandle
+#else
+	volatile s32 signals;
+	volatile s32 waiting; // set by pump before it sleeps on signals
+	s32 seen;          // signals already drained
+#endif
+
+	// statistics of current run
+	u32 wakeups;       // drains after signal
+	u32 timeouts;      // drains after timeout
+} audio_pump;
+
+// once, event exists from now on so it can be given to source before pump starts
+static bool AudioPumpCreate(audio_pump *p);
+static void AudioPumpDestroy(audio_pump *p);
+
+// starts thread, signals that came before start are not lost
+static bool AudioPumpStart(audio_pump *p, const audio_pump_config *config);
+
+// waits for drain in progress, no drain runs after it returns
+static void AudioPumpStop(audio_pump *p);
+
+// any thread, source has new data
+static void AudioPumpSignal(audio_pump *p);
+
+#endif //AUDIO_PUMP_H
@@ -0,0 +1,79 @@
+#ifndef BOG_CPU_H
+#define BOG_CPU_H
+
+#include "bog_types.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BOG_X86 1
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+// msvc allows any intrinsic inside any function
+#define BOG_TARGET_SSE2
+#define BOG_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define BOG_TARGET_SSE2 __attribute__((target("sse2")))
+#define BOG_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#ifdef _MSC_VER
+#define BOG_ALIGN(n) __declspec(align(n))
+#else
+#define BOG_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+#define BOG_CACHE_LINE 64
+
+typedef enum {
+	BOG_CPU_SCALAR,
+	BOG_CPU_SSE2,
+	BOG_CPU_AVX2
+} bog_cpu_level;
+
+#ifdef BOG_X86
+static void BOGCpuId(u32 leaf, u32 subleaf, u32 *regs) {
+#ifdef _MSC_VER
+	__cpuidex((int *) regs, (int) leaf, (int) subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static u64 BOGCpuXGetBV(void) {
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	u32 lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((u64) hi << 32) | lo;
+#endif
+}
+#endif
+
+// highest instruction set that both cpu and os support
+static bog_cpu_level BOGCpuLevel(void) {
+	bog_cpu_level result = BOG_CPU_SCALAR;
+
+#ifdef BOG_X86
+	u32 regs[4];
+	BOGCpuId(0, 0, regs);
+	u32 maxLeaf = regs[0];
+
+	BOGCpuId(1, 0, regs);
+	if (regs[3] & (1 << 26)) result = BOG_CPU_SSE2;
+
+	// avx2 needs os to save ymm registers (osxsave + xcr0 bits 1 and 2)
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	if (osxsave && maxLeaf >= 7 && (BOGCpuXGetBV() & 6) == 6) {
+		BOGCpuId(7, 0, regs);
+		if (regs[1] & (1 << 5)) result = BOG_CPU_AVX2;
+	}
+#endif
+
+	return result;
+}
+
+#endif //BOG_CPU_H
@@ -0,0 +1,38 @@
+#ifndef BOG_MEMORY_H
+#define BOG_MEMORY_H
+
+// MAP_ANONYMOUS is not in strict C, must be set before first system header
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "bog_types.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// returned memory is zeroed & page aligned
+
+static void * BOGAlloc(udm size) {
+#ifdef _WIN32
+	return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	void *result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return (result == MAP_FAILED) ? 0 : result;
+#endif
+}
+
+static void BOGFree(void *memory, udm size) {
+	if (!memory) return;
+
+#ifdef _WIN32
+	VirtualFree(memory, 0, MEM_RELEASE);
+#else
+	munmap(memory, size);
+#endif
+}
+
+#endif //BOG_MEMORY_H
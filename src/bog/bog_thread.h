@@ -0,0 +1,173 @@
+#ifndef BOG_THREAD_H
+#define BOG_THREAD_H
+
+// futex syscall & CLOCK_MONOTONIC are not in strict C, must be set before first system header
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "bog_types.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// threads, atomics & waiting on address, same semantics on windows & linux
+
+#ifdef _WIN32
+typedef HANDLE bog_thread;
+#define BOG_THREAD_PROC(name) DWORD WINAPI name(void *arg)
+#else
+typedef pthread_t bog_thread;
+#define BOG_THREAD_PROC(name) void * name(void *arg)
+#endif
+
+typedef BOG_THREAD_PROC(bog_thread_proc);
+
+static bool BOGThreadCreate(bog_thread *thread, bog_thread_proc *proc, void *arg) {
+#ifdef _WIN32
+	*thread = CreateThread(0, 0, proc, arg, 0, 0);
+	return *thread != 0;
+#else
+	return pthread_create(thread, 0, proc, arg) == 0;
+#endif
+}
+
+static void BOGThreadJoin(bog_thread thread) {
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, 0);
+#endif
+}
+
+// logical processors available to process
+static u32 BOGThreadCount(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (u32) count : 1;
+#endif
+}
+
+// all atomic operations are sequentially consistent & return new value
+
+static inline s32 BOGAtomicAdd(volatile s32 *value, s32 add) {
+#ifdef _WIN32
+	return InterlockedExchangeAdd((volatile LONG *) value, add) + add;
+#else
+	return __atomic_add_fetch(value, add, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline s32 BOGAtomicLoad(volatile s32 *value) {
+#ifdef _WIN32
+	return InterlockedCompareExchange((volatile LONG *) value, 0, 0);
+#else
+	return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void BOGAtomicStore(volatile s32 *value, s32 store) {
+#ifdef _WIN32
+	InterlockedExchange((volatile LONG *) value, store);
+#else
+	__atomic_store_n(value, store, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline u64 BOGAtomicLoad64(volatile u64 *value) {
+#ifdef _WIN32
+	return (u64) InterlockedCompareExchange64((volatile LONG64 *) value, 0, 0);
+#else
+	return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void BOGAtomicStore64(volatile u64 *value, u64 store) {
+#ifdef _WIN32
+	InterlockedExchange64((volatile LONG64 *) value, (LONG64) store);
+#else
+	__atomic_store_n(value, store, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void * BOGAtomicLoadPointer(void *volatile *value) {
+#ifdef _WIN32
+	return InterlockedCompareExchangePointer(value, 0, 0);
+#else
+	return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void BOGAtomicStorePointer(void *volatile *value, void *store) {
+#ifdef _WIN32
+	InterlockedExchangePointer(value, store);
+#else
+	__atomic_store_n(value, store, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// stores desired only if value equals expected, returns whether it did
+static inline bool BOGAtomicCompareExchange(volatile s32 *value, s32 expected, s32 desired) {
+#ifdef _WIN32
+	return InterlockedCompareExchange((volatile LONG *) value, desired, expected) == expected;
+#else
+	return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST,
+									   __ATOMIC_SEQ_CST);
+#endif
+}
+
+// blocks while *address == value, can return spuriously
+static void BOGWaitOnAddress(volatile s32 *address, s32 value) {
+#ifdef _WIN32
+	WaitOnAddress(address, &value, sizeof(value), INFINITE);
+#else
+	syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, 0, 0, 0);
+#endif
+}
+
+// same as BOGWaitOnAddress, but gives up after msec
+static void BOGWaitOnAddressTimeout(volatile s32 *address, s32 value, u32 msec) {
+#ifdef _WIN32
+	WaitOnAddress(address, &value, sizeof(value), msec);
+#else
+	struct timespec timeout = { (time_t) (msec / 1000), (long) (msec % 1000) * 1000000 };
+	syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, &timeout, 0, 0);
+#endif
+}
+
+static void BOGWakeAll(volatile s32 *address) {
+#ifdef _WIN32
+	WakeByAddressAll((void *) address);
+#else
+	syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+#endif
+}
+
+// monotonic clock for timeouts
+static u64 BOGTimeMsec(void) {
+#ifdef _WIN32
+	LARGE_INTEGER time, frequency;
+	QueryPerformanceCounter(&time);
+	QueryPerformanceFrequency(&frequency);
+	return (u64) time.QuadPart * 1000 / (u64) frequency.QuadPart;
+#else
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (u64) time.tv_sec * 1000 + (u64) time.tv_nsec / 1000000;
+#endif
+}
+
+#endif //BOG_THREAD_H
@@ -1,6 +1,12 @@
 #ifndef BOG_TYPES_H
 #define BOG_TYPES_H
 
+// first header of every module, so strict C builds still see posix & linux extensions
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -0,0 +1,1406 @@
+#include "convert.h"
+
+// all kernels must produce bit identical output, so every one of them evaluates float expressions in
+// exactly same order as scalar version:
+//   Y  = ((R * m0 + G * m1) + B * m2) + m3, truncated to integer like uint() cast in shader
+//   UV = ((uv00 + uv01) + (uv10 + uv11)) * 0.25, average of 2x2 block
+// that also means no fused multiply-add contraction, msvc /fp:precise never contracts, gcc & clang
+// need -ffp-contract=off when targeting cpu with FMA
+//
+// kernels are stamped out by CONVERT_KERNEL_* macros from per format load & store functions:
+//   load turns pixels into R/G/B floats in [0..input max] range that matrix expects
+//   store truncates & clamps results to output sample range
+// scRGB load also applies primaries matrix & transfer function, see ConvertSetTransfer
+//
+// integer inputs also have fixed point kernels, those work on 16-bit values & pmaddwd, so they are
+// exact by construction & every cpu level gives same output too
+
+#define CONVERT_PIXEL_BGRA8 4
+#define CONVERT_PIXEL_RGBA8 4
+#define CONVERT_PIXEL_RGB10A2 4
+#define CONVERT_PIXEL_RGBA16F 8
+#define CONVERT_PIXEL_SCRGB 8
+
+#define CONVERT_SAMPLE_NV12 1
+#define CONVERT_SAMPLE_P010 2
+
+// transfer lookup table is indexed by exponent & top 8 mantissa bits of float, that is 256 linearly
+// interpolated entries per octave from 2^-40 up to 1, smaller values get first entry
+#define CONVERT_TRANSFER_OCTAVES 40
+#define CONVERT_TRANSFER_SHIFT 15
+#define CONVERT_TRANSFER_BASE ((127 - CONVERT_TRANSFER_OCTAVES) << (23 - CONVERT_TRANSFER_SHIFT))
+#define CONVERT_TRANSFER_SIZE ((CONVERT_TRANSFER_OCTAVES << (23 - CONVERT_TRANSFER_SHIFT)) + 2)
+
+static convert_rows *gConvertKernels[CONVERT_INPUT_COUNT][CONVERT_OUTPUT_COUNT];
+static convert_fixed_rows *gConvertFixedKernels[CONVERT_INPUT_COUNT][CONVERT_OUTPUT_COUNT];
+static bog_cpu_level gConvertLevel;
+
+static f32 gConvertTransfer[CONVERT_TRANSFER_SIZE];
+static f32 gConvertPrimaries[3][3]; // scRGB to output primaries, scaled to [0..1] of transfer input
+static bool gConvertTransferReady;
+
+static inline f32 ConvertDot(const f32 *row, f32 r, f32 g, f32 b) {
+	return ((r * row[0] + g * row[1]) + b * row[2]) + row[3];
+}
+
+static inline s32 ConvertClamp(f32 value, s32 max) {
+	s32 result = (s32) value;
+	return result < 0 ? 0 : result > max ? max : result;
+}
+
+// NaN becomes 0
+static inline f32 ConvertSaturate(f32 value) {
+	return value > 0 ? (value < 1 ? value : 1) : 0;
+}
+
+// exact for every half value, infinities & NaNs become large finite numbers
+static inline f32 ConvertHalfLinear(u16 half) {
+	union { u32 u; f32 f; } bits, scale;
+	bits.u = (u32) (half & 0x7fff) << 13;
+	scale.u = 0x77800000; // 2^112, moves half exponent bias to float one
+	bits.f *= scale.f;
+	bits.u |= (u32) (half & 0x8000) << 16;
+
+	return bits.f;
+}
+
+static inline f32 ConvertHalf(u16 half) {
+	return ConvertSaturate(ConvertHalfLinear(half));
+}
+
+// transfer function of value in [0..1]
+static inline f32 ConvertLookup(f32 value) {
+	union { f32 f; u32 u; } bits;
+	bits.f = value;
+
+	s32 index = (s32) (bits.u >> CONVERT_TRANSFER_SHIFT) - CONVERT_TRANSFER_BASE;
+	f32 frac = (f32) (bits.u & ((1 << CONVERT_TRANSFER_SHIFT) - 1)) *
+			   (1.f / (1 << CONVERT_TRANSFER_SHIFT));
+	if (index < 0) {
+		index = 0;
+		frac = 0;
+	}
+
+	const f32 *t = gConvertTransfer + index;
+	return t[0] + (t[1] - t[0]) * frac;
+}
+
+static inline void ConvertLoadBGRA8(const u8 *p, f32 *r, f32 *g, f32 *b) {
+	*r = p[2];
+	*g = p[1];
+	*b = p[0];
+}
+
+static inline void ConvertLoadRGBA8(const u8 *p, f32 *r, f32 *g, f32 *b) {
+	*r = p[0];
+	*g = p[1];
+	*b = p[2];
+}
+
+static inline void ConvertLoadRGB10A2(const u8 *p, f32 *r, f32 *g, f32 *b) {
+	u32 value = p[0] | (p[1] << 8) | (p[2] << 16) | ((u32) p[3] << 24);
+	*r = (f32) (value & 0x3ff);
+	*g = (f32) ((value >> 10) & 0x3ff);
+	*b = (f32) ((value >> 20) & 0x3ff);
+}
+
+static inline void ConvertLoadRGBA16F(const u8 *p, f32 *r, f32 *g, f32 *b) {
+	*r = ConvertHalf((u16) (p[0] | (p[1] << 8)));
+	*g = ConvertHalf((u16) (p[2] | (p[3] << 8)));
+	*b = ConvertHalf((u16) (p[4] | (p[5] << 8)));
+}
+
+static inline void ConvertLoadSCRGB(const u8 *p, f32 *r, f32 *g, f32 *b) {
+	f32 x = ConvertHalfLinear((u16) (p[0] | (p[1] << 8)));
+	f32 y = ConvertHalfLinear((u16) (p[2] | (p[3] << 8)));
+	f32 z = ConvertHalfLinear((u16) (p[4] | (p[5] << 8)));
+
+	f32 (*m)[3] = gConvertPrimaries;
+	*r = ConvertLookup(ConvertSaturate((x * m[0][0] + y * m[0][1]) + z * m[0][2]));
+	*g = ConvertLookup(ConvertSaturate((x * m[1][0] + y * m[1][1]) + z * m[1][2]));
+	*b = ConvertLookup(ConvertSaturate((x * m[2][0] + y * m[2][1]) + z * m[2][2]));
+}
+
+static inline void ConvertStoreNV12(void *dstY0, void *dstY1, void *dstUV, u32 i, const f32 *y,
+									f32 u, f32 v) {
+	u8 *y0 = (u8 *) dstY0 + 2 * i;
+	u8 *y1 = (u8 *) dstY1 + 2 * i;
+	u8 *uv = (u8 *) dstUV + 2 * i;
+
+	y0[0] = (u8) ConvertClamp(y[0], 255);
+	y0[1] = (u8) ConvertClamp(y[1], 255);
+	y1[0] = (u8) ConvertClamp(y[2], 255);
+	y1[1] = (u8) ConvertClamp(y[3], 255);
+	uv[0] = (u8) ConvertClamp(u, 255);
+	uv[1] = (u8) ConvertClamp(v, 255);
+}
+
+static inline void ConvertStoreP010(void *dstY0, void *dstY1, void *dstUV, u32 i, const f32 *y,
+									f32 u, f32 v) {
+	u16 *y0 = (u16 *) dstY0 + 2 * i;
+	u16 *y1 = (u16 *) dstY1 + 2 * i;
+	u16 *uv = (u16 *) dstUV + 2 * i;
+
+	y0[0] = (u16) (ConvertClamp(y[0], 1023) << 6);
+	y0[1] = (u16) (ConvertClamp(y[1], 1023) << 6);
+	y1[0] = (u16) (ConvertClamp(y[2], 1023) << 6);
+	y1[1] = (u16) (ConvertClamp(y[3], 1023) << 6);
+	uv[0] = (u16) (ConvertClamp(u, 1023) << 6);
+	uv[1] = (u16) (ConvertClamp(v, 1023) << 6);
+}
+
+// pixels 0 & 1 are from first row, 2 & 3 from second one
+static inline void ConvertBlock(const convert_matrix *m, const f32 *r, const f32 *g, const f32 *b,
+								f32 *y, f32 *u, f32 *v) {
+	for (u32 k = 0; k < 4; ++k) {
+		y[k] = ConvertDot(m->m[0], r[k], g[k], b[k]);
+	}
+
+	*u = ((ConvertDot(m->m[1], r[0], g[0], b[0]) + ConvertDot(m->m[1], r[1], g[1], b[1])) +
+		  (ConvertDot(m->m[1], r[2], g[2], b[2]) + ConvertDot(m->m[1], r[3], g[3], b[3]))) * 0.25f;
+	*v = ((ConvertDot(m->m[2], r[0], g[0], b[0]) + ConvertDot(m->m[2], r[1], g[1], b[1])) +
+		  (ConvertDot(m->m[2], r[2], g[2], b[2]) + ConvertDot(m->m[2], r[3], g[3], b[3]))) * 0.25f;
+}
+
+#define CONVERT_KERNEL_SCALAR(in, out)															\
+static void Convert##in##To##out##Scalar(const convert_matrix *m, const void *src0,				\
+										 const void *src1, void *dstY0, void *dstY1,			\
+										 void *dstUV, u32 count) {								\
+	for (u32 i = 0; i < count; ++i) {															\
+		const u8 *p0 = (const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in;							\
+		const u8 *p1 = (const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in;							\
+		f32 r[4], g[4], b[4];																	\
+		ConvertLoad##in(p0, &r[0], &g[0], &b[0]);												\
+		ConvertLoad##in(p0 + CONVERT_PIXEL_##in, &r[1], &g[1], &b[1]);							\
+		ConvertLoad##in(p1, &r[2], &g[2], &b[2]);												\
+		ConvertLoad##in(p1 + CONVERT_PIXEL_##in, &r[3], &g[3], &b[3]);							\
+																								\
+		f32 y[4], u, v;																			\
+		ConvertBlock(m, r, g, b, y, &u, &v);													\
+		ConvertStore##out(dstY0, dstY1, dstUV, i, y, u, v);										\
+	}																							\
+}
+
+CONVERT_KERNEL_SCALAR(BGRA8, NV12)
+CONVERT_KERNEL_SCALAR(BGRA8, P010)
+CONVERT_KERNEL_SCALAR(RGBA8, NV12)
+CONVERT_KERNEL_SCALAR(RGBA8, P010)
+CONVERT_KERNEL_SCALAR(RGB10A2, NV12)
+CONVERT_KERNEL_SCALAR(RGB10A2, P010)
+CONVERT_KERNEL_SCALAR(RGBA16F, NV12)
+CONVERT_KERNEL_SCALAR(RGBA16F, P010)
+CONVERT_KERNEL_SCALAR(SCRGB, NV12)
+CONVERT_KERNEL_SCALAR(SCRGB, P010)
+
+static inline s32 ConvertClampFixed(s32 value, s32 max) {
+	return value < 0 ? 0 : value > max ? max : value;
+}
+
+static inline void ConvertFixedLoadBGRA8(const u8 *p, s32 *r, s32 *g, s32 *b) {
+	*r = p[2];
+	*g = p[1];
+	*b = p[0];
+}
+
+static inline void ConvertFixedLoadRGBA8(const u8 *p, s32 *r, s32 *g, s32 *b) {
+	*r = p[0];
+	*g = p[1];
+	*b = p[2];
+}
+
+static inline void ConvertFixedLoadRGB10A2(const u8 *p, s32 *r, s32 *g, s32 *b) {
+	u32 value = p[0] | (p[1] << 8) | (p[2] << 16) | ((u32) p[3] << 24);
+	*r = value & 0x3ff;
+	*g = (value >> 10) & 0x3ff;
+	*b = (value >> 20) & 0x3ff;
+}
+
+static inline void ConvertFixedStoreNV12(void *dstY0, void *dstY1, void *dstUV, u32 i, const s32 *y,
+										 s32 u, s32 v) {
+	u8 *y0 = (u8 *) dstY0 + 2 * i;
+	u8 *y1 = (u8 *) dstY1 + 2 * i;
+	u8 *uv = (u8 *) dstUV + 2 * i;
+
+	y0[0] = (u8) ConvertClampFixed(y[0], 255);
+	y0[1] = (u8) ConvertClampFixed(y[1], 255);
+	y1[0] = (u8) ConvertClampFixed(y[2], 255);
+	y1[1] = (u8) ConvertClampFixed(y[3], 255);
+	uv[0] = (u8) ConvertClampFixed(u, 255);
+	uv[1] = (u8) ConvertClampFixed(v, 255);
+}
+
+static inline void ConvertFixedStoreP010(void *dstY0, void *dstY1, void *dstUV, u32 i, const s32 *y,
+										 s32 u, s32 v) {
+	u16 *y0 = (u16 *) dstY0 + 2 * i;
+	u16 *y1 = (u16 *) dstY1 + 2 * i;
+	u16 *uv = (u16 *) dstUV + 2 * i;
+
+	y0[0] = (u16) (ConvertClampFixed(y[0], 1023) << 6);
+	y0[1] = (u16) (ConvertClampFixed(y[1], 1023) << 6);
+	y1[0] = (u16) (ConvertClampFixed(y[2], 1023) << 6);
+	y1[1] = (u16) (ConvertClampFixed(y[3], 1023) << 6);
+	uv[0] = (u16) (ConvertClampFixed(u, 1023) << 6);
+	uv[1] = (u16) (ConvertClampFixed(v, 1023) << 6);
+}
+
+static inline s32 ConvertDotFixed(const s16 *row, s32 r, s32 g, s32 b) {
+	return r * row[0] + g * row[1] + b * row[2];
+}
+
+// chroma is computed from sums of 2x2 block, that is same as average of its 4 values
+static inline void ConvertBlockFixed(const convert_fixed *f, const s32 *r, const s32 *g,
+									 const s32 *b, s32 *y, s32 *u, s32 *v) {
+	for (u32 k = 0; k < 4; ++k) {
+		y[k] = (ConvertDotFixed(f->m[0], r[k], g[k], b[k]) + f->offset[0]) >> f->shift;
+	}
+
+	s32 sr = (r[0] + r[1]) + (r[2] + r[3]);
+	s32 sg = (g[0] + g[1]) + (g[2] + g[3]);
+	s32 sb = (b[0] + b[1]) + (b[2] + b[3]);
+	*u = (ConvertDotFixed(f->m[1], sr, sg, sb) + 4 * f->offset[1]) >> (f->shift + 2);
+	*v = (ConvertDotFixed(f->m[2], sr, sg, sb) + 4 * f->offset[2]) >> (f->shift + 2);
+}
+
+#define CONVERT_FIXED_KERNEL_SCALAR(in, out)													\
+static void ConvertFixed##in##To##out##Scalar(const convert_fixed *f, const void *src0,			\
+											  const void *src1, void *dstY0, void *dstY1,		\
+											  void *dstUV, u32 count) {							\
+	for (u32 i = 0; i < count; ++i) {															\
+		const u8 *p0 = (const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in;							\
+		const u8 *p1 = (const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in;							\
+		s32 r[4], g[4], b[4];																	\
+		ConvertFixedLoad##in(p0, &r[0], &g[0], &b[0]);											\
+		ConvertFixedLoad##in(p0 + CONVERT_PIXEL_##in, &r[1], &g[1], &b[1]);						\
+		ConvertFixedLoad##in(p1, &r[2], &g[2], &b[2]);											\
+		ConvertFixedLoad##in(p1 + CONVERT_PIXEL_##in, &r[3], &g[3], &b[3]);						\
+																								\
+		s32 y[4], u, v;																			\
+		ConvertBlockFixed(f, r, g, b, y, &u, &v);												\
+		ConvertFixedStore##out(dstY0, dstY1, dstUV, i, y, u, v);								\
+	}																							\
+}
+
+CONVERT_FIXED_KERNEL_SCALAR(BGRA8, NV12)
+CONVERT_FIXED_KERNEL_SCALAR(BGRA8, P010)
+CONVERT_FIXED_KERNEL_SCALAR(RGBA8, NV12)
+CONVERT_FIXED_KERNEL_SCALAR(RGBA8, P010)
+CONVERT_FIXED_KERNEL_SCALAR(RGB10A2, NV12)
+CONVERT_FIXED_KERNEL_SCALAR(RGB10A2, P010)
+
+#ifdef BOG_X86
+// R/G/B floats of left (0) & right (1) pixel of consecutive 2x2 blocks
+typedef struct {
+	__m128 r[2], g[2], b[2];
+} convert_pixels_sse2;
+
+BOG_TARGET_SSE2
+static inline void ConvertUnpackSSE2(__m128i px, s32 shiftR, s32 shiftG, s32 shiftB, s32 mask,
+									 __m128 *r, __m128 *g, __m128 *b) {
+	__m128i m = _mm_set1_epi32(mask);
+	*r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(px, _mm_cvtsi32_si128(shiftR)), m));
+	*g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(px, _mm_cvtsi32_si128(shiftG)), m));
+	*b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(px, _mm_cvtsi32_si128(shiftB)), m));
+}
+
+// 8 pixels of 32-bit format = 4 blocks
+BOG_TARGET_SSE2
+static inline void ConvertLoad32SSE2(const u8 *src, s32 shiftR, s32 shiftG, s32 shiftB, s32 mask,
+									 convert_pixels_sse2 *p) {
+	__m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) (src + 0)));
+	__m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) (src + 16)));
+
+	// split into left & right pixel of each block
+	__m128i left = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i right = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+	ConvertUnpackSSE2(left, shiftR, shiftG, shiftB, mask, &p->r[0], &p->g[0], &p->b[0]);
+	ConvertUnpackSSE2(right, shiftR, shiftG, shiftB, mask, &p->r[1], &p->g[1], &p->b[1]);
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertLoadBGRA8SSE2(const u8 *src, convert_pixels_sse2 *p) {
+	ConvertLoad32SSE2(src, 16, 8, 0, 0xff, p);
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertLoadRGBA8SSE2(const u8 *src, convert_pixels_sse2 *p) {
+	ConvertLoad32SSE2(src, 0, 8, 16, 0xff, p);
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertLoadRGB10A2SSE2(const u8 *src, convert_pixels_sse2 *p) {
+	ConvertLoad32SSE2(src, 0, 10, 20, 0x3ff, p);
+}
+
+// max returns second operand for NaN, which scalar version turns into 0 too
+BOG_TARGET_SSE2
+static inline __m128 ConvertSaturateSSE2(__m128 value) {
+	return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.f));
+}
+
+// same integer trick as ConvertHalfLinear, on 32-bit lanes holding 16-bit values
+BOG_TARGET_SSE2
+static inline __m128 ConvertHalfLinearSSE2(__m128i half) {
+	__m128i bits = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x7fff)), 13);
+	__m128 value = _mm_mul_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+	__m128i sign = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x8000)), 16);
+	return _mm_or_ps(value, _mm_castsi128_ps(sign));
+}
+
+// 4 pixels as 4 x 16-bit channels, returns R/G/B halves as 32-bit lanes
+BOG_TARGET_SSE2
+static inline void ConvertTransposeHalfSSE2(__m128i a, __m128i b, __m128i *h) {
+	// a = p0 p1, b = p2 p3 -> r0 r2 g0 g2 b0 b2 a0 a2 | r1 r3 g1 g3 b1 b3 a1 a3
+	__m128i zero = _mm_setzero_si128();
+	__m128i t0 = _mm_unpacklo_epi16(a, b);
+	__m128i t1 = _mm_unpackhi_epi16(a, b);
+	__m128i rg = _mm_unpacklo_epi16(t0, t1);
+	__m128i ba = _mm_unpackhi_epi16(t0, t1);
+	h[0] = _mm_unpacklo_epi16(rg, zero);
+	h[1] = _mm_unpackhi_epi16(rg, zero);
+	h[2] = _mm_unpacklo_epi16(ba, zero);
+}
+
+// 8 pixels of 64-bit format = 4 blocks, R/G/B of left pixels go to h[0..2], right ones to h[3..5]
+BOG_TARGET_SSE2
+static inline void ConvertLoad64SSE2(const u8 *src, __m128i *h) {
+	__m128i q0 = _mm_loadu_si128((const __m128i *) (src + 0));
+	__m128i q1 = _mm_loadu_si128((const __m128i *) (src + 16));
+	__m128i q2 = _mm_loadu_si128((const __m128i *) (src + 32));
+	__m128i q3 = _mm_loadu_si128((const __m128i *) (src + 48));
+
+	// left pixels are low halves of each register, right pixels high halves
+	ConvertTransposeHalfSSE2(_mm_unpacklo_epi64(q0, q1), _mm_unpacklo_epi64(q2, q3), h + 0);
+	ConvertTransposeHalfSSE2(_mm_unpackhi_epi64(q0, q1), _mm_unpackhi_epi64(q2, q3), h + 3);
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertLoadRGBA16FSSE2(const u8 *src, convert_pixels_sse2 *p) {
+	__m128i h[6];
+	ConvertLoad64SSE2(src, h);
+
+	for (u32 k = 0; k < 2; ++k) {
+		p->r[k] = ConvertSaturateSSE2(ConvertHalfLinearSSE2(h[3 * k + 0]));
+		p->g[k] = ConvertSaturateSSE2(ConvertHalfLinearSSE2(h[3 * k + 1]));
+		p->b[k] = ConvertSaturateSSE2(ConvertHalfLinearSSE2(h[3 * k + 2]));
+	}
+}
+
+// same as ConvertLookup, table has no gather in SSE2 so entries are loaded one by one
+BOG_TARGET_SSE2
+static inline __m128 ConvertLookupSSE2(__m128 value) {
+	__m128i bits = _mm_castps_si128(value);
+	__m128i index = _mm_sub_epi32(_mm_srli_epi32(bits, CONVERT_TRANSFER_SHIFT),
+								  _mm_set1_epi32(CONVERT_TRANSFER_BASE));
+	__m128i mantissa = _mm_and_si128(bits, _mm_set1_epi32((1 << CONVERT_TRANSFER_SHIFT) - 1));
+	__m128 frac = _mm_mul_ps(_mm_cvtepi32_ps(mantissa),
+							 _mm_set1_ps(1.f / (1 << CONVERT_TRANSFER_SHIFT)));
+
+	__m128i below = _mm_cmplt_epi32(index, _mm_setzero_si128());
+	index = _mm_andnot_si128(below, index);
+	frac = _mm_andnot_ps(_mm_castsi128_ps(below), frac);
+
+	s32 i[4];
+	_mm_storeu_si128((__m128i *) i, index);
+
+	const f32 *t = gConvertTransfer;
+	__m128 a = _mm_setr_ps(t[i[0]], t[i[1]], t[i[2]], t[i[3]]);
+	__m128 b = _mm_setr_ps(t[i[0] + 1], t[i[1] + 1], t[i[2] + 1], t[i[3] + 1]);
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), frac));
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertLoadSCRGBSSE2(const u8 *src, convert_pixels_sse2 *p) {
+	__m128i h[6];
+	ConvertLoad64SSE2(src, h);
+
+	__m128 m[3][3];
+	for (u32 row = 0; row < 3; ++row) {
+		for (u32 col = 0; col < 3; ++col) {
+			m[row][col] = _mm_set1_ps(gConvertPrimaries[row][col]);
+		}
+	}
+
+	for (u32 k = 0; k < 2; ++k) {
+		__m128 x = ConvertHalfLinearSSE2(h[3 * k + 0]);
+		__m128 y = ConvertHalfLinearSSE2(h[3 * k + 1]);
+		__m128 z = ConvertHalfLinearSSE2(h[3 * k + 2]);
+
+		__m128 *out[3] = { &p->r[k], &p->g[k], &p->b[k] };
+		for (u32 row = 0; row < 3; ++row) {
+			__m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[row][0]),
+												 _mm_mul_ps(y, m[row][1])),
+									  _mm_mul_ps(z, m[row][2]));
+			*out[row] = ConvertLookupSSE2(ConvertSaturateSSE2(value));
+		}
+	}
+}
+
+// left & right values of 4 blocks into 8 ordered 16-bit values, saturated
+BOG_TARGET_SSE2
+static inline __m128i ConvertInterleaveSSE2(__m128 left, __m128 right) {
+	__m128i a = _mm_cvttps_epi32(left);
+	__m128i b = _mm_cvttps_epi32(right);
+	return _mm_packs_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertStoreNV12SSE2(void *dstY0, void *dstY1, void *dstUV, const __m128 *y,
+										__m128 u, __m128 v) {
+	__m128i row0 = ConvertInterleaveSSE2(y[0], y[1]);
+	__m128i row1 = ConvertInterleaveSSE2(y[2], y[3]);
+	__m128i uv = ConvertInterleaveSSE2(u, v);
+	_mm_storel_epi64((__m128i *) dstY0, _mm_packus_epi16(row0, row0));
+	_mm_storel_epi64((__m128i *) dstY1, _mm_packus_epi16(row1, row1));
+	_mm_storel_epi64((__m128i *) dstUV, _mm_packus_epi16(uv, uv));
+}
+
+BOG_TARGET_SSE2
+static inline __m128i ConvertClamp10SSE2(__m128i words) {
+	words = _mm_min_epi16(_mm_max_epi16(words, _mm_setzero_si128()), _mm_set1_epi16(1023));
+	return _mm_slli_epi16(words, 6);
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertStoreP010SSE2(void *dstY0, void *dstY1, void *dstUV, const __m128 *y,
+										__m128 u, __m128 v) {
+	_mm_storeu_si128((__m128i *) dstY0, ConvertClamp10SSE2(ConvertInterleaveSSE2(y[0], y[1])));
+	_mm_storeu_si128((__m128i *) dstY1, ConvertClamp10SSE2(ConvertInterleaveSSE2(y[2], y[3])));
+	_mm_storeu_si128((__m128i *) dstUV, ConvertClamp10SSE2(ConvertInterleaveSSE2(u, v)));
+}
+
+#define CONVERT_DOT_SSE2(row, r, g, b)												\
+	_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r, row[0]), _mm_mul_ps(g, row[1])),	\
+						  _mm_mul_ps(b, row[2])), row[3])
+
+#define CONVERT_KERNEL_SSE2(in, out)															\
+BOG_TARGET_SSE2																					\
+static void Convert##in##To##out##SSE2(const convert_matrix *m, const void *src0,				\
+									   const void *src1, void *dstY0, void *dstY1,				\
+									   void *dstUV, u32 count) {								\
+	__m128 my[4], mu[4], mv[4];																	\
+	for (u32 k = 0; k < 4; ++k) {																\
+		my[k] = _mm_set1_ps(m->m[0][k]);														\
+		mu[k] = _mm_set1_ps(m->m[1][k]);														\
+		mv[k] = _mm_set1_ps(m->m[2][k]);														\
+	}																							\
+																								\
+	__m128 quarter = _mm_set1_ps(0.25f);														\
+																								\
+	/* 4 blocks = 8 pixels from each row per iteration */										\
+	u32 i = 0;																					\
+	for (; i + 4 <= count; i += 4) {															\
+		convert_pixels_sse2 a, b;																\
+		ConvertLoad##in##SSE2((const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in, &a);				\
+		ConvertLoad##in##SSE2((const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in, &b);				\
+																								\
+		__m128 y[4] = {																			\
+			CONVERT_DOT_SSE2(my, a.r[0], a.g[0], a.b[0]),										\
+			CONVERT_DOT_SSE2(my, a.r[1], a.g[1], a.b[1]),										\
+			CONVERT_DOT_SSE2(my, b.r[0], b.g[0], b.b[0]),										\
+			CONVERT_DOT_SSE2(my, b.r[1], b.g[1], b.b[1]),										\
+		};																						\
+		__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(CONVERT_DOT_SSE2(mu, a.r[0], a.g[0], a.b[0]),	\
+													CONVERT_DOT_SSE2(mu, a.r[1], a.g[1], a.b[1])),	\
+										 _mm_add_ps(CONVERT_DOT_SSE2(mu, b.r[0], b.g[0], b.b[0]),	\
+													CONVERT_DOT_SSE2(mu, b.r[1], b.g[1], b.b[1]))),	\
+							  quarter);															\
+		__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(CONVERT_DOT_SSE2(mv, a.r[0], a.g[0], a.b[0]),	\
+													CONVERT_DOT_SSE2(mv, a.r[1], a.g[1], a.b[1])),	\
+										 _mm_add_ps(CONVERT_DOT_SSE2(mv, b.r[0], b.g[0], b.b[0]),	\
+													CONVERT_DOT_SSE2(mv, b.r[1], b.g[1], b.b[1]))),	\
+							  quarter);															\
+																								\
+		udm offset = 2 * i * CONVERT_SAMPLE_##out;												\
+		ConvertStore##out##SSE2((u8 *) dstY0 + offset, (u8 *) dstY1 + offset,					\
+								(u8 *) dstUV + offset, y, u, v);								\
+	}																							\
+																								\
+	udm offset = 2 * i * CONVERT_SAMPLE_##out;													\
+	Convert##in##To##out##Scalar(m, (const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in,				\
+								 (const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in,				\
+								 (u8 *) dstY0 + offset, (u8 *) dstY1 + offset,					\
+								 (u8 *) dstUV + offset, count - i);								\
+}
+
+CONVERT_KERNEL_SSE2(BGRA8, NV12)
+CONVERT_KERNEL_SSE2(BGRA8, P010)
+CONVERT_KERNEL_SSE2(RGBA8, NV12)
+CONVERT_KERNEL_SSE2(RGBA8, P010)
+CONVERT_KERNEL_SSE2(RGB10A2, NV12)
+CONVERT_KERNEL_SSE2(RGB10A2, P010)
+CONVERT_KERNEL_SSE2(RGBA16F, NV12)
+CONVERT_KERNEL_SSE2(RGBA16F, P010)
+CONVERT_KERNEL_SSE2(SCRGB, NV12)
+CONVERT_KERNEL_SSE2(SCRGB, P010)
+
+// fixed point kernels keep every pixel as 4 words, so one pmaddwd does 2 pixels and pairs of its
+// results are added into dot products, 8-bit formats keep channels in memory order & coefficients
+// get swapped instead, alpha word is multiplied by 0
+#define CONVERT_FIXED_SWAP_BGRA8 true
+#define CONVERT_FIXED_SWAP_RGBA8 false
+#define CONVERT_FIXED_SWAP_RGB10A2 false
+
+// 4 pixels into words, lo gets pixels 0 & 1, hi pixels 2 & 3
+BOG_TARGET_SSE2
+static inline void ConvertFixedWords8SSE2(__m128i px, __m128i *lo, __m128i *hi) {
+	*lo = _mm_unpacklo_epi8(px, _mm_setzero_si128());
+	*hi = _mm_unpackhi_epi8(px, _mm_setzero_si128());
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertFixedWordsBGRA8SSE2(__m128i px, __m128i *lo, __m128i *hi) {
+	ConvertFixedWords8SSE2(px, lo, hi);
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertFixedWordsRGBA8SSE2(__m128i px, __m128i *lo, __m128i *hi) {
+	ConvertFixedWords8SSE2(px, lo, hi);
+}
+
+// R, G, B, 0 words
+BOG_TARGET_SSE2
+static inline void ConvertFixedWordsRGB10A2SSE2(__m128i px, __m128i *lo, __m128i *hi) {
+	__m128i rg = _mm_or_si128(_mm_and_si128(px, _mm_set1_epi32(0x3ff)),
+							  _mm_and_si128(_mm_slli_epi32(px, 6), _mm_set1_epi32(0x3ff0000)));
+	__m128i b = _mm_and_si128(_mm_srli_epi32(px, 20), _mm_set1_epi32(0x3ff));
+	*lo = _mm_unpacklo_epi32(rg, b);
+	*hi = _mm_unpackhi_epi32(rg, b);
+}
+
+BOG_TARGET_SSE2
+static inline __m128i ConvertFixedRowSSE2(const s16 *row, bool swap) {
+	s16 first = swap ? row[2] : row[0];
+	s16 last = swap ? row[0] : row[2];
+	return _mm_setr_epi16(first, row[1], last, 0, first, row[1], last, 0);
+}
+
+// dot products of 4 pixels, a has words of pixels 0 & 1, b of pixels 2 & 3
+BOG_TARGET_SSE2
+static inline __m128i ConvertFixedDotSSE2(__m128i a, __m128i b, __m128i row) {
+	__m128 x = _mm_castsi128_ps(_mm_madd_epi16(a, row));
+	__m128 y = _mm_castsi128_ps(_mm_madd_epi16(b, row));
+	return _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0))),
+						 _mm_castps_si128(_mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1))));
+}
+
+BOG_TARGET_SSE2
+static inline __m128i ConvertFixedScaleSSE2(__m128i dot, __m128i offset, __m128i shift) {
+	return _mm_sra_epi32(_mm_add_epi32(dot, offset), shift);
+}
+
+// words of 2 pixels from both rows of block, sums of block are in low 4 words
+BOG_TARGET_SSE2
+static inline __m128i ConvertFixedBlockSSE2(__m128i row0, __m128i row1) {
+	__m128i sum = _mm_add_epi16(row0, row1);
+	return _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertFixedStoreNV12SSE2(void *dstY0, void *dstY1, void *dstUV, __m128i y0,
+											 __m128i y1, __m128i uv) {
+	_mm_storel_epi64((__m128i *) dstY0, _mm_packus_epi16(y0, y0));
+	_mm_storel_epi64((__m128i *) dstY1, _mm_packus_epi16(y1, y1));
+	_mm_storel_epi64((__m128i *) dstUV, _mm_packus_epi16(uv, uv));
+}
+
+BOG_TARGET_SSE2
+static inline void ConvertFixedStoreP010SSE2(void *dstY0, void *dstY1, void *dstUV, __m128i y0,
+											 __m128i y1, __m128i uv) {
+	_mm_storeu_si128((__m128i *) dstY0, ConvertClamp10SSE2(y0));
+	_mm_storeu_si128((__m128i *) dstY1, ConvertClamp10SSE2(y1));
+	_mm_storeu_si128((__m128i *) dstUV, ConvertClamp10SSE2(uv));
+}
+
+#define CONVERT_FIXED_KERNEL_SSE2(in, out)														\
+BOG_TARGET_SSE2																					\
+static void ConvertFixed##in##To##out##SSE2(const convert_fixed *f, const void *src0,			\
+											const void *src1, void *dstY0, void *dstY1,			\
+											void *dstUV, u32 count) {							\
+	__m128i my = ConvertFixedRowSSE2(f->m[0], CONVERT_FIXED_SWAP_##in);							\
+	__m128i mu = ConvertFixedRowSSE2(f->m[1], CONVERT_FIXED_SWAP_##in);							\
+	__m128i mv = ConvertFixedRowSSE2(f->m[2], CONVERT_FIXED_SWAP_##in);							\
+	__m128i oy = _mm_set1_epi32(f->offset[0]);													\
+	__m128i ou = _mm_set1_epi32(4 * f->offset[1]);												\
+	__m128i ov = _mm_set1_epi32(4 * f->offset[2]);												\
+	__m128i shiftY = _mm_cvtsi32_si128((s32) f->shift);											\
+	__m128i shiftUV = _mm_cvtsi32_si128((s32) f->shift + 2);									\
+																								\
+	/* 4 blocks = 8 pixels from each row per iteration */										\
+	u32 i = 0;																					\
+	for (; i + 4 <= count; i += 4) {															\
+		const u8 *p0 = (const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in;							\
+		const u8 *p1 = (const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in;							\
+		__m128i a[4], b[4];																		\
+		ConvertFixedWords##in##SSE2(_mm_loadu_si128((const __m128i *) p0), &a[0], &a[1]);		\
+		ConvertFixedWords##in##SSE2(_mm_loadu_si128((const __m128i *) p0 + 1), &a[2], &a[3]);	\
+		ConvertFixedWords##in##SSE2(_mm_loadu_si128((const __m128i *) p1), &b[0], &b[1]);		\
+		ConvertFixedWords##in##SSE2(_mm_loadu_si128((const __m128i *) p1 + 1), &b[2], &b[3]);	\
+																								\
+		__m128i y0 = _mm_packs_epi32(ConvertFixedScaleSSE2(ConvertFixedDotSSE2(a[0], a[1], my),	\
+														   oy, shiftY),							\
+									 ConvertFixedScaleSSE2(ConvertFixedDotSSE2(a[2], a[3], my),	\
+														   oy, shiftY));						\
+		__m128i y1 = _mm_packs_epi32(ConvertFixedScaleSSE2(ConvertFixedDotSSE2(b[0], b[1], my),	\
+														   oy, shiftY),							\
+									 ConvertFixedScaleSSE2(ConvertFixedDotSSE2(b[2], b[3], my),	\
+														   oy, shiftY));						\
+																								\
+		__m128i blocks01 = _mm_unpacklo_epi64(ConvertFixedBlockSSE2(a[0], b[0]),				\
+											  ConvertFixedBlockSSE2(a[1], b[1]));				\
+		__m128i blocks23 = _mm_unpacklo_epi64(ConvertFixedBlockSSE2(a[2], b[2]),				\
+											  ConvertFixedBlockSSE2(a[3], b[3]));				\
+		__m128i u = ConvertFixedScaleSSE2(ConvertFixedDotSSE2(blocks01, blocks23, mu),			\
+										  ou, shiftUV);											\
+		__m128i v = ConvertFixedScaleSSE2(ConvertFixedDotSSE2(blocks01, blocks23, mv),			\
+										  ov, shiftUV);											\
+		__m128i uv = _mm_packs_epi32(_mm_unpacklo_epi32(u, v), _mm_unpackhi_epi32(u, v));		\
+																								\
+		udm offset = 2 * i * CONVERT_SAMPLE_##out;												\
+		ConvertFixedStore##out##SSE2((u8 *) dstY0 + offset, (u8 *) dstY1 + offset,				\
+									 (u8 *) dstUV + offset, y0, y1, uv);						\
+	}																							\
+																								\
+	udm offset = 2 * i * CONVERT_SAMPLE_##out;													\
+	ConvertFixed##in##To##out##Scalar(f, (const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in,		\
+									  (const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in,			\
+									  (u8 *) dstY0 + offset, (u8 *) dstY1 + offset,				\
+									  (u8 *) dstUV + offset, count - i);						\
+}
+
+CONVERT_FIXED_KERNEL_SSE2(BGRA8, NV12)
+CONVERT_FIXED_KERNEL_SSE2(BGRA8, P010)
+CONVERT_FIXED_KERNEL_SSE2(RGBA8, NV12)
+CONVERT_FIXED_KERNEL_SSE2(RGBA8, P010)
+CONVERT_FIXED_KERNEL_SSE2(RGB10A2, NV12)
+CONVERT_FIXED_KERNEL_SSE2(RGB10A2, P010)
+
+// AVX2 versions use in-lane shuffles, so blocks end up in 0,1,4,5 | 2,3,6,7 order & get reordered
+// only when storing, 16-bit float inputs stay with SSE2 version as there is no F16C check
+typedef struct {
+	__m256 r[2], g[2], b[2];
+} convert_pixels_avx2;
+
+BOG_TARGET_AVX2
+static inline void ConvertUnpackAVX2(__m256i px, s32 shiftR, s32 shiftG, s32 shiftB, s32 mask,
+									 __m256 *r, __m256 *g, __m256 *b) {
+	__m256i m = _mm256_set1_epi32(mask);
+	*r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(px, _mm_cvtsi32_si128(shiftR)), m));
+	*g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(px, _mm_cvtsi32_si128(shiftG)), m));
+	*b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(px, _mm_cvtsi32_si128(shiftB)), m));
+}
+
+// 16 pixels of 32-bit format = 8 blocks
+BOG_TARGET_AVX2
+static inline void ConvertLoad32AVX2(const u8 *src, s32 shiftR, s32 shiftG, s32 shiftB, s32 mask,
+									 convert_pixels_avx2 *p) {
+	__m256 a = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *) (src + 0)));
+	__m256 b = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *) (src + 32)));
+
+	__m256i left = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m256i right = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+	ConvertUnpackAVX2(left, shiftR, shiftG, shiftB, mask, &p->r[0], &p->g[0], &p->b[0]);
+	ConvertUnpackAVX2(right, shiftR, shiftG, shiftB, mask, &p->r[1], &p->g[1], &p->b[1]);
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertLoadBGRA8AVX2(const u8 *src, convert_pixels_avx2 *p) {
+	ConvertLoad32AVX2(src, 16, 8, 0, 0xff, p);
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertLoadRGBA8AVX2(const u8 *src, convert_pixels_avx2 *p) {
+	ConvertLoad32AVX2(src, 0, 8, 16, 0xff, p);
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertLoadRGB10A2AVX2(const u8 *src, convert_pixels_avx2 *p) {
+	ConvertLoad32AVX2(src, 0, 10, 20, 0x3ff, p);
+}
+
+// packs 8+8 32-bit values that are in [0,1,4,5 | 2,3,6,7] block order (result of in-lane shuffles)
+// interleaving them into 16 ordered 16-bit values, saturated
+BOG_TARGET_AVX2
+static inline __m256i ConvertInterleaveAVX2(__m256 left, __m256 right) {
+	__m256i a = _mm256_cvttps_epi32(left);
+	__m256i b = _mm256_cvttps_epi32(right);
+	__m256i words = _mm256_packs_epi32(_mm256_unpacklo_epi32(a, b), _mm256_unpackhi_epi32(a, b));
+	return _mm256_permute4x64_epi64(words, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+BOG_TARGET_AVX2
+static inline __m128i ConvertBytesAVX2(__m256i words) {
+	return _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertStoreNV12AVX2(void *dstY0, void *dstY1, void *dstUV, const __m256 *y,
+										__m256 u, __m256 v) {
+	_mm_storeu_si128((__m128i *) dstY0, ConvertBytesAVX2(ConvertInterleaveAVX2(y[0], y[1])));
+	_mm_storeu_si128((__m128i *) dstY1, ConvertBytesAVX2(ConvertInterleaveAVX2(y[2], y[3])));
+	_mm_storeu_si128((__m128i *) dstUV, ConvertBytesAVX2(ConvertInterleaveAVX2(u, v)));
+}
+
+BOG_TARGET_AVX2
+static inline __m256i ConvertClamp10AVX2(__m256i words) {
+	words = _mm256_min_epi16(_mm256_max_epi16(words, _mm256_setzero_si256()),
+							 _mm256_set1_epi16(1023));
+	return _mm256_slli_epi16(words, 6);
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertStoreP010AVX2(void *dstY0, void *dstY1, void *dstUV, const __m256 *y,
+										__m256 u, __m256 v) {
+	_mm256_storeu_si256((__m256i *) dstY0, ConvertClamp10AVX2(ConvertInterleaveAVX2(y[0], y[1])));
+	_mm256_storeu_si256((__m256i *) dstY1, ConvertClamp10AVX2(ConvertInterleaveAVX2(y[2], y[3])));
+	_mm256_storeu_si256((__m256i *) dstUV, ConvertClamp10AVX2(ConvertInterleaveAVX2(u, v)));
+}
+
+#define CONVERT_DOT_AVX2(row, r, g, b)												\
+	_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, row[0]),				\
+											  _mm256_mul_ps(g, row[1])),			\
+								_mm256_mul_ps(b, row[2])), row[3])
+
+#define CONVERT_KERNEL_AVX2(in, out)															\
+BOG_TARGET_AVX2																					\
+static void Convert##in##To##out##AVX2(const convert_matrix *m, const void *src0,				\
+									   const void *src1, void *dstY0, void *dstY1,				\
+									   void *dstUV, u32 count) {								\
+	__m256 my[4], mu[4], mv[4];																	\
+	for (u32 k = 0; k < 4; ++k) {																\
+		my[k] = _mm256_set1_ps(m->m[0][k]);														\
+		mu[k] = _mm256_set1_ps(m->m[1][k]);														\
+		mv[k] = _mm256_set1_ps(m->m[2][k]);														\
+	}																							\
+																								\
+	__m256 quarter = _mm256_set1_ps(0.25f);														\
+																								\
+	/* 8 blocks = 16 pixels from each row per iteration */										\
+	u32 i = 0;																					\
+	for (; i + 8 <= count; i += 8) {															\
+		convert_pixels_avx2 a, b;																\
+		ConvertLoad##in##AVX2((const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in, &a);				\
+		ConvertLoad##in##AVX2((const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in, &b);				\
+																								\
+		__m256 y[4] = {																			\
+			CONVERT_DOT_AVX2(my, a.r[0], a.g[0], a.b[0]),										\
+			CONVERT_DOT_AVX2(my, a.r[1], a.g[1], a.b[1]),										\
+			CONVERT_DOT_AVX2(my, b.r[0], b.g[0], b.b[0]),										\
+			CONVERT_DOT_AVX2(my, b.r[1], b.g[1], b.b[1]),										\
+		};																						\
+		__m256 u = _mm256_mul_ps(_mm256_add_ps(													\
+			_mm256_add_ps(CONVERT_DOT_AVX2(mu, a.r[0], a.g[0], a.b[0]),							\
+						  CONVERT_DOT_AVX2(mu, a.r[1], a.g[1], a.b[1])),						\
+			_mm256_add_ps(CONVERT_DOT_AVX2(mu, b.r[0], b.g[0], b.b[0]),							\
+						  CONVERT_DOT_AVX2(mu, b.r[1], b.g[1], b.b[1]))), quarter);				\
+		__m256 v = _mm256_mul_ps(_mm256_add_ps(													\
+			_mm256_add_ps(CONVERT_DOT_AVX2(mv, a.r[0], a.g[0], a.b[0]),							\
+						  CONVERT_DOT_AVX2(mv, a.r[1], a.g[1], a.b[1])),						\
+			_mm256_add_ps(CONVERT_DOT_AVX2(mv, b.r[0], b.g[0], b.b[0]),							\
+						  CONVERT_DOT_AVX2(mv, b.r[1], b.g[1], b.b[1]))), quarter);				\
+																								\
+		udm offset = 2 * i * CONVERT_SAMPLE_##out;												\
+		ConvertStore##out##AVX2((u8 *) dstY0 + offset, (u8 *) dstY1 + offset,					\
+								(u8 *) dstUV + offset, y, u, v);								\
+	}																							\
+																								\
+	udm offset = 2 * i * CONVERT_SAMPLE_##out;													\
+	Convert##in##To##out##SSE2(m, (const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in,				\
+							   (const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in,					\
+							   (u8 *) dstY0 + offset, (u8 *) dstY1 + offset,					\
+							   (u8 *) dstUV + offset, count - i);								\
+}
+
+CONVERT_KERNEL_AVX2(BGRA8, NV12)
+CONVERT_KERNEL_AVX2(BGRA8, P010)
+CONVERT_KERNEL_AVX2(RGBA8, NV12)
+CONVERT_KERNEL_AVX2(RGBA8, P010)
+CONVERT_KERNEL_AVX2(RGB10A2, NV12)
+CONVERT_KERNEL_AVX2(RGB10A2, P010)
+
+// in-lane unpacks & shuffles put pixels 0,1 | 4,5 into one register & 2,3 | 6,7 into other one,
+// so dot products come out in order & only packing to words needs reordering
+BOG_TARGET_AVX2
+static inline void ConvertFixedWords8AVX2(__m256i px, __m256i *lo, __m256i *hi) {
+	*lo = _mm256_unpacklo_epi8(px, _mm256_setzero_si256());
+	*hi = _mm256_unpackhi_epi8(px, _mm256_setzero_si256());
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertFixedWordsBGRA8AVX2(__m256i px, __m256i *lo, __m256i *hi) {
+	ConvertFixedWords8AVX2(px, lo, hi);
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertFixedWordsRGBA8AVX2(__m256i px, __m256i *lo, __m256i *hi) {
+	ConvertFixedWords8AVX2(px, lo, hi);
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertFixedWordsRGB10A2AVX2(__m256i px, __m256i *lo, __m256i *hi) {
+	__m256i rg = _mm256_or_si256(_mm256_and_si256(px, _mm256_set1_epi32(0x3ff)),
+								 _mm256_and_si256(_mm256_slli_epi32(px, 6),
+												  _mm256_set1_epi32(0x3ff0000)));
+	__m256i b = _mm256_and_si256(_mm256_srli_epi32(px, 20), _mm256_set1_epi32(0x3ff));
+	*lo = _mm256_unpacklo_epi32(rg, b);
+	*hi = _mm256_unpackhi_epi32(rg, b);
+}
+
+BOG_TARGET_AVX2
+static inline __m256i ConvertFixedRowAVX2(const s16 *row, bool swap) {
+	return _mm256_broadcastsi128_si256(ConvertFixedRowSSE2(row, swap));
+}
+
+BOG_TARGET_AVX2
+static inline __m256i ConvertFixedDotAVX2(__m256i a, __m256i b, __m256i row) {
+	__m256 x = _mm256_castsi256_ps(_mm256_madd_epi16(a, row));
+	__m256 y = _mm256_castsi256_ps(_mm256_madd_epi16(b, row));
+	return _mm256_add_epi32(_mm256_castps_si256(_mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0))),
+							_mm256_castps_si256(_mm256_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1))));
+}
+
+BOG_TARGET_AVX2
+static inline __m256i ConvertFixedScaleAVX2(__m256i dot, __m256i offset, __m128i shift) {
+	return _mm256_sra_epi32(_mm256_add_epi32(dot, offset), shift);
+}
+
+BOG_TARGET_AVX2
+static inline __m256i ConvertFixedBlockAVX2(__m256i row0, __m256i row1) {
+	__m256i sum = _mm256_add_epi16(row0, row1);
+	return _mm256_add_epi16(sum, _mm256_srli_si256(sum, 8));
+}
+
+// packs 8+8 values that are in [0..3, 8..11 | 4..7, 12..15] order after in-lane pack
+BOG_TARGET_AVX2
+static inline __m256i ConvertFixedPackAVX2(__m256i a, __m256i b) {
+	return _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertFixedStoreNV12AVX2(void *dstY0, void *dstY1, void *dstUV, __m256i y0,
+											 __m256i y1, __m256i uv) {
+	_mm_storeu_si128((__m128i *) dstY0, ConvertBytesAVX2(y0));
+	_mm_storeu_si128((__m128i *) dstY1, ConvertBytesAVX2(y1));
+	_mm_storeu_si128((__m128i *) dstUV, ConvertBytesAVX2(uv));
+}
+
+BOG_TARGET_AVX2
+static inline void ConvertFixedStoreP010AVX2(void *dstY0, void *dstY1, void *dstUV, __m256i y0,
+											 __m256i y1, __m256i uv) {
+	_mm256_storeu_si256((__m256i *) dstY0, ConvertClamp10AVX2(y0));
+	_mm256_storeu_si256((__m256i *) dstY1, ConvertClamp10AVX2(y1));
+	_mm256_storeu_si256((__m256i *) dstUV, ConvertClamp10AVX2(uv));
+}
+
+#define CONVERT_FIXED_KERNEL_AVX2(in, out)														\
+BOG_TARGET_AVX2																					\
+static void ConvertFixed##in##To##out##AVX2(const convert_fixed *f, const void *src0,			\
+											const void *src1, void *dstY0, void *dstY1,			\
+											void *dstUV, u32 count) {							\
+	__m256i my = ConvertFixedRowAVX2(f->m[0], CONVERT_FIXED_SWAP_##in);							\
+	__m256i mu = ConvertFixedRowAVX2(f->m[1], CONVERT_FIXED_SWAP_##in);							\
+	__m256i mv = ConvertFixedRowAVX2(f->m[2], CONVERT_FIXED_SWAP_##in);							\
+	__m256i oy = _mm256_set1_epi32(f->offset[0]);												\
+	__m256i ou = _mm256_set1_epi32(4 * f->offset[1]);											\
+	__m256i ov = _mm256_set1_epi32(4 * f->offset[2]);											\
+	__m128i shiftY = _mm_cvtsi32_si128((s32) f->shift);											\
+	__m128i shiftUV = _mm_cvtsi32_si128((s32) f->shift + 2);									\
+																								\
+	/* 8 blocks = 16 pixels from each row per iteration */										\
+	u32 i = 0;																					\
+	for (; i + 8 <= count; i += 8) {															\
+		const u8 *p0 = (const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in;							\
+		const u8 *p1 = (const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in;							\
+		__m256i a[4], b[4];																		\
+		ConvertFixedWords##in##AVX2(_mm256_loadu_si256((const __m256i *) p0), &a[0], &a[1]);	\
+		ConvertFixedWords##in##AVX2(_mm256_loadu_si256((const __m256i *) p0 + 1), &a[2], &a[3]);	\
+		ConvertFixedWords##in##AVX2(_mm256_loadu_si256((const __m256i *) p1), &b[0], &b[1]);	\
+		ConvertFixedWords##in##AVX2(_mm256_loadu_si256((const __m256i *) p1 + 1), &b[2], &b[3]);	\
+																								\
+		__m256i y0 = ConvertFixedPackAVX2(														\
+			ConvertFixedScaleAVX2(ConvertFixedDotAVX2(a[0], a[1], my), oy, shiftY),				\
+			ConvertFixedScaleAVX2(ConvertFixedDotAVX2(a[2], a[3], my), oy, shiftY));			\
+		__m256i y1 = ConvertFixedPackAVX2(														\
+			ConvertFixedScaleAVX2(ConvertFixedDotAVX2(b[0], b[1], my), oy, shiftY),				\
+			ConvertFixedScaleAVX2(ConvertFixedDotAVX2(b[2], b[3], my), oy, shiftY));			\
+																								\
+		/* blocks end up in 0,1,4,5 | 2,3,6,7 order, same as in float kernels */				\
+		__m256i blocks0 = _mm256_unpacklo_epi64(ConvertFixedBlockAVX2(a[0], b[0]),				\
+												ConvertFixedBlockAVX2(a[1], b[1]));				\
+		__m256i blocks1 = _mm256_unpacklo_epi64(ConvertFixedBlockAVX2(a[2], b[2]),				\
+												ConvertFixedBlockAVX2(a[3], b[3]));				\
+		__m256i u = ConvertFixedScaleAVX2(ConvertFixedDotAVX2(blocks0, blocks1, mu),			\
+										  ou, shiftUV);											\
+		__m256i v = ConvertFixedScaleAVX2(ConvertFixedDotAVX2(blocks0, blocks1, mv),			\
+										  ov, shiftUV);											\
+		__m256i uv = ConvertFixedPackAVX2(_mm256_unpacklo_epi32(u, v),							\
+										  _mm256_unpackhi_epi32(u, v));							\
+																								\
+		udm offset = 2 * i * CONVERT_SAMPLE_##out;												\
+		ConvertFixedStore##out##AVX2((u8 *) dstY0 + offset, (u8 *) dstY1 + offset,				\
+									 (u8 *) dstUV + offset, y0, y1, uv);						\
+	}																							\
+																								\
+	udm offset = 2 * i * CONVERT_SAMPLE_##out;													\
+	ConvertFixed##in##To##out##SSE2(f, (const u8 *) src0 + 2 * i * CONVERT_PIXEL_##in,			\
+									(const u8 *) src1 + 2 * i * CONVERT_PIXEL_##in,				\
+									(u8 *) dstY0 + offset, (u8 *) dstY1 + offset,				\
+									(u8 *) dstUV + offset, count - i);							\
+}
+
+CONVERT_FIXED_KERNEL_AVX2(BGRA8, NV12)
+CONVERT_FIXED_KERNEL_AVX2(BGRA8, P010)
+CONVERT_FIXED_KERNEL_AVX2(RGBA8, NV12)
+CONVERT_FIXED_KERNEL_AVX2(RGBA8, P010)
+CONVERT_FIXED_KERNEL_AVX2(RGB10A2, NV12)
+CONVERT_FIXED_KERNEL_AVX2(RGB10A2, P010)
+#endif
+
+// [input][output] kernel tables for every cpu level
+static convert_rows *const gConvertKernelsScalar[CONVERT_INPUT_COUNT][CONVERT_OUTPUT_COUNT] = {
+	{ ConvertBGRA8ToNV12Scalar,   ConvertBGRA8ToP010Scalar   },
+	{ ConvertRGBA8ToNV12Scalar,   ConvertRGBA8ToP010Scalar   },
+	{ ConvertRGB10A2ToNV12Scalar, ConvertRGB10A2ToP010Scalar },
+	{ ConvertRGBA16FToNV12Scalar, ConvertRGBA16FToP010Scalar },
+	{ ConvertSCRGBToNV12Scalar,   ConvertSCRGBToP010Scalar   },
+};
+
+#ifdef BOG_X86
+static convert_rows *const gConvertKernelsSSE2[CONVERT_INPUT_COUNT][CONVERT_OUTPUT_COUNT] = {
+	{ ConvertBGRA8ToNV12SSE2,   ConvertBGRA8ToP010SSE2   },
+	{ ConvertRGBA8ToNV12SSE2,   ConvertRGBA8ToP010SSE2   },
+	{ ConvertRGB10A2ToNV12SSE2, ConvertRGB10A2ToP010SSE2 },
+	{ ConvertRGBA16FToNV12SSE2, ConvertRGBA16FToP010SSE2 },
+	{ ConvertSCRGBToNV12SSE2,   ConvertSCRGBToP010SSE2   },
+};
+
+static convert_rows *const gConvertKernelsAVX2[CONVERT_INPUT_COUNT][CONVERT_OUTPUT_COUNT] = {
+	{ ConvertBGRA8ToNV12AVX2,   ConvertBGRA8ToP010AVX2   },
+	{ ConvertRGBA8ToNV12AVX2,   ConvertRGBA8ToP010AVX2   },
+	{ ConvertRGB10A2ToNV12AVX2, ConvertRGB10A2ToP010AVX2 },
+	{ ConvertRGBA16FToNV12SSE2, ConvertRGBA16FToP010SSE2 },
+	{ ConvertSCRGBToNV12SSE2,   ConvertSCRGBToP010SSE2   },
+};
+#endif
+
+// float inputs have no fixed point kernels
+static convert_fixed_rows *const
+gConvertFixedKernelsScalar[CONVERT_INPUT_COUNT][CONVERT_OUTPUT_COUNT] = {
+	{ ConvertFixedBGRA8ToNV12Scalar,   ConvertFixedBGRA8ToP010Scalar   },
+	{ ConvertFixedRGBA8ToNV12Scalar,   ConvertFixedRGBA8ToP010Scalar   },
+	{ ConvertFixedRGB10A2ToNV12Scalar, ConvertFixedRGB10A2ToP010Scalar },
+};
+
+#ifdef BOG_X86
+static convert_fixed_rows *const
+gConvertFixedKernelsSSE2[CONVERT_INPUT_COUNT][CONVERT_OUTPUT_COUNT] = {
+	{ ConvertFixedBGRA8ToNV12SSE2,   ConvertFixedBGRA8ToP010SSE2   },
+	{ ConvertFixedRGBA8ToNV12SSE2,   ConvertFixedRGBA8ToP010SSE2   },
+	{ ConvertFixedRGB10A2ToNV12SSE2, ConvertFixedRGB10A2ToP010SSE2 },
+};
+
+static convert_fixed_rows *const
+gConvertFixedKernelsAVX2[CONVERT_INPUT_COUNT][CONVERT_OUTPUT_COUNT] = {
+	{ ConvertFixedBGRA8ToNV12AVX2,   ConvertFixedBGRA8ToP010AVX2   },
+	{ ConvertFixedRGBA8ToNV12AVX2,   ConvertFixedRGBA8ToP010AVX2   },
+	{ ConvertFixedRGB10A2ToNV12AVX2, ConvertFixedRGB10A2ToP010AVX2 },
+};
+#endif
+
+static void ConvertSetLevel(bog_cpu_level level) {
+	convert_rows *const (*kernels)[CONVERT_OUTPUT_COUNT];
+	convert_fixed_rows *const (*fixedKernels)[CONVERT_OUTPUT_COUNT];
+
+	switch (level) {
+#ifdef BOG_X86
+		case BOG_CPU_AVX2: {
+			kernels = gConvertKernelsAVX2;
+			fixedKernels = gConvertFixedKernelsAVX2;
+		} break;
+
+		case BOG_CPU_SSE2: {
+			kernels = gConvertKernelsSSE2;
+			fixedKernels = gConvertFixedKernelsSSE2;
+		} break;
+#endif
+
+		default: {
+			level = BOG_CPU_SCALAR;
+			kernels = gConvertKernelsScalar;
+			fixedKernels = gConvertFixedKernelsScalar;
+		}
+	}
+
+	for (u32 i = 0; i < CONVERT_INPUT_COUNT; ++i) {
+		for (u32 o = 0; o < CONVERT_OUTPUT_COUNT; ++o) {
+			gConvertKernels[i][o] = kernels[i][o];
+			gConvertFixedKernels[i][o] = fixedKernels[i][o];
+		}
+	}
+
+	gConvertLevel = level;
+}
+
+static bog_cpu_level ConvertGetLevel(void) {
+	return gConvertLevel;
+}
+
+static void ConvertInit(void) {
+	ConvertSetLevel(BOGCpuLevel());
+}
+
+static void ConvertMatrixInitColorspace(convert_matrix *m, convert_colorspace colorspace, f32 rangeY,
+										f32 offsetY, f32 rangeUV, f32 offsetUV, f32 inputMax) {
+	// https://en.wikipedia.org/wiki/YCbCr#ITU-R_BT.601_conversion
+	// https://en.wikipedia.org/wiki/YCbCr#ITU-R_BT.709_conversion
+	// https://en.wikipedia.org/wiki/YCbCr#ITU-R_BT.2020_conversion
+	static const f32 coefficients[CONVERT_COLORSPACE_COUNT][3][3] = {
+		{
+			{  0.299f,     0.587f,     0.114f     },
+			{ -0.168736f, -0.331264f,  0.5f       },
+			{  0.5f,      -0.418688f, -0.081312f  },
+		},
+		{
+			{  0.2126f,    0.7152f,    0.0722f    },
+			{ -0.1146f,   -0.3854f,    0.5f       },
+			{  0.5f,      -0.4542f,   -0.0458f    },
+		},
+		{
+			{  0.2627f,    0.678f,     0.0593f    },
+			{ -0.13963f,  -0.36037f,   0.5f       },
+			{  0.5f,      -0.45979f,  -0.04021f   },
+		},
+	};
+
+	const f32 (*c)[3] = coefficients[colorspace];
+	f32 scale[3] = { rangeY / inputMax, rangeUV / inputMax, rangeUV / inputMax };
+	f32 offset[3] = { offsetY, offsetUV, offsetUV };
+
+	for (u32 row = 0; row < 3; ++row) {
+		for (u32 col = 0; col < 3; ++col) {
+			m->m[row][col] = c[row][col] * scale[row];
+		}
+		m->m[row][3] = offset[row];
+	}
+}
+
+static void ConvertMatrixInit(convert_matrix *m, f32 rangeY, f32 offsetY, f32 rangeUV, f32 offsetUV,
+							  f32 inputMax) {
+	ConvertMatrixInitColorspace(m, CONVERT_BT709, rangeY, offsetY, rangeUV, offsetUV, inputMax);
+}
+
+static void ConvertMatrixFor(convert_matrix *m, convert_colorspace colorspace, bool fullRange,
+							 convert_input input, convert_output output) {
+	f32 inputMax = (input == CONVERT_INPUT_RGB10A2) ? 1023.f :
+				   (input == CONVERT_INPUT_RGBA16F || input == CONVERT_INPUT_SCRGB) ? 1.f : 255.f;
+
+	// offsets have extra 0.5, because stores truncate
+	f32 bits = (output == CONVERT_OUTPUT_P010) ? 4.f : 1.f;
+	if (fullRange) {
+		f32 max = (output == CONVERT_OUTPUT_P010) ? 1023.f : 255.f;
+		ConvertMatrixInitColorspace(m, colorspace, max, 0.5f, max, 128.f * bits + 0.5f, inputMax);
+	} else {
+		// Y=[16..235], UV=[16..240], 4x larger for 10-bit
+		ConvertMatrixInitColorspace(m, colorspace, 219.f * bits, 16.f * bits + 0.5f, 224.f * bits,
+									128.f * bits + 0.5f, inputMax);
+	}
+}
+
+// transfer functions are evaluated only while building lookup table, double precision series are
+// accurate enough for that & need no C runtime math
+static d64 ConvertLog2(d64 x) {
+	// x = m * 2^e, m in [sqrt(1/2)..sqrt(2)), x must be positive & normal
+	union { d64 f; u64 u; } bits;
+	bits.f = x;
+	s32 e = (s32) ((bits.u >> 52) & 0x7ff) - 1023;
+	bits.u = (bits.u & 0xfffffffffffffULL) | (1023ULL << 52);
+	if (bits.f > 1.4142135623730951) {
+		bits.f *= 0.5;
+		e += 1;
+	}
+
+	// ln(m) = 2 * atanh(t), t = (m - 1) / (m + 1), |t| < 0.172
+	d64 t = (bits.f - 1) / (bits.f + 1);
+	d64 t2 = t * t;
+	d64 term = t;
+	d64 sum = 0;
+	for (u32 k = 1; k < 40; k += 2) {
+		sum += term / k;
+		term *= t2;
+	}
+
+	return e + 2 * sum * 1.4426950408889634; // 1 / ln(2)
+}
+
+static d64 ConvertExp2(d64 x) {
+	if (x < -1000) return 0;
+
+	// 2^x = 2^n * e^(f * ln(2)), f in [0..1)
+	s32 n = (s32) x;
+	if (n > x) n -= 1;
+	d64 f = (x - n) * 0.6931471805599453;
+
+	d64 term = 1;
+	d64 sum = 1;
+	for (u32 k = 1; k < 24; ++k) {
+		term *= f / k;
+		sum += term;
+	}
+
+	union { d64 f; u64 u; } scale;
+	scale.u = (u64) (n + 1023) << 52;
+	return sum * scale.f;
+}
+
+static d64 ConvertPow(d64 x, d64 y) {
+	return x > 0 ? ConvertExp2(y * ConvertLog2(x)) : 0;
+}
+
+// value is linear light in [0..1] of range transfer function covers, result is signal in [0..1]
+// peak is peak luminance relative to SDR white
+static d64 ConvertTransferValue(convert_transfer transfer, d64 value, d64 peak) {
+	d64 result;
+
+	switch (transfer) {
+		case CONVERT_TRANSFER_PQ: {
+			// https://en.wikipedia.org/wiki/Perceptual_quantizer
+			d64 m1 = 2610.0 / 16384.0;
+			d64 m2 = 2523.0 / 4096.0 * 128.0;
+			d64 c1 = 3424.0 / 4096.0;
+			d64 c2 = 2413.0 / 4096.0 * 32.0;
+			d64 c3 = 2392.0 / 4096.0 * 32.0;
+
+			d64 y = ConvertPow(value, m1);
+			result = ConvertPow((c1 + c2 * y) / (1 + c3 * y), m2);
+		} break;
+
+		case CONVERT_TRANSFER_HLG: {
+			// https://en.wikipedia.org/wiki/Hybrid_log%E2%80%93gamma
+			// desktop light is display referred & is encoded without inverse OOTF, so decoders with
+			// system gamma above 1 show slightly more contrast than desktop had
+			d64 a = 0.17883277;
+			d64 b = 1 - 4 * a;
+			d64 c = 0.5 - a * ConvertLog2(4 * a) * 0.6931471805599453;
+
+			if (value <= 1.0 / 12.0) {
+				result = ConvertPow(3 * value, 0.5);
+			} else {
+				result = a * ConvertLog2(12 * value - b) * 0.6931471805599453 + c;
+			}
+		} break;
+
+		default: {
+			// linear up to knee, above it values up to peak are compressed to white with
+			// extended Reinhard curve that keeps slope at knee
+			d64 knee = 0.75;
+			d64 l = value * peak;
+			if (l > knee && peak > 1) {
+				d64 x = (l - knee) / (1 - knee);
+				d64 w = (peak - knee) / (1 - knee);
+				l = knee + (1 - knee) * x * (1 + x / (w * w)) / (1 + x);
+			}
+
+			// https://en.wikipedia.org/wiki/SRGB#Transfer_function_(%22gamma%22)
+			result = (l <= 0.0031308) ? 12.92 * l : 1.055 * ConvertPow(l, 1 / 2.4) - 0.055;
+		}
+	}
+
+	return result < 0 ? 0 : result > 1 ? 1 : result;
+}
+
+static void ConvertSetTransfer(convert_transfer transfer, f32 whiteNits, f32 peakNits) {
+	// https://www.itu.int/pub/R-REP-BT.2087
+	static const f32 bt709ToBt2020[3][3] = {
+		{ 0.6274040f, 0.3292820f, 0.0433136f },
+		{ 0.0690970f, 0.9195400f, 0.0113612f },
+		{ 0.0163916f, 0.0880132f, 0.8955950f },
+	};
+
+	if (peakNits < whiteNits) peakNits = whiteNits;
+
+	// scRGB 1 is 80 nits, PQ covers absolute range, HLG & SDR are relative to display peak
+	f32 rangeNits = (transfer == CONVERT_TRANSFER_PQ) ? 10000.f : peakNits;
+	for (u32 row = 0; row < 3; ++row) {
+		for (u32 col = 0; col < 3; ++col) {
+			f32 c = (transfer == CONVERT_TRANSFER_SDR) ? (row == col ? 1.f : 0.f) :
+					bt709ToBt2020[row][col];
+			gConvertPrimaries[row][col] = c * (80.f / rangeNits);
+		}
+	}
+
+	d64 peak = (d64) peakNits / whiteNits;
+	for (u32 i = 0; i < CONVERT_TRANSFER_SIZE; ++i) {
+		// value at start of entry, last one is past 1 & used only with zero weight
+		union { u32 u; f32 f; } bits;
+		bits.u = (u32) (i + CONVERT_TRANSFER_BASE) << CONVERT_TRANSFER_SHIFT;
+		d64 value = (bits.f < 1) ? bits.f : 1;
+		gConvertTransfer[i] = (f32) ConvertTransferValue(transfer, value, peak);
+	}
+
+	gConvertTransferReady = true;
+}
+
+static s32 ConvertRound(d64 value) {
+	return (value < 0) ? -(s32) (0.5 - value) : (s32) (value + 0.5);
+}
+
+static void ConvertFixedFromMatrix(convert_fixed *f, const convert_matrix *m) {
+	// largest shift that keeps all coefficients in 16 bits, with room for sum correction
+	f32 largest = 0;
+	for (u32 row = 0; row < 3; ++row) {
+		for (u32 col = 0; col < 3; ++col) {
+			f32 c = m->m[row][col] < 0 ? -m->m[row][col] : m->m[row][col];
+			largest = c > largest ? c : largest;
+		}
+	}
+
+	u32 shift = 14;
+	while (shift > 0 && largest * (f32) (1 << shift) > 32760.f) --shift;
+
+	d64 scale = (d64) (1 << shift);
+	for (u32 row = 0; row < 3; ++row) {
+		d64 exact[3];
+		d64 sum = 0;
+		s32 rounded = 0;
+		for (u32 col = 0; col < 3; ++col) {
+			exact[col] = m->m[row][col] * scale;
+			f->m[row][col] = (s16) ConvertRound(exact[col]);
+			sum += exact[col];
+			rounded += f->m[row][col];
+		}
+
+		// fix sum by moving coefficients that were rounded the most, towards their exact values
+		for (s32 diff = ConvertRound(sum) - rounded; diff != 0;) {
+			s32 step = (diff > 0) ? 1 : -1;
+			u32 best = 0;
+			d64 bestError = 0;
+			for (u32 col = 0; col < 3; ++col) {
+				d64 error = (exact[col] - f->m[row][col]) * step;
+				if (col == 0 || error > bestError) {
+					best = col;
+					bestError = error;
+				}
+			}
+			f->m[row][best] = (s16) (f->m[row][best] + step);
+			diff -= step;
+		}
+
+		f->offset[row] = ConvertRound(m->m[row][3] * scale);
+	}
+
+	f->shift = shift;
+}
+
+static void ConvertMatrixFromFixed(convert_matrix *m, const convert_fixed *f, f32 inputMax,
+								   f32 outputScale) {
+	f32 scale = outputScale / (f32) (1 << f->shift);
+	for (u32 row = 0; row < 3; ++row) {
+		for (u32 col = 0; col < 3; ++col) {
+			m->m[row][col] = f->m[row][col] * inputMax * scale;
+		}
+		m->m[row][3] = (f32) f->offset[row] * scale;
+	}
+}
+
+static bool ConvertFixedSupported(convert_input input) {
+	return input == CONVERT_INPUT_BGRA8 || input == CONVERT_INPUT_RGBA8 ||
+		   input == CONVERT_INPUT_RGB10A2;
+}
+
+static u32 ConvertInputSize(convert_input input) {
+	return (input == CONVERT_INPUT_RGBA16F || input == CONVERT_INPUT_SCRGB) ? 8 : 4;
+}
+
+static u32 ConvertOutputSize(convert_output output) {
+	return (output == CONVERT_OUTPUT_P010) ? 2 : 1;
+}
+
+// converts with float matrix m, or fixed one f when m is 0
+static void ConvertRegionWith(convert_input input, convert_output output, const convert_matrix *m,
+							  const convert_fixed *f, const void *src, udm srcStride, u32 width,
+							  u32 height, u32 x0, u32 y0, u32 x1, u32 y1, void *dstY, udm strideY,
+							  void *dstUV, udm strideUV) {
+	if (!gConvertKernels[0][0]) ConvertInit();
+	if (input == CONVERT_INPUT_SCRGB && !gConvertTransferReady) {
+		ConvertSetTransfer(CONVERT_TRANSFER_SDR, 80.f, 80.f);
+	}
+
+	convert_rows *rows = gConvertKernels[input][output];
+	convert_fixed_rows *fixedRows = gConvertFixedKernels[input][output];
+	u32 pixelSize = ConvertInputSize(input);
+	u32 sampleSize = ConvertOutputSize(output);
+
+	u32 blocks = (x1 - x0) / 2;
+	bool oddWidth = (x1 == width) && (width & 1);
+
+	for (u32 y = y0; y < y1; y += 2) {
+		const u8 *src0 = (const u8 *) src + y * srcStride + x0 * pixelSize;
+		const u8 *src1 = (y + 1 < height) ? src0 + srcStride : src0;
+		u8 *outY0 = (u8 *) dstY + y * strideY + x0 * sampleSize;
+		u8 *outY1 = outY0 + strideY;
+		u8 *outUV = (u8 *) dstUV + (y / 2) * strideUV + x0 * sampleSize;
+
+		if (m) {
+			rows(m, src0, src1, outY0, outY1, outUV, blocks);
+		} else {
+			fixedRows(f, src0, src1, outY0, outY1, outUV, blocks);
+		}
+
+		if (oddWidth) {
+			// last block repeats its only column
+			u32 x = blocks * 2;
+			u8 tail0[16], tail1[16];
+			for (u32 i = 0; i < pixelSize; ++i) {
+				tail0[i] = tail0[pixelSize + i] = src0[x * pixelSize + i];
+				tail1[i] = tail1[pixelSize + i] = src1[x * pixelSize + i];
+			}
+
+			u16 outTail[3][2];
+			if (m) {
+				gConvertKernelsScalar[input][output](m, tail0, tail1, outTail[0], outTail[1],
+													 outTail[2], 1);
+			} else {
+				gConvertFixedKernelsScalar[input][output](f, tail0, tail1, outTail[0], outTail[1],
+														  outTail[2], 1);
+			}
+
+			// second Y sample of each row is outside of image, but inside of rounded up output
+			u8 *tails = (u8 *) outTail;
+			for (u32 i = 0; i < 2 * sampleSize; ++i) {
+				outY0[x * sampleSize + i] = tails[i];
+				outY1[x * sampleSize + i] = tails[4 + i];
+				outUV[x * sampleSize + i] = tails[8 + i];
+			}
+		}
+	}
+}
+
+static void ConvertRegion(convert_input input, convert_output output, const convert_matrix *m,
+						  const void *src, udm srcStride, u32 width, u32 height,
+						  u32 x0, u32 y0, u32 x1, u32 y1, void *dstY, udm strideY,
+						  void *dstUV, udm strideUV) {
+	ConvertRegionWith(input, output, m, 0, src, srcStride, width, height, x0, y0, x1, y1,
+					  dstY, strideY, dstUV, strideUV);
+}
+
+static void ConvertRegionFixed(convert_input input, convert_output output, const convert_fixed *f,
+							   const void *src, udm srcStride, u32 width, u32 height,
+							   u32 x0, u32 y0, u32 x1, u32 y1, void *dstY, udm strideY,
+							   void *dstUV, udm strideUV) {
+	ConvertRegionWith(input, output, 0, f, src, srcStride, width, height, x0, y0, x1, y1,
+					  dstY, strideY, dstUV, strideUV);
+}
+
+static void ConvertToNV12Region(const convert_fixed *f, const void *src, udm srcStride, u32 width,
+								u32 height, u32 x0, u32 y0, u32 x1, u32 y1, u8 *dstY, udm strideY,
+								u8 *dstUV, udm strideUV) {
+	ConvertRegionFixed(CONVERT_INPUT_BGRA8, CONVERT_OUTPUT_NV12, f, src, srcStride, width, height,
+					   x0, y0, x1, y1, dstY, strideY, dstUV, strideUV);
+}
+
+static void ConvertToNV12(const convert_fixed *f, const void *src, udm srcStride, u32 width,
+						  u32 height, u8 *dstY, udm strideY, u8 *dstUV, udm strideUV) {
+	ConvertToNV12Region(f, src, srcStride, width, height, 0, 0, width, height, dstY, strideY,
+						dstUV, strideUV);
+}
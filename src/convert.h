@@ -0,0 +1,122 @@
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_cpu.h"
+
+// CPU implementation of Convert kernel from shaders.hlsl, RGB to YUV 4:2:0
+// separate kernel is generated for every input & output format pair, so inner loops never branch
+// on format, matrix is just data loaded into registers once per row
+
+// interface
+
+typedef enum {
+	CONVERT_INPUT_BGRA8,	// DXGI_FORMAT_B8G8R8A8_UNORM
+	CONVERT_INPUT_RGBA8,	// DXGI_FORMAT_R8G8B8A8_UNORM
+	CONVERT_INPUT_RGB10A2,	// DXGI_FORMAT_R10G10B10A2_UNORM
+	CONVERT_INPUT_RGBA16F,	// DXGI_FORMAT_R16G16B16A16_FLOAT, values clamped to [0..1]
+	CONVERT_INPUT_SCRGB,	// DXGI_FORMAT_R16G16B16A16_FLOAT, HDR desktop, linear scRGB, 1 = 80 nits
+	CONVERT_INPUT_COUNT
+} convert_input;
+
+typedef enum {
+	CONVERT_OUTPUT_NV12,	// 8-bit samples
+	CONVERT_OUTPUT_P010,	// 10-bit samples in top bits of 16-bit words
+	CONVERT_OUTPUT_COUNT
+} convert_output;
+
+typedef enum {
+	CONVERT_BT601,
+	CONVERT_BT709,
+	CONVERT_BT2020,
+	CONVERT_COLORSPACE_COUNT
+} convert_colorspace;
+
+// transfer function that encodes linear scRGB input
+typedef enum {
+	CONVERT_TRANSFER_PQ,	// SMPTE ST 2084, absolute luminance up to 10000 nits, BT.2020 primaries
+	CONVERT_TRANSFER_HLG,	// ARIB STD-B67, peak luminance is signal 1, BT.2020 primaries
+	CONVERT_TRANSFER_SDR,	// peak tone-mapped down to SDR white, sRGB curve, BT.709 primaries
+	CONVERT_TRANSFER_COUNT
+} convert_transfer;
+
+// rows are Y, U, V; columns multiply R, G, B and last column is added offset
+// same layout as ConvertBuffer constant buffer used by shader
+typedef struct {
+	f32 m[3][4];
+} convert_matrix;
+
+// integer version of matrix for integer inputs, shift is picked so coefficients fit in 16 bits:
+//   Y  = (R * m0 + G * m1 + B * m2 + offset) >> shift
+//   UV = (R, G & B sums of 2x2 block * m0..m2 + 4 * offset) >> (shift + 2)
+typedef struct {
+	s16 m[3][3];
+	s32 offset[3];
+	u32 shift;
+} convert_fixed;
+
+// converts count 2x2 blocks from two source rows, writing two Y rows and one UV row
+typedef void convert_rows(const convert_matrix *m, const void *src0, const void *src1,
+						  void *dstY0, void *dstY1, void *dstUV, u32 count);
+typedef void convert_fixed_rows(const convert_fixed *f, const void *src0, const void *src1,
+								void *dstY0, void *dstY1, void *dstUV, u32 count);
+
+// picks fastest kernels for current cpu, call once before converting
+static void ConvertInit(void);
+static bog_cpu_level ConvertGetLevel(void);
+static void ConvertSetLevel(bog_cpu_level level);
+
+// BT.709 matrix, inputMax is value of full intensity in input (1 for UNORM textures, 255 for bytes)
+static void ConvertMatrixInit(convert_matrix *m, f32 rangeY, f32 offsetY, f32 rangeUV, f32 offsetUV,
+							  f32 inputMax);
+static void ConvertMatrixInitColorspace(convert_matrix *m, convert_colorspace colorspace, f32 rangeY,
+										f32 offsetY, f32 rangeUV, f32 offsetUV, f32 inputMax);
+
+// matrix for converting input format to output format, limited or full range
+static void ConvertMatrixFor(convert_matrix *m, convert_colorspace colorspace, bool fullRange,
+							 convert_input input, convert_output output);
+
+// builds lookup table used by CONVERT_INPUT_SCRGB kernels, must not be called while converting
+// whiteNits is SDR white level of desktop, peakNits is brightest value that is not clipped
+// PQ & HLG output should use BT.2020 matrix, SDR output BT.709 one
+static void ConvertSetTransfer(convert_transfer transfer, f32 whiteNits, f32 peakNits);
+
+// rounds matrix to integers, so that every row sums to rounded sum of float row, that keeps
+// white & black exact & gives grey exactly zero chroma
+static void ConvertFixedFromMatrix(convert_fixed *f, const convert_matrix *m);
+
+// float matrix with same coefficients as fixed one, so shader gives same results as CPU
+// inputMax is input value fixed matrix was made for that shader sees as 1, outputScale multiplies
+// output samples
+static void ConvertMatrixFromFixed(convert_matrix *m, const convert_fixed *f, f32 inputMax,
+								   f32 outputScale);
+
+// true for inputs that have integer kernels, float ones do not
+static bool ConvertFixedSupported(convert_input input);
+
+static u32 ConvertInputSize(convert_input input);   // bytes per pixel
+static u32 ConvertOutputSize(convert_output output); // bytes per sample
+
+// converts only [x0..x1) x [y0..y1) pixels of image, x0 & y0 must be even, output is same as
+// corresponding part of whole image conversion, so regions can be updated independently
+// output size is width & height rounded up to multiple of 2, last column/row is repeated just like
+// shader does when input size is odd, all strides are in bytes
+static void ConvertRegion(convert_input input, convert_output output, const convert_matrix *m,
+						  const void *src, udm srcStride, u32 width, u32 height,
+						  u32 x0, u32 y0, u32 x1, u32 y1, void *dstY, udm strideY,
+						  void *dstUV, udm strideUV);
+
+// same as ConvertRegion with integer kernels, input must be supported by ConvertFixedSupported
+static void ConvertRegionFixed(convert_input input, convert_output output, const convert_fixed *f,
+							   const void *src, udm srcStride, u32 width, u32 height,
+							   u32 x0, u32 y0, u32 x1, u32 y1, void *dstY, udm strideY,
+							   void *dstUV, udm strideUV);
+
+// BGRA8 to NV12 shortcuts, with fixed point kernels
+static void ConvertToNV12(const convert_fixed *f, const void *src, udm srcStride, u32 width,
+						  u32 height, u8 *dstY, udm strideY, u8 *dstUV, udm strideUV);
+static void ConvertToNV12Region(const convert_fixed *f, const void *src, udm srcStride, u32 width,
+								u32 height, u32 x0, u32 y0, u32 x1, u32 y1, u8 *dstY, udm strideY,
+								u8 *dstUV, udm strideUV);
+
+#endif //CONVERT_H
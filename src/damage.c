@@ -0,0 +1,310 @@
+#include "damage.h"
+
+// tile hash follows structure of XXH3 (https://github.com/Cyan4973/xxHash):
+// every 32 byte stripe is mixed into 4 64-bit lanes with its own secret, each tile row is
+// scrambled afterwards, so identical content moved to different position hashes differently
+// SIMD versions do exactly same integer math, hashes are identical on every cpu
+
+#define DAMAGE_LANES 4
+#define DAMAGE_STRIPE 32
+#define DAMAGE_STRIPES (DAMAGE_TILE_WIDTH * 4 / DAMAGE_STRIPE)
+#define DAMAGE_PRIME32 0x9E3779B1U
+
+// hashes rows of tile which is exactly width of full stripes
+typedef void damage_hash_rows(u64 *acc, const u8 *src, udm srcStride, u32 stripes, u32 rows);
+
+static BOG_ALIGN(32) u64 gDamageSecret[DAMAGE_STRIPES * DAMAGE_LANES];
+static BOG_ALIGN(32) u64 gDamageScramble[DAMAGE_LANES];
+static damage_hash_rows *gDamageHashRows;
+static bog_cpu_level gDamageLevel;
+
+static inline u64 DamageLoad64(const u8 *p) {
+	u64 result = 0;
+	for (u32 i = 0; i < 8; ++i) result |= (u64) p[i] << (8 * i);
+	return result;
+}
+
+static inline u64 DamageMix(u64 h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static inline void DamageAccumulate(u64 *acc, const u8 *p, const u64 *secret) {
+	for (u32 j = 0; j < DAMAGE_LANES; ++j) {
+		u64 data = DamageLoad64(p + 8 * j);
+		u64 key = data ^ secret[j];
+		acc[j ^ 1] += data;
+		acc[j] += (key & 0xffffffff) * (key >> 32);
+	}
+}
+
+static inline void DamageScramble(u64 *acc) {
+	for (u32 j = 0; j < DAMAGE_LANES; ++j) {
+		u64 a = acc[j];
+		a ^= a >> 47;
+		a ^= gDamageScramble[j];
+		acc[j] = a * DAMAGE_PRIME32;
+	}
+}
+
+static void DamageHashRowsScalar(u64 *acc, const u8 *src, udm srcStride, u32 stripes, u32 rows) {
+	for (u32 y = 0; y < rows; ++y) {
+		for (u32 s = 0; s < stripes; ++s) {
+			DamageAccumulate(acc, src + s * DAMAGE_STRIPE, gDamageSecret + s * DAMAGE_LANES);
+		}
+
+		DamageScramble(acc);
+		src += srcStride;
+	}
+}
+
+#ifdef BOG_X86
+BOG_TARGET_SSE2
+static void DamageHashRowsSSE2(u64 *acc, const u8 *src, udm srcStride, u32 stripes, u32 rows) {
+	__m128i acc0 = _mm_loadu_si128((const __m128i *) (acc + 0));
+	__m128i acc1 = _mm_loadu_si128((const __m128i *) (acc + 2));
+	__m128i scramble0 = _mm_load_si128((const __m128i *) (gDamageScramble + 0));
+	__m128i scramble1 = _mm_load_si128((const __m128i *) (gDamageScramble + 2));
+	__m128i prime = _mm_set1_epi32(DAMAGE_PRIME32);
+
+	for (u32 y = 0; y < rows; ++y) {
+		for (u32 s = 0; s < stripes; ++s) {
+			const u8 *p = src + s * DAMAGE_STRIPE;
+			const u64 *secret = gDamageSecret + s * DAMAGE_LANES;
+
+			__m128i data0 = _mm_loadu_si128((const __m128i *) (p + 0));
+			__m128i data1 = _mm_loadu_si128((const __m128i *) (p + 16));
+			__m128i key0 = _mm_xor_si128(data0, _mm_load_si128((const __m128i *) (secret + 0)));
+			__m128i key1 = _mm_xor_si128(data1, _mm_load_si128((const __m128i *) (secret + 2)));
+
+			// low 32 bits times high 32 bits of each lane
+			__m128i product0 = _mm_mul_epu32(key0, _mm_shuffle_epi32(key0, _MM_SHUFFLE(0, 3, 0, 1)));
+			__m128i product1 = _mm_mul_epu32(key1, _mm_shuffle_epi32(key1, _MM_SHUFFLE(0, 3, 0, 1)));
+
+			// data is added to neighbour lane
+			acc0 = _mm_add_epi64(acc0, _mm_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2)));
+			acc1 = _mm_add_epi64(acc1, _mm_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2)));
+			acc0 = _mm_add_epi64(acc0, product0);
+			acc1 = _mm_add_epi64(acc1, product1);
+		}
+
+		// scramble, 64-bit multiply by 32-bit prime done as two 32x32 multiplies
+		acc0 = _mm_xor_si128(_mm_xor_si128(acc0, _mm_srli_epi64(acc0, 47)), scramble0);
+		acc1 = _mm_xor_si128(_mm_xor_si128(acc1, _mm_srli_epi64(acc1, 47)), scramble1);
+		acc0 = _mm_add_epi64(_mm_mul_epu32(acc0, prime),
+							 _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(acc0, 32), prime), 32));
+		acc1 = _mm_add_epi64(_mm_mul_epu32(acc1, prime),
+							 _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(acc1, 32), prime), 32));
+
+		src += srcStride;
+	}
+
+	_mm_storeu_si128((__m128i *) (acc + 0), acc0);
+	_mm_storeu_si128((__m128i *) (acc + 2), acc1);
+}
+
+BOG_TARGET_AVX2
+static void DamageHashRowsAVX2(u64 *acc, const u8 *src, udm srcStride, u32 stripes, u32 rows) {
+	__m256i a = _mm256_loadu_si256((const __m256i *) acc);
+	__m256i scramble = _mm256_load_si256((const __m256i *) gDamageScramble);
+	__m256i prime = _mm256_set1_epi32(DAMAGE_PRIME32);
+
+	for (u32 y = 0; y < rows; ++y) {
+		for (u32 s = 0; s < stripes; ++s) {
+			__m256i data = _mm256_loadu_si256((const __m256i *) (src + s * DAMAGE_STRIPE));
+			__m256i secret = _mm256_load_si256((const __m256i *) (gDamageSecret + s * DAMAGE_LANES));
+			__m256i key = _mm256_xor_si256(data, secret);
+
+			__m256i product = _mm256_mul_epu32(key, _mm256_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+			a = _mm256_add_epi64(a, _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+			a = _mm256_add_epi64(a, product);
+		}
+
+		a = _mm256_xor_si256(_mm256_xor_si256(a, _mm256_srli_epi64(a, 47)), scramble);
+		a = _mm256_add_epi64(_mm256_mul_epu32(a, prime),
+							 _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime), 32));
+
+		src += srcStride;
+	}
+
+	_mm256_storeu_si256((__m256i *) acc, a);
+}
+#endif
+
+static void DamageSetLevel(bog_cpu_level level) {
+	switch (level) {
+#ifdef BOG_X86
+		case BOG_CPU_AVX2: {
+			gDamageHashRows = DamageHashRowsAVX2;
+		} break;
+
+		case BOG_CPU_SSE2: {
+			gDamageHashRows = DamageHashRowsSSE2;
+		} break;
+#endif
+
+		default: {
+			level = BOG_CPU_SCALAR;
+			gDamageHashRows = DamageHashRowsScalar;
+		}
+	}
+
+	gDamageLevel = level;
+}
+
+static bog_cpu_level DamageGetLevel(void) {
+	return gDamageLevel;
+}
+
+static void DamageInit(void) {
+	// secrets only need to be fixed & random looking, splitmix64 sequence will do
+	u64 state = 0x243F6A8885A308D3ULL;
+	for (u32 i = 0; i < DAMAGE_STRIPES * DAMAGE_LANES; ++i) {
+		state += 0x9E3779B97F4A7C15ULL;
+		gDamageSecret[i] = DamageMix(state);
+	}
+
+	for (u32 i = 0; i < DAMAGE_LANES; ++i) {
+		state += 0x9E3779B97F4A7C15ULL;
+		gDamageScramble[i] = DamageMix(state);
+	}
+
+	DamageSetLevel(BOGCpuLevel());
+}
+
+static u64 DamageHashTile(const u8 *src, udm srcStride, u32 width, u32 height) {
+	if (!gDamageHashRows) DamageInit();
+
+	u64 acc[DAMAGE_LANES] = {
+		0xC2B2AE3D27D4EB4FULL, 0x9E3779B185EBCA87ULL, 0x165667B19E3779F9ULL, 0x85EBCA77C2B2AE63ULL
+	};
+
+	u32 bytes = width * 4;
+	u32 stripes = bytes / DAMAGE_STRIPE;
+	u32 tail = bytes % DAMAGE_STRIPE;
+
+	if (!tail) {
+		gDamageHashRows(acc, src, srcStride, stripes, height);
+	} else {
+		// partial stripe at right edge of frame is zero padded
+		u8 last[DAMAGE_STRIPE] = {0};
+		for (u32 y = 0; y < height; ++y) {
+			for (u32 s = 0; s < stripes; ++s) {
+				DamageAccumulate(acc, src + s * DAMAGE_STRIPE, gDamageSecret + s * DAMAGE_LANES);
+			}
+
+			for (u32 i = 0; i < tail; ++i) last[i] = src[stripes * DAMAGE_STRIPE + i];
+			DamageAccumulate(acc, last, gDamageSecret + stripes * DAMAGE_LANES);
+			DamageScramble(acc);
+			src += srcStride;
+		}
+	}
+
+	u64 result = (((u64) width << 32) | height) * 0x9E3779B185EBCA87ULL;
+	for (u32 j = 0; j < DAMAGE_LANES; ++j) {
+		result = DamageMix(result ^ acc[j]);
+	}
+
+	return result;
+}
+
+static bool DamageCreate(damage_map *d, u32 width, u32 height) {
+	u32 tilesX = (width + DAMAGE_TILE_WIDTH - 1) / DAMAGE_TILE_WIDTH;
+	u32 tilesY = (height + DAMAGE_TILE_HEIGHT - 1) / DAMAGE_TILE_HEIGHT;
+	udm count = (udm) tilesX * tilesY;
+
+	d->memorySize = count * sizeof(u64) + count;
+	d->memory = BOGAlloc(d->memorySize);
+	if (!d->memory) return false;
+
+	d->hashes = (u64 *) d->memory;
+	d->dirty = (u8 *) (d->hashes + count);
+	d->width = width;
+	d->height = height;
+	d->tilesX = tilesX;
+	d->tilesY = tilesY;
+	d->dirtyCount = 0;
+	d->valid = false;
+
+	if (!gDamageHashRows) DamageInit();
+
+	return true;
+}
+
+static void DamageDestroy(damage_map *d) {
+	BOGFree(d->memory, d->memorySize);
+	d->memory = 0;
+	d->width = 0;
+	d->height = 0;
+}
+
+static void DamageReset(damage_map *d) {
+	d->valid = false;
+}
+
+static u32 DamageUpdate(damage_map *d, const void *src, udm srcStride) {
+	u32 count = 0;
+
+	for (u32 ty = 0; ty < d->tilesY; ++ty) {
+		u32 y = ty * DAMAGE_TILE_HEIGHT;
+		u32 height = d->height - y < DAMAGE_TILE_HEIGHT ? d->height - y : DAMAGE_TILE_HEIGHT;
+		const u8 *row = (const u8 *) src + y * srcStride;
+
+		for (u32 tx = 0; tx < d->tilesX; ++tx) {
+			u32 x = tx * DAMAGE_TILE_WIDTH;
+			u32 width = d->width - x < DAMAGE_TILE_WIDTH ? d->width - x : DAMAGE_TILE_WIDTH;
+			udm index = (udm) ty * d->tilesX + tx;
+
+			u64 hash = DamageHashTile(row + x * 4, srcStride, width, height);
+			bool dirty = !d->valid || hash != d->hashes[index];
+
+			d->hashes[index] = hash;
+			d->dirty[index] = dirty;
+			count += dirty;
+		}
+	}
+
+	d->valid = true;
+	d->dirtyCount = count;
+
+	return count;
+}
+
+static void DamageConvertNV12Rows(damage_map *d, const convert_fixed *f, const void *src,
+								  udm srcStride, u32 tileY0, u32 tileY1, u8 *dstY, udm strideY,
+								  u8 *dstUV, udm strideUV) {
+	if (tileY1 > d->tilesY) tileY1 = d->tilesY;
+
+	// tile edges are even, so 2x2 chroma blocks never cross them & tiles can be converted separately
+	// neighbouring dirty tiles in row are merged into one run for longer SIMD loops, when all of
+	// them are dirty whole row is converted at once
+	for (u32 ty = tileY0; ty < tileY1; ++ty) {
+		const u8 *dirty = d->dirty + ty * d->tilesX;
+		u32 y0 = ty * DAMAGE_TILE_HEIGHT;
+		u32 y1 = y0 + DAMAGE_TILE_HEIGHT < d->height ? y0 + DAMAGE_TILE_HEIGHT : d->height;
+
+		for (u32 tx = 0; tx < d->tilesX;) {
+			if (!dirty[tx]) {
+				tx++;
+				continue;
+			}
+
+			u32 first = tx;
+			while (tx < d->tilesX && dirty[tx]) tx++;
+
+			u32 x0 = first * DAMAGE_TILE_WIDTH;
+			u32 x1 = tx * DAMAGE_TILE_WIDTH < d->width ? tx * DAMAGE_TILE_WIDTH : d->width;
+			ConvertToNV12Region(f, src, srcStride, d->width, d->height, x0, y0, x1, y1,
+								dstY, strideY, dstUV, strideUV);
+		}
+	}
+}
+
+static void DamageConvertNV12(damage_map *d, const convert_fixed *f, const void *src, udm srcStride,
+							  u8 *dstY, udm strideY, u8 *dstUV, udm strideUV) {
+	DamageConvertNV12Rows(d, f, src, srcStride, 0, d->tilesY, dstY, strideY, dstUV, strideUV);
+}
@@ -0,0 +1,58 @@
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_cpu.h"
+#include "bog/bog_memory.h"
+#include "convert.h"
+
+// detects which tiles of BGRA frame changed since previous frame by hashing them
+// it needs frame in CPU memory, so encoder reads every frame back, CPU conversion then converts
+// only changed tiles, GPU conversion only uses it to skip frames without any change
+
+// tile is 64 pixels = 256 bytes wide, that is 8 stripes of 32 bytes hashed in parallel lanes
+// height is multiple of 2, so tiles never split 2x2 chroma blocks of NV12
+#define DAMAGE_TILE_WIDTH 64
+#define DAMAGE_TILE_HEIGHT 16
+
+// interface
+
+typedef struct {
+	u32 width, height;
+	u32 tilesX, tilesY;
+	u64 *hashes;	// hash of every tile from previous frame
+	u8 *dirty;		// 1 for tiles that changed in last update
+	u32 dirtyCount;
+	bool valid;		// false until first update, or after reset, all tiles will be dirty
+
+	void *memory;
+	udm memorySize;
+} damage_map;
+
+static void DamageInit(void);
+static bog_cpu_level DamageGetLevel(void);
+static void DamageSetLevel(bog_cpu_level level);
+
+static bool DamageCreate(damage_map *d, u32 width, u32 height);
+static void DamageDestroy(damage_map *d);
+
+// makes next update report every tile as changed
+static void DamageReset(damage_map *d);
+
+// hashes frame & compares with previous one, returns count of changed tiles
+static u32 DamageUpdate(damage_map *d, const void *src, udm srcStride);
+
+// hash of width x height pixels, width must be at most DAMAGE_TILE_WIDTH
+static u64 DamageHashTile(const u8 *src, udm srcStride, u32 width, u32 height);
+
+// converts only tiles marked dirty by last update, dst must contain previous converted frame
+// result is bit identical to converting whole frame with ConvertToNV12
+static void DamageConvertNV12(damage_map *d, const convert_fixed *f, const void *src, udm srcStride,
+							  u8 *dstY, udm strideY, u8 *dstUV, udm strideUV);
+
+// same as DamageConvertNV12 but only for tile rows [tileY0..tileY1), so bands can run in parallel
+static void DamageConvertNV12Rows(damage_map *d, const convert_fixed *f, const void *src,
+								  udm srcStride, u32 tileY0, u32 tileY1, u8 *dstY, udm strideY,
+								  u8 *dstUV, udm strideUV);
+
+#endif //DAMAGE_H
@@ -0,0 +1,144 @@
+#include "drift.h"
+
+static void DriftStart(drift *d, const drift_config *config, u64 start) {
+	d->config = *config;
+
+	drift_config *c = &d->config;
+	if (c->window > DRIFT_MAX_POINTS) c->window = DRIFT_MAX_POINTS;
+	if (c->window < 2) c->window = 2;
+	if (!c->sampleRate) c->sampleRate = 1;
+
+	d->start = start;
+	d->written = 0;
+	d->started = false;
+	d->head = 0;
+	d->count = 0;
+	d->intervalFrames = (u64) c->interval * c->sampleRate / 1000;
+	d->lastPosition = 0;
+
+	d->basePosition = 0;
+	d->baseTime = start;
+	d->x = 0;
+	d->y = 0;
+	d->nominal = (d64) c->clock.num / ((d64) c->clock.den * c->sampleRate);
+	d->framesPerTick = 1 / d->nominal;
+	d->slope = d->nominal;
+
+	d->silenced = 0;
+	d->trimmed = 0;
+	d->corrected = 0;
+	d->discontinuities = 0;
+}
+
+static s64 DriftRound(d64 value) {
+	return value >= 0 ? (s64) (value + 0.5) : -(s64) (0.5 - value);
+}
+
+// clock ticks from start to where fitted line is at position, negative before start
+static d64 DriftFit(drift *d, u64 position) {
+	d64 base = (d64) (s64) (d->baseTime - d->start);
+	return base + d->y + d->slope * ((d64) (s64) (position - d->basePosition) - d->x);
+}
+
+static void DriftAddPoint(drift *d, u64 position, u64 time) {
+	const drift_config *c = &d->config;
+	if (!d->count) {
+		d->basePosition = position;
+		d->baseTime = time;
+	}
+
+	d->position[d->head] = position;
+	d->time[d->head] = time;
+	d->head = (d->head + 1) % c->window;
+	if (d->count < c->window) d->count++;
+
+	// least squares around means, so large positions don't lose precision in squares
+	d64 sx = 0, sy = 0;
+	for (u32 i = 0; i < d->count; i++) {
+		u32 index = (d->head + c->window - d->count + i) % c->window;
+		sx += (d64) (s64) (d->position[index] - d->basePosition);
+		sy += (d64) (s64) (d->time[index] - d->baseTime);
+	}
+	d->x = sx / d->count;
+	d->y = sy / d->count;
+
+	d64 sxx = 0, sxy = 0;
+	for (u32 i = 0; i < d->count; i++) {
+		u32 index = (d->head + c->window - d->count + i) % c->window;
+		d64 dx = (d64) (s64) (d->position[index] - d->basePosition) - d->x;
+		d64 dy = (d64) (s64) (d->time[index] - d->baseTime) - d->y;
+		sxx += dx * dx;
+		sxy += dx * dy;
+	}
+
+	// few close points give noisy slope, it can't be further off than twice what is corrected
+	if (sxx > 0) {
+		d64 range = d->nominal * 2 * c->maxPpm / 1000000;
+		d64 slope = sxy / sxx;
+		if (slope < d->nominal - range) slope = d->nominal - range;
+		if (slope > d->nominal + range) slope = d->nominal + range;
+		d->slope = slope;
+	}
+}
+
+static drift_plan DriftPacket(drift *d, u64 position, u64 time, u32 count, bool discontinuity) {
+	const drift_config *c = &d->config;
+	drift_plan plan = { 0 };
+
+	// packet far from fitted line is same as discontinuity device reported
+	d64 gap = (d64) c->gapLimit * c->sampleRate / 1000;
+	if (d->count) {
+		d64 offset = ((d64) (s64) (time - d->start) - DriftFit(d, position)) * d->framesPerTick;
+		if (offset > gap || offset < -gap || position < d->lastPosition) discontinuity = true;
+	}
+	if (discontinuity && d->started) {
+		// only offset of line starts over, slope of device clock stays
+		d->count = 0;
+		d->discontinuities++;
+	}
+
+	if (!d->count || position - d->position[(d->head + c->window - 1) % c->window] >=
+		d->intervalFrames) {
+		DriftAddPoint(d, position, time);
+	}
+	d->lastPosition = position + count;
+
+	plan.time = d->start + (u64) DriftRound(d->written * d->nominal);
+	plan.ratio = DriftRatio(d);
+
+	// positive when output is behind clock
+	d64 error = DriftFit(d, position) * d->framesPerTick - d->written;
+	if (!d->started || discontinuity || error > gap || error < -gap) {
+		// sample accurate right away
+		s64 frames = DriftRound(error);
+		if (frames > 0) {
+			plan.silence = frames < 0xFFFFFFFF ? (u32) frames : 0xFFFFFFFF;
+		} else {
+			plan.trim = (u64) -frames < count ? (u32) -frames : count;
+		}
+		// packets before start are all trimmed this way, including one that start is in
+		d->started = plan.silence || plan.trim < count;
+	} else {
+		// only what is beyond tolerance is corrected, spread over DRIFT_SETTLE seconds
+		d64 tolerance = (d64) c->tolerance * c->sampleRate / 1000;
+		d64 beyond = 0;
+		if (error > tolerance) beyond = error - tolerance;
+		if (error < -tolerance) beyond = error + tolerance;
+		d64 limit = (d64) c->maxPpm / 1000000;
+		d64 correction = beyond / ((d64) c->sampleRate * DRIFT_SETTLE);
+		if (correction > limit) correction = limit;
+		if (correction < -limit) correction = -limit;
+
+		d->corrected += (count - plan.trim) * plan.ratio * correction;
+		plan.ratio *= 1 + correction;
+	}
+
+	d->written += ((d64) plan.silence + count - plan.trim) * plan.ratio;
+	d->silenced += plan.silence;
+	d->trimmed += plan.trim;
+	return plan;
+}
+
+static d64 DriftRatio(drift *d) {
+	return d->slope / d->nominal;
+}
@@ -0,0 +1,74 @@
+#ifndef DRIFT_H
+#define DRIFT_H
+
+#include "bog/bog_types.h"
+#include "timebase.h"
+
+// keeps audio in sync with clock when audio device runs bit faster or slower than it
+// fits line through device position & clock time of packets over last window, so jitter of
+// single timestamps doesn't matter, & plans for every packet how many output frames it gives
+// resampler follows slope of line with its ratio, small differences are corrected by bending
+// ratio bit more, so they are gone over few seconds without repeating or dropping any frame
+// packet that is far from fitted line, or that device marks as discontinuity, starts new line &
+// gets silence before it or has its start trimmed, so output is sample accurate right away
+// output frames are contiguous, frame n of output always belongs to start + n / sampleRate
+
+#define DRIFT_MAX_POINTS 64
+#define DRIFT_SETTLE 10 // seconds over which ratio corrects what is beyond tolerance
+
+// interface
+
+typedef struct {
+	u32 sampleRate;    // frames per second device should give & output has
+	time_rate clock;   // ticks of packet times
+	u32 interval;      // msec between points of fitted line
+	u32 window;        // points of fitted line, at most DRIFT_MAX_POINTS
+	u32 maxPpm;        // ratio is corrected by at most this many parts per million
+	u32 tolerance;     // msec output can be off clock before it's corrected, so fitted line
+	                   // moving bit with every new point doesn't bend ratio back & forth
+	u32 gapLimit;      // msec packet can be off fitted line before it's discontinuity
+} drift_config;
+
+// what to output for one packet, in this order
+typedef struct {
+	u64 time;          // clock ticks of first output frame
+	u32 silence;       // frames of silence
+	u32 trim;          // frames dropped from start of packet
+	d64 ratio;         // resampler gives this many output frames per frame, silence included
+} drift_plan;
+
+typedef struct {
+	drift_config config;
+	u64 start;         // clock ticks of output frame 0
+	d64 written;       // output frames so far, fractional with ratio
+	bool started;
+
+	// points [head - count..head) of fitted line, positions & times relative to first one
+	u64 position[DRIFT_MAX_POINTS];
+	u64 time[DRIFT_MAX_POINTS];
+	u32 head, count;
+	u64 intervalFrames;
+	u64 lastPosition;  // end of previous packet
+
+	// fitted line goes through (basePosition + x, baseTime + y) with slope ticks per frame
+	u64 basePosition, baseTime;
+	d64 x, y, slope;
+	d64 nominal;       // ticks per frame at sample rate
+	d64 framesPerTick;
+
+	// statistics
+	u64 silenced, trimmed;
+	d64 corrected;     // frames ratio added beyond slope of line, < 0 when it removed them
+	u32 discontinuities;
+} drift;
+
+// start is clock time that output frame 0 belongs to, earlier audio is trimmed
+static void DriftStart(drift *d, const drift_config *config, u64 start);
+
+// packet of count frames at device position with clock time of its first frame
+static drift_plan DriftPacket(drift *d, u64 position, u64 time, u32 count, bool discontinuity);
+
+// output frames per device frame, what resampler would need to follow clock
+static d64 DriftRatio(drift *d);
+
+#endif //DRIFT_H
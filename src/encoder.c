@@ -37,7 +37,20 @@ static HRESULT STDMETHODCALLTYPE EncoderVideoInvoke(IMFAsyncCallback *this, IMFA
 	// keep Sample object reference count incremented to reuse for new frame submission
 
 	encoder *e = CONTAINING_RECORD(this, encoder, videoSampleCallback);
-	InterlockedIncrement(&e->videoCount);
+
+	u64 time = TimeClockNow(&e->clock);
+
+	UINT32 index;
+	if (SUCCEEDED(IMFSample_GetUINT32(sample, &ENCODER_BUFFER_INDEX, &index))) {
+		// allocator is cleared once it was called, so this really frees repeated frame sample
+		if (sample != e->videoSample[index]) IMFSample_Release(sample);
+
+		// buffer is free when last sample using it returns & it is not current frame of pacer
+		if (!BOGAtomicAdd(&e->videoRefs[index], -1)) {
+			PoolRelease(&e->videoPool, (s32) index, time);
+			WakeByAddressSingle((void *) &e->videoPool.free);
+		}
+	}
 
 	return S_OK;
 }
@@ -51,6 +64,9 @@ static HRESULT STDMETHODCALLTYPE EncoderAudioInvoke(IMFAsyncCallback *this, IMFA
 	IUnknown_Release(object);
 	// keep Sample object reference count incremented to reuse for new sample submission
 
+	// buffer goes back to ring once encoder doesn't hold it either
+	IMFSample_RemoveAllBuffers(sample);
+
 	encoder *e = CONTAINING_RECORD(this, encoder, audioSampleCallback);
 	InterlockedIncrement(&e->audioCount);
 	WakeByAddressSingle(&e->audioCount);
@@ -58,10 +74,253 @@ static HRESULT STDMETHODCALLTYPE EncoderAudioInvoke(IMFAsyncCallback *this, IMFA
 	return S_OK;
 }
 
-static void EncoderInit(encoder *e) {
+static HRESULT STDMETHODCALLTYPE EncoderBufferQueryInterface(IMFMediaBuffer *this, REFIID riid,
+															 void **object) {
+	if (!object) return E_POINTER;
+
+	if (IsEqualGUID(&IID_IUnknown, riid) || IsEqualGUID(&IID_IMFMediaBuffer, riid)) {
+		EncoderBufferAddRef(this);
+		*object = this;
+		return S_OK;
+	}
+
+	*object = 0;
+	return E_NOINTERFACE;
+}
+
+static ULONG STDMETHODCALLTYPE EncoderBufferAddRef(IMFMediaBuffer *this) {
+	encoder_audio_buffer *buffer = (encoder_audio_buffer *) this;
+	return InterlockedIncrement(&buffer->refs);
+}
+
+static ULONG STDMETHODCALLTYPE EncoderBufferRelease(IMFMediaBuffer *this) {
+	encoder_audio_buffer *buffer = (encoder_audio_buffer *) this;
+	ULONG refs = InterlockedDecrement(&buffer->refs);
+	if (!refs) RingRelease(buffer->ring, buffer);
+	return refs;
+}
+
+static HRESULT STDMETHODCALLTYPE EncoderBufferLock(IMFMediaBuffer *this, BYTE **data,
+												   DWORD *maxLength, DWORD *currentLength) {
+	encoder_audio_buffer *buffer = (encoder_audio_buffer *) this;
+	if (!data) return E_POINTER;
+
+	*data = (BYTE *) (buffer + 1);
+	if (maxLength) *maxLength = buffer->maxLength;
+	if (currentLength) *currentLength = buffer->length;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE EncoderBufferUnlock(IMFMediaBuffer *this) {
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE EncoderBufferGetCurrentLength(IMFMediaBuffer *this,
+															   DWORD *length) {
+	if (!length) return E_POINTER;
+	*length = ((encoder_audio_buffer *) this)->length;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE EncoderBufferSetCurrentLength(IMFMediaBuffer *this,
+															   DWORD length) {
+	encoder_audio_buffer *buffer = (encoder_audio_buffer *) this;
+	if (length > buffer->maxLength) return E_INVALIDARG;
+	buffer->length = length;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE EncoderBufferGetMaxLength(IMFMediaBuffer *this, DWORD *length) {
+	if (!length) return E_POINTER;
+	*length = ((encoder_audio_buffer *) this)->maxLength;
+	return S_OK;
+}
+
+static void EncoderInit(void) {
 	MFStartup(MF_VERSION, MFSTARTUP_LITE);
-	e->videoSampleCallback.lpVtbl = &EncoderVideoSampleCallbackVtbl;
-	e->audioSampleCallback.lpVtbl = &EncoderAudioSampleCallbackVtbl;
+	ConvertInit();
+	ResizeInit();
+	DamageInit();
+	ResamplerInit();
+}
+
+// NV12 texture & sample for buffer number index of video pool
+static bool EncoderCreateVideoBuffer(void *user, u32 index) {
+	encoder *e = (encoder *) user;
+
+	ID3D11Texture2D *texture;
+	if (FAILED(ID3D11Device_CreateTexture2D(e->device, &e->videoDesc, 0, &texture))) return false;
+
+	e->convertOutputViewY[index] = 0;
+	e->convertOutputViewUV[index] = 0;
+	if (!e->cpuConvert) {
+		D3D11_UNORDERED_ACCESS_VIEW_DESC viewY = {
+			.Format = e->videoFormatY,
+			.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D
+		};
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC viewUV = {
+			.Format = e->videoFormatUV,
+			.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D,
+		};
+
+		ID3D11Device_CreateUnorderedAccessView(e->device, (ID3D11Resource *) texture, &viewY,
+											   &e->convertOutputViewY[index]);
+		ID3D11Device_CreateUnorderedAccessView(e->device, (ID3D11Resource *) texture, &viewUV,
+											   &e->convertOutputViewUV[index]);
+	}
+
+	IMFSample *videoSample;
+	IMFMediaBuffer *buffer;
+	MFCreateVideoSampleFromSurface(0, &videoSample);
+	MFCreateDXGISurfaceBuffer(&IID_ID3D11Texture2D, (IUnknown *) texture, 0, false, &buffer);
+	IMFMediaBuffer_SetCurrentLength(buffer, e->videoSize);
+	IMFSample_AddBuffer(videoSample, buffer);
+	IMFMediaBuffer_Release(buffer);
+
+	// allocator callback finds buffer by this
+	IMFSample_SetUINT32(videoSample, &ENCODER_BUFFER_INDEX, index);
+
+	e->convertTexture[index] = texture;
+	e->videoSample[index] = videoSample;
+	return true;
+}
+
+static void EncoderDestroyVideoBuffer(void *user, u32 index) {
+	encoder *e = (encoder *) user;
+
+	ID3D11UnorderedAccessView *viewY = e->convertOutputViewY[index];
+	ID3D11UnorderedAccessView *viewUV = e->convertOutputViewUV[index];
+	if (viewY) ID3D11UnorderedAccessView_Release(viewY);
+	if (viewUV) ID3D11UnorderedAccessView_Release(viewUV);
+	ID3D11Texture2D_Release(e->convertTexture[index]);
+	IMFSample_Release(e->videoSample[index]);
+}
+
+static void EncoderCreateStagingInput(encoder *e, ID3D11Device *device, u32 width, u32 height) {
+	D3D11_TEXTURE2D_DESC desc = {
+		.Width = width,
+		.Height = height,
+		.MipLevels = 1,
+		.ArraySize = 1,
+		.Format = DXGI_FORMAT_B8G8R8A8_UNORM,
+		.SampleDesc = {1, 0},
+		.Usage = D3D11_USAGE_STAGING,
+		.CPUAccessFlags = D3D11_CPU_ACCESS_READ
+	};
+
+	e->stagingInput = 0;
+	ID3D11Device_CreateTexture2D(device, &desc, 0, &e->stagingInput);
+	e->stagingWidth = e->stagingInput ? width : 0;
+	e->stagingHeight = e->stagingInput ? height : 0;
+}
+
+static bool EncoderCreateInputTexture(encoder *e, ID3D11Device *device, u32 width, u32 height) {
+	if (e->inputTexture) {
+		ID3D11RenderTargetView_Release(e->inputRenderTarget);
+		ID3D11ShaderResourceView_Release(e->resizeInputView);
+		ID3D11Texture2D_Release(e->inputTexture);
+		e->inputTexture = 0;
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {
+		.Width = width,
+		.Height = height,
+		.MipLevels = 1,
+		.ArraySize = 1,
+		.Format = DXGI_FORMAT_B8G8R8A8_UNORM,
+		.SampleDesc = {1, 0},
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE
+	};
+
+	ID3D11Texture2D *texture;
+	if (FAILED(ID3D11Device_CreateTexture2D(device, &desc, 0, &texture))) return false;
+	ID3D11Device_CreateRenderTargetView(device, (ID3D11Resource *) texture, 0,
+										&e->inputRenderTarget);
+	ID3D11Device_CreateShaderResourceView(device, (ID3D11Resource *) texture, 0,
+										  &e->resizeInputView);
+
+	// nothing is captured yet, black is better than garbage
+	ID3D11DeviceContext *context;
+	ID3D11Device_GetImmediateContext(device, &context);
+	f32 black[] = {0, 0, 0, 0};
+	ID3D11DeviceContext_ClearRenderTargetView(context, e->inputRenderTarget, black);
+	ID3D11DeviceContext_Release(context);
+
+	e->inputTexture = texture;
+	e->inputWidth = width;
+	e->inputHeight = height;
+	return true;
+}
+
+// resize shader writes packed BGRA as uint, R8G8B8A8 is format that can be viewed that way, so
+// converter reads R & B swapped
+static bool EncoderCreateResizedTexture(encoder *e, ID3D11Device *device, u32 width, u32 height) {
+	D3D11_TEXTURE2D_DESC desc = {
+		.Width = width,
+		.Height = height,
+		.MipLevels = 1,
+		.ArraySize = 1,
+		.Format = DXGI_FORMAT_R8G8B8A8_TYPELESS,
+		.SampleDesc = {1, 0},
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
+	};
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC outputDesc = {
+		.Format = DXGI_FORMAT_R32_UINT,
+		.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D
+	};
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC inputDesc = {
+		.Format = DXGI_FORMAT_R8G8B8A8_UNORM,
+		.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D,
+		.Texture2D.MipLevels = 1
+	};
+
+	e->resizedTexture = 0;
+	e->resizeOutputView = 0;
+	e->convertInputView = 0;
+
+	ID3D11Texture2D *texture;
+	if (FAILED(ID3D11Device_CreateTexture2D(device, &desc, 0, &texture))) return false;
+
+	HRESULT hr = ID3D11Device_CreateUnorderedAccessView(device, (ID3D11Resource *) texture,
+														&outputDesc, &e->resizeOutputView);
+	if (SUCCEEDED(hr)) {
+		hr = ID3D11Device_CreateShaderResourceView(device, (ID3D11Resource *) texture, &inputDesc,
+												   &e->convertInputView);
+	}
+
+	if (FAILED(hr)) {
+		if (e->resizeOutputView) ID3D11UnorderedAccessView_Release(e->resizeOutputView);
+		ID3D11Texture2D_Release(texture);
+		e->resizeOutputView = 0;
+		return false;
+	}
+
+	e->resizedTexture = texture;
+	return true;
+}
+
+// first file has name given to EncoderStart, later ones get part number before extension
+static bool EncoderSegmentName(void *user, u32 index, output_path *path, u32 count) {
+	encoder *e = (encoder *) user;
+	if (wcscpy_s(path, count, e->fileName)) return false;
+	if (!index) return true;
+
+	wchar_t *extension = wcsrchr(path, L'.');
+	if (!extension || wcschr(extension, L'\\')) extension = path + wcslen(path);
+
+	wchar_t part[32];
+	wsprintfW(part, L" (part %u)", index + 1);
+	udm offset = extension - path;
+	if (offset + wcslen(part) + wcslen(e->fileName + offset) >= count) return false;
+
+	wcscpy_s(extension, count - offset, part);
+	wcscat_s(path, count, e->fileName + offset);
+	return true;
 }
 
 #pragma warning(push)
@@ -75,12 +334,19 @@ static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, en
 	ID3D11DeviceContext *context;
 	ID3D11Device_GetImmediateContext(device, &context);
 	
-	ID3D11ComputeShader *resizeShader;
-	ID3D11ComputeShader *convertShader;
-	ID3D11Device_CreateComputeShader(device, ResizeShaderBytes, sizeof(ResizeShaderBytes), 0,
-									 &resizeShader);
-	ID3D11Device_CreateComputeShader(device, ConvertShaderBytes, sizeof(ConvertShaderBytes), 0,
-									 &convertShader);
+	ID3D11ComputeShader *resizeShader = 0;
+	ID3D11ComputeShader *convertShader = 0;
+	HRESULT shaderResult = ID3D11Device_CreateComputeShader(device, ResizeShaderBytes,
+															sizeof(ResizeShaderBytes), 0,
+															&resizeShader);
+	if (SUCCEEDED(shaderResult)) {
+		shaderResult = ID3D11Device_CreateComputeShader(device, ConvertShaderBytes,
+														sizeof(ConvertShaderBytes), 0,
+														&convertShader);
+	}
+	
+	// fall back to converting on CPU if compute shaders are not available
+	bool cpuConvert = config->cpuConvert || FAILED(shaderResult);
 	
 	// must be multiple of 2, round upwards
 	DWORD width = (config->width + 1) & ~1;
@@ -88,13 +354,17 @@ static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, en
 	
 	BOOL result = FALSE;
 	IMFSinkWriter *writer = 0;
-	IMFTransform *resampler = 0;
+	mux_sink *sink = 0;
+	resampler *audioResampler = 0;
+	block_ring *audioRing = 0;
 	HRESULT hr;
 	
+	e->videoSampleCallback.lpVtbl = &EncoderVideoSampleCallbackVtbl;
+	e->audioSampleCallback.lpVtbl = &EncoderAudioSampleCallbackVtbl;
 	e->videoStreamIndex = -1;
 	e->audioStreamIndex = -1;
 	
-	const GUID *container, *codec, *mediaFormatYUV;
+	const GUID *codec, *mediaFormatYUV;
 	UINT32 profile;
 	DXGI_FORMAT formatYUV, formatY, formatUV;
 	
@@ -103,29 +373,12 @@ static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, en
 	formatY = DXGI_FORMAT_R8_UINT;
 	formatUV = DXGI_FORMAT_R8G8_UINT;
 	
-	container = &MFTranscodeContainerType_MPEG4;
 	codec = &MFVideoFormat_H264;
 	profile = eAVEncH264VProfile_High;
 	
-	// output file
-	{
-		IMFAttributes *attributes;
-		MFCreateAttributes(&attributes, 4);
-		IMFAttributes_SetUINT32(attributes, &MF_READWRITE_ENABLE_HARDWARE_TRANSFORMS, false);
-		IMFAttributes_SetUnknown(attributes, &MF_SINK_WRITER_D3D_MANAGER, (IUnknown *) manager);
-		IMFAttributes_SetUINT32(attributes, &MF_SINK_WRITER_DISABLE_THROTTLING, true);
-		IMFAttributes_SetGUID(attributes, &MF_TRANSCODE_CONTAINERTYPE, container);
-
-		hr = MFCreateSinkWriterFromURL(fileName, 0, attributes, &writer);
-		IMFAttributes_Release(attributes);
-
-		if (hr != S_OK) {
-			MessageBoxW(0, L"Cannot create output mp4 file!", L"Error", MB_ICONERROR);
-			goto bail;
-		}
-	}
-
-	// video output type
+	// output types, encoders are inserted by sink writer between them & input types
+	IMFMediaType *types[2] = { 0 };
+	u32 typeCount = config->audioFormat ? 2 : 1;
 	{
 		IMFMediaType *type;
 		MFCreateMediaType(&type);
@@ -141,14 +394,71 @@ static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, en
 							   MFT64(config->framerateNum, config->framerateDen));
 		IMFMediaType_SetUINT64(type, &MF_MT_FRAME_SIZE, MFT64(width, height));
 		IMFMediaType_SetUINT32(type, &MF_MT_AVG_BITRATE, AUDIO_BITRATE * 1000);
+		types[0] = type;
 
-		hr = IMFSinkWriter_AddStream(writer, type, (DWORD *) &e->videoStreamIndex);
-		IMFMediaType_Release(type);
+		if (config->audioFormat) {
+			MFCreateMediaType(&type);
+			IMFMediaType_SetGUID(type, &MF_MT_MAJOR_TYPE, &MFMediaType_Audio);
+			IMFMediaType_SetGUID(type, &MF_MT_SUBTYPE, &MFAudioFormat_FLAC);
+			IMFMediaType_SetUINT32(type, &MF_MT_AUDIO_BITS_PER_SAMPLE, 16);
+			IMFMediaType_SetUINT32(type, &MF_MT_AUDIO_SAMPLES_PER_SECOND, AUDIO_SAMPLERATE);
+			IMFMediaType_SetUINT32(type, &MF_MT_AUDIO_NUM_CHANNELS, AUDIO_CHANNELS);
+			types[1] = type;
+		}
+	}
+
+	// output file, written by our own fragmented MP4 muxer so it plays even if recording dies
+	{
+		wcsncpy_s(e->fileName, SEGMENT_MAX_PATH, fileName, _TRUNCATE);
+		mux_sink_config sinkConfig = {
+			.record = !(config->replayOnly && config->replayDuration),
+			.segment = {
+				.duration = config->segmentDuration,
+				.size = config->segmentSize,
+				.fragmentDuration = ENCODER_FRAGMENT_DURATION,
+				.output = {
+					.bufferSize = ENCODER_OUTPUT_BUFFER,
+					.bufferCount = ENCODER_OUTPUT_BUFFER_COUNT,
+					.preallocate = ENCODER_OUTPUT_PREALLOCATE,
+					.direct = true,
+					.wait = false // sink writer never waits for disk, full output drops fragment
+				},
+				.name = EncoderSegmentName,
+				.user = e
+			},
+			.replayDuration = config->replayDuration
+		};
+
+		// VBR peaks go over mean bit rate, FLAC is never bigger than its PCM
+		u64 videoBytes = AUDIO_BITRATE * 1000 / 8 * ENCODER_REPLAY_HEADROOM;
+		u64 audioBytes = config->audioFormat ? AUDIO_SAMPLERATE * AUDIO_CHANNELS * sizeof(s16) : 0;
+		sinkConfig.replaySize = TimeConvert(config->replayDuration, TIME_RATE_MSEC,
+											TIME_RATE_SECOND, TIME_CEIL) * (videoBytes + audioBytes);
+		bool created = MuxSinkCreate(&e->sink, types, typeCount, &sinkConfig);
+		for (u32 i = 0; i < typeCount; ++i) IMFMediaType_Release(types[i]);
+
+		hr = E_FAIL;
+		if (created) {
+			sink = &e->sink;
+
+			IMFAttributes *attributes;
+			MFCreateAttributes(&attributes, 3);
+			IMFAttributes_SetUINT32(attributes, &MF_READWRITE_ENABLE_HARDWARE_TRANSFORMS, false);
+			IMFAttributes_SetUnknown(attributes, &MF_SINK_WRITER_D3D_MANAGER, (IUnknown *) manager);
+			IMFAttributes_SetUINT32(attributes, &MF_SINK_WRITER_DISABLE_THROTTLING, true);
+
+			hr = MFCreateSinkWriterFromMediaSink(&e->sink.sink, attributes, &writer);
+			IMFAttributes_Release(attributes);
+		}
 
 		if (hr != S_OK) {
 			MessageBoxW(0, L"Cannot configure video encoder!", L"Error", MB_ICONERROR);
 			goto bail;
 		}
+
+		// stream sinks are in order of types
+		e->videoStreamIndex = 0;
+		e->audioStreamIndex = config->audioFormat ? 1 : -1;
 	}
 
 	// video input type, NV12 or P010 format
@@ -204,58 +514,51 @@ static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, en
 	}
 	
 	if (config->audioFormat) {
-		CoCreateInstance(&CLSID_CResamplerMediaObject, 0, CLSCTX_INPROC_SERVER, &IID_IMFTransform,
-						 (void* ) &resampler);
-
-		// audio resampler input
+		// audio resampler, extensible format keeps format tag in first part of subformat GUID
 		{
-			IMFMediaType *type;
-			MFCreateMediaType(&type);
-			MFInitMediaTypeFromWaveFormatEx(type, config->audioFormat,
-											sizeof(*config->audioFormat) + config->audioFormat->cbSize);
-			IMFTransform_SetInputType(resampler, 0, type, 0);
-			IMFMediaType_Release(type);
-		}
+			WAVEFORMATEX *format = config->audioFormat;
+			WORD tag = format->wFormatTag;
+			u32 mask = 0;
+			if (tag == WAVE_FORMAT_EXTENSIBLE && format->cbSize >= 22) {
+				WAVEFORMATEXTENSIBLE *extensible = (WAVEFORMATEXTENSIBLE *) format;
+				tag = (WORD) extensible->SubFormat.Data1;
+				mask = extensible->dwChannelMask;
+			}
 
-		// audio resampler output
-		{
-			WAVEFORMATEX format = {
-				.wFormatTag = WAVE_FORMAT_PCM,
-				.nChannels = AUDIO_CHANNELS,
-				.nSamplesPerSec = AUDIO_SAMPLERATE,
-				.wBitsPerSample = sizeof(s16) * 8
+			// ratio follows device clock, so filter runs even for same rates
+			resampler_config resamplerConfig = {
+				.channels = format->nChannels,
+				.channelMask = mask,
+				.inRate = format->nSamplesPerSec,
+				.outRate = AUDIO_SAMPLERATE,
+				.variable = true
 			};
-			format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
-			format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
-
-			IMFMediaType *type;
-			MFCreateMediaType(&type);
-			MFInitMediaTypeFromWaveFormatEx(type, &format, sizeof(format));
-			IMFTransform_SetOutputType(resampler, 0, type, 0);
-			IMFMediaType_Release(type);
-		}
-
-		IMFTransform_ProcessMessage(resampler, MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0);
-
-		// audio output type
-		{
-			const GUID* codec = &MFAudioFormat_FLAC;
+			bool supported = true;
+			if (tag == WAVE_FORMAT_IEEE_FLOAT && format->wBitsPerSample == 32) {
+				resamplerConfig.format = RESAMPLER_F32;
+			} else if (tag == WAVE_FORMAT_PCM && format->wBitsPerSample == 16) {
+				resamplerConfig.format = RESAMPLER_S16;
+			} else if (tag == WAVE_FORMAT_PCM && format->wBitsPerSample == 24) {
+				resamplerConfig.format = RESAMPLER_S24;
+			} else if (tag == WAVE_FORMAT_PCM && format->wBitsPerSample == 32) {
+				resamplerConfig.format = RESAMPLER_S32;
+			} else {
+				supported = false;
+			}
 
-			IMFMediaType *type;
-			MFCreateMediaType(&type);
-			IMFMediaType_SetGUID(type, &MF_MT_MAJOR_TYPE, &MFMediaType_Audio);
-			IMFMediaType_SetGUID(type, &MF_MT_SUBTYPE, codec);
-			IMFMediaType_SetUINT32(type, &MF_MT_AUDIO_BITS_PER_SAMPLE, 16);
-			IMFMediaType_SetUINT32(type, &MF_MT_AUDIO_SAMPLES_PER_SECOND, AUDIO_SAMPLERATE);
-			IMFMediaType_SetUINT32(type, &MF_MT_AUDIO_NUM_CHANNELS, AUDIO_CHANNELS);
-			
-			hr = IMFSinkWriter_AddStream(writer, type, (DWORD *) &e->audioStreamIndex);
-			IMFMediaType_Release(type);
+			if (!supported || !ResamplerCreate(&e->resampler, &resamplerConfig)) {
+				MessageBoxW(0, L"Unsupported audio capture format!", L"Error", MB_ICONERROR);
+				goto bail;
+			}
+			audioResampler = &e->resampler;
 
-			if (hr != S_OK) {
-				MessageBoxW(0, L"Cannot configure audio encoder output!", L"Error", MB_ICONERROR);
+			time_rate outputRate = TimeRate(AUDIO_SAMPLERATE, 1);
+			u64 ringFrames = TimeConvert(ENCODER_AUDIO_RING, TIME_RATE_MSEC, outputRate, TIME_CEIL);
+			if (!RingCreate(&e->audioRing, (u32) (ringFrames * AUDIO_CHANNELS * sizeof(s16)))) {
+				MessageBoxW(0, L"Cannot allocate audio buffers!", L"Error", MB_ICONERROR);
 				goto bail;
 			}
+			audioRing = &e->audioRing;
 		}
 
 		// audio input type
@@ -285,35 +588,25 @@ static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, en
 		goto bail;
 	}
 
+	if (!MuxSinkStart(&e->sink)) {
+		MessageBoxW(0, L"Cannot create output mp4 file!", L"Error", MB_ICONERROR);
+		goto bail;
+	}
+
 	// video texture/buffers/samples
 	{
-		// RGB input texture
-		{
-			D3D11_TEXTURE2D_DESC textureDesc = {
-				.Width = width,
-				.Height = height,
-				.MipLevels = 1,
-				.ArraySize = 1,
-				.Format = DXGI_FORMAT_B8G8R8A8_UNORM,
-				.SampleDesc = {1, 0},
-				.Usage = D3D11_USAGE_DEFAULT,
-				.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE
-			};
-			ID3D11Device_CreateTexture2D(device, &textureDesc, 0, &e->inputTexture);
-			ID3D11Device_CreateRenderTargetView(device, (ID3D11Resource *) e->inputTexture, 0,
-												&e->inputRenderTarget);
-			ID3D11Device_CreateShaderResourceView(device, (ID3D11Resource *) e->inputTexture, 0,
-												  &e->resizeInputView);
-
-			f32 black[] = {0, 0, 0, 0};
-			ID3D11DeviceContext_ClearRenderTargetView(context, e->inputRenderTarget, black);
-		}
+		// RGB input texture, recreated at captured size by first frame
+		e->inputTexture = 0;
+		EncoderCreateInputTexture(e, device, width, height);
 
-		// RGB resized texture
-		// no resizing needed, use input texture as input to converter shader directly
-		ID3D11ShaderResourceView_AddRef(e->resizeInputView);
-		e->convertInputView = e->resizeInputView;
+		// RGB resized texture, captured rect of other size is resized to it first
+		// GPU that can't do that converts on CPU, which resizes on its own
 		e->resizedTexture = 0;
+		e->resizeOutputView = 0;
+		e->convertInputView = 0;
+		if (!cpuConvert && !EncoderCreateResizedTexture(e, device, width, height)) {
+			cpuConvert = true;
+		}
 			
 		// YUV converted texture
 		{
@@ -328,40 +621,39 @@ static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, en
 				.Format = formatYUV,
 				.SampleDesc = {1, 0},
 				.Usage = D3D11_USAGE_DEFAULT,
-				.BindFlags = D3D11_BIND_UNORDERED_ACCESS
+				.BindFlags = cpuConvert ? 0 : D3D11_BIND_UNORDERED_ACCESS
 			};
 
-			D3D11_UNORDERED_ACCESS_VIEW_DESC viewY = {
-				.Format = formatY,
-				.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D
-			};
+			// textures & samples are created by video pool when it needs them
+			e->videoDesc = textureDesc;
+			e->videoFormatY = formatY;
+			e->videoFormatUV = formatUV;
+			e->videoSize = size;
+		}
+		
+		// staging textures for CPU conversion, output one always keeps last converted frame
+		// GPU path creates input one with first frame, it only reads frames to skip static ones
+		e->stagingInput = 0;
+		e->stagingOutput = 0;
+		e->stagingWidth = 0;
+		e->stagingHeight = 0;
+		
+		if (cpuConvert) {
+			JobsCreate(&e->jobs, 0);
+			EncoderCreateStagingInput(e, device, width, height);
 
-			D3D11_UNORDERED_ACCESS_VIEW_DESC viewUV = {
-				.Format = formatUV,
-				.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D,
+			D3D11_TEXTURE2D_DESC outputDesc = {
+				.Width = width,
+				.Height = height,
+				.MipLevels = 1,
+				.ArraySize = 1,
+				.Format = formatYUV,
+				.SampleDesc = {1, 0},
+				.Usage = D3D11_USAGE_STAGING,
+				.CPUAccessFlags = D3D11_CPU_ACCESS_READ | D3D11_CPU_ACCESS_WRITE
 			};
-
-			// create samples each referencing individual element of texture array
-			for (u32 i = 0; i < ENCODER_VIDEO_BUFFER_COUNT; ++i) {
-				IMFSample *videoSample;
-				IMFMediaBuffer *buffer;
-
-				ID3D11Texture2D *texture;
-				ID3D11Device_CreateTexture2D(device, &textureDesc, 0, &texture);
-				ID3D11Device_CreateUnorderedAccessView(device, (ID3D11Resource *) texture, &viewY,
-													   &e->convertOutputViewY[i]);
-				ID3D11Device_CreateUnorderedAccessView(device, (ID3D11Resource *) texture, &viewUV,
-													   &e->convertOutputViewUV[i]);
-				MFCreateVideoSampleFromSurface(0, &videoSample);
-				MFCreateDXGISurfaceBuffer(&IID_ID3D11Texture2D, (IUnknown *) texture, 0, false,
-										  &buffer);
-				IMFMediaBuffer_SetCurrentLength(buffer, size);
-				IMFSample_AddBuffer(videoSample, buffer);
-				IMFMediaBuffer_Release(buffer);
-				
-				e->convertTexture[i] = texture;
-				e->videoSample[i] = videoSample;
-			}
+			
+			ID3D11Device_CreateTexture2D(device, &outputDesc, 0, &e->stagingOutput);
 		}
 
 		e->width = width;
@@ -370,75 +662,54 @@ static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, en
 		e->framerateDen = config->framerateDen;
 		e->videoDiscontinuity = false;
 		e->videoLastTime = 0x8000000000000000ULL; // some large time in future
-		e->videoIndex = 0;
-		e->videoCount = ENCODER_VIDEO_BUFFER_COUNT;
+		e->videoWait = config->videoWait;
+		e->constantFramerate = config->constantFramerate;
+		e->clock = config->clock;
+		e->videoCurrent = -1;
+		for (u32 i = 0; i < ENCODER_VIDEO_BUFFER_MAX; ++i) e->videoRefs[i] = 0;
+		InitializeSRWLock(&e->pacerLock);
 	}
 
 	if (e->audioStreamIndex >= 0) {
-		// resampler input buffer/sample
-		{
-			IMFSample *sample;
-			IMFMediaBuffer *buffer;
-
-			MFCreateSample(&sample);
-			MFCreateMemoryBuffer(config->audioFormat->nAvgBytesPerSec, &buffer);
-			IMFSample_AddBuffer(sample, buffer);
-
-			e->audioInputSample = sample;
-			e->audioInputBuffer = buffer;
-		}
-
-		// resampler output & audio encoding input buffer/samples
+		// audio encoding input samples, they get buffer from ring for every packet
+		u64 maxInput = TimeConvert(ENCODER_AUDIO_CHUNK, TIME_RATE_MSEC,
+								   TimeRate(config->audioFormat->nSamplesPerSec, 1), TIME_CEIL);
+		e->audioMaxInput = (DWORD) maxInput;
 		for (u32 i = 0; i < ENCODER_AUDIO_BUFFER_COUNT; ++i) {
 			IMFSample *sample;
-			IMFMediaBuffer *buffer;
 			IMFTrackedSample *tracked;
 
 			MFCreateTrackedSample(&tracked);
 			IMFTrackedSample_QueryInterface(tracked, &IID_IMFSample, (void *) &sample);
-			MFCreateMemoryBuffer(AUDIO_SAMPLERATE * AUDIO_CHANNELS * sizeof(s16), &buffer);
-			IMFSample_AddBuffer(sample, buffer);
-			IMFMediaBuffer_Release(buffer);
 			IMFTrackedSample_Release(tracked);
 
 			e->audioSample[i] = sample;
 		}
 
 		e->audioFrameSize = config->audioFormat->nBlockAlign;
-		e->audioSampleRate = config->audioFormat->nSamplesPerSec;
-		e->resampler = resampler;
+		e->audioStarted = false;
+		e->audioWritten = 0;
+		e->audioDropped = 0;
 		e->audioIndex = 0;
 		e->audioCount = ENCODER_AUDIO_BUFFER_COUNT;
 	}
 
 	// constant buffer for RGB to YUV conversion
+	// CPU kernels & shader use same fixed point coefficients, so both give same colors
 	{
-		f32 rangeY, offsetY;
-		f32 rangeUV, offsetUV;
-
-		if (formatYUV == DXGI_FORMAT_NV12) {
-			// Y=[16..235], UV=[16..240]
-			rangeY = 219.f;
-			offsetY = 16.5f;
-			rangeUV = 224.f;
-			offsetUV = 128.5f;
-		} else { // FormatYUV == DXGI_FORMAT_P010
-			// Y=[64..940], UV=[64..960]
-			// mutiplied by 64, because 10-bit values are positioned at top of 16-bit used for texture
-			// storage format
-			rangeY = 876.f * 64.f;
-			offsetY = 64.5f * 64.f;
-			rangeUV = 896.f * 64.f;
-			offsetUV = 512.5f * 64.f;
-		}
-
-		// BT.709 - https://en.wikipedia.org/wiki/YCbCr#ITU-R_BT.709_conversion
-		f32 convertMtx[3][4] =
-		{
-			{  0.2126f * rangeY,   0.7152f * rangeY,   0.0722f * rangeY,  offsetY  },
-			{ -0.1146f * rangeUV, -0.3854f * rangeUV,  0.5f    * rangeUV, offsetUV },
-			{  0.5f    * rangeUV, -0.4542f * rangeUV, -0.0458f * rangeUV, offsetUV },
-		};
+		// Y=[16..235], UV=[16..240] for NV12, Y=[64..940], UV=[64..960] for P010
+		convert_output output = (formatYUV == DXGI_FORMAT_NV12) ? CONVERT_OUTPUT_NV12 :
+																   CONVERT_OUTPUT_P010;
+		convert_matrix matrix;
+		ConvertMatrixFor(&matrix, CONVERT_BT709, false, CONVERT_INPUT_BGRA8, output);
+		ConvertFixedFromMatrix(&e->convertFixed, &matrix);
+
+		// shader reads UNORM texture as [0..1] floats, CPU reads raw bytes
+		// 10-bit values are mutiplied by 64, because they are positioned at top of 16-bit used for
+		// texture storage format
+		convert_matrix convertMtx;
+		ConvertMatrixFromFixed(&convertMtx, &e->convertFixed, 255.f,
+							   (output == CONVERT_OUTPUT_P010) ? 64.f : 1.f);
 
 		D3D11_BUFFER_DESC desc = {
 			.ByteWidth = sizeof(convertMtx),
@@ -447,37 +718,114 @@ static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, en
 		};
 
 		D3D11_SUBRESOURCE_DATA data = {
-			.pSysMem = convertMtx,
+			.pSysMem = &convertMtx,
 		};
 
 		ID3D11Device_CreateBuffer(device, &desc, &data, &e->convertBuffer);
+
+		// resized texture holds B in R channel & R in B channel
+		for (u32 row = 0; row < 3; ++row) {
+			f32 r = convertMtx.m[row][0];
+			convertMtx.m[row][0] = convertMtx.m[row][2];
+			convertMtx.m[row][2] = r;
+		}
+		ID3D11Device_CreateBuffer(device, &desc, &data, &e->resizedConvertBuffer);
 	}
 	
 	ID3D11Device_AddRef(device);
 	ID3D11DeviceContext_AddRef(context);
-	ID3D11ComputeShader_AddRef(resizeShader);
-	ID3D11ComputeShader_AddRef(convertShader);
+	if (resizeShader) ID3D11ComputeShader_AddRef(resizeShader);
+	if (convertShader) ID3D11ComputeShader_AddRef(convertShader);
 	e->context = context;
 	e->device = device;
 	e->resizeShader = resizeShader;
 	e->convertShader = convertShader;
+	e->cpuConvert = cpuConvert;
+
+	// starts with few buffers, more are added when encoder returns them late
+	{
+		time_rate ticks = e->clock.rate;
+		time_rate framerate = TimeRate(config->framerateNum, config->framerateDen);
+		u64 now = TimeClockNow(&e->clock);
+
+		pool_config poolConfig = {
+			.minCount = ENCODER_VIDEO_BUFFER_MIN,
+			.maxCount = ENCODER_VIDEO_BUFFER_MAX,
+			.bufferSize = e->videoSize,
+			.interval = TimeConvert(1, framerate, ticks, TIME_NEAREST),
+			.window = TimeConvert(ENCODER_VIDEO_POOL_WINDOW, TIME_RATE_SECOND, ticks, TIME_NEAREST),
+			.create = EncoderCreateVideoBuffer,
+			.destroy = EncoderDestroyVideoBuffer,
+			.user = e
+		};
+		PoolCreate(&e->videoPool, &poolConfig, now);
+
+		// capture & update timer both use ticks of clock
+		pacer_config pacerConfig = {
+			.framerateNum = config->framerateNum,
+			.framerateDen = config->framerateDen,
+			.frequency = TimeConvert(1, TIME_RATE_SECOND, ticks, TIME_NEAREST),
+			.latency = TimeConvert(ENCODER_PACER_LATENCY, TIME_RATE_MSEC, ticks, TIME_NEAREST)
+		};
+		PacerStart(&e->pacer, &pacerConfig);
+	}
+
+	if (e->audioStreamIndex >= 0) {
+		// small blocks can fill queue before ring, pump then waits as it does for ring & drops
+		mailbox_config queueConfig = {
+			.itemSize = sizeof(encoder_audio_item),
+			.count = ENCODER_AUDIO_BUFFER_COUNT,
+			.policy = MAILBOX_BLOCK,
+			.timeout = ENCODER_AUDIO_WAIT,
+			.drop = EncoderDropAudio,
+			.user = e
+		};
+		e->audioThreaded = MailboxCreate(&e->audioQueue, &queueConfig);
+		if (e->audioThreaded) {
+			e->audioThreaded = BOGThreadCreate(&e->audioThread, EncoderAudioThread, e);
+			if (!e->audioThreaded) MailboxDestroy(&e->audioQueue);
+		}
+	}
+
+	// frames queue drops give their buffer back right away
+	{
+		mailbox_config queueConfig = {
+			.itemSize = sizeof(encoder_video_item),
+			.count = ENCODER_VIDEO_QUEUE,
+			.policy = config->videoPolicy,
+			.timeout = config->videoWait,
+			.drop = EncoderDropVideo,
+			.user = e
+		};
+		e->videoQueueDrops = 0;
+		e->videoQueueSeen = 0;
+		e->videoThreaded = MailboxCreate(&e->videoQueue, &queueConfig);
+		if (e->videoThreaded) {
+			e->videoThreaded = BOGThreadCreate(&e->videoThread, EncoderVideoThread, e);
+			if (!e->videoThreaded) MailboxDestroy(&e->videoQueue);
+		}
+	}
 
-	e->startTime = 0;
+	BOGAtomicStore64(&e->startTime, 0);
 	e->writer = writer;
 	writer = 0;
-	resampler = 0;
+	sink = 0;
+	audioResampler = 0;
+	audioRing = 0;
 	result = TRUE;
 	
 bail:
-	if (resampler) IMFTransform_Release(resampler);
+	if (audioResampler) ResamplerDestroy(audioResampler);
+	if (audioRing) RingDestroy(audioRing);
 	
-	if (writer) {
-		IMFSinkWriter_Release(writer);
-		DeleteFileW(fileName);
+	if (writer) IMFSinkWriter_Release(writer);
+	if (sink) {
+		MuxSinkStop(sink);
+		DeleteFileW(e->fileName);
 	}
 	
-	ID3D11ComputeShader_Release(convertShader);
-	ID3D11ComputeShader_Release(resizeShader);
+	if (convertShader) ID3D11ComputeShader_Release(convertShader);
+	if (resizeShader) ID3D11ComputeShader_Release(resizeShader);
 	ID3D11DeviceContext_Release(context);
 	IMFDXGIDeviceManager_Release(manager);
 	
@@ -485,196 +833,639 @@ bail:
 }
 #pragma warning(pop)
 
-static void EncoderStop(encoder *e) {
+// sends frame in buffer index to encoder, repeated frame gets its own sample sharing same buffer
+static void EncoderSubmitVideo(encoder *e, s32 index, LONGLONG time, LONGLONG duration,
+							   bool repeat) {
+	IMFSample *sample = e->videoSample[index];
+	if (repeat) {
+		IMFMediaBuffer *buffer;
+		IMFSample_GetBufferByIndex(sample, 0, &buffer);
+		MFCreateVideoSampleFromSurface(0, &sample);
+		IMFSample_AddBuffer(sample, buffer);
+		IMFMediaBuffer_Release(buffer);
+		IMFSample_SetUINT32(sample, &ENCODER_BUFFER_INDEX, index);
+	}
+
+	IMFSample_SetSampleDuration(sample, duration);
+	IMFSample_SetSampleTime(sample, time);
+
+	if (e->videoDiscontinuity) {
+		IMFSample_SetUINT32(sample, &MFSampleExtension_Discontinuity, true);
+		e->videoDiscontinuity = false;
+	} else {
+		// don't care about success or no, we just don't want this attribute set at all
+		IMFSample_DeleteItem(sample, &MFSampleExtension_Discontinuity);
+	}
+
+	IMFTrackedSample *tracked;
+	IMFSample_QueryInterface(sample, &IID_IMFTrackedSample, (void *) &tracked);
+	IMFTrackedSample_SetAllocator(tracked, &e->videoSampleCallback, 0);
+	IMFTrackedSample_Release(tracked);
+
+	// submit to encoder which will happen in background
+	BOGAtomicAdd(&e->videoRefs[index], 1);
+	IMFSinkWriter_WriteSample(e->writer, e->videoStreamIndex, sample);
+
+	IMFSample_Release(sample);
+}
+
+// current frame of pacer goes to slots plan gives it, times are exact multiples of frame duration
+static void EncoderRunPlan(encoder *e, pacer_plan plan) {
+	for (u32 i = 0; i < plan.count; ++i) {
+		LONGLONG time = PacerSlotTime(&e->pacer, plan.first + i, MF_UNITS_PER_SECOND);
+		LONGLONG end = PacerSlotTime(&e->pacer, plan.first + i + 1, MF_UNITS_PER_SECOND);
+		EncoderSubmitVideo(e, e->videoCurrent, time, end - time, i > 0 || !plan.submit);
+	}
+}
+
+// pacer is done with its current frame, buffer is reused once encoder returns its samples
+static void EncoderReleaseCurrent(encoder *e, bool submitted, u64 now) {
+	s32 index = e->videoCurrent;
+	if (index < 0) return;
+
+	e->videoCurrent = -1;
+	if (!BOGAtomicAdd(&e->videoRefs[index], -1)) {
+		if (submitted) {
+			PoolRelease(&e->videoPool, index, now);
+		} else {
+			// never submitted, there is no latency to measure
+			PoolCancel(&e->videoPool, index);
+		}
+	}
+}
+
+static bool EncoderStop(encoder *e) {
+	if (e->videoThreaded) {
+		// frames still queued are placed first, quit item must not be dropped like frame can be
+		encoder_video_item quit = { .type = ENCODER_VIDEO_QUIT, .index = -1 };
+		while (!MailboxPush(&e->videoQueue, &quit)) Sleep(1);
+		BOGThreadJoin(e->videoThread);
+		MailboxDestroy(&e->videoQueue);
+	}
+
+	if (e->constantFramerate) {
+		u64 now = TimeClockNow(&e->clock);
+		pacer_plan plan = PacerFlush(&e->pacer);
+		EncoderRunPlan(e, plan);
+		EncoderReleaseCurrent(e, !plan.drop, now);
+	}
+
 	if (e->audioStreamIndex >= 0) {
-		IMFTransform_ProcessMessage(e->resampler, MFT_MESSAGE_COMMAND_DRAIN, 0);
-		EncoderOutputAudioSamples(e);
-		IMFTransform_Release(e->resampler);
+		// pump is stopped & this thread is producer now, nothing at stop may be dropped
+		if (e->audioThreaded) e->audioQueue.timeout = MAILBOX_WAIT_FOREVER;
+
+		// end of last input is still in filter window
+		EncoderOutputAudioSample(e, 0, 0);
+		ResamplerDestroy(&e->resampler);
+
+		if (e->audioThreaded) {
+			encoder_audio_item quit = { 0 };
+			MailboxPush(&e->audioQueue, &quit);
+			BOGThreadJoin(e->audioThread);
+			MailboxDestroy(&e->audioQueue);
+		}
 	}
 	
 	IMFSinkWriter_Finalize(e->writer);
 	IMFSinkWriter_Release(e->writer);
+
+	// sink writer delivered last samples, files can be finished
+	bool written = MuxSinkStop(&e->sink) && !e->sink.rejected;
 	
 	if (e->audioStreamIndex >= 0) {
 		for (int i = 0; i < ENCODER_AUDIO_BUFFER_COUNT; ++i) {
 			IMFSample_Release(e->audioSample[i]);
 		}
-		
-		IMFSample_Release(e->audioInputSample);
-		IMFMediaBuffer_Release(e->audioInputBuffer);
+
+		// writer is gone, so it released every buffer
+		RingDestroy(&e->audioRing);
 	}
 	
-	for (int i = 0; i < ENCODER_VIDEO_BUFFER_COUNT; ++i) {
-		ID3D11UnorderedAccessView_Release(e->convertOutputViewY[i]);
-		ID3D11UnorderedAccessView_Release(e->convertOutputViewUV[i]);
-		ID3D11Texture2D_Release(e->convertTexture[i]);
-		IMFSample_Release(e->videoSample[i]);
-	}
+	PoolDestroy(&e->videoPool);
+	
+	if (e->stagingInput) ID3D11Texture2D_Release(e->stagingInput);
+	if (e->stagingOutput) ID3D11Texture2D_Release(e->stagingOutput);
+	DamageDestroy(&e->damage);
+	ResizeDestroy(&e->resize);
+	JobsDestroy(&e->jobs);
 	
-	ID3D11ShaderResourceView_Release(e->convertInputView);
 	if (e->resizedTexture) {
+		ID3D11ShaderResourceView_Release(e->convertInputView);
 		ID3D11UnorderedAccessView_Release(e->resizeOutputView);
 		ID3D11Texture2D_Release(e->resizedTexture);
 		e->resizedTexture = 0;
 	}
 
-	ID3D11RenderTargetView_Release(e->inputRenderTarget);
-	ID3D11ShaderResourceView_Release(e->resizeInputView);
-	ID3D11Texture2D_Release(e->inputTexture);
+	if (e->inputTexture) {
+		ID3D11RenderTargetView_Release(e->inputRenderTarget);
+		ID3D11ShaderResourceView_Release(e->resizeInputView);
+		ID3D11Texture2D_Release(e->inputTexture);
+	}
 
 	ID3D11Buffer_Release(e->convertBuffer);
-	ID3D11ComputeShader_Release(e->resizeShader);
-	ID3D11ComputeShader_Release(e->convertShader);
+	ID3D11Buffer_Release(e->resizedConvertBuffer);
+	if (e->resizeShader) ID3D11ComputeShader_Release(e->resizeShader);
+	if (e->convertShader) ID3D11ComputeShader_Release(e->convertShader);
 	ID3D11DeviceContext_Release(e->context);
 	ID3D11Device_Release(e->device);
+
+	return written;
+}
+
+static bool EncoderSaveReplay(encoder *e, const wchar_t *fileName) {
+	return MuxSinkSaveReplay(&e->sink, fileName);
 }
 
-static void EncoderOutputAudioSamples(encoder *e) {
+// writer thread, or audio thread when there is none
+static void EncoderWriteAudio(encoder *e, const encoder_audio_item *item) {
+	// we don't want to drop any audio frames, so wait for available sample
+	LONG available = e->audioCount;
+	while (!available) {
+		LONG zero = 0;
+		WaitOnAddress(&e->audioCount, &zero, sizeof(LONG), INFINITE);
+		available = e->audioCount;
+	}
+
+	DWORD index = e->audioIndex;
+	IMFSample* sample = e->audioSample[index];
+
+	IMFSample_AddBuffer(sample, &item->buffer->buffer);
+	IMFMediaBuffer_Release(&item->buffer->buffer);
+	IMFSample_SetSampleTime(sample, item->time);
+	IMFSample_SetSampleDuration(sample, item->duration);
+
+	e->audioIndex = (index + 1) % ENCODER_AUDIO_BUFFER_COUNT;
+	InterlockedDecrement(&e->audioCount);
+
+	IMFTrackedSample *tracked;
+	IMFSample_QueryInterface(sample, &IID_IMFTrackedSample, (void *) &tracked);
+	IMFTrackedSample_SetAllocator(tracked, &e->audioSampleCallback, (IUnknown *) tracked);
+
+	IMFSinkWriter_WriteSample(e->writer, e->audioStreamIndex, sample);
+
+	IMFSample_Release(sample);
+	IMFTrackedSample_Release(tracked);
+}
+
+// pump thread, queue stayed full, block goes back to ring & its frames are counted as dropped
+// writer never sees them, later blocks keep their times so there is just gap
+static void EncoderDropAudio(void *user, const void *data) {
+	const encoder_audio_item *item = (const encoder_audio_item *) data;
+	if (!item->buffer) return;
+
+	encoder *e = (encoder *) user;
+	resampler_config *c = &e->resampler.config;
+	u32 frames = item->buffer->length / (AUDIO_CHANNELS * sizeof(s16));
+	e->audioDropped += TimeConvert(frames, TimeRate(c->outRate, 1), TimeRate(c->inRate, 1),
+								   TIME_NEAREST);
+	IMFMediaBuffer_Release(&item->buffer->buffer);
+}
+
+// gives queued blocks to sink writer in order, until item without buffer
+static BOG_THREAD_PROC(EncoderAudioThread) {
+	encoder *e = (encoder *) arg;
+
+	// media foundation objects are free threaded, this thread just needs COM
+	CoInitializeEx(0, COINIT_MULTITHREADED);
 	for (;;) {
-		// we don't want to drop any audio frames, so wait for available sample/buffer
-		LONG count = e->audioCount;
-		while (!count) {
-			LONG zero = 0;
-			WaitOnAddress(&e->audioCount, &zero, sizeof(LONG), INFINITE);
-			count = e->audioCount;
+		encoder_audio_item item;
+		if (!MailboxPop(&e->audioQueue, &item)) {
+			MailboxWait(&e->audioQueue, MAILBOX_WAIT_FOREVER);
+			continue;
 		}
+		if (!item.buffer) break;
 
-		DWORD index = e->audioIndex;
-		IMFSample* sample = e->audioSample[index];
-
-		DWORD status;
-		MFT_OUTPUT_DATA_BUFFER output = {.dwStreamID = 0, .pSample = sample};
-		HRESULT hr = IMFTransform_ProcessOutput(e->resampler, 0, 1, &output, &status);
-		if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT) break;
-		
-		e->audioIndex = (index + 1) % ENCODER_AUDIO_BUFFER_COUNT;
-		InterlockedDecrement(&e->audioCount);
+		EncoderWriteAudio(e, &item);
+	}
+	CoUninitialize();
 
-		IMFTrackedSample *tracked;
-		IMFSample_QueryInterface(sample, &IID_IMFTrackedSample, (void *) &tracked);
-		IMFTrackedSample_SetAllocator(tracked, &e->audioSampleCallback, (IUnknown *) tracked);
+	return 0;
+}
 
-		IMFSinkWriter_WriteSample(e->writer, e->audioStreamIndex, sample);
+// resamples at most audioMaxInput frames straight to block of audio ring & queues it for writer,
+// count of 0 drains resampler
+static void EncoderOutputAudioSample(encoder *e, const void *samples, DWORD count) {
+	// block big enough for any output, only written part of it is committed
+	u32 frameSize = AUDIO_CHANNELS * sizeof(s16);
+	u32 maxSize = (u32) sizeof(encoder_audio_buffer) + ResamplerMaxOutput(&e->resampler, count) *
+				  frameSize;
+	// caller is time critical pump thread, writer that falls behind costs input instead of stalling
+	// it, frames the input would give are skipped so later audio keeps its time, drain at stop waits
+	u32 wait = count ? ENCODER_AUDIO_WAIT : RING_WAIT_FOREVER;
+	encoder_audio_buffer *buffer = RingReserve(&e->audioRing, maxSize, wait);
+	if (!buffer) {
+		resampler_config *c = &e->resampler.config;
+		e->audioWritten += TimeConvert(count, TimeRate(c->inRate, 1), TimeRate(c->outRate, 1),
+									   TIME_NEAREST);
+		e->audioDropped += count;
+		return;
+	}
 
-		IMFSample_Release(sample);
-		IMFTrackedSample_Release(tracked);
+	s16 *output = (s16 *) (buffer + 1);
+	u32 written = count ? ResamplerProcess(&e->resampler, samples, count, output) :
+						  ResamplerDrain(&e->resampler, output);
+
+	// input shorter than filter step gives nothing yet, it comes out with next input
+	if (!written) return;
+
+	buffer->buffer.lpVtbl = &EncoderAudioBufferVtbl;
+	buffer->refs = 1;
+	buffer->ring = &e->audioRing;
+	buffer->length = written * frameSize;
+	buffer->maxLength = buffer->length;
+	RingCommit(&e->audioRing, buffer, (u32) sizeof(*buffer) + buffer->length);
+
+	// output rate is exact, so times follow from frames written since start
+	time_rate outputRate = TimeRate(AUDIO_SAMPLERATE, 1);
+	LONGLONG start = TimeConvert(e->audioWritten, outputRate, TIME_RATE_MF, TIME_NEAREST);
+	e->audioWritten += written;
+	LONGLONG end = TimeConvert(e->audioWritten, outputRate, TIME_RATE_MF, TIME_NEAREST);
+
+	encoder_audio_item item = {
+		.buffer = buffer,
+		.time = e->audioStart + start,
+		.duration = end - start
+	};
+	if (e->audioThreaded) {
+		MailboxPush(&e->audioQueue, &item);
+	} else {
+		EncoderWriteAudio(e, &item);
 	}
 }
 
-static bool EncoderNewFrame(encoder *e, ID3D11Texture2D *texture, RECT rect, u64 time, u64 timePeriod) {
-	e->videoLastTime = time;
+// copies captured frame to staging texture & maps it for reading
+static bool EncoderReadFrame(encoder *e, ID3D11Texture2D *texture, RECT rect,
+							 D3D11_MAPPED_SUBRESOURCE *input) {
+	ID3D11DeviceContext *context = e->context;
 
-	if (!e->videoCount) {
-		// dropped frame
-		LONGLONG timestamp = MFllMulDiv(time - e->startTime, MF_UNITS_PER_SECOND, timePeriod, 0);
-		IMFSinkWriter_SendStreamTick(e->writer, e->videoStreamIndex, timestamp);
-		e->videoDiscontinuity = true;
-		
-		return false;
+	// only captured rect is copied, region can change size while recording
+	u32 width = rect.right - rect.left;
+	u32 height = rect.bottom - rect.top;
+	if (width != e->stagingWidth || height != e->stagingHeight) {
+		if (e->stagingInput) ID3D11Texture2D_Release(e->stagingInput);
+		EncoderCreateStagingInput(e, e->device, width, height);
 	}
-	
-	DWORD index = e->videoIndex;
-	e->videoIndex = (index + 1) % ENCODER_VIDEO_BUFFER_COUNT;
-	InterlockedDecrement(&e->videoCount);
+	if (!e->stagingInput) return false;
+
+	D3D11_BOX box = {
+		.left = rect.left,
+		.top = rect.top,
+		.right = rect.right,
+		.bottom = rect.bottom,
+		.front = 0,
+		.back = 1
+	};
+
+	ID3D11DeviceContext_CopySubresourceRegion(context, (ID3D11Resource *) e->stagingInput,
+											  0, 0, 0, 0, (ID3D11Resource *) texture, 0, &box);
+
+	// reading staging texture waits for copy to finish
+	return SUCCEEDED(ID3D11DeviceContext_Map(context, (ID3D11Resource *) e->stagingInput, 0,
+											 D3D11_MAP_READ, 0, input));
+}
 
-	IMFSample *sample = e->videoSample[index];
+// bands of ENCODER_BAND_HEIGHT rows keep 2x2 chroma blocks & damage tiles whole, resizer
+// recomputes rows under filter support at band edges itself
+static void EncoderConvertBand(void *data, u32 index, u32 worker) {
+	encoder_band *b = (encoder_band *) data;
+	u32 y0 = index * ENCODER_BAND_HEIGHT;
+	u32 y1 = (y0 + ENCODER_BAND_HEIGHT < b->height) ? y0 + ENCODER_BAND_HEIGHT : b->height;
+
+	ConvertToNV12Region(&b->e->convertFixed, b->src, b->srcStride, b->width, b->height,
+						0, y0, b->width, y1, b->dstY, b->dstStride, b->dstUV, b->dstStride);
+}
+
+static void EncoderConvertDamageBand(void *data, u32 index, u32 worker) {
+	encoder_band *b = (encoder_band *) data;
+	u32 tiles = ENCODER_BAND_HEIGHT / DAMAGE_TILE_HEIGHT;
+
+	DamageConvertNV12Rows(&b->e->damage, &b->e->convertFixed, b->src, b->srcStride,
+						  index * tiles, (index + 1) * tiles, b->dstY, b->dstStride,
+						  b->dstUV, b->dstStride);
+}
+
+static void EncoderResizeBand(void *data, u32 index, u32 worker) {
+	encoder_band *b = (encoder_band *) data;
+	u32 y0 = index * ENCODER_BAND_HEIGHT;
+
+	ResizeToNV12Rows(&b->e->resize, worker, &b->e->convertFixed, b->src, b->srcStride,
+					 y0, y0 + ENCODER_BAND_HEIGHT, b->dstY, b->dstStride, b->dstUV, b->dstStride);
+}
+
+// output size is captured size rounded up to even, converter fills that last column & row itself
+static bool EncoderNeedsResize(encoder *e, u32 width, u32 height) {
+	return ((width + 1) & ~1u) != e->width || ((height + 1) & ~1u) != e->height;
+}
+
+static void EncoderConvertOnCPU(encoder *e, D3D11_MAPPED_SUBRESOURCE *input, RECT rect, DWORD index) {
 	ID3D11DeviceContext *context = e->context;
 
-	// copy to input texture
-	{
-		D3D11_BOX box = {
-			.left = rect.left,
-			.top = rect.top,
-			.right = rect.right,
-			.bottom = rect.bottom,
-			.front = 0,
-			.back = 1
+	// mapping for read & write keeps previous frame, only changed tiles need converting
+	D3D11_MAPPED_SUBRESOURCE output;
+	if (SUCCEEDED(ID3D11DeviceContext_Map(context, (ID3D11Resource *) e->stagingOutput, 0,
+										  D3D11_MAP_READ_WRITE, 0, &output))) {
+		// UV plane of NV12 follows right after Y plane using same pitch
+		u8 *dstY = (u8 *) output.pData;
+		u8 *dstUV = dstY + output.RowPitch * e->height;
+
+		encoder_band band = {
+			.e = e,
+			.src = (const u8 *) input->pData,
+			.srcStride = input->RowPitch,
+			.dstY = dstY,
+			.dstUV = dstUV,
+			.dstStride = output.RowPitch,
+			.width = rect.right - rect.left,
+			.height = rect.bottom - rect.top
 		};
+		u32 bands = (e->height + ENCODER_BAND_HEIGHT - 1) / ENCODER_BAND_HEIGHT;
+
+		if (EncoderNeedsResize(e, band.width, band.height)) {
+			// resize & convert in one pass, previous frame is not reused
+			if (e->resize.inWidth != band.width || e->resize.inHeight != band.height) {
+				ResizeDestroy(&e->resize);
+				ResizeCreate(&e->resize, band.width, band.height, e->width, e->height,
+							 e->jobs.workerCount);
+			}
 
-		ID3D11DeviceContext_CopySubresourceRegion(context, (ID3D11Resource *) e->inputTexture,
-												  0, 0, 0, 0, (ID3D11Resource *) texture, 0, &box);
+			if (e->resize.memory) JobsRun(&e->jobs, EncoderResizeBand, &band, bands);
+		} else if (e->damage.memory) {
+			JobsRun(&e->jobs, EncoderConvertDamageBand, &band, bands);
+		} else {
+			JobsRun(&e->jobs, EncoderConvertBand, &band, bands);
+		}
+
+		ID3D11DeviceContext_Unmap(context, (ID3D11Resource *) e->stagingOutput, 0);
+	} else {
+		// last converted frame is lost, next one must be converted fully
+		DamageReset(&e->damage);
 	}
 
-	// convert to YUV
-	{
-		ID3D11DeviceContext_ClearState(context);
-		// input
-		ID3D11DeviceContext_CSSetConstantBuffers(context, 0, 1, &e->convertBuffer);
-		ID3D11DeviceContext_CSSetShaderResources(context, 0, 1, &e->convertInputView);
-		// output
-		ID3D11UnorderedAccessView *views[] = {
-			e->convertOutputViewY[index],
-			e->convertOutputViewUV[index]
-		};
-		ID3D11DeviceContext_CSSetUnorderedAccessViews(context, 0, _countof(views), views, 0);
-		// shader
-		ID3D11DeviceContext_CSSetShader(context, e->convertShader, 0, 0);
-		ID3D11DeviceContext_Dispatch(context, (e->width / 2 + 15) / 16,
-									 (e->height / 2 + 7) / 8, 1);
+	ID3D11DeviceContext_Unmap(context, (ID3D11Resource *) e->stagingInput, 0);
+
+	ID3D11DeviceContext_CopyResource(context, (ID3D11Resource *) e->convertTexture[index],
+									 (ID3D11Resource *) e->stagingOutput);
+}
+
+// clock ticks to MF time from start of recording
+static LONGLONG EncoderMediaTime(encoder *e, u64 time) {
+	return TimeConvert(time - e->startTime, e->clock.rate, TIME_RATE_MF, TIME_NEAREST);
+}
+
+// no new frame goes to encoder, previous one just gets extended
+static void EncoderSkipFrame(encoder *e, u64 time) {
+	if (e->constantFramerate) {
+		// repeated by pacer instead, file has no gaps
+		AcquireSRWLockExclusive(&e->pacerLock);
+		EncoderRunPlan(e, PacerIdle(&e->pacer, time));
+		ReleaseSRWLockExclusive(&e->pacerLock);
+		return;
 	}
 
-	// setup input time & duration
-	if (!e->startTime) e->startTime = time;
-	IMFSample_SetSampleDuration(sample, MFllMulDiv(e->framerateDen, MF_UNITS_PER_SECOND,
-												   e->framerateNum, 0));
-	IMFSample_SetSampleTime(sample, MFllMulDiv(time - e->startTime, MF_UNITS_PER_SECOND,
-											   timePeriod, 0));
+	IMFSinkWriter_SendStreamTick(e->writer, e->videoStreamIndex, EncoderMediaTime(e, time));
+	e->videoDiscontinuity = true;
+}
 
-	if (e->videoDiscontinuity) {
-		IMFSample_SetUINT32(sample, &MFSampleExtension_Discontinuity, true);
-		e->videoDiscontinuity = false;
-	} else {
-		// don't care about success or no, we just don't want this attribute set at all
-		IMFSample_DeleteItem(sample, &MFSampleExtension_Discontinuity);
+// after conversion, frame gets slots from pacer or keeps time it was captured at
+static void EncoderPlaceFrame(encoder *e, s32 index, u64 time) {
+	if (e->constantFramerate) {
+		// previous frame is placed once this one shows which slots are nearer to it
+		u64 now = TimeClockNow(&e->clock);
+		AcquireSRWLockExclusive(&e->pacerLock);
+		pacer_plan plan = PacerFrame(&e->pacer, time);
+		EncoderRunPlan(e, plan);
+		EncoderReleaseCurrent(e, !plan.drop, now);
+		e->videoCurrent = index;
+		e->videoRefs[index] = 1;
+		ReleaseSRWLockExclusive(&e->pacerLock);
+		return;
 	}
 
-	IMFTrackedSample *tracked;
-	IMFSample_QueryInterface(sample, &IID_IMFTrackedSample, (void *) &tracked);
-	IMFTrackedSample_SetAllocator(tracked, &e->videoSampleCallback, 0);
-	IMFTrackedSample_Release(tracked);
+	time_rate framerate = TimeRate(e->framerateNum, e->framerateDen);
+	LONGLONG duration = TimeConvert(1, framerate, TIME_RATE_MF, TIME_NEAREST);
+	EncoderSubmitVideo(e, index, EncoderMediaTime(e, time), duration, false);
+}
 
-	// submit to encoder which will happen in background
-	IMFSinkWriter_WriteSample(e->writer, e->videoStreamIndex, sample);
+// video thread, or capture thread when there is none
+static void EncoderHandleVideo(encoder *e, const encoder_video_item *item) {
+	e->videoLastTime = item->time;
 
-	IMFSample_Release(sample);
-	
+	// frames queue dropped leave gap, constant frame rate repeats previous frame over it instead
+	s32 drops = BOGAtomicLoad(&e->videoQueueDrops);
+	if (drops != e->videoQueueSeen) {
+		e->videoQueueSeen = drops;
+		if (!e->constantFramerate) e->videoDiscontinuity = true;
+	}
+
+	if (item->type == ENCODER_VIDEO_FRAME) {
+		EncoderPlaceFrame(e, item->index, item->time);
+	} else {
+		EncoderSkipFrame(e, item->time);
+	}
+}
+
+// capture thread, false when policy of full queue dropped item
+static bool EncoderQueueVideo(encoder *e, encoder_video_type type, s32 index, u64 time) {
+	encoder_video_item item = { .type = type, .index = index, .time = time };
+	if (e->videoThreaded) return MailboxPush(&e->videoQueue, &item);
+
+	EncoderHandleVideo(e, &item);
 	return true;
 }
 
-static void EncoderNewSamples(encoder *e, void *samples, DWORD videoCount, u64 time, u64 timePeriod) {
-	IMFSample *audioSample = e->audioInputSample;
-	IMFMediaBuffer *buffer = e->audioInputBuffer;
-	
-	BYTE *bufferData;
-	DWORD maxLength;
-	IMFMediaBuffer_Lock(buffer, &bufferData, &maxLength, 0);
-	
-	DWORD bufferSize = videoCount * e->audioFrameSize;
+// capture thread, frame queue dropped was never submitted, so its buffer is free again
+// & next frame is encoded even if it's static, it may be only one that has dropped changes
+static void EncoderDropVideo(void *user, const void *data) {
+	const encoder_video_item *item = (const encoder_video_item *) data;
+	if (item->type != ENCODER_VIDEO_FRAME) return;
+
+	encoder *e = (encoder *) user;
+	PoolCancel(&e->videoPool, item->index);
+	DamageReset(&e->damage);
+	BOGAtomicAdd(&e->videoQueueDrops, 1);
+}
+
+static bool EncoderNewFrame(encoder *e, ID3D11Texture2D *texture, RECT rect, u64 time) {
+	// encoder often returns buffer within few msec, short wait is better than dropped frame
+	buffer_pool *pool = &e->videoPool;
+	if (e->videoWait && !pool->free && pool->count >= pool->config.maxCount) {
+		u64 deadline = BOGTimeMsec() + e->videoWait;
+		for (;;) {
+			u64 now = BOGTimeMsec();
+			if (pool->free || now >= deadline) break;
+			
+			s32 zero = 0;
+			WaitOnAddress(&pool->free, &zero, sizeof(s32), (DWORD) (deadline - now));
+		}
+	}
+
+	u64 now = TimeClockNow(&e->clock);
+	s32 index = PoolAcquire(pool, now);
+
+	if (index < 0) {
+		// dropped frame
+		EncoderQueueVideo(e, ENCODER_VIDEO_SKIP, -1, time);
+		return false;
+	}
 	
-	if (samples) {
-		CopyMemory(bufferData, samples, bufferSize);
+	// both paths read frame back to look for changes, GPU path still converts on GPU & only skips
+	// static frames, without staging texture or damage map it converts every frame it gets
+	D3D11_MAPPED_SUBRESOURCE input;
+	bool mapped = EncoderReadFrame(e, texture, rect, &input);
+	if (e->cpuConvert && !mapped) {
+		PoolCancel(pool, index);
+		return false;
+	}
+
+	if (mapped) {
+		u32 width = rect.right - rect.left;
+		u32 height = rect.bottom - rect.top;
+		if (e->damage.width != width || e->damage.height != height) {
+			DamageDestroy(&e->damage);
+			DamageCreate(&e->damage, width, height);
+		}
+
+		if (e->damage.memory && !DamageUpdate(&e->damage, input.pData, input.RowPitch)) {
+			// static frame, nothing to convert or encode
+			ID3D11DeviceContext_Unmap(e->context, (ID3D11Resource *) e->stagingInput, 0);
+			PoolCancel(pool, index);
+			EncoderQueueVideo(e, ENCODER_VIDEO_SKIP, -1, time);
+			return false;
+		}
+	}
+
+	ID3D11DeviceContext *context = e->context;
+
+	if (e->cpuConvert) {
+		EncoderConvertOnCPU(e, &input, rect, (DWORD) index);
 	} else {
-		ZeroMemory(bufferData, bufferSize);
+		if (mapped) ID3D11DeviceContext_Unmap(context, (ID3D11Resource *) e->stagingInput, 0);
+
+		// input texture is captured size, so converter repeats last column & row of odd size just
+		// like CPU path does, other size than output goes through resize shader first
+		u32 width = rect.right - rect.left;
+		u32 height = rect.bottom - rect.top;
+		bool resize = EncoderNeedsResize(e, width, height);
+		if (width != e->inputWidth || height != e->inputHeight || !e->inputTexture) {
+			if (!EncoderCreateInputTexture(e, e->device, width, height)) {
+				DamageReset(&e->damage);
+				PoolCancel(pool, index);
+				return false;
+			}
+		}
+
+		// copy to input texture
+		{
+			D3D11_BOX box = {
+				.left = rect.left,
+				.top = rect.top,
+				.right = rect.right,
+				.bottom = rect.bottom,
+				.front = 0,
+				.back = 1
+			};
+
+			ID3D11DeviceContext_CopySubresourceRegion(context, (ID3D11Resource *) e->inputTexture,
+													  0, 0, 0, 0, (ID3D11Resource *) texture, 0, &box);
+		}
+
+		// resize to output size
+		if (resize) {
+			ID3D11DeviceContext_ClearState(context);
+			ID3D11DeviceContext_CSSetShaderResources(context, 0, 1, &e->resizeInputView);
+			ID3D11DeviceContext_CSSetUnorderedAccessViews(context, 0, 1, &e->resizeOutputView, 0);
+			ID3D11DeviceContext_CSSetShader(context, e->resizeShader, 0, 0);
+			ID3D11DeviceContext_Dispatch(context, (e->width + 15) / 16, (e->height + 7) / 8, 1);
+		}
+
+		// convert to YUV
+		{
+			ID3D11DeviceContext_ClearState(context);
+			// input
+			ID3D11Buffer *buffer = resize ? e->resizedConvertBuffer : e->convertBuffer;
+			ID3D11ShaderResourceView *view = resize ? e->convertInputView : e->resizeInputView;
+			ID3D11DeviceContext_CSSetConstantBuffers(context, 0, 1, &buffer);
+			ID3D11DeviceContext_CSSetShaderResources(context, 0, 1, &view);
+			// output
+			ID3D11UnorderedAccessView *views[] = {
+				e->convertOutputViewY[index],
+				e->convertOutputViewUV[index]
+			};
+			ID3D11DeviceContext_CSSetUnorderedAccessViews(context, 0, _countof(views), views, 0);
+			// shader
+			ID3D11DeviceContext_CSSetShader(context, e->convertShader, 0, 0);
+			ID3D11DeviceContext_Dispatch(context, (e->width / 2 + 15) / 16,
+										 (e->height / 2 + 7) / 8, 1);
+		}
 	}
-	
-	IMFMediaBuffer_Unlock(buffer);
-	IMFMediaBuffer_SetCurrentLength(buffer, bufferSize);
-	
-	// setup input time & duration
-	IMFSample_SetSampleDuration(audioSample, MFllMulDiv(videoCount, MF_UNITS_PER_SECOND,
-														e->audioSampleRate, 0));
-	IMFSample_SetSampleTime(audioSample, MFllMulDiv(time - e->startTime, MF_UNITS_PER_SECOND,
-													timePeriod, 0));
-	
-	IMFTransform_ProcessInput(e->resampler, 0, audioSample, 0);
-	EncoderOutputAudioSamples(e);
+
+	// start time is set before first frame is queued, so video thread sees it too
+	if (!e->startTime) BOGAtomicStore64(&e->startTime, time);
+
+	return EncoderQueueVideo(e, ENCODER_VIDEO_FRAME, index, time);
 }
 
-static void EncoderUpdate(encoder *e, u64 time, u64 timePeriod) {
-	if (time - e->videoLastTime >= timePeriod) {
+static void EncoderNewSamples(encoder *e, void *samples, DWORD videoCount, u64 time) {
+	// input is contiguous from first samples on, so only their time is needed
+	if (!e->audioStarted) {
+		e->audioStart = EncoderMediaTime(e, time);
+		e->audioStarted = true;
+	}
+
+	const BYTE *input = (const BYTE *) samples;
+	while (videoCount) {
+		DWORD count = videoCount < e->audioMaxInput ? videoCount : e->audioMaxInput;
+		EncoderOutputAudioSample(e, input, count);
+		if (input) input += count * e->audioFrameSize;
+		videoCount -= count;
+	}
+}
+
+static void EncoderSetAudioRatio(encoder *e, d64 ratio) {
+	ResamplerSetRatio(&e->resampler, ratio);
+}
+
+// no frame came for while
+static void EncoderIdle(encoder *e, u64 time) {
+	if (e->constantFramerate) {
+		// static screen gives no frames, its slots still need them
+		EncoderSkipFrame(e, time);
+		return;
+	}
+
+	// once per second without frames
+	if (time - e->videoLastTime >= TimeConvert(1, TIME_RATE_SECOND, e->clock.rate, TIME_NEAREST)) {
 		e->videoLastTime = time;
-		LONGLONG timestamp = MFllMulDiv(time - e->startTime, MF_UNITS_PER_SECOND, timePeriod, 0);
-		IMFSinkWriter_SendStreamTick(e->writer, e->videoStreamIndex, timestamp);
+		IMFSinkWriter_SendStreamTick(e->writer, e->videoStreamIndex, EncoderMediaTime(e, time));
 		e->videoDiscontinuity = true;
 	}
 }
+
+// places queued frames in order, static screen is handled once queue stays empty for a while
+static BOG_THREAD_PROC(EncoderVideoThread) {
+	encoder *e = (encoder *) arg;
+
+	// media foundation objects are free threaded, this thread just needs COM
+	CoInitializeEx(0, COINIT_MULTITHREADED);
+	bool started = false; // idle time is only known after first frame
+	for (;;) {
+		encoder_video_item item;
+		if (!MailboxPop(&e->videoQueue, &item)) {
+			if (!MailboxWait(&e->videoQueue, ENCODER_VIDEO_IDLE) && started) {
+				EncoderIdle(e, TimeClockNow(&e->clock));
+			}
+			continue;
+		}
+		if (item.type == ENCODER_VIDEO_QUIT) break;
+
+		EncoderHandleVideo(e, &item);
+		if (item.type == ENCODER_VIDEO_FRAME) started = true;
+	}
+	CoUninitialize();
+
+	return 0;
+}
+
+static void EncoderUpdate(encoder *e, u64 time) {
+	if (!e->videoThreaded) EncoderIdle(e, time);
+}
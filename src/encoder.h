@@ -8,13 +8,42 @@
 #include <mferror.h>
 #include <mfidl.h>
 #include <mfreadwrite.h>
-#include <wmcodecdsp.h>
 
 #include "resize_shader.h"
 #include "convert_shader.h"
+#include "convert.h"
+#include "damage.h"
+#include "resize.h"
+#include "jobs.h"
+#include "pool.h"
+#include "pacer.h"
+#include "timebase.h"
+#include "drift.h"
+#include "resampler.h"
+#include "ring.h"
+#include "mailbox.h"
+#include "mux_sink.h"
 
-#define ENCODER_VIDEO_BUFFER_COUNT 8
-#define ENCODER_AUDIO_BUFFER_COUNT 16
+// sample attribute holding index of video buffer
+DEFINE_GUID(ENCODER_BUFFER_INDEX,
+			0x5d0b8e3a, 0x6c1f, 0x4f2e, 0x9a, 0x47, 0x31, 0xd8, 0x2b, 0x6e, 0x90, 0xc4);
+
+#define ENCODER_VIDEO_BUFFER_MIN 2
+#define ENCODER_VIDEO_BUFFER_MAX 16  // not more than POOL_MAX_BUFFERS
+#define ENCODER_VIDEO_POOL_WINDOW 2  // sec, latency peak is kept & pool must be too big to shrink
+#define ENCODER_VIDEO_QUEUE 8  // converted frames waiting for video thread
+#define ENCODER_VIDEO_IDLE 100 // msec without frames before video thread handles static screen
+#define ENCODER_AUDIO_BUFFER_COUNT 64 // samples only point to blocks of audio ring
+#define ENCODER_AUDIO_RING 500 // msec of output audio held for encoder, in blocks sized to packets
+#define ENCODER_AUDIO_CHUNK 100 // msec of input at most in one sample, much less than ring
+#define ENCODER_AUDIO_WAIT 20 // msec audio pump waits for ring block or queue slot before dropping
+#define ENCODER_BAND_HEIGHT 64 // output rows converted on CPU by one job, multiple of tile height
+#define ENCODER_PACER_LATENCY 100 // msec, slot of constant frame rate waits at most this for frame
+#define ENCODER_FRAGMENT_DURATION 1000 // msec, file plays up to last fragment if recording dies
+#define ENCODER_OUTPUT_BUFFER (1 << 20) // bytes of one write to recording file
+#define ENCODER_OUTPUT_BUFFER_COUNT 16
+#define ENCODER_OUTPUT_PREALLOCATE (64 << 20) // first extent of file, later ones double
+#define ENCODER_REPLAY_HEADROOM 2 // replay ring holds this many times mean video bit rate
 #define MF_UNITS_PER_SECOND 10000000ULL
 
 #define AUDIO_BITRATE 8000
@@ -33,6 +62,19 @@ static HRESULT STDMETHODCALLTYPE EncoderGetParameters(IMFAsyncCallback *this, DW
 static HRESULT STDMETHODCALLTYPE EncoderVideoInvoke(IMFAsyncCallback *this, IMFAsyncResult *result);
 static HRESULT STDMETHODCALLTYPE EncoderAudioInvoke(IMFAsyncCallback *this, IMFAsyncResult *Result);
 
+static HRESULT STDMETHODCALLTYPE EncoderBufferQueryInterface(IMFMediaBuffer *this, REFIID riid,
+															 void **object);
+static ULONG STDMETHODCALLTYPE EncoderBufferAddRef(IMFMediaBuffer *this);
+static ULONG STDMETHODCALLTYPE EncoderBufferRelease(IMFMediaBuffer *this);
+static HRESULT STDMETHODCALLTYPE EncoderBufferLock(IMFMediaBuffer *this, BYTE **data,
+												   DWORD *maxLength, DWORD *currentLength);
+static HRESULT STDMETHODCALLTYPE EncoderBufferUnlock(IMFMediaBuffer *this);
+static HRESULT STDMETHODCALLTYPE EncoderBufferGetCurrentLength(IMFMediaBuffer *this,
+															   DWORD *length);
+static HRESULT STDMETHODCALLTYPE EncoderBufferSetCurrentLength(IMFMediaBuffer *this,
+															   DWORD length);
+static HRESULT STDMETHODCALLTYPE EncoderBufferGetMaxLength(IMFMediaBuffer *this, DWORD *length);
+
 static IMFAsyncCallbackVtbl EncoderVideoSampleCallbackVtbl = {
 	&EncoderQueryInterface,
 	&EncoderAddRef,
@@ -49,71 +91,189 @@ static IMFAsyncCallbackVtbl EncoderAudioSampleCallbackVtbl = {
 	&EncoderAudioInvoke
 };
 
+static IMFMediaBufferVtbl EncoderAudioBufferVtbl = {
+	&EncoderBufferQueryInterface,
+	&EncoderBufferAddRef,
+	&EncoderBufferRelease,
+	&EncoderBufferLock,
+	&EncoderBufferUnlock,
+	&EncoderBufferGetCurrentLength,
+	&EncoderBufferSetCurrentLength,
+	&EncoderBufferGetMaxLength
+};
+
+// media buffer at start of audio ring block, samples follow it, block is released with last
+// reference
+typedef struct {
+	IMFMediaBuffer buffer;
+	volatile LONG refs;
+	block_ring *ring;
+	DWORD length;
+	DWORD maxLength;
+} encoder_audio_buffer;
+
+// resampled block on its way from audio thread to writer thread, buffer 0 stops writer thread
+typedef struct {
+	encoder_audio_buffer *buffer;
+	LONGLONG time;
+	LONGLONG duration;
+} encoder_audio_item;
+
+typedef enum {
+	ENCODER_VIDEO_FRAME, // converted frame in buffer index
+	ENCODER_VIDEO_SKIP,  // no new frame, previous one is extended to time
+	ENCODER_VIDEO_QUIT,  // stops video thread
+} encoder_video_type;
+
+// captured frame on its way from capture thread to video thread, which places it with pacer &
+// submits it
+typedef struct {
+	encoder_video_type type;
+	s32 index;
+	u64 time;          // clock ticks it was captured at
+} encoder_video_item;
+
 typedef struct {
 	DWORD width;  // width of video output
 	DWORD height; // height of video output
 	DWORD framerateNum; // video output framerate numerator
 	DWORD framerateDen; // video output framerate denumerator
-	u64 startTime;   // time in QPC ticks since first call of NewFrame
+	volatile u64 startTime; // clock ticks of first call of NewFrame, read by audio pump too
+	time_clock clock; // of capture times, MF times are converted from it
 
 	IMFAsyncCallback videoSampleCallback;
 	IMFAsyncCallback audioSampleCallback;
 	ID3D11Device *device;
 	ID3D11DeviceContext *context;
 	IMFSinkWriter *writer;
+	mux_sink sink;      // sink writer gives encoded samples to it, it writes files itself
+	wchar_t fileName[SEGMENT_MAX_PATH];
 	s32 videoStreamIndex;
 	s32 audioStreamIndex;
 
 	ID3D11ComputeShader *resizeShader;
 	ID3D11ComputeShader *convertShader;
 	ID3D11Buffer *convertBuffer;
+	ID3D11Buffer *resizedConvertBuffer; // same matrix for R & B swapped by resize shader output
 
-	// RGB input texture
+	// RGB input texture, captured size
 	ID3D11Texture2D *inputTexture;
 	ID3D11RenderTargetView *inputRenderTarget;
 	ID3D11ShaderResourceView *resizeInputView;
+	u32 inputWidth, inputHeight;
 
-	// RGB resized texture
+	// RGB resized texture of output size, GPU path only
 	ID3D11Texture2D *resizedTexture;
 	ID3D11ShaderResourceView *convertInputView;
 	ID3D11UnorderedAccessView *resizeOutputView;
 
-	// NV12 converted texture
-	ID3D11Texture2D				*convertTexture[ENCODER_VIDEO_BUFFER_COUNT];
-	ID3D11UnorderedAccessView	*convertOutputViewY[ENCODER_VIDEO_BUFFER_COUNT];
-	ID3D11UnorderedAccessView	*convertOutputViewUV[ENCODER_VIDEO_BUFFER_COUNT];
-	IMFSample					*videoSample[ENCODER_VIDEO_BUFFER_COUNT];
+	// NV12 converted texture, only ones allocated by video pool are valid
+	ID3D11Texture2D				*convertTexture[ENCODER_VIDEO_BUFFER_MAX];
+	ID3D11UnorderedAccessView	*convertOutputViewY[ENCODER_VIDEO_BUFFER_MAX];
+	ID3D11UnorderedAccessView	*convertOutputViewUV[ENCODER_VIDEO_BUFFER_MAX];
+	IMFSample					*videoSample[ENCODER_VIDEO_BUFFER_MAX];
+	D3D11_TEXTURE2D_DESC		videoDesc;
+	DXGI_FORMAT					videoFormatY, videoFormatUV;
+	u32							videoSize; // bytes of one NV12 frame
+	buffer_pool					videoPool; // grows & shrinks with time encoder holds samples
+
+	// CPU conversion, used when compute shaders are not available
+	bool cpuConvert;
+	convert_fixed convertFixed;		// same coefficients as shader uses
+	ID3D11Texture2D *stagingInput;	// BGRA, CPU readable, size of captured rect, both paths
+	ID3D11Texture2D *stagingOutput;	// NV12, CPU writable
+	u32 stagingWidth, stagingHeight;
+	damage_map damage;				// static frames that don't need converting or encoding
+	resizer resize;					// scales captured rect to output size when they differ
+	jobs jobs;						// threads converting bands of frame in parallel
 
 	bool videoDiscontinuity;
 	u64  videoLastTime;
-	DWORD  videoIndex; // next index to use
-	LONG   videoCount; // how many samples are currently available to use
+	DWORD  videoWait;  // msec to wait for available sample before frame is dropped
 
-	IMFTransform	*resampler;
-	IMFSample		*audioSample[ENCODER_AUDIO_BUFFER_COUNT];
-	IMFSample		*audioInputSample;
-	IMFMediaBuffer	*audioInputBuffer;
+	// constant frame rate, every frame interval gets nearest frame & gaps repeat previous one
+	bool constantFramerate;
+	pacer pacer;
+	SRWLOCK pacerLock;  // video thread or, without it, capture thread & update timer move pacer
+	s32 videoCurrent;   // buffer of current frame of pacer, -1 when there is none
+	volatile s32 videoRefs[ENCODER_VIDEO_BUFFER_MAX]; // samples in encoder, +1 while current
+
+	mailbox videoQueue;     // converted frames, capture thread never waits on pacer or writer
+	bog_thread videoThread; // places queued frames & handles static screen
+	bool videoThreaded;     // no thread when false, frames go straight to writer
+	volatile s32 videoQueueDrops; // frames queue dropped, written by capture thread
+	s32 videoQueueSeen;     // drops video thread already marked as discontinuity
+
+	resampler		resampler;  // captured format to AUDIO_CHANNELS s16 at AUDIO_SAMPLERATE
+	IMFSample		*audioSample[ENCODER_AUDIO_BUFFER_COUNT]; // without buffer while available
+	block_ring		audioRing;  // buffers of samples, resampler writes straight to them
 	DWORD			audioFrameSize;
-	DWORD			audioSampleRate;
+	DWORD			audioMaxInput; // input frames in one sample at most
+	bool			audioStarted;
+	LONGLONG		audioStart;    // MF time of first input frame, which is first output frame
+	u64				audioWritten;  // output frames, dropped input skips its frames so times stay
+	u64				audioDropped;  // input frames dropped because ring or queue stayed full
 	DWORD			audioIndex; // next index to use
 	LONG			audioCount; // how many samples are currently available to use
+	drift			audioDrift; // keeps audio on clock, started by first audio after startTime
+	bool			audioDriftStarted;
+	mailbox			audioQueue; // resampled blocks, audio thread never waits on sink writer
+	bog_thread		audioThread; // gives queued blocks to sink writer
+	bool			audioThreaded; // no thread when false, blocks go straight to writer
 	
 	u64 nextEncode;
+	u64 stopTime; // clock ticks when recording was stopped, for reporting finalization time
 } encoder;
 
 typedef struct {
 	DWORD width, height;
 	DWORD framerateNum, framerateDen;
 	WAVEFORMATEX *audioFormat;
+	bool cpuConvert; // force conversion on CPU instead of compute shader
+	DWORD videoWait; // msec to wait for free video buffer, 0 drops frame right away
+	mailbox_policy videoPolicy; // full video queue, MAILBOX_BLOCK waits videoWait for video thread
+	bool constantFramerate; // repeat frames so every frame interval has one, instead of gaps
+	u32 segmentDuration; // msec, recording continues in next file after it, 0 for one file
+	u64 segmentSize;     // bytes, same for file size
+	u32 replayDuration;  // msec of last encoded video & audio kept in memory, 0 for none
+	bool replayOnly;     // no recording file, only replay ring, ignored without replayDuration
+	time_clock clock; // all times given to encoder are its ticks
 } encoder_config;
 
-static void EncoderInit(encoder *e);
+// band of frame converted on CPU by one job
+typedef struct {
+	encoder *e;
+	const u8 *src;
+	udm srcStride;
+	u8 *dstY, *dstUV;
+	udm dstStride;
+	u32 width, height;
+} encoder_band;
+
+// once per process, encoders themselves are independent & can be stopped on any thread
+static void EncoderInit(void);
+static bool EncoderSegmentName(void *user, u32 index, output_path *path, u32 count);
 static bool EncoderStart(encoder *e, ID3D11Device *device, wchar_t *fileName, encoder_config *config);
-static void EncoderStop(encoder *e);
+// drains audio, finalizes file & releases everything, can take seconds for long recording
+// false when some of recording could not be written
+static bool EncoderStop(encoder *e);
+// any thread before stop, writes last replayDuration of recording to its own file
+static bool EncoderSaveReplay(encoder *e, const wchar_t *fileName);
 
-static bool EncoderNewFrame(encoder *e, ID3D11Texture2D *texture, RECT rect, u64 time, u64 timePeriod);
-static void EncoderNewSamples(encoder *e, void *samples, DWORD videoCount, u64 time, u64 timePeriod);
-static void EncoderOutputAudioSamples(encoder *e);
-static void EncoderUpdate(encoder *e, u64 time, u64 timePeriod);
+// capture thread, false when frame was dropped or is static
+static bool EncoderNewFrame(encoder *e, ID3D11Texture2D *texture, RECT rect, u64 time);
+static void EncoderHandleVideo(encoder *e, const encoder_video_item *item);
+static void EncoderDropVideo(void *user, const void *item);
+static BOG_THREAD_PROC(EncoderVideoThread);
+// any one thread at time, usually audio pump
+static void EncoderNewSamples(encoder *e, void *samples, DWORD videoCount, u64 time);
+// same thread as samples, later samples give ratio times more output frames
+static void EncoderSetAudioRatio(encoder *e, d64 ratio);
+static void EncoderOutputAudioSample(encoder *e, const void *samples, DWORD count);
+static void EncoderWriteAudio(encoder *e, const encoder_audio_item *item);
+static void EncoderDropAudio(void *user, const void *item);
+static BOG_THREAD_PROC(EncoderAudioThread);
+// update timer, video thread handles static screen itself when there is one
+static void EncoderUpdate(encoder *e, u64 time);
 
 #endif //ENCODER_H
@@ -0,0 +1,81 @@
+#include "finalizer.h"
+
+static BOG_THREAD_PROC(FinalizerThread) {
+	finalizer *f = (finalizer *) arg;
+	s32 finished = 0;
+
+	for (;;) {
+		s32 submitted = BOGAtomicLoad(&f->submitted);
+
+		if (submitted == finished) {
+			// item can be submitted just before quit is set
+			if (BOGAtomicLoad(&f->quit)) {
+				if (BOGAtomicLoad(&f->submitted) == finished) break;
+				continue;
+			}
+
+			BOGWaitOnAddress(&f->submitted, submitted);
+			continue;
+		}
+
+		finalizer_item *item = &f->items[(u32) finished % FINALIZER_MAX_ITEMS];
+		item->func(item->data);
+
+		finished++;
+		BOGAtomicStore(&f->finished, finished);
+		BOGWakeAll(&f->finished);
+	}
+
+	return 0;
+}
+
+static void FinalizerCreate(finalizer *f) {
+	f->submitted = 0;
+	f->finished = 0;
+	f->quit = 0;
+	f->threaded = BOGThreadCreate(&f->thread, FinalizerThread, f);
+}
+
+static void FinalizerDestroy(finalizer *f) {
+	if (!f->threaded) return;
+
+	BOGAtomicStore(&f->quit, 1);
+	BOGWakeAll(&f->submitted);
+	BOGThreadJoin(f->thread);
+	f->threaded = false;
+}
+
+static void FinalizerSubmit(finalizer *f, finalizer_func *func, void *data) {
+	if (!f->threaded) {
+		func(data);
+		return;
+	}
+
+	// only submitting thread changes submitted
+	s32 submitted = f->submitted;
+	for (;;) {
+		s32 finished = BOGAtomicLoad(&f->finished);
+		if (submitted - finished < FINALIZER_MAX_ITEMS) break;
+		BOGWaitOnAddress(&f->finished, finished);
+	}
+
+	finalizer_item *item = &f->items[(u32) submitted % FINALIZER_MAX_ITEMS];
+	item->func = func;
+	item->data = data;
+
+	BOGAtomicStore(&f->submitted, submitted + 1);
+	BOGWakeAll(&f->submitted);
+}
+
+static void FinalizerWait(finalizer *f) {
+	s32 submitted = f->submitted;
+	for (;;) {
+		s32 finished = BOGAtomicLoad(&f->finished);
+		if (finished == submitted) break;
+		BOGWaitOnAddress(&f->finished, finished);
+	}
+}
+
+static u32 FinalizerPending(finalizer *f) {
+	return (u32) (f->submitted - BOGAtomicLoad(&f->finished));
+}
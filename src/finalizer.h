@@ -0,0 +1,47 @@
+#ifndef FINALIZER_H
+#define FINALIZER_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_thread.h"
+
+// finishes stopped recordings on background thread, so next recording can start right away
+// while previous file is still being drained, finalized & released
+// items run one after another in order they were submitted, only one thread may submit
+
+#define FINALIZER_MAX_ITEMS 16
+
+// interface
+
+typedef void finalizer_func(void *data);
+
+typedef struct {
+	finalizer_func *func;
+	void *data;
+} finalizer_item;
+
+typedef struct {
+	bog_thread thread;
+	bool threaded; // thread could not be created when false, items then run inside submit
+
+	// items [finished..submitted) belong to finalizer thread
+	finalizer_item items[FINALIZER_MAX_ITEMS];
+	volatile s32 submitted;
+	volatile s32 finished;
+	volatile s32 quit;
+} finalizer;
+
+static void FinalizerCreate(finalizer *f);
+
+// waits for every submitted item to finish first
+static void FinalizerDestroy(finalizer *f);
+
+// only waits when FINALIZER_MAX_ITEMS items are still pending
+static void FinalizerSubmit(finalizer *f, finalizer_func *func, void *data);
+
+// waits until every item submitted so far has finished
+static void FinalizerWait(finalizer *f);
+
+// items submitted but not finished yet
+static u32 FinalizerPending(finalizer *f);
+
+#endif //FINALIZER_H
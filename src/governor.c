@@ -0,0 +1,154 @@
+#include "governor.h"
+
+#define GOVERNOR_NEVER 0xFFFFFFFF
+
+static void GovernorResetWindow(governor *g, u64 now) {
+	g->windowStart = now;
+	g->frames = 0;
+	g->drops = 0;
+	g->queueMax = 0;
+	g->queueSum = 0;
+	g->work = 0;
+}
+
+static void GovernorCreate(governor *g, const governor_config *config) {
+	g->config = *config;
+
+	governor_config *c = &g->config;
+	if (c->rateCount > GOVERNOR_MAX_RATES) c->rateCount = GOVERNOR_MAX_RATES;
+	if (c->scaleCount > GOVERNOR_MAX_SCALES) c->scaleCount = GOVERNOR_MAX_SCALES;
+	if (!c->scaleCount) {
+		c->scale[0] = 100;
+		c->scaleCount = 1;
+	}
+	if (!c->window) c->window = 1;
+	if (!c->hold) c->hold = 1;
+	if (c->maxHold < c->hold) c->maxHold = c->hold;
+
+	g->rate = 0;
+	g->scale = 0;
+	g->hold = c->hold;
+	GovernorStart(g, 0);
+}
+
+static void GovernorStart(governor *g, u64 now) {
+	GovernorResetWindow(g, now);
+	g->lastDrops = 0;
+	g->quiet = 0;
+	g->overloaded = 0;
+	g->sinceUp = GOVERNOR_NEVER;
+	g->startScale = g->scale;
+	g->switches = 0;
+	g->lowestRate = g->rate;
+}
+
+static bool GovernorDecide(governor *g, u64 now) {
+	const governor_config *c = &g->config;
+	u64 interval = c->frequency / c->framerate[g->rate];
+	u64 work = g->work / g->frames;
+	u32 queue = (u32) (g->queueSum / g->frames);
+
+	// frames encoder finished in window, what is not queued anymore & was not dropped
+	s64 done = (s64) g->frames - g->drops + g->queueFirst - g->queueLast;
+	u64 elapsed = now - g->windowStart;
+	u64 throughput = done > 0 ? (u64) done * c->frequency / elapsed : 0;
+
+	// backlog that shrinks by itself is left to drain, stepping down again would overshoot
+	bool draining = g->queueLast < g->queueFirst;
+	bool behind = g->drops || queue >= c->queueHigh ||
+				  g->queueLast >= g->queueFirst + c->queueHigh / 2;
+	bool slow = work * 100 > interval * c->busy;
+
+	if (g->sinceUp != GOVERNOR_NEVER && ++g->sinceUp >= c->maxHold) {
+		// step up held for longest hold, next one can come sooner again
+		g->hold = g->hold / 2 > c->hold ? g->hold / 2 : c->hold;
+		g->sinceUp = GOVERNOR_NEVER;
+	}
+
+	if ((behind && !draining) || slow) {
+		g->quiet = 0;
+		g->overloaded++;
+
+		// step up that failed goes back to frame rate that worked before it
+		bool failed = g->sinceUp < g->hold;
+		if (failed) g->hold = 2 * g->hold < c->maxHold ? 2 * g->hold : c->maxHold;
+		g->sinceUp = GOVERNOR_NEVER;
+
+		if (g->rate + 1 < c->rateCount) {
+			// otherwise straight to frame rate encoder & capture thread managed, so sudden load
+			// doesn't take many windows of dropped frames
+			g->rate++;
+			while (!failed && g->rate + 1 < c->rateCount) {
+				u32 rate = c->framerate[g->rate];
+				bool fits = rate <= throughput || !behind;
+				if (fits && (!slow || work * rate * 100 <= c->frequency * c->busy)) break;
+				g->rate++;
+			}
+			if (g->rate > g->lowestRate) g->lowestRate = g->rate;
+			g->switches++;
+			return true;
+		}
+
+		// even lowest frame rate is too much for long time, next recording gets smaller output
+		if (g->overloaded >= c->maxHold && g->scale == g->startScale &&
+			g->scale + 1 < c->scaleCount) {
+			g->scale++;
+		}
+		return false;
+	}
+
+	g->overloaded = 0;
+
+	// higher frame rate must leave capture thread more slack than limit for stepping down
+	bool fits = true;
+	if (g->rate) {
+		u64 next = c->frequency / c->framerate[g->rate - 1];
+		fits = work * 400 <= next * c->busy * 3;
+	}
+
+	if (g->drops || g->queueMax >= c->queueHigh || g->queueLast > g->queueFirst + 1 || !fits) {
+		g->quiet = 0;
+		return false;
+	}
+
+	g->quiet++;
+	if (g->rate) {
+		if (g->quiet < g->hold) return false;
+
+		g->rate--;
+		g->quiet = 0;
+		g->sinceUp = 0;
+		g->switches++;
+		return true;
+	}
+
+	// output size is bigger step than frame rate, it needs longest quiet run
+	if (g->quiet >= c->maxHold && g->scale && g->scale == g->startScale) g->scale--;
+	return false;
+}
+
+static bool GovernorFrame(governor *g, const governor_sample *sample, u64 now) {
+	if (!g->frames) g->queueFirst = sample->queued;
+
+	g->frames++;
+	g->drops += sample->drops - g->lastDrops;
+	g->lastDrops = sample->drops;
+	g->queueLast = sample->queued;
+	if (sample->queued > g->queueMax) g->queueMax = sample->queued;
+	g->queueSum += sample->queued;
+	g->work += sample->work;
+
+	if (now - g->windowStart < g->config.window) return false;
+
+	bool changed = GovernorDecide(g, now);
+	GovernorResetWindow(g, now);
+	return changed;
+}
+
+static u32 GovernorFramerate(governor *g) {
+	return g->config.framerate[g->rate];
+}
+
+static u32 GovernorScale(governor *g) {
+	return g->config.scale[g->scale];
+}
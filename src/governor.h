@@ -0,0 +1,77 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include "bog/bog_types.h"
+
+// picks frame rate & output size encoder can keep up with, so it gets fewer frames evenly
+// instead of dropping newest ones whenever it falls behind
+// every window it looks at dropped frames, how many frames encoder holds & how long capture
+// thread spends preparing one frame, steps down right away when encoder falls behind & steps up
+// only after run of quiet windows, that run doubles every time step up has to be taken back, so
+// load right at limit doesn't make it switch back & forth
+// frame rate changes right away, output size only for next recording since encoder can't change
+// it in middle of file
+
+#define GOVERNOR_MAX_RATES 8
+#define GOVERNOR_MAX_SCALES 4
+
+// interface
+
+typedef struct {
+	u32 framerate[GOVERNOR_MAX_RATES]; // frames per second, from highest
+	u32 rateCount;
+	u32 scale[GOVERNOR_MAX_SCALES];    // output size in percent of captured size, from largest
+	u32 scaleCount;
+	u64 frequency;     // clock ticks per second
+	u64 window;        // clock ticks between decisions
+	u32 queueHigh;     // frames held by encoder that mean it is falling behind
+	u32 busy;          // percent of frame interval capture thread can spend on frame
+	u32 hold;          // quiet windows before step up
+	u32 maxHold;       // hold doubles up to this after step up that had to be taken back
+} governor_config;
+
+// what capture thread saw for one frame offered to encoder
+typedef struct {
+	u32 queued;        // frames held by encoder after this one was submitted
+	u32 drops;         // frames dropped by encoder since recording started
+	u64 work;          // clock ticks capture thread spent on frame
+} governor_sample;
+
+typedef struct {
+	governor_config config;
+	u32 rate;          // index to framerate, used by frame limiter
+	u32 scale;         // index to scale, used when next recording starts
+
+	// current window
+	u64 windowStart;
+	u32 frames;
+	u32 drops;
+	u32 queueFirst, queueLast, queueMax;
+	u64 queueSum;
+	u64 work;
+	u32 lastDrops;
+
+	u32 quiet;         // windows in row with headroom
+	u32 overloaded;    // windows in row encoder was behind
+	u32 hold;          // quiet windows needed now
+	u32 sinceUp;       // windows since last step up, step down soon after it means it failed
+	u32 startScale;    // scale of current recording, next one moves at most one step from it
+
+	// statistics of current recording
+	u32 switches;
+	u32 lowestRate;    // index of lowest frame rate used
+} governor;
+
+// starts at highest frame rate & largest size
+static void GovernorCreate(governor *g, const governor_config *config);
+
+// new recording keeps frame rate & size previous one ended with
+static void GovernorStart(governor *g, u64 now);
+
+// capture thread, after every frame offered to encoder, returns true when frame rate changed
+static bool GovernorFrame(governor *g, const governor_sample *sample, u64 now);
+
+static u32 GovernorFramerate(governor *g);
+static u32 GovernorScale(governor *g);
+
+#endif //GOVERNOR_H
@@ -0,0 +1,103 @@
+#include "jobs.h"
+
+static void JobsProcess(jobs *j, u32 worker) {
+	// own range first, then neighbours
+	for (u32 i = 0; i < j->workerCount; ++i) {
+		jobs_range *range = &j->ranges[(worker + i) % j->workerCount];
+
+		for (;;) {
+			// next can go past end when several workers race for last item, that's fine
+			s32 index = BOGAtomicAdd(&range->next, 1) - 1;
+			if (index >= range->end) break;
+
+			j->func(j->data, index, worker);
+		}
+	}
+}
+
+static BOG_THREAD_PROC(JobsWorker) {
+	jobs_worker *w = (jobs_worker *) arg;
+	jobs *j = w->owner;
+	s32 generation = 0;
+
+	for (;;) {
+		while (BOGAtomicLoad(&j->generation) == generation) {
+			BOGWaitOnAddress(&j->generation, generation);
+		}
+
+		// next run can't start before this one finishes, so no generation is ever skipped
+		generation++;
+		if (BOGAtomicLoad(&j->quit)) break;
+
+		JobsProcess(j, w->index);
+
+		if (BOGAtomicAdd(&j->running, -1) == 0) BOGWakeAll(&j->running);
+	}
+
+	return 0;
+}
+
+static bool JobsCreate(jobs *j, u32 workerCount) {
+	if (!workerCount) workerCount = BOGThreadCount();
+	if (workerCount > JOBS_MAX_WORKERS) workerCount = JOBS_MAX_WORKERS;
+	if (!workerCount) workerCount = 1;
+
+	j->func = 0;
+	j->data = 0;
+	j->generation = 0;
+	j->running = 0;
+	j->quit = 0;
+
+	// worker 0 is thread calling JobsRun
+	j->workerCount = 1;
+	for (u32 i = 1; i < workerCount; ++i) {
+		j->workers[i].owner = j;
+		j->workers[i].index = i;
+		if (!BOGThreadCreate(&j->threads[i], JobsWorker, &j->workers[i])) break;
+		j->workerCount++;
+	}
+
+	return true;
+}
+
+static void JobsDestroy(jobs *j) {
+	if (!j->workerCount) return;
+
+	BOGAtomicStore(&j->quit, 1);
+	BOGAtomicAdd(&j->generation, 1);
+	BOGWakeAll(&j->generation);
+
+	for (u32 i = 1; i < j->workerCount; ++i) {
+		BOGThreadJoin(j->threads[i]);
+	}
+
+	j->workerCount = 0;
+}
+
+static void JobsRun(jobs *j, jobs_func *func, void *data, u32 count) {
+	if (j->workerCount <= 1 || count <= 1) {
+		for (u32 i = 0; i < count; ++i) func(data, i, 0);
+		return;
+	}
+
+	j->func = func;
+	j->data = data;
+
+	for (u32 i = 0; i < j->workerCount; ++i) {
+		j->ranges[i].end = (s32) ((u64) count * (i + 1) / j->workerCount);
+		BOGAtomicStore(&j->ranges[i].next, (s32) ((u64) count * i / j->workerCount));
+	}
+
+	// atomic increment publishes everything above to workers
+	BOGAtomicStore(&j->running, (s32) j->workerCount - 1);
+	BOGAtomicAdd(&j->generation, 1);
+	BOGWakeAll(&j->generation);
+
+	JobsProcess(j, 0);
+
+	for (;;) {
+		s32 running = BOGAtomicLoad(&j->running);
+		if (!running) break;
+		BOGWaitOnAddress(&j->running, running);
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_cpu.h"
+#include "bog/bog_thread.h"
+
+// pool of worker threads running parallel for loops over per-frame work, like bands of image
+// items are split into one contiguous range per worker, worker that finishes its own range early
+// steals remaining items from ranges of others
+
+#define JOBS_MAX_WORKERS 32
+
+// interface
+
+// processes one item, worker is 0..workerCount-1 & can be used to pick per thread scratch memory
+typedef void jobs_func(void *data, u32 index, u32 worker);
+
+typedef struct {
+	volatile s32 next; // next item to take, taking is atomic increment so others can steal from it
+	s32 end;
+	u8 padding[BOG_CACHE_LINE - 2 * sizeof(s32)];
+} jobs_range;
+
+typedef struct jobs jobs;
+
+typedef struct {
+	jobs *owner;
+	u32 index;
+} jobs_worker;
+
+struct jobs {
+	u32 workerCount; // including thread calling JobsRun
+	bog_thread threads[JOBS_MAX_WORKERS];
+	jobs_worker workers[JOBS_MAX_WORKERS];
+	jobs_range ranges[JOBS_MAX_WORKERS];
+
+	jobs_func *func;
+	void *data;
+	volatile s32 generation; // incremented for every run, idle workers sleep on it
+	volatile s32 running;    // workers still busy with current run
+	volatile s32 quit;
+};
+
+// workerCount 0 uses every logical processor
+static bool JobsCreate(jobs *j, u32 workerCount);
+static void JobsDestroy(jobs *j);
+
+// calls func for every index in 0..count-1, returns after all of them finished
+// calling thread works too, so with single worker everything simply runs in place
+static void JobsRun(jobs *j, jobs_func *func, void *data, u32 count);
+
+#endif //JOBS_H
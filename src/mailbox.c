@@ -0,0 +1,173 @@
+#include "mailbox.h"
+
+#include <string.h>
+
+static u8 *MailboxItem(mailbox *m, s32 index) {
+	return m->data + (udm) ((u32) index & m->mask) * m->itemSize;
+}
+
+static bool MailboxCreate(mailbox *m, const mailbox_config *config) {
+	if (!config->itemSize || !config->count || config->count > (1u << 30)) return false;
+
+	u32 count = 1;
+	while (count < config->count) count *= 2;
+
+	m->memorySize = (udm) count * config->itemSize;
+	m->memory = BOGAlloc(m->memorySize);
+	if (!m->memory) return false;
+
+	m->data = (u8 *) m->memory;
+	m->itemSize = config->itemSize;
+	m->mask = count - 1;
+	m->policy = config->policy;
+	m->timeout = config->timeout;
+	m->drop = config->drop;
+	m->user = config->user;
+
+	m->head = 0;
+	m->cachedTail = 0;
+	m->consumerWaiting = 0;
+	m->dropped = 0;
+	m->tail = 0;
+	m->cachedHead = 0;
+	m->producerWaiting = 0;
+
+	return true;
+}
+
+static void MailboxDestroy(mailbox *m) {
+	BOGFree(m->memory, m->memorySize);
+	m->memory = 0;
+}
+
+// waits for consumer to free slot, false on timeout
+static bool MailboxWaitForSlot(mailbox *m, s32 head) {
+	bool forever = m->timeout == MAILBOX_WAIT_FOREVER;
+	u64 deadline = BOGTimeMsec() + m->timeout;
+	bool result = true;
+
+	// consumer checks flag after it moves tail, so either it sees flag or we see new tail
+	BOGAtomicStore(&m->producerWaiting, 1);
+	for (;;) {
+		s32 tail = BOGAtomicLoad(&m->tail);
+		if ((u32) (head - tail) <= m->mask) {
+			m->cachedTail = tail;
+			break;
+		}
+
+		if (forever) {
+			BOGWaitOnAddress(&m->tail, tail);
+		} else {
+			u64 now = BOGTimeMsec();
+			if (now >= deadline) {
+				result = false;
+				break;
+			}
+			BOGWaitOnAddressTimeout(&m->tail, tail, (u32) (deadline - now));
+		}
+	}
+	BOGAtomicStore(&m->producerWaiting, 0);
+
+	return result;
+}
+
+static bool MailboxPush(mailbox *m, const void *item) {
+	s32 head = m->head;
+
+	if ((u32) (head - m->cachedTail) > m->mask) {
+		m->cachedTail = BOGAtomicLoad(&m->tail);
+	}
+
+	if ((u32) (head - m->cachedTail) > m->mask) {
+		bool drop = false;
+
+		switch (m->policy) {
+			case MAILBOX_DROP_NEWEST: {
+				drop = true;
+			} break;
+
+			case MAILBOX_REPLACE_OLDEST: {
+				// consumer can take oldest item meanwhile, then there is free slot anyway
+				// only producer writes slots, so dropped item is intact until it is overwritten
+				s32 tail = m->cachedTail;
+				if (BOGAtomicCompareExchange(&m->tail, tail, tail + 1)) {
+					m->dropped++;
+					if (m->drop) m->drop(m->user, MailboxItem(m, tail));
+				}
+				m->cachedTail = tail + 1;
+			} break;
+
+			case MAILBOX_BLOCK: {
+				drop = !MailboxWaitForSlot(m, head);
+			} break;
+		}
+
+		if (drop) {
+			m->dropped++;
+			if (m->drop) m->drop(m->user, item);
+			return false;
+		}
+	}
+
+	memcpy(MailboxItem(m, head), item, m->itemSize);
+	BOGAtomicStore(&m->head, head + 1);
+
+	if (BOGAtomicLoad(&m->consumerWaiting)) BOGWakeAll(&m->head);
+	return true;
+}
+
+static bool MailboxPop(mailbox *m, void *item) {
+	for (;;) {
+		// only producer replacing oldest item moves tail besides consumer
+		s32 tail = m->policy == MAILBOX_REPLACE_OLDEST ? BOGAtomicLoad(&m->tail) : m->tail;
+
+		// producer replacing oldest items can move tail past cached head
+		if ((s32) (m->cachedHead - tail) <= 0) {
+			m->cachedHead = BOGAtomicLoad(&m->head);
+			if (m->cachedHead == tail) return false;
+		}
+
+		memcpy(item, MailboxItem(m, tail), m->itemSize);
+
+		if (m->policy != MAILBOX_REPLACE_OLDEST) {
+			BOGAtomicStore(&m->tail, tail + 1);
+			break;
+		}
+
+		// producer dropped item while it was copied & may have overwritten it, try next one
+		if (BOGAtomicCompareExchange(&m->tail, tail, tail + 1)) break;
+	}
+
+	if (BOGAtomicLoad(&m->producerWaiting)) BOGWakeAll(&m->tail);
+	return true;
+}
+
+static bool MailboxWait(mailbox *m, u32 msec) {
+	if ((s32) (m->cachedHead - BOGAtomicLoad(&m->tail)) > 0) return true;
+
+	bool forever = msec == MAILBOX_WAIT_FOREVER;
+	u64 deadline = BOGTimeMsec() + msec;
+	bool result = false;
+
+	// producer checks flag after it moves head, so either it sees flag or we see new head
+	BOGAtomicStore(&m->consumerWaiting, 1);
+	for (;;) {
+		s32 head = BOGAtomicLoad(&m->head);
+		m->cachedHead = head;
+		if (head != BOGAtomicLoad(&m->tail)) {
+			result = true;
+			break;
+		}
+
+		if (forever) {
+			BOGWaitOnAddress(&m->head, head);
+		} else {
+			u64 now = BOGTimeMsec();
+			if (now >= deadline) break;
+			BOGWaitOnAddressTimeout(&m->head, head, (u32) (deadline - now));
+		}
+	}
+	BOGAtomicStore(&m->consumerWaiting, 0);
+
+	return result;
+}
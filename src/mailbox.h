@@ -0,0 +1,75 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_cpu.h"
+#include "bog/bog_memory.h"
+#include "bog/bog_thread.h"
+
+// lock-free ring of fixed size items between one producer thread & one consumer thread
+// producer & consumer indices live on separate cache lines, each side caches last seen index of
+// other one, so shared line is only read when ring looks full or empty
+// policy decides what push does when ring is full
+
+#define MAILBOX_WAIT_FOREVER 0xFFFFFFFF
+
+// interface
+
+typedef enum {
+	MAILBOX_DROP_NEWEST,    // item being pushed is dropped
+	MAILBOX_REPLACE_OLDEST, // oldest item is dropped, with count 1 consumer always gets latest
+	MAILBOX_BLOCK,          // producer waits up to timeout for free slot, then drops item
+} mailbox_policy;
+
+// producer thread, gets every item that is dropped, so what it holds can be released
+typedef void mailbox_drop(void *user, const void *item);
+
+typedef struct {
+	u32 itemSize;
+	u32 count;       // rounded up to power of 2
+	mailbox_policy policy;
+	u32 timeout;     // msec for MAILBOX_BLOCK, MAILBOX_WAIT_FOREVER never drops
+	mailbox_drop *drop; // optional
+	void *user;
+} mailbox_config;
+
+typedef struct {
+	u8 *data;
+	u32 itemSize;
+	u32 mask;        // count - 1
+	mailbox_policy policy;
+	u32 timeout;
+	mailbox_drop *drop;
+	void *user;
+	void *memory;
+	udm memorySize;
+	u8 padding0[BOG_CACHE_LINE];
+
+	// items [tail..head) are ready, indices wrap around
+	// producer line, consumer only reads head when its cached copy says ring is empty
+	volatile s32 head;
+	s32 cachedTail;
+	volatile s32 consumerWaiting; // set by consumer before it sleeps on head
+	u32 dropped;                  // pushes that dropped item, including replaced ones
+	u8 padding1[BOG_CACHE_LINE];
+
+	// consumer line, tail is also moved by producer when it replaces oldest item
+	volatile s32 tail;
+	s32 cachedHead;
+	volatile s32 producerWaiting; // set by producer before it sleeps on tail
+	u8 padding2[BOG_CACHE_LINE];
+} mailbox;
+
+static bool MailboxCreate(mailbox *m, const mailbox_config *config);
+static void MailboxDestroy(mailbox *m);
+
+// producer side, copies item in, returns false if it was dropped
+static bool MailboxPush(mailbox *m, const void *item);
+
+// consumer side, copies oldest item out, returns false if ring is empty
+static bool MailboxPop(mailbox *m, void *item);
+
+// consumer side, waits up to msec for item, returns false if ring is still empty
+static bool MailboxWait(mailbox *m, u32 msec);
+
+#endif //MAILBOX_H
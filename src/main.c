@@ -14,8 +14,27 @@
 
 #include "bog\bog_types.h"
 #include "bog\bog_stringw.h"
+#include "timebase.c"
 #include "audio_capture.c"
 #include "video_capture.c"
+#include "convert.c"
+#include "resize.c"
+#include "damage.c"
+#include "jobs.c"
+#include "mp4.c"
+#include "output.c"
+#include "segment.c"
+#include "replay.c"
+#include "mux_sink.c"
+#include "finalizer.c"
+#include "mailbox.c"
+#include "pool.c"
+#include "governor.c"
+#include "pacer.c"
+#include "drift.c"
+#include "resampler.c"
+#include "ring.c"
+#include "audio_pump.c"
 #include "encoder.c"
 
 #pragma comment(lib, "advapi32.lib")
@@ -33,7 +52,6 @@
 #pragma comment(lib, "mfuuid.lib")
 #pragma comment(lib, "user32.lib")
 #pragma comment(lib, "windowsapp.lib")
-#pragma comment(lib, "wmcodecdspuuid.lib")
 
 #define APP_NAME		L"Logger"
 
@@ -48,20 +66,36 @@
 #define ID_KEYS_SHORTCUT			(WM_USER + 8)
 #define ID_CLIPBOARD_TEXT_SHORTCUT	(WM_USER + 9)
 #define ID_CLIPBOARD_FILES_SHORTCUT	(WM_USER + 10)
+#define CMD_SAVE_REPLAY				(WM_USER + 11)
+#define ID_SAVE_REPLAY_SHORTCUT		(WM_USER + 12)
+#define CMD_KEEP_REPLAY				(WM_USER + 13)
 
 #define LOGS_PATH		L"%APPDATA%\\Logger"
 #define MAX_CLIPBOARD_SIZE 65536
 
-#define AUDIO_CAPTURE_TIMER    1
-#define AUDIO_CAPTURE_INTERVAL 100 // msec
-
 #define VIDEO_UPDATE_TIMER     2
 #define VIDEO_UPDATE_INTERVAL  100 // msec
+#define VIDEO_CONSTANT_FRAMERATE false // repeat frames so every frame interval has one
+#define VIDEO_QUEUE_POLICY MAILBOX_DROP_NEWEST // frame when video thread falls behind
+#define VIDEO_WAIT 0 // msec capture waits for free buffer, or queue slot with MAILBOX_BLOCK
+
+#define RECORD_SEGMENT_DURATION (30 * 60 * 1000) // msec, long recording is split into parts
+#define RECORD_REPLAY_DURATION (60 * 1000) // msec, last minute of recording can be saved any time
+#define RECORD_REPLAY_ONLY false // with replay kept, recording writes no file, only replay is saved
+#define RECORD_SEGMENT_SIZE (3ULL << 30) // bytes, split waits for IDR frame, FAT32 holds < 4 GB
 
-#define AUDIO_CAPTURE_BUFFER_DURATION_100NS (10 * 1000 * 1000)
+#define AUDIO_CAPTURE_BUFFER_DURATION_100NS (100 * 1000 * 10) // 100 msec, pump drains every period
+#define AUDIO_PUMP_TIMEOUT 20 // msec, loopback of some devices never sets event, pump polls then
+#define AUDIO_DRIFT_TOLERANCE 1 // msec audio can be off clock before resampler ratio corrects it
+#define AUDIO_DRIFT_GAP       20 // msec off that is treated as discontinuity
 
-static encoder gEncoder;
-static LARGE_INTEGER gTickFreq;
+static encoder *volatile gEncoder; // recording in progress, 0 when not recording
+static finalizer gFinalizer;   // finishes stopped recordings in background
+static time_clock gClock;       // QPC, same clock capture & audio timestamps use
+static u64 gStopTime;          // clock ticks of last stop, for reporting stop to next start latency
+static governor gGovernor;     // frame rate & output size encoder keeps up with
+static audio_pump gAudioPump;  // drains audio capture on own thread while recording
+static bool gKeepReplay;       // next recording keeps replay ring, it takes over 100 MB
 
 static void AddTrayIcon(HWND hWindow, HICON hIcon) {
 	NOTIFYICONDATAW nid = {
@@ -129,6 +163,8 @@ static bool EnableHotKeys(HWND hWindow) {
 									  MOD_ALT | MOD_CONTROL | MOD_SHIFT, 'C');
 	result = result && RegisterHotKey(hWindow, ID_CLIPBOARD_FILES_SHORTCUT,
 									  MOD_ALT | MOD_CONTROL | MOD_SHIFT, 'V');
+	result = result && RegisterHotKey(hWindow, ID_SAVE_REPLAY_SHORTCUT,
+									  MOD_ALT | MOD_CONTROL | MOD_SHIFT, 'R');
 	
 	return result;
 }
@@ -510,6 +546,24 @@ static void CreateDirectoryRecursivelyW(wchar_t *path) {
 	}
 }
 
+// capture, audio pump & UI threads all look at recording, so it is published atomically
+static encoder * CurrentEncoder(void) {
+	return (encoder *) BOGAtomicLoadPointer((void *volatile *) &gEncoder);
+}
+
+static void SetCurrentEncoder(encoder *e) {
+	BOGAtomicStorePointer((void *volatile *) &gEncoder, e);
+}
+
+// shows up in debugger or DebugView, costs nothing otherwise
+static void LogTiming(wchar_t *what, u64 ticks) {
+	wchar_t text[128];
+	u64 usec = TimeConvert(ticks, gClock.rate, TimeRate(1000000, 1), TIME_FLOOR);
+	wsprintfW(text, L"%s: %I64u.%03u ms, %u recordings finalizing\n", what, usec / 1000,
+			  (u32) (usec % 1000), FinalizerPending(&gFinalizer));
+	OutputDebugStringW(text);
+}
+
 HKL GetInputLanguage() {
 	HKL result = 0;
 	
@@ -574,8 +628,67 @@ LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
 	return CallNextHookEx(0, nCode, wParam, lParam);
 }
 
-static void StartRecording(HWND hWindow, ID3D11Device *device, video_capture *vc, audio_capture *ac) {
-	wchar_t filename[22 + 5];
+static void EncodeCapturedAudio(audio_capture *ac) {
+	encoder *e = CurrentEncoder();
+	u64 startTime = e ? BOGAtomicLoad64(&e->startTime) : 0;
+	if (!startTime) return;
+	
+	u32 sampleRate = ac->format->nSamplesPerSec;
+	u32 bytesPerFrame = ac->format->nBlockAlign;
+	
+	// started with first audio of recording, estimator trims what came before start
+	drift *d = &e->audioDrift;
+	if (!e->audioDriftStarted) {
+		drift_config dc = {
+			.sampleRate = sampleRate,
+			.clock = gClock.rate,
+			.interval = 1000,
+			.window = 32,
+			.maxPpm = 1000,
+			.tolerance = AUDIO_DRIFT_TOLERANCE,
+			.gapLimit = AUDIO_DRIFT_GAP
+		};
+		DriftStart(d, &dc, startTime);
+		e->audioDriftStarted = true;
+	}
+	
+	audio_capture_data data;
+	while (AudioCaptureGetData(ac, &data, startTime)) {
+		u32 count = (u32) data.count;
+		drift_plan plan = DriftPacket(d, data.position, data.time, count, data.discontinuity);
+		EncoderSetAudioRatio(e, plan.ratio);
+		
+		// output frames are contiguous, each piece starts where previous one ended
+		u64 done = 0;
+		time_rate rate = TimeRate(sampleRate, 1);
+		
+		// in pieces encoder input buffer can hold
+		while (done < plan.silence) {
+			u32 piece = (u32) (plan.silence - done < sampleRate ? plan.silence - done : sampleRate);
+			u64 time = plan.time + TimeConvert(done, rate, gClock.rate, TIME_NEAREST);
+			EncoderNewSamples(e, 0, piece, time);
+			done += piece;
+		}
+		
+		u32 frames = count - plan.trim;
+		if (frames) {
+			BYTE *samples = data.samples ? (BYTE *) data.samples + plan.trim * bytesPerFrame : 0;
+			u64 time = plan.time + TimeConvert(done, rate, gClock.rate, TIME_NEAREST);
+			EncoderNewSamples(e, samples, frames, time);
+		}
+		
+		AudioCaptureReleaseData(ac, &data);
+	}
+}
+
+// runs on audio pump thread, recording can't stop before pump does
+static void DrainCapturedAudio(void *user) {
+	EncodeCapturedAudio((audio_capture *) user);
+}
+
+// new file in recordings named by current time & suffix, path holds MAX_PATH
+static void RecordingPath(wchar_t *path, wchar_t *suffix) {
+	wchar_t filename[22 + 32];
 	GetTimestamp(filename);
 	
 	for (u32 i = 0; i < 22; ++i) {
@@ -585,10 +698,10 @@ static void StartRecording(HWND hWindow, ID3D11Device *device, video_capture *vc
 	filename[13] = L'-';
 	filename[16] = L'-';
 	filename[19] = L'\0';
+	BOGStringCatW(filename, suffix);
 	BOGStringCatW(filename, L".mp4\0");
 	
 	wchar_t *literalPath = LOGS_PATH"\\Recordings\\";
-	wchar_t path[MAX_PATH] = {0};
 	
 	CreateDirectoryRecursivelyW(literalPath);
 	
@@ -598,14 +711,48 @@ static void StartRecording(HWND hWindow, ID3D11Device *device, video_capture *vc
 	CreateDirectoryW(path, 0);
 	BOGStringCatW(path, filename);
 	
+	// previous recording can still be finalizing in same second, its file must not be reused
+	wchar_t *extension = path + BOGStringLengthW(path) - 4;
+	for (u32 n = 2; GetFileAttributesW(path) != INVALID_FILE_ATTRIBUTES; ++n) {
+		wsprintfW(extension, L" (%u).mp4", n);
+	}
+}
+
+static void StartRecording(HWND hWindow, ID3D11Device *device, video_capture *vc, audio_capture *ac) {
+	wchar_t path[MAX_PATH] = {0};
+	RecordingPath(path, L"");
+	
+	// output size can't change in middle of file, governor picks it at start
+	u32 scale = GovernorScale(&gGovernor);
 	encoder_config ec = {
-		.width = vc->rect.right - vc->rect.left,
-		.height = vc->rect.bottom - vc->rect.top,
+		.width = (vc->rect.right - vc->rect.left) * scale / 100,
+		.height = (vc->rect.bottom - vc->rect.top) * scale / 100,
 		.framerateNum = 60,
-		.framerateDen = 1
+		.framerateDen = 1,
+		.videoWait = VIDEO_WAIT,
+		.videoPolicy = VIDEO_QUEUE_POLICY,
+		.constantFramerate = VIDEO_CONSTANT_FRAMERATE,
+		.segmentDuration = RECORD_SEGMENT_DURATION,
+		.segmentSize = RECORD_SEGMENT_SIZE,
+		.replayDuration = gKeepReplay ? RECORD_REPLAY_DURATION : 0,
+		.replayOnly = RECORD_REPLAY_ONLY,
+		.clock = gClock
 	};
 	
-	if (!AudioCaptureStart(ac, AUDIO_CAPTURE_BUFFER_DURATION_100NS)) {
+	if (!AudioCaptureStart(ac, AUDIO_CAPTURE_BUFFER_DURATION_100NS, gAudioPump.event)) {
+		CaptureStop(vc);
+		ID3D11Device_Release(device);
+		return;
+	}
+	
+	// drains nothing until encoder is set
+	audio_pump_config pc = {
+		.drain = DrainCapturedAudio,
+		.user = ac,
+		.timeout = AUDIO_PUMP_TIMEOUT
+	};
+	if (!AudioPumpStart(&gAudioPump, &pc)) {
+		AudioCaptureStop(ac);
 		CaptureStop(vc);
 		ID3D11Device_Release(device);
 		return;
@@ -613,52 +760,100 @@ static void StartRecording(HWND hWindow, ID3D11Device *device, video_capture *vc
 	
 	ec.audioFormat = ac->format;
 	
-	if (!EncoderStart(&gEncoder, device, path, &ec)) {
+	// every recording has its own encoder, previous one may still be finalizing
+	encoder *e = (encoder *) BOGAlloc(sizeof(encoder));
+	if (!e || !EncoderStart(e, device, path, &ec)) {
+		BOGFree(e, sizeof(encoder));
+		AudioPumpStop(&gAudioPump);
 		AudioCaptureStop(ac);
 		CaptureStop(vc);
 		ID3D11Device_Release(device);
 		return;
 	}
 
+	GovernorStart(&gGovernor, TimeClockNow(&gClock));
+
+	SetCurrentEncoder(e);
 	CaptureStart(vc, true, false);
-	SetTimer(hWindow, AUDIO_CAPTURE_TIMER, AUDIO_CAPTURE_INTERVAL, 0);
 	SetTimer(hWindow, VIDEO_UPDATE_TIMER, VIDEO_UPDATE_INTERVAL, 0);
 	ID3D11Device_Release(device);
+	
+	// only first start after stop is timed against it
+	if (gStopTime) {
+		LogTiming(L"recording started after stop", TimeClockNow(&gClock) - gStopTime);
+		gStopTime = 0;
+	}
 }
 
-static void EncodeCapturedAudio(audio_capture *ac) {
-	if (!gEncoder.startTime) return;
+// runs on finalizer thread, nothing else references encoder anymore
+static void FinishRecording(void *data) {
+	encoder *e = (encoder *) data;
 	
-	audio_capture_data data;
-	while (AudioCaptureGetData(ac, &data, gEncoder.startTime)) {
-		u32 framesToEncode = (u32) data.count;
-		if (data.time < gEncoder.startTime) {
-			u32 sampleRate = ac->format->nSamplesPerSec;
-			u32 bytesPerFrame = ac->format->nBlockAlign;
+	// media foundation & D3D11 objects are free threaded, this thread just needs COM
+	CoInitializeEx(0, COINIT_MULTITHREADED);
+	if (!EncoderStop(e)) {
+		wchar_t text[128];
+		wsprintfW(text, L"recording not fully written, %u samples rejected\n", e->sink.rejected);
+		OutputDebugStringW(text);
+	}
+	
+	// disk fell behind, recording has gaps there & continues from next IDR frame
+	if (e->sink.segment.droppedFragments) {
+		wchar_t text[128];
+		wsprintfW(text, L"recording output full, %u fragments dropped\n",
+				  e->sink.segment.droppedFragments);
+		OutputDebugStringW(text);
+	}
+	CoUninitialize();
+	
+	LogTiming(L"recording finalized after stop", TimeClockNow(&gClock) - e->stopTime);
+	
+	BOGFree(e, sizeof(encoder));
+}
 
-			// figure out how much time (100nsec units) and frame count to skip from current buffer
-			u64 timeToSkip = gEncoder.startTime - data.time;
-			u32 framesToSkip = (u32) ((timeToSkip * sampleRate - 1) / MF_UNITS_PER_SECOND + 1);
-			if (framesToSkip < framesToEncode) {
-				// need to skip part of captured data
-				data.time += framesToSkip * MF_UNITS_PER_SECOND / sampleRate;
-				framesToEncode -= framesToSkip;
-				if (data.samples) data.samples = (BYTE *) data.samples + framesToSkip * bytesPerFrame;
-			} else {
-				// need to skip all of captured data
-				framesToEncode = 0;
-			}
-		}
-		if (framesToEncode) {
-			EncoderNewSamples(&gEncoder, data.samples, framesToEncode, data.time, gTickFreq.QuadPart);
-		}
-		
-		AudioCaptureReleaseData(ac, &data);
+typedef struct {
+	encoder *e;
+	wchar_t path[MAX_PATH];
+} replay_save;
+
+// runs on finalizer thread, stop of recording is queued after it so encoder is still there
+static void SaveReplay(void *data) {
+	replay_save *save = (replay_save *) data;
+	u64 start = TimeClockNow(&gClock);
+	bool saved = EncoderSaveReplay(save->e, save->path);
+	
+	wchar_t text[MAX_PATH + 64];
+	wsprintfW(text, L"replay %s: %s\n", saved ? L"saved" : L"not saved", save->path);
+	OutputDebugStringW(text);
+	LogTiming(L"replay written", TimeClockNow(&gClock) - start);
+	
+	BOGFree(save, sizeof(replay_save));
+}
+
+// last RECORD_REPLAY_DURATION of current recording goes to its own file, recording continues
+static void SaveRecordingReplay(HWND hwnd) {
+	encoder *e = CurrentEncoder();
+	if (e && !e->sink.config.replayDuration) {
+		ShowTrayMessage(hwnd, NIIF_INFO, L"Replay is only kept with Keep Replay turned on");
+		return;
+	}
+	
+	replay_save *save = e ? (replay_save *) BOGAlloc(sizeof(replay_save)) : 0;
+	if (!save) {
+		ShowTrayMessage(hwnd, NIIF_INFO, L"Replay is only kept while recording");
+		return;
 	}
+	
+	save->e = e;
+	RecordingPath(save->path, L" replay");
+	FinalizerSubmit(&gFinalizer, SaveReplay, save);
 }
 
 static void StopRecording(HWND hwnd, audio_capture *ac, video_capture *vc) {
-	KillTimer(hwnd, AUDIO_CAPTURE_TIMER);
+	u64 start = TimeClockNow(&gClock);
+	
+	// pump is done with capture & encoder, rest of audio is drained here
+	AudioPumpStop(&gAudioPump);
 	AudioCaptureFlush(ac);
 	EncodeCapturedAudio(ac);
 	AudioCaptureStop(ac);
@@ -666,10 +861,57 @@ static void StopRecording(HWND hwnd, audio_capture *ac, video_capture *vc) {
 	KillTimer(hwnd, VIDEO_UPDATE_TIMER);
 
 	CaptureStop(vc);
-	EncoderStop(&gEncoder);
+	
+	// finalizing file can take seconds, new recording can start meanwhile
+	encoder *e = CurrentEncoder();
+	SetCurrentEncoder(0);
+	if (e) {
+		buffer_pool *pool = &e->videoPool;
+		wchar_t text[128];
+		wsprintfW(text, L"video buffers: %u (%u MB), at most %u, %u frames dropped\n", pool->count,
+				  (u32) (PoolMemory(pool) >> 20), pool->maxUsed, pool->drops);
+		OutputDebugStringW(text);
+		
+		wsprintfW(text, L"video queue: %u frames dropped\n", e->videoQueueDrops);
+		OutputDebugStringW(text);
+		
+		wsprintfW(text, L"audio frames dropped: %u\n", (u32) e->audioDropped);
+		OutputDebugStringW(text);
+		
+		governor *g = &gGovernor;
+		wsprintfW(text, L"frame rate: %u fps, lowest %u fps, %u switches, next size %u%%\n",
+				  GovernorFramerate(g), g->config.framerate[g->lowestRate], g->switches,
+				  GovernorScale(g));
+		OutputDebugStringW(text);
+		
+		if (e->constantFramerate) {
+			wsprintfW(text, L"constant frame rate: %u frames, %u repeated, %u dropped\n",
+					  (u32) e->pacer.frames, (u32) e->pacer.duplicates, (u32) e->pacer.dropped);
+			OutputDebugStringW(text);
+		}
+		
+		if (e->audioDriftStarted) {
+			// device clock against QPC, positive when device is faster
+			drift *d = &e->audioDrift;
+			wsprintfW(text, L"audio drift: %d ppm, %d frames corrected, %u silence, %u trimmed, "
+					  L"%u discontinuities\n", (s32) ((1 / DriftRatio(d) - 1) * 1000000),
+					  (s32) d->corrected, (u32) d->silenced, (u32) d->trimmed, d->discontinuities);
+			OutputDebugStringW(text);
+		}
+		
+		wsprintfW(text, L"audio pump: %u wakeups, %u timeouts\n", gAudioPump.wakeups,
+				  gAudioPump.timeouts);
+		OutputDebugStringW(text);
+		
+		e->stopTime = start;
+		FinalizerSubmit(&gFinalizer, FinishRecording, e);
+	}
 	
 	SetWindowPos(hwnd, HWND_NOTOPMOST, 0, 0, 0, 0, SWP_HIDEWINDOW | SWP_NOMOVE | SWP_NOSIZE);
 	SetWindowLongW(hwnd, GWL_EXSTYLE, 0);
+	
+	gStopTime = start;
+	LogTiming(L"recording stopped", TimeClockNow(&gClock) - start);
 }
 
 static ID3D11Device * CreateDevice() {
@@ -734,16 +976,35 @@ static void CaptureScreen(HWND hWindow, video_capture *vc, audio_capture *ac) {
 }
 
 static void OnCaptureFrame(ID3D11Texture2D *texture, RECT rect, u64 time) {
+	encoder *e = CurrentEncoder();
+	if (!e) return;
+	
+	// capture gives QPC time in 100nsec units
+	time = TimeConvert(time, TIME_RATE_MF, gClock.rate, TIME_NEAREST);
+	
 	bool doEncode = true;
-	DWORD limitFramerate = 60;
-	if (time * limitFramerate < gEncoder.nextEncode) {
+	DWORD limitFramerate = GovernorFramerate(&gGovernor);
+	if (time * limitFramerate < e->nextEncode) {
 		doEncode = false;
 	} else {
-		if (!gEncoder.nextEncode) gEncoder.nextEncode = time * limitFramerate;
-		gEncoder.nextEncode += gTickFreq.QuadPart;
+		if (!e->nextEncode) e->nextEncode = time * limitFramerate;
+		e->nextEncode += TimeConvert(1, TIME_RATE_SECOND, gClock.rate, TIME_NEAREST);
 	}
 	
-	if (doEncode) EncoderNewFrame(&gEncoder, texture, rect, time, gTickFreq.QuadPart);
+	if (doEncode) {
+		u64 start = TimeClockNow(&gClock);
+		EncoderNewFrame(e, texture, rect, time);
+		u64 end = TimeClockNow(&gClock);
+		
+		governor_sample sample = {
+			.queued = PoolInFlight(&e->videoPool),
+			.drops = e->videoPool.drops + (u32) e->videoQueueDrops,
+			.work = end - start
+		};
+		
+		// limiter counts in units of frame rate, it starts over with new one
+		if (GovernorFrame(&gGovernor, &sample, end)) e->nextEncode = 0;
+	}
 }
 
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -778,6 +1039,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			
 			hMenu = CreatePopupMenu();
 			AppendMenu(hMenu, MF_STRING, CMD_RECORD, "Screen Record");
+			AppendMenu(hMenu, MF_STRING, CMD_SAVE_REPLAY, "Save Replay");
+			AppendMenu(hMenu, MF_STRING, CMD_KEEP_REPLAY, "Keep Replay");
 			AppendMenu(hMenu, MF_SEPARATOR, 0, 0);
 			AppendMenu(hMenu, MF_STRING, CMD_KEYS, "Log Keys");
 			AppendMenu(hMenu, MF_SEPARATOR, 0, 0);
@@ -787,11 +1050,28 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			
 			clipboardViewer = SetClipboardViewer(hwnd);
 			
-			QueryPerformanceFrequency(&gTickFreq);
+			TimeClockSystem(&gClock);
+			
+			// frame rate steps down as soon as encoder falls behind, size only for next recording
+			governor_config gc = {
+				.framerate = {60, 50, 40, 30, 24, 20, 15},
+				.rateCount = 7,
+				.scale = {100, 75, 50},
+				.scaleCount = 3,
+				.frequency = TimeConvert(1, TIME_RATE_SECOND, gClock.rate, TIME_NEAREST),
+				.window = TimeConvert(500, TIME_RATE_MSEC, gClock.rate, TIME_NEAREST),
+				.queueHigh = ENCODER_VIDEO_BUFFER_MAX / 2,
+				.busy = 80,
+				.hold = 4,
+				.maxHold = 64
+			};
+			GovernorCreate(&gGovernor, &gc);
 			
 			CoInitializeEx(0, COINIT_APARTMENTTHREADED);
 			CaptureInit(&vc, OnCaptureFrame);
-			EncoderInit(&gEncoder);
+			EncoderInit();
+			FinalizerCreate(&gFinalizer);
+			AudioPumpCreate(&gAudioPump);
 		} break;
 		
 		case WM_APP_CLICKED: {
@@ -829,6 +1109,16 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 					}
 				} break;
 				
+				case CMD_SAVE_REPLAY: {
+					SaveRecordingReplay(hwnd);
+				} break;
+				
+				// memory for replay is taken when next recording starts
+				case CMD_KEEP_REPLAY: {
+					gKeepReplay = !gKeepReplay;
+					CheckMenuItem(hMenu, CMD_KEEP_REPLAY, gKeepReplay ? MF_CHECKED : MF_UNCHECKED);
+				} break;
+				
 				case CMD_KEYS: {
 					u32 state = GetMenuState(hMenu, CMD_KEYS, MF_BYCOMMAND);
 					switch (state) {
@@ -944,6 +1234,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 					SendMessage(hwnd, WM_COMMAND, MAKEWPARAM(CMD_RECORD, 0), 0);
 				} break;
 				
+				case ID_SAVE_REPLAY_SHORTCUT: {
+					SendMessage(hwnd, WM_COMMAND, MAKEWPARAM(CMD_SAVE_REPLAY, 0), 0);
+				} break;
+				
 				case ID_KEYS_SHORTCUT: {
 					SendMessage(hwnd, WM_COMMAND, MAKEWPARAM(CMD_KEYS, 0), 0);
 				} break;
@@ -961,20 +1255,18 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 		case WM_TIMER: {
 			if (record) {
 				switch (wParam) {
-					case AUDIO_CAPTURE_TIMER: {
-						EncodeCapturedAudio(&ac);
-					} break;
-						
 					case VIDEO_UPDATE_TIMER: {
-						LARGE_INTEGER time;
-						QueryPerformanceCounter(&time);
-						EncoderUpdate(&gEncoder, time.QuadPart, gTickFreq.QuadPart);
+						encoder *e = CurrentEncoder();
+						if (e) EncoderUpdate(e, TimeClockNow(&gClock));
 					} break;
 				}
 			}
 		} break;
 		
 		case WM_DESTROY: {
+			// files of stopped recordings are only valid once finalized
+			FinalizerDestroy(&gFinalizer);
+			AudioPumpDestroy(&gAudioPump);
 			ChangeClipboardChain(hwnd, clipboardViewer);
 			RemoveTrayIcon(hwnd);
 			PostQuitMessage(0);
@@ -0,0 +1,869 @@
+#include "mp4.h"
+
+#include <string.h>
+
+// sample_depends_on = 2 for sync samples, sample_is_non_sync_sample for rest
+#define MP4_FLAGS_SYNC     0x02000000
+#define MP4_FLAGS_NON_SYNC 0x01010000
+
+// tfhd & trun flags
+#define MP4_TFHD_DURATION      0x000008
+#define MP4_TFHD_SIZE          0x000010
+#define MP4_TFHD_FLAGS         0x000020
+#define MP4_TFHD_BASE_IS_MOOF  0x020000
+#define MP4_TRUN_DATA_OFFSET   0x000001
+#define MP4_TRUN_FIRST_FLAGS   0x000004
+#define MP4_TRUN_DURATION      0x000100
+#define MP4_TRUN_SIZE          0x000200
+#define MP4_TRUN_FLAGS         0x000400
+#define MP4_TRUN_OFFSET        0x000800
+
+// box writing, everything is big endian, size of box is patched when it ends
+
+static void Mp4Put(mp4_muxer *m, const void *data, udm size) {
+	if (m->boxSize + size > m->boxCapacity) {
+		m->failed = true;
+		return;
+	}
+
+	memcpy(m->box + m->boxSize, data, size);
+	m->boxSize += size;
+}
+
+static void Mp4U8(mp4_muxer *m, u32 value) {
+	u8 bytes[1] = { (u8) value };
+	Mp4Put(m, bytes, sizeof(bytes));
+}
+
+static void Mp4U16(mp4_muxer *m, u32 value) {
+	u8 bytes[2] = { (u8) (value >> 8), (u8) value };
+	Mp4Put(m, bytes, sizeof(bytes));
+}
+
+static void Mp4U24(mp4_muxer *m, u32 value) {
+	u8 bytes[3] = { (u8) (value >> 16), (u8) (value >> 8), (u8) value };
+	Mp4Put(m, bytes, sizeof(bytes));
+}
+
+static void Mp4U32(mp4_muxer *m, u32 value) {
+	u8 bytes[4] = { (u8) (value >> 24), (u8) (value >> 16), (u8) (value >> 8), (u8) value };
+	Mp4Put(m, bytes, sizeof(bytes));
+}
+
+static void Mp4U64(mp4_muxer *m, u64 value) {
+	Mp4U32(m, (u32) (value >> 32));
+	Mp4U32(m, (u32) value);
+}
+
+static void Mp4Zeros(mp4_muxer *m, u32 count) {
+	for (u32 i = 0; i < count; ++i) Mp4U8(m, 0);
+}
+
+static void Mp4Patch32(mp4_muxer *m, udm at, u32 value) {
+	if (m->failed) return;
+
+	m->box[at + 0] = (u8) (value >> 24);
+	m->box[at + 1] = (u8) (value >> 16);
+	m->box[at + 2] = (u8) (value >> 8);
+	m->box[at + 3] = (u8) value;
+}
+
+// returns offset of box, pass it to Mp4BoxEnd
+static udm Mp4Box(mp4_muxer *m, const char *type) {
+	udm start = m->boxSize;
+	Mp4U32(m, 0);
+	Mp4Put(m, type, 4);
+	return start;
+}
+
+static udm Mp4FullBox(mp4_muxer *m, const char *type, u32 version, u32 flags) {
+	udm start = Mp4Box(m, type);
+	Mp4U8(m, version);
+	Mp4U24(m, flags);
+	return start;
+}
+
+static void Mp4BoxEnd(mp4_muxer *m, udm start) {
+	Mp4Patch32(m, start, (u32) (m->boxSize - start));
+}
+
+static void Mp4Matrix(mp4_muxer *m) {
+	static const u32 identity[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+	for (u32 i = 0; i < 9; ++i) Mp4U32(m, identity[i]);
+}
+
+// H.264 Annex B parsing
+
+// returns position of next 00 00 01 start code, or end if there is none
+static const u8 *Mp4FindStartCode(const u8 *p, const u8 *end) {
+	while (p + 3 <= end) {
+		if (p[2] > 1) {
+			p += 3;
+		} else if (p[2] == 0) {
+			p++;
+		} else if (p[0] == 0 && p[1] == 0) {
+			return p;
+		} else {
+			p += 3;
+		}
+	}
+
+	return end;
+}
+
+// returns next NAL unit without start code & trailing zeros, or 0 at end of access unit
+static const u8 *Mp4NextNal(const u8 **at, const u8 *end, u32 *size) {
+	const u8 *start = Mp4FindStartCode(*at, end);
+	if (start == end) return 0;
+
+	start += 3;
+	const u8 *next = Mp4FindStartCode(start, end);
+	*at = next;
+
+	// zero byte of next 4 byte start code belongs to it
+	const u8 *last = next;
+	while (last > start && last[-1] == 0) --last;
+
+	*size = (u32) (last - start);
+	return start;
+}
+
+// upper bound of Mp4CopyNals output, 3 byte start codes grow to 4 byte lengths
+static u32 Mp4CopyNalsBound(u32 size) {
+	return size + size / 3 + 4;
+}
+
+// copies Annex B access unit as NAL units prefixed with 4 byte size, dst must fit bound size
+static u32 Mp4CopyNals(u8 *dst, const u8 *src, u32 size) {
+	const u8 *at = src;
+	const u8 *end = src + size;
+	u8 *out = dst;
+	u32 nalSize;
+
+	for (const u8 *nal; (nal = Mp4NextNal(&at, end, &nalSize)) != 0; ) {
+		// access unit delimiters are not used in MP4
+		if (!nalSize || (nal[0] & 0x1f) == 9) continue;
+
+		out[0] = (u8) (nalSize >> 24);
+		out[1] = (u8) (nalSize >> 16);
+		out[2] = (u8) (nalSize >> 8);
+		out[3] = (u8) nalSize;
+		memcpy(out + 4, nal, nalSize);
+		out += 4 + nalSize;
+	}
+
+	return (u32) (out - dst);
+}
+
+// reads bits of SPS, skipping emulation prevention bytes
+typedef struct {
+	const u8 *p, *end;
+	u32 zeros;
+	u32 byte;
+	u32 bits;
+} mp4_bits;
+
+static u32 Mp4ReadBit(mp4_bits *b) {
+	if (!b->bits) {
+		if (b->p == b->end) return 0;
+
+		u32 byte = *b->p++;
+		if (b->zeros >= 2 && byte == 3) {
+			if (b->p == b->end) return 0;
+			byte = *b->p++;
+			b->zeros = 0;
+		}
+
+		b->zeros = byte ? 0 : b->zeros + 1;
+		b->byte = byte;
+		b->bits = 8;
+	}
+
+	b->bits--;
+	return (b->byte >> b->bits) & 1;
+}
+
+static u32 Mp4ReadGolomb(mp4_bits *b) {
+	u32 zeros = 0;
+	while (!Mp4ReadBit(b) && zeros < 31) zeros++;
+
+	u32 value = 0;
+	for (u32 i = 0; i < zeros; ++i) value = (value << 1) | Mp4ReadBit(b);
+
+	return (1u << zeros) - 1 + value;
+}
+
+// builds avcC box contents from first SPS & PPS in Annex B data
+static bool Mp4ConfigH264(mp4_track *t, const u8 *data, u32 size) {
+	const u8 *sps = 0, *pps = 0;
+	u32 spsSize = 0, ppsSize = 0;
+
+	const u8 *at = data;
+	const u8 *end = data + size;
+	u32 nalSize;
+
+	for (const u8 *nal; (nal = Mp4NextNal(&at, end, &nalSize)) != 0; ) {
+		if (!nalSize) continue;
+
+		u32 type = nal[0] & 0x1f;
+		if (type == 7 && !sps) {
+			sps = nal;
+			spsSize = nalSize;
+		} else if (type == 8 && !pps) {
+			pps = nal;
+			ppsSize = nalSize;
+		}
+	}
+
+	if (!sps || !pps || spsSize < 4 || 8 + spsSize + 3 + ppsSize + 4 > MP4_MAX_CONFIG) return false;
+
+	u32 profile = sps[1];
+	u8 *c = t->config;
+	*c++ = 1; // configurationVersion
+	*c++ = (u8) profile;
+	*c++ = sps[2];
+	*c++ = sps[3];
+	*c++ = 0xfc | 3; // 4 byte NAL unit sizes
+	*c++ = 0xe0 | 1;
+	*c++ = (u8) (spsSize >> 8);
+	*c++ = (u8) spsSize;
+	memcpy(c, sps, spsSize);
+	c += spsSize;
+	*c++ = 1;
+	*c++ = (u8) (ppsSize >> 8);
+	*c++ = (u8) ppsSize;
+	memcpy(c, pps, ppsSize);
+	c += ppsSize;
+
+	// high profiles also describe chroma format & bit depth, they follow seq_parameter_set_id
+	if (profile == 100 || profile == 110 || profile == 122 || profile == 144 || profile == 244) {
+		mp4_bits b = { sps + 4, sps + spsSize, 0, 0, 0 };
+		Mp4ReadGolomb(&b);
+
+		u32 chroma = Mp4ReadGolomb(&b);
+		if (chroma == 3) Mp4ReadBit(&b);
+		u32 depthLuma = Mp4ReadGolomb(&b);
+		u32 depthChroma = Mp4ReadGolomb(&b);
+
+		*c++ = (u8) (0xfc | (chroma & 3));
+		*c++ = (u8) (0xf8 | (depthLuma & 7));
+		*c++ = (u8) (0xf8 | (depthChroma & 7));
+		*c++ = 0; // no SPS extensions
+	}
+
+	t->configSize = (u32) (c - t->config);
+	return true;
+}
+
+// header
+
+static void Mp4SampleEntry(mp4_muxer *m, mp4_track *t) {
+	switch (t->codec) {
+		case MP4_CODEC_H264: {
+			udm avc1 = Mp4Box(m, "avc1");
+			Mp4Zeros(m, 6);
+			Mp4U16(m, 1); // data_reference_index
+			Mp4Zeros(m, 16);
+			Mp4U16(m, t->width);
+			Mp4U16(m, t->height);
+			Mp4U32(m, 0x00480000); // 72 dpi
+			Mp4U32(m, 0x00480000);
+			Mp4U32(m, 0);
+			Mp4U16(m, 1); // frame_count
+			Mp4Zeros(m, 32); // compressorname
+			Mp4U16(m, 0x18); // depth
+			Mp4U16(m, 0xffff);
+
+			udm avcC = Mp4Box(m, "avcC");
+			Mp4Put(m, t->config, t->configSize);
+			Mp4BoxEnd(m, avcC);
+			Mp4BoxEnd(m, avc1);
+		} break;
+
+		case MP4_CODEC_AAC:
+		case MP4_CODEC_FLAC: {
+			udm entry = Mp4Box(m, t->codec == MP4_CODEC_AAC ? "mp4a" : "fLaC");
+			Mp4Zeros(m, 6);
+			Mp4U16(m, 1); // data_reference_index
+			Mp4Zeros(m, 8);
+			Mp4U16(m, t->channels);
+			Mp4U16(m, 16); // samplesize
+			Mp4U32(m, 0);
+			Mp4U32(m, t->sampleRate < 0x10000 ? t->sampleRate << 16 : 0);
+
+			if (t->codec == MP4_CODEC_AAC) {
+				// ES_Descriptor > DecoderConfigDescriptor > DecoderSpecificInfo, SLConfigDescriptor
+				udm esds = Mp4FullBox(m, "esds", 0, 0);
+				Mp4U8(m, 3);
+				Mp4U8(m, 3 + 2 + 13 + 2 + t->configSize + 3);
+				Mp4U16(m, 0); // ES_ID
+				Mp4U8(m, 0);
+				Mp4U8(m, 4);
+				Mp4U8(m, 13 + 2 + t->configSize);
+				Mp4U8(m, 0x40); // MPEG-4 audio
+				Mp4U8(m, 0x15); // audio stream
+				Mp4U24(m, 0);   // bufferSizeDB
+				Mp4U32(m, 0);   // maxBitrate
+				Mp4U32(m, 0);   // avgBitrate
+				Mp4U8(m, 5);
+				Mp4U8(m, t->configSize);
+				Mp4Put(m, t->config, t->configSize);
+				Mp4U8(m, 6);
+				Mp4U8(m, 1);
+				Mp4U8(m, 2);
+				Mp4BoxEnd(m, esds);
+			} else {
+				// single metadata block, last one & STREAMINFO type
+				udm dfLa = Mp4FullBox(m, "dfLa", 0, 0);
+				Mp4U8(m, 0x80);
+				Mp4U24(m, t->configSize);
+				Mp4Put(m, t->config, t->configSize);
+				Mp4BoxEnd(m, dfLa);
+			}
+
+			Mp4BoxEnd(m, entry);
+		} break;
+
+		default: {
+			m->failed = true;
+		} break;
+	}
+}
+
+static void Mp4Track(mp4_muxer *m, u32 index) {
+	mp4_track *t = &m->tracks[index];
+	bool video = t->codec == MP4_CODEC_H264;
+
+	udm trak = Mp4Box(m, "trak");
+
+	udm tkhd = Mp4FullBox(m, "tkhd", 0, 3); // enabled & in movie
+	Mp4U32(m, 0); // creation_time
+	Mp4U32(m, 0); // modification_time
+	Mp4U32(m, index + 1);
+	Mp4U32(m, 0);
+	Mp4U32(m, 0); // duration is unknown, fragments tell it
+	Mp4Zeros(m, 8);
+	Mp4U16(m, 0); // layer
+	Mp4U16(m, 0); // alternate_group
+	Mp4U16(m, video ? 0 : 0x0100);
+	Mp4U16(m, 0);
+	Mp4Matrix(m);
+	Mp4U32(m, video ? t->width << 16 : 0);
+	Mp4U32(m, video ? t->height << 16 : 0);
+	Mp4BoxEnd(m, tkhd);
+
+	udm mdia = Mp4Box(m, "mdia");
+
+	udm mdhd = Mp4FullBox(m, "mdhd", 0, 0);
+	Mp4U32(m, 0);
+	Mp4U32(m, 0);
+	Mp4U32(m, t->timescale);
+	Mp4U32(m, 0);
+	Mp4U16(m, 0x55c4); // "und" language
+	Mp4U16(m, 0);
+	Mp4BoxEnd(m, mdhd);
+
+	udm hdlr = Mp4FullBox(m, "hdlr", 0, 0);
+	Mp4U32(m, 0);
+	Mp4Put(m, video ? "vide" : "soun", 4);
+	Mp4Zeros(m, 12);
+	Mp4Put(m, video ? "Video" : "Audio", 6);
+	Mp4BoxEnd(m, hdlr);
+
+	udm minf = Mp4Box(m, "minf");
+
+	if (video) {
+		udm vmhd = Mp4FullBox(m, "vmhd", 0, 1);
+		Mp4Zeros(m, 8);
+		Mp4BoxEnd(m, vmhd);
+	} else {
+		udm smhd = Mp4FullBox(m, "smhd", 0, 0);
+		Mp4Zeros(m, 4);
+		Mp4BoxEnd(m, smhd);
+	}
+
+	udm dinf = Mp4Box(m, "dinf");
+	udm dref = Mp4FullBox(m, "dref", 0, 0);
+	Mp4U32(m, 1);
+	udm url = Mp4FullBox(m, "url ", 0, 1); // samples are in same file
+	Mp4BoxEnd(m, url);
+	Mp4BoxEnd(m, dref);
+	Mp4BoxEnd(m, dinf);
+
+	// sample tables are empty, all samples are in fragments
+	udm stbl = Mp4Box(m, "stbl");
+	udm stsd = Mp4FullBox(m, "stsd", 0, 0);
+	Mp4U32(m, 1);
+	Mp4SampleEntry(m, t);
+	Mp4BoxEnd(m, stsd);
+
+	const char *empty[] = { "stts", "stsc", "stco" };
+	for (u32 i = 0; i < 3; ++i) {
+		udm box = Mp4FullBox(m, empty[i], 0, 0);
+		Mp4U32(m, 0);
+		Mp4BoxEnd(m, box);
+	}
+
+	udm stsz = Mp4FullBox(m, "stsz", 0, 0);
+	Mp4U32(m, 0);
+	Mp4U32(m, 0);
+	Mp4BoxEnd(m, stsz);
+
+	Mp4BoxEnd(m, stbl);
+	Mp4BoxEnd(m, minf);
+	Mp4BoxEnd(m, mdia);
+	Mp4BoxEnd(m, trak);
+}
+
+static void Mp4Header(mp4_muxer *m) {
+	udm ftyp = Mp4Box(m, "ftyp");
+	Mp4Put(m, "iso6", 4);
+	Mp4U32(m, 0);
+	Mp4Put(m, "iso6isommp41avc1", 16);
+	Mp4BoxEnd(m, ftyp);
+
+	udm moov = Mp4Box(m, "moov");
+
+	udm mvhd = Mp4FullBox(m, "mvhd", 0, 0);
+	Mp4U32(m, 0); // creation_time
+	Mp4U32(m, 0); // modification_time
+	Mp4U32(m, 1000);
+	Mp4U32(m, 0); // duration
+	Mp4U32(m, 0x00010000); // rate
+	Mp4U16(m, 0x0100); // volume
+	Mp4Zeros(m, 10);
+	Mp4Matrix(m);
+	Mp4Zeros(m, 24);
+	Mp4U32(m, m->trackCount + 1); // next_track_ID
+	Mp4BoxEnd(m, mvhd);
+
+	for (u32 i = 0; i < m->trackCount; ++i) Mp4Track(m, i);
+
+	udm mvex = Mp4Box(m, "mvex");
+	for (u32 i = 0; i < m->trackCount; ++i) {
+		udm trex = Mp4FullBox(m, "trex", 0, 0);
+		Mp4U32(m, i + 1);
+		Mp4U32(m, 1); // default_sample_description_index
+		Mp4U32(m, 0);
+		Mp4U32(m, 0);
+		Mp4U32(m, 0);
+		Mp4BoxEnd(m, trex);
+	}
+	Mp4BoxEnd(m, mvex);
+
+	Mp4BoxEnd(m, moov);
+}
+
+// fragments
+
+static void Mp4AddRun(mp4_run *runs, u32 *count, u32 value) {
+	if (*count && runs[*count - 1].value == value) {
+		runs[*count - 1].count++;
+	} else {
+		runs[*count].count = 1;
+		runs[*count].value = value;
+		(*count)++;
+	}
+}
+
+// returns value of next sample & advances to it
+static u32 Mp4NextRun(const mp4_run *runs, u32 *run, u32 *used) {
+	u32 value = runs[*run].value;
+	if (++*used == runs[*run].count) {
+		++*run;
+		*used = 0;
+	}
+	return value;
+}
+
+// moves pending sample to end of fragment
+static void Mp4Commit(mp4_track *t, u64 duration) {
+	u32 sampleDuration = duration > 0xffffffff ? 0xffffffff : (u32) duration;
+
+	t->sizes[t->sampleCount++] = t->pendingSize;
+	Mp4AddRun(t->durations, &t->durationRuns, sampleDuration);
+	Mp4AddRun(t->flags, &t->flagRuns, t->pendingSync ? MP4_FLAGS_SYNC : MP4_FLAGS_NON_SYNC);
+	Mp4AddRun(t->offsets, &t->offsetRuns, (u32) t->pendingOffset);
+
+	t->dataSize += t->pendingSize;
+	t->duration += sampleDuration;
+	t->lastDuration = sampleDuration;
+	t->pending = false;
+}
+
+// writes traf & returns offset of trun data_offset, it is patched once moof size is known
+static udm Mp4Traf(mp4_muxer *m, u32 index) {
+	mp4_track *t = &m->tracks[index];
+
+	bool sameSize = true;
+	for (u32 i = 1; i < t->sampleCount; ++i) {
+		if (t->sizes[i] != t->sizes[0]) sameSize = false;
+	}
+
+	bool sameDuration = t->durationRuns == 1;
+	bool sameFlags = t->flagRuns == 1;
+	bool firstFlags = t->flagRuns == 2 && t->flags[0].count == 1;
+	bool noOffsets = t->offsetRuns == 1 && t->offsets[0].value == 0;
+
+	udm traf = Mp4Box(m, "traf");
+
+	u32 tfhdFlags = MP4_TFHD_BASE_IS_MOOF;
+	if (sameDuration) tfhdFlags |= MP4_TFHD_DURATION;
+	if (sameSize) tfhdFlags |= MP4_TFHD_SIZE;
+	if (sameFlags || firstFlags) tfhdFlags |= MP4_TFHD_FLAGS;
+
+	udm tfhd = Mp4FullBox(m, "tfhd", 0, tfhdFlags);
+	Mp4U32(m, index + 1);
+	if (sameDuration) Mp4U32(m, t->durations[0].value);
+	if (sameSize) Mp4U32(m, t->sizes[0]);
+	if (sameFlags) Mp4U32(m, t->flags[0].value);
+	if (firstFlags) Mp4U32(m, t->flags[1].value);
+	Mp4BoxEnd(m, tfhd);
+
+	udm tfdt = Mp4FullBox(m, "tfdt", 1, 0);
+	Mp4U64(m, t->decodeTime);
+	Mp4BoxEnd(m, tfdt);
+
+	u32 trunFlags = MP4_TRUN_DATA_OFFSET;
+	if (firstFlags) trunFlags |= MP4_TRUN_FIRST_FLAGS;
+	if (!sameDuration) trunFlags |= MP4_TRUN_DURATION;
+	if (!sameSize) trunFlags |= MP4_TRUN_SIZE;
+	if (!sameFlags && !firstFlags) trunFlags |= MP4_TRUN_FLAGS;
+	if (!noOffsets) trunFlags |= MP4_TRUN_OFFSET;
+
+	// version 1 has signed composition offsets
+	udm trun = Mp4FullBox(m, "trun", 1, trunFlags);
+	Mp4U32(m, t->sampleCount);
+	udm dataOffset = m->boxSize;
+	Mp4U32(m, 0);
+	if (firstFlags) Mp4U32(m, t->flags[0].value);
+
+	u32 durationRun = 0, durationUsed = 0;
+	u32 flagRun = 0, flagUsed = 0;
+	u32 offsetRun = 0, offsetUsed = 0;
+
+	for (u32 i = 0; i < t->sampleCount; ++i) {
+		u32 duration = Mp4NextRun(t->durations, &durationRun, &durationUsed);
+		u32 flags = Mp4NextRun(t->flags, &flagRun, &flagUsed);
+		u32 offset = Mp4NextRun(t->offsets, &offsetRun, &offsetUsed);
+
+		if (trunFlags & MP4_TRUN_DURATION) Mp4U32(m, duration);
+		if (trunFlags & MP4_TRUN_SIZE) Mp4U32(m, t->sizes[i]);
+		if (trunFlags & MP4_TRUN_FLAGS) Mp4U32(m, flags);
+		if (trunFlags & MP4_TRUN_OFFSET) Mp4U32(m, offset);
+	}
+
+	Mp4BoxEnd(m, trun);
+	Mp4BoxEnd(m, traf);
+
+	return dataOffset;
+}
+
+static bool Mp4Output(mp4_muxer *m, const void *data, udm size) {
+	if (!m->failed && size && !m->write(m->user, data, size)) m->failed = true;
+	return !m->failed;
+}
+
+// fragment & pending samples are gone, so decoding can only go on from next sync sample
+static bool Mp4Drop(mp4_muxer *m) {
+	m->droppedFragments++;
+	for (u32 i = 0; i < m->trackCount; ++i) {
+		mp4_track *t = &m->tracks[i];
+		m->droppedSamples += t->sampleCount + t->pending;
+
+		t->decodeTime += t->duration;
+		t->duration = 0;
+		t->sampleCount = 0;
+		t->durationRuns = 0;
+		t->flagRuns = 0;
+		t->offsetRuns = 0;
+		t->dataSize = 0;
+		t->pending = false;
+	}
+
+	m->skipping = true;
+	return true;
+}
+
+// writes all committed samples as one moof + mdat, pending samples stay for next fragment
+static bool Mp4Flush(mp4_muxer *m) {
+	if (m->failed) return false;
+
+	bool ready = true;
+	u32 dataSize = 0;
+
+	for (u32 i = 0; i < m->trackCount; ++i) {
+		if (!m->tracks[i].ready) ready = false;
+		dataSize += m->tracks[i].dataSize;
+	}
+
+	if (!m->headerWritten && ready && dataSize) {
+		m->boxSize = 0;
+		Mp4Header(m);
+		if (m->fits && !m->fits(m->user, m->boxSize)) return Mp4Drop(m);
+		if (!Mp4Output(m, m->box, m->boxSize)) return false;
+		m->headerWritten = true;
+	}
+
+	// samples that came before every track knew its config can't be written, moov is missing
+	if (m->headerWritten && dataSize) {
+		udm dataOffsets[MP4_MAX_TRACKS];
+
+		m->boxSize = 0;
+		udm moof = Mp4Box(m, "moof");
+		udm mfhd = Mp4FullBox(m, "mfhd", 0, 0);
+		Mp4U32(m, ++m->sequence);
+		Mp4BoxEnd(m, mfhd);
+
+		for (u32 i = 0; i < m->trackCount; ++i) {
+			if (m->tracks[i].sampleCount) dataOffsets[i] = Mp4Traf(m, i);
+		}
+		Mp4BoxEnd(m, moof);
+
+		// data of tracks follows mdat header in track order
+		u32 offset = (u32) m->boxSize + 8;
+		for (u32 i = 0; i < m->trackCount; ++i) {
+			if (!m->tracks[i].sampleCount) continue;
+			Mp4Patch32(m, dataOffsets[i], offset);
+			offset += m->tracks[i].dataSize;
+		}
+
+		Mp4U32(m, dataSize + 8);
+		Mp4Put(m, "mdat", 4);
+
+		// whole fragment or nothing, file never has part of one
+		if (m->fits && !m->fits(m->user, m->boxSize + dataSize)) return Mp4Drop(m);
+		if (!Mp4Output(m, m->box, m->boxSize)) return false;
+
+		for (u32 i = 0; i < m->trackCount; ++i) {
+			if (!Mp4Output(m, m->tracks[i].data, m->tracks[i].dataSize)) return false;
+		}
+	}
+
+	for (u32 i = 0; i < m->trackCount; ++i) {
+		mp4_track *t = &m->tracks[i];
+
+		if (t->pending) memmove(t->data, t->data + t->dataSize, t->pendingSize);
+
+		t->decodeTime += t->duration;
+		t->duration = 0;
+		t->sampleCount = 0;
+		t->durationRuns = 0;
+		t->flagRuns = 0;
+		t->offsetRuns = 0;
+		t->dataSize = 0;
+	}
+
+	return true;
+}
+
+static bool Mp4Create(mp4_muxer *m, const mp4_track_config *tracks, u32 trackCount,
+					  u32 fragmentDuration, mp4_write *write, void *user) {
+	if (!trackCount || trackCount > MP4_MAX_TRACKS) return false;
+
+	// moof has at most 16 bytes for every sample, rest of boxes are small
+	udm boxCapacity = 4096 + trackCount * (1024 + MP4_MAX_CONFIG + MP4_MAX_SAMPLES * 16);
+	udm tablesSize = MP4_MAX_SAMPLES * (sizeof(u32) + 3 * sizeof(mp4_run));
+
+	m->memorySize = boxCapacity;
+	for (u32 i = 0; i < trackCount; ++i) {
+		const mp4_track_config *c = &tracks[i];
+		if (c->codec >= MP4_CODEC_COUNT || !c->timescale || c->configSize > MP4_MAX_CONFIG) {
+			return false;
+		}
+		// descriptor sizes of esds are single bytes
+		if (c->codec == MP4_CODEC_AAC && (!c->configSize || c->configSize > 64)) return false;
+		if (c->codec == MP4_CODEC_FLAC && c->configSize != 34) return false;
+
+		u32 bufferSize = c->bufferSize ? c->bufferSize : MP4_DEFAULT_BUFFER;
+		m->memorySize += tablesSize + bufferSize;
+	}
+
+	m->memory = BOGAlloc(m->memorySize);
+	if (!m->memory) return false;
+
+	u8 *memory = (u8 *) m->memory;
+	m->box = memory;
+	m->boxSize = 0;
+	m->boxCapacity = boxCapacity;
+	memory += boxCapacity;
+
+	m->primary = 0;
+	for (u32 i = trackCount; i-- > 0; ) {
+		if (tracks[i].codec == MP4_CODEC_H264) m->primary = i;
+	}
+
+	for (u32 i = 0; i < trackCount; ++i) {
+		const mp4_track_config *c = &tracks[i];
+		mp4_track *t = &m->tracks[i];
+
+		t->codec = c->codec;
+		t->timescale = c->timescale;
+		t->width = c->width;
+		t->height = c->height;
+		t->channels = c->channels;
+		t->sampleRate = c->sampleRate;
+		t->configSize = 0;
+
+		if (c->codec == MP4_CODEC_H264) {
+			t->ready = c->configSize && Mp4ConfigH264(t, (const u8 *) c->config, c->configSize);
+		} else {
+			memcpy(t->config, c->config, c->configSize);
+			t->configSize = c->configSize;
+			t->ready = true;
+		}
+
+		t->sizes = (u32 *) memory;
+		t->durations = (mp4_run *) (t->sizes + MP4_MAX_SAMPLES);
+		t->flags = t->durations + MP4_MAX_SAMPLES;
+		t->offsets = t->flags + MP4_MAX_SAMPLES;
+		t->data = (u8 *) (t->offsets + MP4_MAX_SAMPLES);
+		t->bufferSize = c->bufferSize ? c->bufferSize : MP4_DEFAULT_BUFFER;
+		memory = t->data + t->bufferSize;
+
+		t->decodeTime = 0;
+		t->sampleCount = 0;
+		t->durationRuns = 0;
+		t->flagRuns = 0;
+		t->offsetRuns = 0;
+		t->duration = 0;
+		t->lastDuration = 0;
+		t->pending = false;
+		t->ended = false;
+		t->dataSize = 0;
+	}
+
+	m->write = write;
+	m->user = user;
+	m->trackCount = trackCount;
+	m->fragmentDuration = fragmentDuration;
+	m->sequence = 0;
+	m->headerWritten = false;
+	m->failed = false;
+	m->fits = 0;
+	m->skipping = false;
+	m->droppedFragments = 0;
+	m->droppedSamples = 0;
+
+	return true;
+}
+
+static void Mp4Destroy(mp4_muxer *m) {
+	BOGFree(m->memory, m->memorySize);
+	m->memory = 0;
+	m->trackCount = 0;
+}
+
+// after dropped fragment, true for samples that are dropped too, sync sample of primary track
+// ends skipping
+static bool Mp4Skipped(mp4_muxer *m, u32 track, bool sync) {
+	if (!m->skipping) return false;
+	if (track != m->primary || !sync) {
+		m->droppedSamples++;
+		return true;
+	}
+	m->skipping = false;
+	return false;
+}
+
+static bool Mp4WriteSample(mp4_muxer *m, u32 track, const void *data, u32 size, u64 decodeTime,
+						   u64 compositionTime, bool sync) {
+	if (m->failed || track >= m->trackCount) return false;
+
+	mp4_track *t = &m->tracks[track];
+	bool h264 = t->codec == MP4_CODEC_H264;
+	if (t->ended) return false;
+
+	if (!t->ready) {
+		// decoder can't start without parameter sets anyway
+		if (!sync || !Mp4ConfigH264(t, (const u8 *) data, size)) return true;
+		t->ready = true;
+	}
+
+	// nothing is pending while skipping, so sample that resumes starts new fragment
+	if (Mp4Skipped(m, track, sync)) return true;
+
+	if (t->pending) {
+		if (decodeTime <= t->pendingTime) return false;
+		Mp4Commit(t, decodeTime - t->pendingTime);
+	} else if (!t->sampleCount) {
+		t->decodeTime = decodeTime;
+	}
+
+	u64 elapsed = decodeTime - t->decodeTime;
+	u64 limit = (u64) m->fragmentDuration * t->timescale / 1000;
+	if (track != m->primary || !sync) limit *= 2;
+
+	u32 bound = h264 ? Mp4CopyNalsBound(size) : size;
+	bool full = t->sampleCount == MP4_MAX_SAMPLES || t->dataSize + (u64) bound > t->bufferSize;
+
+	if (t->sampleCount && (elapsed >= limit || full)) {
+		if (!Mp4Flush(m)) return false;
+
+		// fragment was dropped, this sample may resume right away
+		if (Mp4Skipped(m, track, sync)) return true;
+	}
+
+	if (bound > t->bufferSize) return false;
+
+	u8 *dst = t->data + t->dataSize;
+	if (h264) {
+		t->pendingSize = Mp4CopyNals(dst, (const u8 *) data, size);
+	} else {
+		memcpy(dst, data, size);
+		t->pendingSize = size;
+	}
+
+	t->pending = true;
+	t->pendingTime = decodeTime;
+	t->pendingOffset = (s32) (compositionTime - decodeTime);
+	t->pendingSync = sync;
+
+	return true;
+}
+
+static bool Mp4EndTrack(mp4_muxer *m, u32 track, u64 endTime) {
+	if (m->failed || track >= m->trackCount) return false;
+
+	mp4_track *t = &m->tracks[track];
+	if (t->pending) {
+		if (endTime <= t->pendingTime) return false;
+		Mp4Commit(t, endTime - t->pendingTime);
+	}
+
+	t->ended = true;
+	return true;
+}
+
+static void Mp4SetFits(mp4_muxer *m, mp4_fits *fits) {
+	m->fits = fits;
+}
+
+static void Mp4ShareConfig(mp4_muxer *m, const mp4_muxer *from) {
+	for (u32 i = 0; i < m->trackCount && i < from->trackCount; ++i) {
+		mp4_track *t = &m->tracks[i];
+		const mp4_track *source = &from->tracks[i];
+
+		if (!t->ready && source->ready && t->codec == source->codec) {
+			memcpy(t->config, source->config, source->configSize);
+			t->configSize = source->configSize;
+			t->ready = true;
+		}
+	}
+}
+
+static u64 Mp4ConvertTime(u64 time, u32 from, u32 to) {
+	// split, so multiplication can't overflow
+	return time / from * to + time % from * to / from;
+}
+
+static bool Mp4Finish(mp4_muxer *m) {
+	if (m->failed) return false;
+
+	for (u32 i = 0; i < m->trackCount; ++i) {
+		mp4_track *t = &m->tracks[i];
+		if (t->pending) Mp4Commit(t, t->lastDuration ? t->lastDuration : 1);
+	}
+
+	return Mp4Flush(m);
+}
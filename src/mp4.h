@@ -0,0 +1,137 @@
+#ifndef MP4_H
+#define MP4_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_memory.h"
+
+// fragmented MP4 (ISO/IEC 14496-12) muxer for H.264 video & audio access units
+// moov only describes tracks & has no samples, samples go into moof + mdat fragment every few
+// seconds, so file cut at any point plays up to last complete fragment & finishing costs one
+// fragment no matter how long the recording is
+// all memory is allocated when muxer is created, muxing itself never allocates
+
+#define MP4_MAX_TRACKS 4
+#define MP4_MAX_CONFIG 256        // bytes of codec configuration
+#define MP4_MAX_SAMPLES 4096      // per track in one fragment, fragment is flushed early when full
+#define MP4_DEFAULT_BUFFER (8 << 20) // bytes of sample data per track in one fragment
+
+// interface
+
+typedef enum {
+	MP4_CODEC_H264, // Annex B access units, config is taken from SPS & PPS of first IDR frame
+	MP4_CODEC_AAC,  // raw AAC frames, config is AudioSpecificConfig
+	MP4_CODEC_FLAC, // FLAC frames, config is 34 bytes of STREAMINFO block
+	MP4_CODEC_COUNT
+} mp4_codec;
+
+// writes bytes to output, returning false stops muxer & every later call fails
+typedef bool mp4_write(void *user, const void *data, udm size);
+
+// whether output takes size bytes right now, fragment that doesn't fit is dropped instead
+typedef bool mp4_fits(void *user, udm size);
+
+typedef struct {
+	mp4_codec codec;
+	u32 timescale;     // ticks per second of sample times
+	u32 width, height; // video only
+	u32 channels, sampleRate; // audio only
+	const void *config; // for H.264 can be Annex B SPS & PPS, 0 waits for first IDR frame
+	u32 configSize;
+	u32 bufferSize;    // 0 uses MP4_DEFAULT_BUFFER, largest sample must fit in it
+} mp4_track_config;
+
+// consecutive samples that have same value of one field
+typedef struct {
+	u32 count;
+	u32 value;
+} mp4_run;
+
+typedef struct {
+	mp4_codec codec;
+	u32 timescale;
+	u32 width, height;
+	u32 channels, sampleRate;
+	u8 config[MP4_MAX_CONFIG];
+	u32 configSize;
+	bool ready; // config is known, H.264 track drops everything before first IDR frame
+	bool ended;
+
+	// samples of current fragment, sizes vary too much to compress, rest is run-length encoded
+	u64 decodeTime;     // of first sample in fragment
+	u32 sampleCount;
+	u32 *sizes;
+	mp4_run *durations, *flags, *offsets;
+	u32 durationRuns, flagRuns, offsetRuns;
+	u64 duration;       // sum of sample durations in fragment
+	u32 lastDuration;
+
+	// last sample is kept out of fragment until next one arrives, its duration is difference of
+	// their decode times, that keeps variable frame rate exact
+	bool pending;
+	u64 pendingTime;
+	s32 pendingOffset;
+	bool pendingSync;
+	u32 pendingSize;
+
+	u8 *data;           // samples of fragment followed by pending sample
+	u32 dataSize;       // without pending sample
+	u32 bufferSize;
+} mp4_track;
+
+typedef struct {
+	mp4_write *write;
+	void *user;
+
+	mp4_track tracks[MP4_MAX_TRACKS];
+	u32 trackCount;
+	u32 primary;          // fragments start on its sync samples, first video track
+	u32 fragmentDuration; // msec
+
+	u32 sequence;         // of next moof
+	bool headerWritten;
+	bool failed;
+
+	// fragment output had no room for is dropped, file continues on next sync sample of primary
+	// track, tfdt of every track jumps over gap
+	mp4_fits *fits;       // optional, without it every fragment is written
+	bool skipping;        // samples are dropped until that sync sample
+	u32 droppedFragments;
+	u32 droppedSamples;
+
+	u8 *box;              // moov & moof are built here
+	udm boxSize;
+	udm boxCapacity;
+
+	void *memory;
+	udm memorySize;
+} mp4_muxer;
+
+// fragmentDuration is in msec, fragments are flushed on first sync sample of primary track after
+// that much time, or after twice that much time on any track even if no sync sample came
+static bool Mp4Create(mp4_muxer *m, const mp4_track_config *tracks, u32 trackCount,
+					  u32 fragmentDuration, mp4_write *write, void *user);
+static void Mp4Destroy(mp4_muxer *m);
+
+// adds one access unit, times are in track timescale, decodeTime must increase for every sample
+// of track, compositionTime is presentation time that differs from it when frames are reordered
+// returns false if sample does not fit into buffer, times go backwards or writing failed
+static bool Mp4WriteSample(mp4_muxer *m, u32 track, const void *data, u32 size, u64 decodeTime,
+						   u64 compositionTime, bool sync);
+
+// ends track at endTime, so its last sample lasts exactly until then, later samples are rejected
+static bool Mp4EndTrack(mp4_muxer *m, u32 track, u64 endTime);
+
+// fragments that output has no room for when they are flushed get dropped, muxing goes on
+static void Mp4SetFits(mp4_muxer *m, mp4_fits *fits);
+
+// tracks still waiting for config take it from muxer with same tracks, so next file can start
+// with IDR frame that has no parameter sets
+static void Mp4ShareConfig(mp4_muxer *m, const mp4_muxer *from);
+
+// writes everything that is buffered, last sample of every track gets duration of previous one
+static bool Mp4Finish(mp4_muxer *m);
+
+// converts time from one timescale to another, rounding down
+static u64 Mp4ConvertTime(u64 time, u32 from, u32 to);
+
+#endif //MP4_H
@@ -0,0 +1,597 @@
+#include "mux_sink.h"
+
+// media sink
+
+static HRESULT STDMETHODCALLTYPE MuxSinkQueryInterface(IMFMediaSink *this, REFIID riid,
+													   void **object) {
+	if (!object) return E_POINTER;
+
+	mux_sink *m = CONTAINING_RECORD(this, mux_sink, sink);
+	if (IsEqualGUID(&IID_IUnknown, riid) || IsEqualGUID(&IID_IMFMediaSink, riid)) {
+		*object = &m->sink;
+		return S_OK;
+	}
+
+	if (IsEqualGUID(&IID_IMFClockStateSink, riid)) {
+		*object = &m->clockSink;
+		return S_OK;
+	}
+
+	*object = 0;
+	return E_NOINTERFACE;
+}
+
+// sink lives in encoder, which outlives sink writer
+static ULONG STDMETHODCALLTYPE MuxSinkAddRef(IMFMediaSink *this) {
+	return 1;
+}
+
+static ULONG STDMETHODCALLTYPE MuxSinkRelease(IMFMediaSink *this) {
+	return 1;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxSinkGetCharacteristics(IMFMediaSink *this, DWORD *flags) {
+	if (!flags) return E_POINTER;
+	*flags = MEDIASINK_FIXED_STREAMS | MEDIASINK_RATELESS;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxSinkAddStreamSink(IMFMediaSink *this, DWORD id,
+													  IMFMediaType *type, IMFStreamSink **stream) {
+	return MF_E_STREAMSINKS_FIXED;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxSinkRemoveStreamSink(IMFMediaSink *this, DWORD id) {
+	return MF_E_STREAMSINKS_FIXED;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxSinkGetStreamSinkCount(IMFMediaSink *this, DWORD *count) {
+	if (!count) return E_POINTER;
+	*count = CONTAINING_RECORD(this, mux_sink, sink)->streamCount;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxSinkGetStreamSinkByIndex(IMFMediaSink *this, DWORD index,
+															 IMFStreamSink **stream) {
+	if (!stream) return E_POINTER;
+
+	mux_sink *m = CONTAINING_RECORD(this, mux_sink, sink);
+	if (index >= m->streamCount) return MF_E_INVALIDINDEX;
+
+	*stream = &m->streams[index].sink;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxSinkGetStreamSinkById(IMFMediaSink *this, DWORD id,
+														  IMFStreamSink **stream) {
+	if (!stream) return E_POINTER;
+
+	// identifiers are stream indices
+	mux_sink *m = CONTAINING_RECORD(this, mux_sink, sink);
+	if (id >= m->streamCount) return MF_E_INVALIDSTREAMNUMBER;
+
+	*stream = &m->streams[id].sink;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxSinkSetPresentationClock(IMFMediaSink *this,
+															 IMFPresentationClock *clock) {
+	mux_sink *m = CONTAINING_RECORD(this, mux_sink, sink);
+	if (m->shutdown) return MF_E_SHUTDOWN;
+
+	if (m->clock) {
+		IMFPresentationClock_RemoveClockStateSink(m->clock, &m->clockSink);
+		IMFPresentationClock_Release(m->clock);
+	}
+
+	m->clock = clock;
+	if (clock) {
+		IMFPresentationClock_AddRef(clock);
+		IMFPresentationClock_AddClockStateSink(clock, &m->clockSink);
+	}
+
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxSinkGetPresentationClock(IMFMediaSink *this,
+															 IMFPresentationClock **clock) {
+	if (!clock) return E_POINTER;
+
+	mux_sink *m = CONTAINING_RECORD(this, mux_sink, sink);
+	if (m->shutdown) return MF_E_SHUTDOWN;
+	if (!m->clock) return MF_E_NO_CLOCK;
+
+	IMFPresentationClock_AddRef(m->clock);
+	*clock = m->clock;
+	return S_OK;
+}
+
+// sink writer or MuxSinkStop, whichever comes first, files stay open until stop
+static HRESULT STDMETHODCALLTYPE MuxSinkShutdown(IMFMediaSink *this) {
+	mux_sink *m = CONTAINING_RECORD(this, mux_sink, sink);
+	if (InterlockedExchange(&m->shutdown, 1)) return MF_E_SHUTDOWN;
+
+	for (u32 i = 0; i < m->streamCount; ++i) {
+		IMFMediaEventQueue_Shutdown(m->streams[i].events);
+	}
+
+	if (m->clock) {
+		IMFPresentationClock_RemoveClockStateSink(m->clock, &m->clockSink);
+		IMFPresentationClock_Release(m->clock);
+		m->clock = 0;
+	}
+
+	return S_OK;
+}
+
+// clock state sink, sink writer starts clock at BeginWriting & stops it when finalizing
+
+static HRESULT STDMETHODCALLTYPE MuxClockQueryInterface(IMFClockStateSink *this, REFIID riid,
+														void **object) {
+	mux_sink *m = CONTAINING_RECORD(this, mux_sink, clockSink);
+	return MuxSinkQueryInterface(&m->sink, riid, object);
+}
+
+static ULONG STDMETHODCALLTYPE MuxClockAddRef(IMFClockStateSink *this) {
+	return 1;
+}
+
+static ULONG STDMETHODCALLTYPE MuxClockRelease(IMFClockStateSink *this) {
+	return 1;
+}
+
+// every stream asks for its first sample, later ones are asked for as samples arrive
+static HRESULT STDMETHODCALLTYPE MuxClockOnStart(IMFClockStateSink *this, MFTIME time,
+												 LONGLONG offset) {
+	mux_sink *m = CONTAINING_RECORD(this, mux_sink, clockSink);
+	for (u32 i = 0; i < m->streamCount; ++i) {
+		IMFMediaEventQueue *events = m->streams[i].events;
+		IMFMediaEventQueue_QueueEventParamVar(events, MEStreamSinkStarted, &GUID_NULL, S_OK, 0);
+		IMFMediaEventQueue_QueueEventParamVar(events, MEStreamSinkRequestSample, &GUID_NULL, S_OK,
+											  0);
+	}
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxClockOnStop(IMFClockStateSink *this, MFTIME time) {
+	mux_sink *m = CONTAINING_RECORD(this, mux_sink, clockSink);
+	for (u32 i = 0; i < m->streamCount; ++i) {
+		IMFMediaEventQueue_QueueEventParamVar(m->streams[i].events, MEStreamSinkStopped,
+											  &GUID_NULL, S_OK, 0);
+	}
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxClockOnPause(IMFClockStateSink *this, MFTIME time) {
+	return MF_E_INVALID_STATE_TRANSITION;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxClockOnRestart(IMFClockStateSink *this, MFTIME time) {
+	return MF_E_INVALID_STATE_TRANSITION;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxClockOnSetRate(IMFClockStateSink *this, MFTIME time,
+												   float rate) {
+	return S_OK;
+}
+
+// muxing
+
+// value of attribute, or fallback when it is not set
+static UINT32 MuxSinkAttribute(IMFAttributes *attributes, REFGUID key, UINT32 fallback) {
+	UINT32 value;
+	return SUCCEEDED(IMFAttributes_GetUINT32(attributes, key, &value)) ? value : fallback;
+}
+
+// STREAMINFO for FLAC track, from user data of encoder type when it has it, made up otherwise
+// block & frame sizes of made up one are just limits every decoder accepts
+static u32 MuxSinkFlacConfig(IMFMediaType *type, u8 *config) {
+	UINT32 size = 0;
+	u8 data[MP4_MAX_CONFIG];
+	if (SUCCEEDED(IMFMediaType_GetBlob(type, &MF_MT_USER_DATA, data, sizeof(data), &size))) {
+		// bare block, block with header, or whole stream header starting with fLaC
+		u32 skip = size == 34 ? 0 : size >= 38 && data[1] == 0 && data[3] == 34 ? 4 :
+				   size >= 42 && !memcmp(data, "fLaC", 4) ? 8 : size;
+		if (size >= skip + 34 && (skip != 4 || (data[0] & 0x7F) == 0)) {
+			memcpy(config, data + skip, 34);
+			return 34;
+		}
+	}
+
+	IMFAttributes *attributes = (IMFAttributes *) type;
+	UINT32 rate = MuxSinkAttribute(attributes, &MF_MT_AUDIO_SAMPLES_PER_SECOND, 0);
+	UINT32 channels = MuxSinkAttribute(attributes, &MF_MT_AUDIO_NUM_CHANNELS, 0);
+	UINT32 bits = MuxSinkAttribute(attributes, &MF_MT_AUDIO_BITS_PER_SAMPLE, 16);
+	if (!rate || !channels || channels > 8 || bits < 4 || bits > 32) return 0;
+
+	memset(config, 0, 34);
+	config[1] = 16;
+	config[2] = 0xFF;
+	config[3] = 0xFF;
+
+	// 20 bits rate, 3 bits channels - 1, 5 bits bits - 1, 36 bits of unknown total samples
+	u64 format = ((u64) rate << 44) | ((u64) (channels - 1) << 41) | ((u64) (bits - 1) << 36);
+	for (u32 i = 0; i < 8; ++i) config[10 + i] = (u8) (format >> (56 - 8 * i));
+
+	return 34;
+}
+
+// tracks come from current types, sink writer has set them once it began writing
+static bool MuxSinkBuildTracks(mux_sink *m) {
+	for (u32 i = 0; i < m->streamCount; ++i) {
+		IMFMediaType *type = m->streams[i].type;
+		mp4_track_config *t = &m->tracks[i];
+		memset(t, 0, sizeof(*t));
+		t->config = m->configs[i];
+
+		if (m->streams[i].video) {
+			UINT64 size = 0;
+			IMFMediaType_GetUINT64(type, &MF_MT_FRAME_SIZE, &size);
+			t->codec = MP4_CODEC_H264;
+			t->timescale = MUX_SINK_VIDEO_TIMESCALE;
+			t->width = (u32) (size >> 32);
+			t->height = (u32) size;
+
+			// SPS & PPS in Annex B, first IDR frame gives them otherwise
+			UINT32 configSize = 0;
+			if (SUCCEEDED(IMFMediaType_GetBlob(type, &MF_MT_MPEG_SEQUENCE_HEADER, m->configs[i],
+											   MP4_MAX_CONFIG, &configSize))) {
+				t->configSize = configSize;
+			}
+		} else {
+			t->codec = MP4_CODEC_FLAC;
+			IMFAttributes *attributes = (IMFAttributes *) type;
+			t->sampleRate = MuxSinkAttribute(attributes, &MF_MT_AUDIO_SAMPLES_PER_SECOND, 0);
+			t->channels = MuxSinkAttribute(attributes, &MF_MT_AUDIO_NUM_CHANNELS, 0);
+			t->timescale = t->sampleRate;
+			t->configSize = MuxSinkFlacConfig(type, m->configs[i]);
+			t->bufferSize = MP4_DEFAULT_BUFFER / 4;
+			if (!t->configSize) return false;
+		}
+	}
+
+	return true;
+}
+
+// stream sink thread, holding lock
+static void MuxSinkWrite(mux_sink *m, mux_stream *s, const u8 *data, u32 size, LONGLONG time,
+						 LONGLONG decode, bool sync) {
+	if (!m->started) return;
+
+	if (!s->started) {
+		s->started = true;
+		s->shift = time - decode;
+	}
+
+	// nothing goes before start of recording
+	decode += s->shift;
+	if (time < 0 || decode < 0) return;
+
+	time_rate timescale = TimeRate(m->tracks[s->id].timescale, 1);
+	u64 composition = TimeConvert((u64) time, TIME_RATE_MF, timescale, TIME_NEAREST);
+	u64 decodeTime = TimeConvert((u64) decode, TIME_RATE_MF, timescale, TIME_NEAREST);
+
+	// decode times must increase, encoder without decode times gives presentation order
+	if (s->last && decodeTime <= s->last) decodeTime = s->last + 1;
+	s->last = decodeTime;
+
+	if (m->recording) {
+		if (!SegmentWriteSample(&m->segment, s->id, data, size, decodeTime, composition, sync)) {
+			m->rejected++;
+		}
+	}
+
+	if (m->replaying) {
+		ReplayWriteSample(&m->replay, s->id, data, size, decodeTime, composition, sync);
+	}
+}
+
+// stream sink
+
+static HRESULT STDMETHODCALLTYPE MuxStreamQueryInterface(IMFStreamSink *this, REFIID riid,
+														 void **object) {
+	if (!object) return E_POINTER;
+
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, sink);
+	if (IsEqualGUID(&IID_IUnknown, riid) || IsEqualGUID(&IID_IMFMediaEventGenerator, riid) ||
+		IsEqualGUID(&IID_IMFStreamSink, riid)) {
+		*object = &s->sink;
+		return S_OK;
+	}
+
+	if (IsEqualGUID(&IID_IMFMediaTypeHandler, riid)) {
+		*object = &s->handler;
+		return S_OK;
+	}
+
+	*object = 0;
+	return E_NOINTERFACE;
+}
+
+static ULONG STDMETHODCALLTYPE MuxStreamAddRef(IMFStreamSink *this) {
+	return 1;
+}
+
+static ULONG STDMETHODCALLTYPE MuxStreamRelease(IMFStreamSink *this) {
+	return 1;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxStreamGetEvent(IMFStreamSink *this, DWORD flags,
+												   IMFMediaEvent **event) {
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, sink);
+	return IMFMediaEventQueue_GetEvent(s->events, flags, event);
+}
+
+static HRESULT STDMETHODCALLTYPE MuxStreamBeginGetEvent(IMFStreamSink *this,
+														IMFAsyncCallback *callback,
+														IUnknown *state) {
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, sink);
+	return IMFMediaEventQueue_BeginGetEvent(s->events, callback, state);
+}
+
+static HRESULT STDMETHODCALLTYPE MuxStreamEndGetEvent(IMFStreamSink *this, IMFAsyncResult *result,
+													  IMFMediaEvent **event) {
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, sink);
+	return IMFMediaEventQueue_EndGetEvent(s->events, result, event);
+}
+
+static HRESULT STDMETHODCALLTYPE MuxStreamQueueEvent(IMFStreamSink *this, MediaEventType type,
+													 REFGUID extendedType, HRESULT status,
+													 const PROPVARIANT *value) {
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, sink);
+	return IMFMediaEventQueue_QueueEventParamVar(s->events, type, extendedType, status, value);
+}
+
+static HRESULT STDMETHODCALLTYPE MuxStreamGetMediaSink(IMFStreamSink *this, IMFMediaSink **sink) {
+	if (!sink) return E_POINTER;
+	*sink = &CONTAINING_RECORD(this, mux_stream, sink)->owner->sink;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxStreamGetIdentifier(IMFStreamSink *this, DWORD *id) {
+	if (!id) return E_POINTER;
+	*id = CONTAINING_RECORD(this, mux_stream, sink)->id;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxStreamGetMediaTypeHandler(IMFStreamSink *this,
+															  IMFMediaTypeHandler **handler) {
+	if (!handler) return E_POINTER;
+	*handler = &CONTAINING_RECORD(this, mux_stream, sink)->handler;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxStreamProcessSample(IMFStreamSink *this, IMFSample *sample) {
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, sink);
+	mux_sink *m = s->owner;
+	if (m->shutdown) return MF_E_SHUTDOWN;
+	if (!sample) return E_POINTER;
+
+	LONGLONG time;
+	if (FAILED(IMFSample_GetSampleTime(sample, &time))) return MF_E_NO_SAMPLE_TIMESTAMP;
+
+	// every audio frame can be decoded on its own, video has sync samples only at IDR frames
+	UINT64 decode = (UINT64) time;
+	IMFSample_GetUINT64(sample, &MFSampleExtension_DecodeTimestamp, &decode);
+	bool sync = !s->video || MuxSinkAttribute((IMFAttributes *) sample,
+											  &MFSampleExtension_CleanPoint, 0);
+
+	IMFMediaBuffer *buffer;
+	HRESULT hr = IMFSample_ConvertToContiguousBuffer(sample, &buffer);
+	if (FAILED(hr)) return hr;
+
+	BYTE *data;
+	DWORD size;
+	hr = IMFMediaBuffer_Lock(buffer, &data, 0, &size);
+	if (SUCCEEDED(hr)) {
+		AcquireSRWLockExclusive(&m->lock);
+		MuxSinkWrite(m, s, data, size, time, (LONGLONG) decode, sync);
+		ReleaseSRWLockExclusive(&m->lock);
+		IMFMediaBuffer_Unlock(buffer);
+	}
+	IMFMediaBuffer_Release(buffer);
+
+	// sink writer only sends sample that was asked for
+	IMFMediaEventQueue_QueueEventParamVar(s->events, MEStreamSinkRequestSample, &GUID_NULL, S_OK,
+										  0);
+	return hr;
+}
+
+// there is nothing queued, so every marker is reached right away
+static HRESULT STDMETHODCALLTYPE MuxStreamPlaceMarker(IMFStreamSink *this,
+													  MFSTREAMSINK_MARKER_TYPE type,
+													  const PROPVARIANT *value,
+													  const PROPVARIANT *context) {
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, sink);
+	if (s->owner->shutdown) return MF_E_SHUTDOWN;
+
+	return IMFMediaEventQueue_QueueEventParamVar(s->events, MEStreamSinkMarker, &GUID_NULL, S_OK,
+												 context);
+}
+
+static HRESULT STDMETHODCALLTYPE MuxStreamFlush(IMFStreamSink *this) {
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, sink);
+	return s->owner->shutdown ? MF_E_SHUTDOWN : S_OK;
+}
+
+// media type handler, stream takes any type of its major type & subtype
+
+static HRESULT STDMETHODCALLTYPE MuxTypeQueryInterface(IMFMediaTypeHandler *this, REFIID riid,
+													   void **object) {
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, handler);
+	return MuxStreamQueryInterface(&s->sink, riid, object);
+}
+
+static ULONG STDMETHODCALLTYPE MuxTypeAddRef(IMFMediaTypeHandler *this) {
+	return 1;
+}
+
+static ULONG STDMETHODCALLTYPE MuxTypeRelease(IMFMediaTypeHandler *this) {
+	return 1;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxTypeIsMediaTypeSupported(IMFMediaTypeHandler *this,
+															 IMFMediaType *type,
+															 IMFMediaType **closest) {
+	if (!type) return E_POINTER;
+	if (closest) *closest = 0;
+
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, handler);
+	GUID major, subtype, ownMajor, ownSubtype;
+	if (FAILED(IMFMediaType_GetGUID(type, &MF_MT_MAJOR_TYPE, &major)) ||
+		FAILED(IMFMediaType_GetGUID(type, &MF_MT_SUBTYPE, &subtype))) {
+		return MF_E_INVALIDMEDIATYPE;
+	}
+
+	IMFMediaType_GetGUID(s->type, &MF_MT_MAJOR_TYPE, &ownMajor);
+	IMFMediaType_GetGUID(s->type, &MF_MT_SUBTYPE, &ownSubtype);
+	if (!IsEqualGUID(&major, &ownMajor) || !IsEqualGUID(&subtype, &ownSubtype)) {
+		return MF_E_INVALIDMEDIATYPE;
+	}
+
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxTypeGetMediaTypeCount(IMFMediaTypeHandler *this, DWORD *count) {
+	if (!count) return E_POINTER;
+	*count = 1;
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxTypeGetMediaTypeByIndex(IMFMediaTypeHandler *this, DWORD index,
+															IMFMediaType **type) {
+	if (index) return MF_E_NO_MORE_TYPES;
+	return MuxTypeGetCurrentMediaType(this, type);
+}
+
+static HRESULT STDMETHODCALLTYPE MuxTypeSetCurrentMediaType(IMFMediaTypeHandler *this,
+															IMFMediaType *type) {
+	HRESULT hr = MuxTypeIsMediaTypeSupported(this, type, 0);
+	if (FAILED(hr)) return hr;
+
+	// tracks are built from it once first sample arrives
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, handler);
+	AcquireSRWLockExclusive(&s->owner->lock);
+	IMFMediaType_AddRef(type);
+	IMFMediaType_Release(s->type);
+	s->type = type;
+	ReleaseSRWLockExclusive(&s->owner->lock);
+
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxTypeGetCurrentMediaType(IMFMediaTypeHandler *this,
+															IMFMediaType **type) {
+	if (!type) return E_POINTER;
+
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, handler);
+	AcquireSRWLockShared(&s->owner->lock);
+	IMFMediaType_AddRef(s->type);
+	*type = s->type;
+	ReleaseSRWLockShared(&s->owner->lock);
+
+	return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE MuxTypeGetMajorType(IMFMediaTypeHandler *this, GUID *major) {
+	if (!major) return E_POINTER;
+
+	mux_stream *s = CONTAINING_RECORD(this, mux_stream, handler);
+	return IMFMediaType_GetGUID(s->type, &MF_MT_MAJOR_TYPE, major);
+}
+
+// interface
+
+static bool MuxSinkCreate(mux_sink *m, IMFMediaType **types, u32 count,
+						  const mux_sink_config *config) {
+	if (!count || count > MUX_SINK_MAX_STREAMS) return false;
+
+	m->sink.lpVtbl = &MuxSinkVtbl;
+	m->clockSink.lpVtbl = &MuxClockVtbl;
+	m->clock = 0;
+	m->streamCount = 0;
+	m->shutdown = 0;
+	InitializeSRWLock(&m->lock);
+	m->config = *config;
+	m->started = false;
+	m->recording = false;
+	m->replaying = 0;
+	m->rejected = 0;
+
+	for (u32 i = 0; i < count; ++i) {
+		mux_stream *s = &m->streams[i];
+		s->sink.lpVtbl = &MuxStreamVtbl;
+		s->handler.lpVtbl = &MuxTypeVtbl;
+		s->owner = m;
+		s->id = i;
+		s->started = false;
+		s->shift = 0;
+		s->last = 0;
+
+		GUID major;
+		IMFMediaType_GetGUID(types[i], &MF_MT_MAJOR_TYPE, &major);
+		s->video = IsEqualGUID(&major, &MFMediaType_Video);
+
+		if (FAILED(MFCreateEventQueue(&s->events))) {
+			MuxSinkStop(m);
+			return false;
+		}
+
+		IMFMediaType_AddRef(types[i]);
+		s->type = types[i];
+		m->streamCount++;
+	}
+
+	return true;
+}
+
+static bool MuxSinkStart(mux_sink *m) {
+	AcquireSRWLockExclusive(&m->lock);
+
+	bool result = MuxSinkBuildTracks(m);
+	if (result && m->config.record) {
+		m->recording = SegmentStart(&m->segment, m->tracks, m->streamCount, &m->config.segment);
+		result = m->recording;
+	}
+
+	if (result && m->config.replayDuration) {
+		replay_config replayConfig = {
+			.duration = m->config.replayDuration,
+			.size = m->config.replaySize
+		};
+		result = ReplayCreate(&m->replay, m->tracks, m->streamCount, &replayConfig);
+		if (result) BOGAtomicStore(&m->replaying, 1);
+	}
+
+	m->started = result;
+	ReleaseSRWLockExclusive(&m->lock);
+	return result;
+}
+
+static bool MuxSinkStop(mux_sink *m) {
+	MuxSinkShutdown(&m->sink);
+
+	bool result = true;
+	if (m->recording && !SegmentStop(&m->segment)) result = false;
+	if (m->replaying) ReplayDestroy(&m->replay);
+	m->recording = false;
+	m->replaying = 0;
+
+	for (u32 i = 0; i < m->streamCount; ++i) {
+		IMFMediaEventQueue_Release(m->streams[i].events);
+		IMFMediaType_Release(m->streams[i].type);
+	}
+	m->streamCount = 0;
+
+	return result;
+}
+
+static bool MuxSinkSaveReplay(mux_sink *m, const output_path *path) {
+	if (!BOGAtomicLoad(&m->replaying)) return false;
+
+	// file is written at once & nothing waits on it, so it can wait for disk
+	output_config output = {
+		.wait = true
+	};
+	return ReplayFlush(&m->replay, path, &output, m->config.segment.fragmentDuration);
+}
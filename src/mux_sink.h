@@ -0,0 +1,215 @@
+#ifndef MUX_SINK_H
+#define MUX_SINK_H
+
+#include <mfapi.h>
+#include <mferror.h>
+#include <mfidl.h>
+
+#include "bog/bog_types.h"
+#include "bog/bog_thread.h"
+#include "mp4.h"
+#include "segment.h"
+#include "replay.h"
+#include "timebase.h"
+
+// media sink that sink writer gives encoded samples to, instead of its own MP4 sink
+// samples go to segmented fragmented MP4 files written by output thread, & to replay ring in
+// memory, so file on disk plays up to its last fragment & last seconds can be saved any time
+// stream sinks ask for next sample as soon as they got one, sink doesn't follow clock
+// stream 0 is H.264 video, stream 1 is FLAC audio when there is one, track numbers are same
+
+#define MUX_SINK_MAX_STREAMS 2
+#define MUX_SINK_VIDEO_TIMESCALE 90000 // common frame rates have whole durations in it
+
+static HRESULT STDMETHODCALLTYPE MuxSinkQueryInterface(IMFMediaSink *this, REFIID riid,
+													   void **object);
+static ULONG STDMETHODCALLTYPE MuxSinkAddRef(IMFMediaSink *this);
+static ULONG STDMETHODCALLTYPE MuxSinkRelease(IMFMediaSink *this);
+static HRESULT STDMETHODCALLTYPE MuxSinkGetCharacteristics(IMFMediaSink *this, DWORD *flags);
+static HRESULT STDMETHODCALLTYPE MuxSinkAddStreamSink(IMFMediaSink *this, DWORD id,
+													  IMFMediaType *type, IMFStreamSink **stream);
+static HRESULT STDMETHODCALLTYPE MuxSinkRemoveStreamSink(IMFMediaSink *this, DWORD id);
+static HRESULT STDMETHODCALLTYPE MuxSinkGetStreamSinkCount(IMFMediaSink *this, DWORD *count);
+static HRESULT STDMETHODCALLTYPE MuxSinkGetStreamSinkByIndex(IMFMediaSink *this, DWORD index,
+															 IMFStreamSink **stream);
+static HRESULT STDMETHODCALLTYPE MuxSinkGetStreamSinkById(IMFMediaSink *this, DWORD id,
+														  IMFStreamSink **stream);
+static HRESULT STDMETHODCALLTYPE MuxSinkSetPresentationClock(IMFMediaSink *this,
+															 IMFPresentationClock *clock);
+static HRESULT STDMETHODCALLTYPE MuxSinkGetPresentationClock(IMFMediaSink *this,
+															 IMFPresentationClock **clock);
+static HRESULT STDMETHODCALLTYPE MuxSinkShutdown(IMFMediaSink *this);
+
+static HRESULT STDMETHODCALLTYPE MuxClockQueryInterface(IMFClockStateSink *this, REFIID riid,
+														void **object);
+static ULONG STDMETHODCALLTYPE MuxClockAddRef(IMFClockStateSink *this);
+static ULONG STDMETHODCALLTYPE MuxClockRelease(IMFClockStateSink *this);
+static HRESULT STDMETHODCALLTYPE MuxClockOnStart(IMFClockStateSink *this, MFTIME time,
+												 LONGLONG offset);
+static HRESULT STDMETHODCALLTYPE MuxClockOnStop(IMFClockStateSink *this, MFTIME time);
+static HRESULT STDMETHODCALLTYPE MuxClockOnPause(IMFClockStateSink *this, MFTIME time);
+static HRESULT STDMETHODCALLTYPE MuxClockOnRestart(IMFClockStateSink *this, MFTIME time);
+static HRESULT STDMETHODCALLTYPE MuxClockOnSetRate(IMFClockStateSink *this, MFTIME time,
+												   float rate);
+
+static HRESULT STDMETHODCALLTYPE MuxStreamQueryInterface(IMFStreamSink *this, REFIID riid,
+														 void **object);
+static ULONG STDMETHODCALLTYPE MuxStreamAddRef(IMFStreamSink *this);
+static ULONG STDMETHODCALLTYPE MuxStreamRelease(IMFStreamSink *this);
+static HRESULT STDMETHODCALLTYPE MuxStreamGetEvent(IMFStreamSink *this, DWORD flags,
+												   IMFMediaEvent **event);
+static HRESULT STDMETHODCALLTYPE MuxStreamBeginGetEvent(IMFStreamSink *this,
+														IMFAsyncCallback *callback,
+														IUnknown *state);
+static HRESULT STDMETHODCALLTYPE MuxStreamEndGetEvent(IMFStreamSink *this, IMFAsyncResult *result,
+													  IMFMediaEvent **event);
+static HRESULT STDMETHODCALLTYPE MuxStreamQueueEvent(IMFStreamSink *this, MediaEventType type,
+													 REFGUID extendedType, HRESULT status,
+													 const PROPVARIANT *value);
+static HRESULT STDMETHODCALLTYPE MuxStreamGetMediaSink(IMFStreamSink *this, IMFMediaSink **sink);
+static HRESULT STDMETHODCALLTYPE MuxStreamGetIdentifier(IMFStreamSink *this, DWORD *id);
+static HRESULT STDMETHODCALLTYPE MuxStreamGetMediaTypeHandler(IMFStreamSink *this,
+															  IMFMediaTypeHandler **handler);
+static HRESULT STDMETHODCALLTYPE MuxStreamProcessSample(IMFStreamSink *this, IMFSample *sample);
+static HRESULT STDMETHODCALLTYPE MuxStreamPlaceMarker(IMFStreamSink *this,
+													  MFSTREAMSINK_MARKER_TYPE type,
+													  const PROPVARIANT *value,
+													  const PROPVARIANT *context);
+static HRESULT STDMETHODCALLTYPE MuxStreamFlush(IMFStreamSink *this);
+
+static HRESULT STDMETHODCALLTYPE MuxTypeQueryInterface(IMFMediaTypeHandler *this, REFIID riid,
+													   void **object);
+static ULONG STDMETHODCALLTYPE MuxTypeAddRef(IMFMediaTypeHandler *this);
+static ULONG STDMETHODCALLTYPE MuxTypeRelease(IMFMediaTypeHandler *this);
+static HRESULT STDMETHODCALLTYPE MuxTypeIsMediaTypeSupported(IMFMediaTypeHandler *this,
+															 IMFMediaType *type,
+															 IMFMediaType **closest);
+static HRESULT STDMETHODCALLTYPE MuxTypeGetMediaTypeCount(IMFMediaTypeHandler *this, DWORD *count);
+static HRESULT STDMETHODCALLTYPE MuxTypeGetMediaTypeByIndex(IMFMediaTypeHandler *this, DWORD index,
+															IMFMediaType **type);
+static HRESULT STDMETHODCALLTYPE MuxTypeSetCurrentMediaType(IMFMediaTypeHandler *this,
+															IMFMediaType *type);
+static HRESULT STDMETHODCALLTYPE MuxTypeGetCurrentMediaType(IMFMediaTypeHandler *this,
+															IMFMediaType **type);
+static HRESULT STDMETHODCALLTYPE MuxTypeGetMajorType(IMFMediaTypeHandler *this, GUID *major);
+
+static IMFMediaSinkVtbl MuxSinkVtbl = {
+	&MuxSinkQueryInterface,
+	&MuxSinkAddRef,
+	&MuxSinkRelease,
+	&MuxSinkGetCharacteristics,
+	&MuxSinkAddStreamSink,
+	&MuxSinkRemoveStreamSink,
+	&MuxSinkGetStreamSinkCount,
+	&MuxSinkGetStreamSinkByIndex,
+	&MuxSinkGetStreamSinkById,
+	&MuxSinkSetPresentationClock,
+	&MuxSinkGetPresentationClock,
+	&MuxSinkShutdown
+};
+
+static IMFClockStateSinkVtbl MuxClockVtbl = {
+	&MuxClockQueryInterface,
+	&MuxClockAddRef,
+	&MuxClockRelease,
+	&MuxClockOnStart,
+	&MuxClockOnStop,
+	&MuxClockOnPause,
+	&MuxClockOnRestart,
+	&MuxClockOnSetRate
+};
+
+static IMFStreamSinkVtbl MuxStreamVtbl = {
+	&MuxStreamQueryInterface,
+	&MuxStreamAddRef,
+	&MuxStreamRelease,
+	&MuxStreamGetEvent,
+	&MuxStreamBeginGetEvent,
+	&MuxStreamEndGetEvent,
+	&MuxStreamQueueEvent,
+	&MuxStreamGetMediaSink,
+	&MuxStreamGetIdentifier,
+	&MuxStreamGetMediaTypeHandler,
+	&MuxStreamProcessSample,
+	&MuxStreamPlaceMarker,
+	&MuxStreamFlush
+};
+
+static IMFMediaTypeHandlerVtbl MuxTypeVtbl = {
+	&MuxTypeQueryInterface,
+	&MuxTypeAddRef,
+	&MuxTypeRelease,
+	&MuxTypeIsMediaTypeSupported,
+	&MuxTypeGetMediaTypeCount,
+	&MuxTypeGetMediaTypeByIndex,
+	&MuxTypeSetCurrentMediaType,
+	&MuxTypeGetCurrentMediaType,
+	&MuxTypeGetMajorType
+};
+
+// interface
+
+typedef struct {
+	bool record;                // segment config is used, false only keeps replay in memory
+	segment_config segment;
+	u32 replayDuration;         // msec, 0 for no replay ring
+	u64 replaySize;             // bytes of replay ring
+} mux_sink_config;
+
+typedef struct mux_sink mux_sink;
+
+typedef struct {
+	IMFStreamSink sink;
+	IMFMediaTypeHandler handler;
+	mux_sink *owner;
+	DWORD id;
+	bool video;
+	IMFMediaType *type;         // output type of encoder, encoder can set more complete one
+	IMFMediaEventQueue *events;
+
+	// decode times of reordered frames start before their presentation, they are moved so first
+	// frame has same decode & presentation time, presentation times are exact as they came
+	bool started;
+	LONGLONG shift;
+	u64 last;                   // decode time of last sample in track timescale
+} mux_stream;
+
+struct mux_sink {
+	IMFMediaSink sink;
+	IMFClockStateSink clockSink;
+	IMFPresentationClock *clock;
+	mux_stream streams[MUX_SINK_MAX_STREAMS];
+	u32 streamCount;
+	volatile LONG shutdown;
+
+	// stream sinks get samples on different work queue threads, muxing is done one at time
+	SRWLOCK lock;
+	mux_sink_config config;
+	bool started;               // files & ring are ready, samples before are dropped
+	mp4_track_config tracks[MUX_SINK_MAX_STREAMS];
+	u8 configs[MUX_SINK_MAX_STREAMS][MP4_MAX_CONFIG];
+	segmenter segment;
+	bool recording;             // segmenter was started
+	replay_ring replay;
+	volatile s32 replaying;     // replay ring was created, saving can start
+
+	// statistics
+	u32 rejected;               // samples muxer or file could not take
+};
+
+// types are encoder output types of every stream, sink holds reference to them
+static bool MuxSinkCreate(mux_sink *m, IMFMediaType **types, u32 count,
+						  const mux_sink_config *config);
+
+// after sink writer began writing, output types are final then, opens first file & replay ring
+// false when stream format is unknown, file cannot be created or there is not enough memory
+static bool MuxSinkStart(mux_sink *m);
+
+// after sink writer is finalized, finishes files & releases everything, false if writing failed
+static bool MuxSinkStop(mux_sink *m);
+
+// any thread, not at same time as stop, writes replay ring as it is now to file
+// false when there is no replay yet or writing failed
+static bool MuxSinkSaveReplay(mux_sink *m, const output_path *path);
+
+#endif //MUX_SINK_H
@@ -0,0 +1,279 @@
+#include "output.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// platform file operations, bog_types.h defines _GNU_SOURCE for O_DIRECT & fallocate on linux,
+// other systems write through page cache & don't preallocate
+
+static bool OutputPlatformOpen(output_file *f, const output_path *path, bool direct) {
+#ifdef _WIN32
+	DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+	if (direct) flags |= FILE_FLAG_NO_BUFFERING;
+
+	f->file = CreateFileW(path, GENERIC_WRITE, FILE_SHARE_READ, 0, CREATE_ALWAYS, flags, 0);
+	return f->file != INVALID_HANDLE_VALUE;
+#else
+	int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef O_DIRECT
+	if (direct) flags |= O_DIRECT;
+#else
+	if (direct) return false;
+#endif
+
+	f->file = open(path, flags, 0644);
+	return f->file >= 0;
+#endif
+}
+
+static void OutputPlatformClose(output_file *f) {
+#ifdef _WIN32
+	CloseHandle(f->file);
+#else
+	close(f->file);
+#endif
+}
+
+static bool OutputPlatformWrite(output_file *f, const u8 *data, u32 size, u64 offset) {
+#ifdef _WIN32
+	OVERLAPPED overlapped = { 0 };
+	overlapped.Offset = (DWORD) offset;
+	overlapped.OffsetHigh = (DWORD) (offset >> 32);
+
+	DWORD written;
+	return WriteFile(f->file, data, size, &written, &overlapped) && written == size;
+#else
+	while (size) {
+		ssize_t written = pwrite(f->file, data, size, (off_t) offset);
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0) return false;
+
+		data += written;
+		size -= (u32) written;
+		offset += (u64) written;
+	}
+	return true;
+#endif
+}
+
+// reserves space without changing file size, failure only means file may end up fragmented
+static void OutputPlatformAllocate(output_file *f, u64 size) {
+#ifdef _WIN32
+	FILE_ALLOCATION_INFO info;
+	info.AllocationSize.QuadPart = (LONGLONG) size;
+	SetFileInformationByHandle(f->file, FileAllocationInfo, &info, sizeof(info));
+#elif defined(FALLOC_FL_KEEP_SIZE)
+	fallocate(f->file, FALLOC_FL_KEEP_SIZE, 0, (off_t) size);
+#else
+	(void) f;
+	(void) size;
+#endif
+}
+
+// also releases preallocated space after end
+static bool OutputPlatformTruncate(output_file *f, u64 size) {
+#ifdef _WIN32
+	FILE_END_OF_FILE_INFO info;
+	info.EndOfFile.QuadPart = (LONGLONG) size;
+	return SetFileInformationByHandle(f->file, FileEndOfFileInfo, &info, sizeof(info));
+#else
+	return ftruncate(f->file, (off_t) size) == 0;
+#endif
+}
+
+static u8 *OutputBufferData(output_file *f, s32 index) {
+	return f->data + (udm) ((u32) index % f->bufferCount) * f->bufferSize;
+}
+
+static BOG_THREAD_PROC(OutputThread) {
+	output_file *f = (output_file *) arg;
+	s32 written = 0;
+
+	for (;;) {
+		s32 submitted = BOGAtomicLoad(&f->submitted);
+
+		if (submitted == written) {
+			// buffer can be submitted just before quit is set
+			if (BOGAtomicLoad(&f->quit)) {
+				if (BOGAtomicLoad(&f->submitted) == written) break;
+				continue;
+			}
+
+			BOGWaitOnAddress(&f->submitted, submitted);
+			continue;
+		}
+
+		output_buffer *b = &f->buffers[(u32) written % f->bufferCount];
+		u32 size = f->direct ? (b->size + OUTPUT_ALIGN - 1) & ~(u32) (OUTPUT_ALIGN - 1) : b->size;
+
+		if (f->extent && b->offset + size > f->allocated) {
+			while (b->offset + size > f->allocated) {
+				f->allocated += f->extent;
+				if (f->extent < OUTPUT_MAX_EXTENT) f->extent *= 2;
+			}
+			OutputPlatformAllocate(f, f->allocated);
+		}
+
+		// direct writes of partial buffer are padded, padding is overwritten by next buffer
+		if (!BOGAtomicLoad(&f->failed)) {
+			if (!OutputPlatformWrite(f, OutputBufferData(f, written), size, b->offset)) {
+				BOGAtomicStore(&f->failed, 1);
+			}
+		}
+
+		written++;
+		BOGAtomicStore(&f->written, written);
+		if (f->wait) BOGWakeAll(&f->written);
+	}
+
+	return 0;
+}
+
+static bool OutputOpen(output_file *f, const output_path *path, const output_config *config) {
+	u32 bufferSize = config->bufferSize ? config->bufferSize : OUTPUT_DEFAULT_BUFFER;
+	u32 bufferCount = config->bufferCount ? config->bufferCount : OUTPUT_DEFAULT_COUNT;
+	if (bufferSize % OUTPUT_ALIGN) return false;
+
+	f->wait = config->wait;
+	f->direct = config->direct && OutputPlatformOpen(f, path, true);
+	if (!f->direct && !OutputPlatformOpen(f, path, false)) return false;
+
+	// buffers come first, so all of them are page aligned as direct writes need
+	f->memorySize = (udm) bufferCount * bufferSize + bufferCount * sizeof(output_buffer);
+	f->memory = BOGAlloc(f->memorySize);
+	if (!f->memory) {
+		OutputPlatformClose(f);
+		return false;
+	}
+
+	f->data = (u8 *) f->memory;
+	f->buffers = (output_buffer *) (f->data + (udm) bufferCount * bufferSize);
+	f->bufferSize = bufferSize;
+	f->bufferCount = bufferCount;
+
+	f->submitted = 0;
+	f->written = 0;
+	f->quit = 0;
+	f->failed = 0;
+	f->used = 0;
+	f->offset = 0;
+	f->size = 0;
+	f->keep = 0;
+	f->overflows = 0;
+	f->allocated = 0;
+	f->extent = config->preallocate;
+
+	if (!BOGThreadCreate(&f->thread, OutputThread, f)) {
+		OutputPlatformClose(f);
+		BOGFree(f->memory, f->memorySize);
+		f->memory = 0;
+		return false;
+	}
+
+	return true;
+}
+
+// hands current buffer to I/O thread, with direct writes unaligned tail stays for next buffer
+static void OutputSubmit(output_file *f) {
+	s32 submitted = f->submitted;
+	output_buffer *b = &f->buffers[(u32) submitted % f->bufferCount];
+	b->offset = f->offset;
+	b->size = f->used;
+
+	// padding of direct write may stay in file if process dies before next write
+	if (f->direct && f->used % OUTPUT_ALIGN) {
+		u8 *data = OutputBufferData(f, submitted);
+		memset(data + f->used, 0, OUTPUT_ALIGN - f->used % OUTPUT_ALIGN);
+	}
+
+	BOGAtomicStore(&f->submitted, submitted + 1);
+	BOGWakeAll(&f->submitted);
+
+	f->keep = f->direct ? f->used % OUTPUT_ALIGN : 0;
+	f->offset += f->used - f->keep;
+	f->used = 0;
+}
+
+static bool OutputWrite(output_file *f, const void *data, udm size) {
+	if (BOGAtomicLoad(&f->failed)) return false;
+
+	// whole write is rejected when it doesn't fit, so file never misses part of it
+	for (;;) {
+		s32 written = BOGAtomicLoad(&f->written);
+		u32 queued = (u32) (f->submitted - written);
+		u64 available = (u64) (f->bufferCount - queued) * f->bufferSize;
+		if (size + f->used + f->keep <= available) break;
+
+		// waiting only makes sense if write fits once every buffer is free
+		u64 capacity = (u64) f->bufferCount * f->bufferSize;
+		if (!f->wait || size + f->used + f->keep > capacity || BOGAtomicLoad(&f->failed)) {
+			f->overflows++;
+			return false;
+		}
+
+		BOGWaitOnAddress(&f->written, written);
+	}
+
+	const u8 *src = (const u8 *) data;
+	while (size) {
+		u8 *dst = OutputBufferData(f, f->submitted);
+
+		// tail of previous buffer is still there, I/O thread only reads buffers
+		if (f->keep) {
+			const output_buffer *previous = &f->buffers[(u32) (f->submitted - 1) % f->bufferCount];
+			memmove(dst, OutputBufferData(f, f->submitted - 1) + previous->size - f->keep, f->keep);
+			f->used = f->keep;
+			f->keep = 0;
+		}
+
+		u32 count = f->bufferSize - f->used;
+		if (count > size) count = (u32) size;
+
+		memcpy(dst + f->used, src, count);
+		f->used += count;
+		f->size += count;
+		src += count;
+		size -= count;
+
+		if (f->used == f->bufferSize) OutputSubmit(f);
+	}
+
+	return true;
+}
+
+static bool OutputFits(output_file *f, udm size) {
+	if (BOGAtomicLoad(&f->failed)) return true;
+
+	u32 queued = (u32) (f->submitted - BOGAtomicLoad(&f->written));
+	u64 available = (u64) (f->bufferCount - queued) * f->bufferSize;
+	return size + f->used + f->keep <= available;
+}
+
+static bool OutputFlush(output_file *f) {
+	if (f->used) OutputSubmit(f);
+	return !BOGAtomicLoad(&f->failed);
+}
+
+static bool OutputClose(output_file *f) {
+	if (!f->memory) return false;
+
+	if (f->used) OutputSubmit(f);
+
+	BOGAtomicStore(&f->quit, 1);
+	BOGWakeAll(&f->submitted);
+	BOGThreadJoin(f->thread);
+
+	bool result = !BOGAtomicLoad(&f->failed);
+	if (!OutputPlatformTruncate(f, f->size)) result = false;
+
+	OutputPlatformClose(f);
+	BOGFree(f->memory, f->memorySize);
+	f->memory = 0;
+
+	return result;
+}
@@ -0,0 +1,92 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_memory.h"
+#include "bog/bog_thread.h"
+
+// output file written from its own thread, so thread producing data never waits for disk
+// bytes are collected into large aligned buffers, full buffers are written by I/O thread in order
+// file can bypass page cache & be preallocated in growing extents, so long recording doesn't
+// fragment file or evict everything else from cache
+
+#define OUTPUT_ALIGN 4096                 // buffer sizes & file offsets of direct writes
+#define OUTPUT_DEFAULT_BUFFER (4 << 20)
+#define OUTPUT_DEFAULT_COUNT 8
+#define OUTPUT_MAX_EXTENT (256 << 20)     // preallocated extents double up to this size
+
+// interface
+
+#ifdef _WIN32
+typedef wchar_t output_path;
+typedef HANDLE output_handle;
+#else
+typedef char output_path;
+typedef int output_handle;
+#endif
+
+typedef struct {
+	u32 bufferSize;  // multiple of OUTPUT_ALIGN, 0 uses OUTPUT_DEFAULT_BUFFER
+	u32 bufferCount; // 0 uses OUTPUT_DEFAULT_COUNT, all of them can be queued before writes fail
+	u32 preallocate; // size of first preallocated extent, 0 disables preallocation
+	bool direct;     // bypass page cache, ignored when file system does not support it
+	bool wait;       // OutputWrite waits for free buffer instead of failing, not for capture path
+} output_config;
+
+typedef struct {
+	u64 offset; // in file, multiple of OUTPUT_ALIGN
+	u32 size;   // valid bytes, direct writes are padded to OUTPUT_ALIGN
+} output_buffer;
+
+typedef struct {
+	output_handle file;
+	bool direct;
+	bool wait;
+	bog_thread thread;
+
+	u8 *data;              // bufferCount buffers of bufferSize bytes
+	output_buffer *buffers;
+	u32 bufferSize;
+	u32 bufferCount;
+
+	// buffers [written..submitted) belong to I/O thread, rest to producer
+	volatile s32 submitted;
+	volatile s32 written;
+	volatile s32 quit;
+	volatile s32 failed;   // write error, every later write fails
+
+	// producer side
+	u32 used;              // bytes in current buffer
+	u64 offset;            // file offset of current buffer
+	u64 size;              // total bytes written by producer
+	u32 keep;              // unaligned tail of flushed buffer, copied to start of next one
+	u32 overflows;         // writes rejected because every buffer was queued
+
+	// I/O thread side
+	u64 allocated;         // preallocated bytes of file
+	u64 extent;            // size of next preallocated extent
+
+	void *memory;
+	udm memorySize;
+} output_file;
+
+// creates or truncates file & starts I/O thread
+static bool OutputOpen(output_file *f, const output_path *path, const output_config *config);
+
+// copies data into buffers, never waits for disk unless config asked for it, returns false when
+// all buffers are queued for writing or when any earlier write failed
+static bool OutputWrite(output_file *f, const void *data, udm size);
+
+// whether size bytes, in any number of writes, would all be taken right now without waiting,
+// so producer can skip data that must not be written partially, true after write error so it fails
+static bool OutputFits(output_file *f, udm size);
+
+// queues partially filled buffer, so everything written so far reaches file soon
+// with direct writes last partial block is written again with next buffer
+static bool OutputFlush(output_file *f);
+
+// writes everything, waits for I/O thread & truncates file to exact size
+// returns false if any write failed
+static bool OutputClose(output_file *f);
+
+#endif //OUTPUT_H
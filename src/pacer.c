@@ -0,0 +1,112 @@
+#include "pacer.h"
+
+static void PacerStart(pacer *p, const pacer_config *config) {
+	p->config = *config;
+	if (!p->config.framerateNum) p->config.framerateNum = 1;
+	if (!p->config.framerateDen) p->config.framerateDen = 1;
+
+	TimeFrameStart(&p->slots, TimeRate(p->config.framerateNum, p->config.framerateDen),
+				   TimeRate(p->config.frequency, 1));
+	p->start = 0;
+	p->current = false;
+	p->submitted = false;
+	p->currentTime = 0;
+	p->lastTime = 0;
+	p->interval = 0;
+	p->frames = 0;
+	p->duplicates = 0;
+	p->dropped = 0;
+}
+
+// slots that start before time go to current frame
+static pacer_plan PacerAssign(pacer *p, u64 time) {
+	pacer_plan plan = {
+		.first = p->slots.index,
+		.count = 0,
+		.submit = false,
+		.drop = false
+	};
+
+	while (p->start + p->slots.time < time) {
+		plan.count++;
+		TimeFrameNext(&p->slots);
+	}
+
+	if (plan.count) {
+		plan.submit = !p->submitted;
+		p->submitted = true;
+		p->duplicates += plan.count - plan.submit;
+	}
+	return plan;
+}
+
+static pacer_plan PacerFrame(pacer *p, u64 time) {
+	pacer_plan plan = { 0 };
+	p->frames++;
+
+	if (!p->current) {
+		p->start = time;
+		p->currentTime = time;
+		p->lastTime = time;
+		p->current = true;
+		return plan;
+	}
+
+	// timestamps that go backwards count as same time
+	if (time < p->lastTime) time = p->lastTime;
+	u64 delta = time - p->lastTime;
+	p->lastTime = time;
+
+	// frame close to where cadence predicts it moves only bit towards its own time, anything
+	// else starts over from it
+	u64 smooth = time;
+	if (p->interval) {
+		s64 error = (s64) (time - (p->currentTime + p->interval));
+		s64 limit = (s64) (p->interval / 4);
+		if (error > -limit && error < limit) {
+			smooth = p->currentTime + p->interval + error / 16;
+			p->interval += error / 128;
+		} else {
+			p->interval = delta;
+		}
+	} else {
+		p->interval = delta;
+	}
+	if (smooth < p->currentTime) smooth = p->currentTime;
+
+	// slots before middle of both frames are nearer to current one
+	plan = PacerAssign(p, p->currentTime + (smooth - p->currentTime) / 2);
+	plan.drop = !p->submitted;
+	if (plan.drop) p->dropped++;
+
+	p->submitted = false;
+	p->currentTime = smooth;
+	return plan;
+}
+
+static pacer_plan PacerIdle(pacer *p, u64 time) {
+	pacer_plan plan = { 0 };
+	if (!p->current || time < p->currentTime) return plan;
+
+	// next frame won't be earlier than time
+	u64 middle = p->currentTime + (time - p->currentTime) / 2;
+	u64 late = time > p->config.latency ? time - p->config.latency : 0;
+	return PacerAssign(p, middle > late ? middle : late);
+}
+
+static pacer_plan PacerFlush(pacer *p) {
+	pacer_plan plan = { 0 };
+	if (!p->current) return plan;
+
+	// as if next frame came one slot later
+	plan = PacerAssign(p, p->currentTime + p->slots.step / 2 + 1);
+	plan.drop = !p->submitted;
+	if (plan.drop) p->dropped++;
+
+	p->current = false;
+	return plan;
+}
+
+static u64 PacerSlotTime(pacer *p, u64 slot, u64 units) {
+	return TimeConvert(slot, p->slots.frames, TimeRate(units, 1), TIME_FLOOR);
+}
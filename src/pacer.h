@@ -0,0 +1,63 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include "bog/bog_types.h"
+#include "timebase.h"
+
+// maps captured frames to slots of constant frame rate output, every slot gets frame with
+// nearest time & slots without own frame repeat one that was submitted before them
+// slot times are exact multiples of den / num seconds, stepped by frame clock so there is no
+// drift however long recording is
+// decision for frame is known once next frame arrives, so newest frame is kept as current one
+// until then, frame times are smoothed while they follow steady cadence, so capture at almost
+// same rate as output doesn't flip between repeated & dropped frames on every bit of jitter
+
+// interface
+
+typedef struct {
+	u32 framerateNum, framerateDen;
+	u64 frequency;     // clock ticks per second of frame times
+	u64 latency;       // clock ticks, older slot gets current frame even if newer one could come
+} pacer_config;
+
+// what to do with current frame
+typedef struct {
+	u64 first;         // first slot for it
+	u32 count;         // slots from first on that show it
+	bool submit;       // first of them submits frame, otherwise all of them repeat it
+	bool drop;         // frame got no slot & won't get one, its buffer can be reused
+} pacer_plan;
+
+typedef struct {
+	pacer_config config;
+	time_frame_clock slots; // at slot that is filled next, times from slot 0
+	u64 start;         // time of slot 0, which is time of first frame
+
+	bool current;      // there is current frame
+	bool submitted;    // it was submitted already
+	u64 currentTime;   // smoothed, so jitter doesn't move frames between slots near their middle
+	u64 lastTime;      // as frame came
+	u64 interval;      // estimated time between frames, 0 when not known
+
+	// statistics
+	u64 frames;        // frames given to pacer
+	u64 duplicates;    // slots that repeat previous frame
+	u64 dropped;       // frames that got no slot
+} pacer;
+
+static void PacerStart(pacer *p, const pacer_config *config);
+
+// new frame, plan is for frame that was current until now, new one becomes current
+static pacer_plan PacerFrame(pacer *p, u64 time);
+
+// no new frame yet, slots new frame can't be nearer to or that are older than latency go to
+// current frame
+static pacer_plan PacerIdle(pacer *p, u64 time);
+
+// end of recording, current frame gets its nearest slot if it doesn't have it yet
+static pacer_plan PacerFlush(pacer *p);
+
+// start of slot in any units per second, exact
+static u64 PacerSlotTime(pacer *p, u64 slot, u64 units);
+
+#endif //PACER_H
@@ -0,0 +1,172 @@
+#include "pool.h"
+
+static u32 PoolLowestBit(u32 mask) {
+	u32 index = 0;
+	while (!(mask & (1u << index))) index++;
+	return index;
+}
+
+// state of bit is always known to caller, so adding or subtracting it can't carry into others
+// only acquiring thread clears bits, any thread sets them
+static void PoolSetFree(buffer_pool *p, u32 index) {
+	BOGAtomicAdd(&p->free, (s32) (1u << index));
+}
+
+static void PoolTakeFree(buffer_pool *p, u32 index) {
+	BOGAtomicAdd(&p->free, (s32) (0u - (1u << index)));
+}
+
+static bool PoolGrow(buffer_pool *p) {
+	if (p->count >= p->config.maxCount) return false;
+
+	u32 index = PoolLowestBit(~p->allocated);
+	if (!p->config.create(p->config.user, index)) {
+		// don't retry for every acquire
+		p->config.maxCount = p->count;
+		return false;
+	}
+
+	p->allocated |= 1u << index;
+	p->count++;
+	if (p->count > p->maxUsed) p->maxUsed = p->count;
+	PoolSetFree(p, index);
+
+	return true;
+}
+
+static void PoolShrink(buffer_pool *p, u32 free) {
+	// highest free buffer goes, so used ones stay packed at low indices
+	for (u32 index = POOL_MAX_BUFFERS; index-- > 0; ) {
+		if (free & (1u << index)) {
+			PoolTakeFree(p, index);
+			p->config.destroy(p->config.user, index);
+			p->allocated &= ~(1u << index);
+			p->count--;
+			break;
+		}
+	}
+}
+
+static void PoolAddLatency(buffer_pool *p, u64 latency) {
+	if (latency > p->peak[0]) p->peak[0] = latency;
+}
+
+static bool PoolCreate(buffer_pool *p, const pool_config *config, u64 now) {
+	p->config = *config;
+	if (p->config.maxCount > POOL_MAX_BUFFERS) p->config.maxCount = POOL_MAX_BUFFERS;
+	if (!p->config.minCount) p->config.minCount = 1;
+	if (p->config.minCount > p->config.maxCount) return false;
+	if (!p->config.interval) p->config.interval = 1;
+
+	p->free = 0;
+	p->allocated = 0;
+	p->inFlight = 0;
+	p->count = 0;
+	p->target = p->config.minCount;
+	p->peak[0] = 0;
+	p->peak[1] = 0;
+	p->windowStart = now;
+	p->surplusSince = 0;
+	p->maxUsed = 0;
+	p->drops = 0;
+
+	while (p->count < p->config.minCount) {
+		if (!PoolGrow(p)) {
+			PoolDestroy(p);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void PoolDestroy(buffer_pool *p) {
+	for (u32 index = 0; index < POOL_MAX_BUFFERS; ++index) {
+		if (p->allocated & (1u << index)) p->config.destroy(p->config.user, index);
+	}
+
+	p->allocated = 0;
+	p->count = 0;
+	p->free = 0;
+}
+
+static s32 PoolAcquire(buffer_pool *p, u64 now) {
+	if (now - p->windowStart >= p->config.window) {
+		p->peak[1] = now - p->windowStart >= 2 * p->config.window ? 0 : p->peak[0];
+		p->peak[0] = 0;
+		p->windowStart = now;
+	}
+
+	// latency of buffers returned since last acquire
+	u32 free = (u32) BOGAtomicLoad(&p->free);
+	u32 returned = p->inFlight & free;
+	p->inFlight &= ~returned;
+
+	for (; returned; returned &= returned - 1) {
+		u32 index = PoolLowestBit(returned);
+		PoolAddLatency(p, p->returnTime[index] - p->submitTime[index]);
+	}
+
+	// buffers still in flight are at least this late already
+	for (u32 late = p->inFlight; late; late &= late - 1) {
+		PoolAddLatency(p, now - p->submitTime[PoolLowestBit(late)]);
+	}
+
+	// one buffer in flight for every interval of latency, & one being filled
+	u64 latency = p->peak[0] > p->peak[1] ? p->peak[0] : p->peak[1];
+	u64 needed = (latency + p->config.interval - 1) / p->config.interval + 1;
+	p->target = needed < p->config.minCount ? p->config.minCount :
+				needed > p->config.maxCount ? p->config.maxCount : (u32) needed;
+
+	while (p->count < p->target && PoolGrow(p)) {}
+
+	if (p->count > p->target) {
+		if (!p->surplusSince) {
+			p->surplusSince = now;
+		} else if (now - p->surplusSince >= p->config.window) {
+			PoolShrink(p, free & ~p->inFlight);
+			p->surplusSince = now;
+		}
+	} else {
+		p->surplusSince = 0;
+	}
+
+	// latency of new buffer is not known yet, so growing is better than dropping
+	free = (u32) BOGAtomicLoad(&p->free);
+	if (!free && PoolGrow(p)) free = (u32) BOGAtomicLoad(&p->free);
+
+	if (!free) {
+		p->drops++;
+		return -1;
+	}
+
+	u32 index = PoolLowestBit(free);
+	PoolTakeFree(p, index);
+	p->inFlight |= 1u << index;
+	p->submitTime[index] = now;
+
+	return (s32) index;
+}
+
+static void PoolCancel(buffer_pool *p, s32 index) {
+	// next acquire sees it returned without any time in flight
+	p->returnTime[index] = p->submitTime[index];
+	PoolSetFree(p, (u32) index);
+}
+
+static void PoolRelease(buffer_pool *p, s32 index, u64 now) {
+	p->returnTime[index] = now;
+	PoolSetFree(p, (u32) index);
+}
+
+static u64 PoolMemory(buffer_pool *p) {
+	return p->count * p->config.bufferSize;
+}
+
+static u32 PoolInFlight(buffer_pool *p) {
+	u32 count = 0;
+	for (u32 mask = p->inFlight & ~(u32) BOGAtomicLoad(&p->free); mask; mask &= mask - 1) {
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,75 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_thread.h"
+
+// reusable buffers that stay in flight for a while after they are submitted, like frames queued
+// to encoder
+// number of buffers follows measured time from submission to return, pool starts small, grows as
+// soon as returns get late & shrinks by one buffer at time once there are more than needed
+// one thread acquires buffers, any thread can return them
+
+#define POOL_MAX_BUFFERS 32
+
+// interface
+
+// allocate or free buffer number index, create can fail & pool then stops growing
+typedef bool pool_create(void *user, u32 index);
+typedef void pool_destroy(void *user, u32 index);
+
+typedef struct {
+	u32 minCount;      // always allocated, at least 1
+	u32 maxCount;      // up to POOL_MAX_BUFFERS
+	u64 bufferSize;    // bytes held by one buffer, only for reporting
+	u64 interval;      // clock ticks between acquires at expected rate
+	u64 window;        // clock ticks latency peak is kept, & pool must be too big before shrink
+	pool_create *create;
+	pool_destroy *destroy;
+	void *user;
+} pool_config;
+
+typedef struct {
+	pool_config config;
+
+	volatile s32 free;                // bit for every allocated buffer that is not in flight
+	u64 submitTime[POOL_MAX_BUFFERS];
+	u64 returnTime[POOL_MAX_BUFFERS]; // set by returning thread before free bit
+
+	// acquiring thread only
+	u32 allocated;     // bit for every allocated buffer
+	u32 inFlight;      // acquired & not seen returned yet
+	u32 count;
+	u32 target;        // count needed for current latency
+	u64 peak[2];       // latency max of current & previous window
+	u64 windowStart;
+	u64 surplusSince;  // when count got above target, 0 when it is not
+
+	// statistics
+	u32 maxUsed;       // highest count so far
+	u32 drops;         // acquires that found no buffer
+} buffer_pool;
+
+// creates minCount buffers, now is time in same clock ticks as all other calls use
+static bool PoolCreate(buffer_pool *p, const pool_config *config, u64 now);
+
+// destroys every buffer, none may be in flight anymore
+static void PoolDestroy(buffer_pool *p);
+
+// returns index of free buffer, grows or shrinks pool first when needed
+// -1 when every buffer is in flight & pool can't grow
+static s32 PoolAcquire(buffer_pool *p, u64 now);
+
+// any thread, gives acquired buffer back when it was not submitted after all, adds no latency
+static void PoolCancel(buffer_pool *p, s32 index);
+
+// any thread, buffer is not used by consumer anymore
+static void PoolRelease(buffer_pool *p, s32 index, u64 now);
+
+// bytes held by allocated buffers
+static u64 PoolMemory(buffer_pool *p);
+
+// acquiring thread, buffers submitted & not returned yet
+static u32 PoolInFlight(buffer_pool *p);
+
+#endif //POOL_H
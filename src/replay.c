@@ -0,0 +1,200 @@
+#include "replay.h"
+
+#include <string.h>
+
+static replay_sample *ReplaySampleAt(replay_ring *r, s32 index) {
+	return &r->samples[(u32) index % r->sampleCount];
+}
+
+// index of first sync sample of primary track after index, or head if there is none
+static s32 ReplayNextGop(replay_ring *r, s32 index, s32 head) {
+	if (index == head) return head;
+
+	for (++index; index != head; ++index) {
+		replay_sample *s = ReplaySampleAt(r, index);
+		if (s->track == r->primary && s->sync) break;
+	}
+	return index;
+}
+
+static bool ReplayCreate(replay_ring *r, const mp4_track_config *tracks, u32 trackCount,
+						 const replay_config *config) {
+	if (!trackCount || trackCount > MP4_MAX_TRACKS || !config->size) return false;
+
+	r->trackCount = trackCount;
+	r->primary = 0;
+
+	for (u32 i = 0; i < trackCount; ++i) {
+		if (tracks[i].configSize > MP4_MAX_CONFIG) return false;
+
+		r->tracks[i] = tracks[i];
+		r->tracks[i].config = r->configs[i];
+		memcpy(r->configs[i], tracks[i].config, tracks[i].configSize);
+	}
+
+	for (u32 i = trackCount; i-- > 0; ) {
+		if (tracks[i].codec == MP4_CODEC_H264) r->primary = i;
+	}
+
+	r->sampleCount = config->sampleCount ? config->sampleCount : REPLAY_DEFAULT_SAMPLES;
+	r->maxSample = config->maxSample ? config->maxSample : REPLAY_DEFAULT_MAX_SAMPLE;
+	r->size = config->size;
+	r->duration = (u64) config->duration * r->tracks[r->primary].timescale / 1000;
+
+	r->memorySize = r->size + (udm) r->sampleCount * sizeof(replay_sample) + r->maxSample;
+	r->memory = BOGAlloc(r->memorySize);
+	if (!r->memory) return false;
+
+	r->samples = (replay_sample *) r->memory;
+	r->data = (u8 *) (r->samples + r->sampleCount);
+	r->scratch = r->data + r->size;
+
+	r->head = 0;
+	r->tail = 0;
+	r->offset = 0;
+	r->stored = 0;
+	r->peak = 0;
+	r->flushing = 0;
+
+	return true;
+}
+
+static void ReplayDestroy(replay_ring *r) {
+	BOGFree(r->memory, r->memorySize);
+	r->memory = 0;
+}
+
+static bool ReplayWriteSample(replay_ring *r, u32 track, const void *data, u32 size,
+							  u64 decodeTime, u64 compositionTime, bool sync) {
+	if (track >= r->trackCount || size > r->maxSample || size > r->size) return false;
+
+	s32 head = r->head;
+	s32 tail = r->tail;
+	bool gop = track == r->primary && sync;
+
+	// nothing can be decoded before first IDR frame
+	if (head == tail && !gop) return true;
+
+	// oldest GOP is not needed once next one alone covers whole duration
+	if (gop && r->duration) {
+		for (;;) {
+			s32 next = ReplayNextGop(r, tail, head);
+			if (next == head) break;
+			if (decodeTime - ReplaySampleAt(r, next)->decodeTime < r->duration) break;
+			tail = next;
+		}
+	}
+
+	// when even newest GOP has to go, ring stays empty until next IDR frame
+	for (;;) {
+		bool full = (u32) (head - tail) >= r->sampleCount;
+		if (head != tail && r->offset + size - ReplaySampleAt(r, tail)->offset > r->size) {
+			full = true;
+		}
+		if (!full) break;
+
+		tail = ReplayNextGop(r, tail, head);
+	}
+
+	// readers must see eviction before evicted bytes are overwritten
+	if (tail != r->tail) BOGAtomicStore(&r->tail, tail);
+	if (head == tail && !gop) return true;
+
+	replay_sample *s = ReplaySampleAt(r, head);
+	s->offset = r->offset;
+	s->decodeTime = decodeTime;
+	s->compositionTime = compositionTime;
+	s->size = size;
+	s->track = (u16) track;
+	s->sync = (u16) sync;
+
+	u64 position = r->offset % r->size;
+	u32 first = r->size - position < size ? (u32) (r->size - position) : size;
+	memcpy(r->data + position, data, first);
+	memcpy(r->data, (const u8 *) data + first, size - first);
+	r->offset += size;
+
+	r->stored = r->offset - ReplaySampleAt(r, tail)->offset;
+	if (r->stored > r->peak) r->peak = r->stored;
+
+	BOGAtomicStore(&r->head, head + 1);
+	return true;
+}
+
+static bool ReplayMuxWrite(void *user, const void *data, udm size) {
+	return OutputWrite((output_file *) user, data, size);
+}
+
+static bool ReplayFlush(replay_ring *r, const output_path *path, const output_config *output,
+						u32 fragmentDuration) {
+	if (BOGAtomicAdd(&r->flushing, 1) != 1) {
+		BOGAtomicAdd(&r->flushing, -1);
+		return false;
+	}
+
+	s32 end = BOGAtomicLoad(&r->head);
+	s32 index = BOGAtomicLoad(&r->tail);
+	bool result = index != end;
+
+	// flush is not on capture path, it can wait for disk
+	output_config config = *output;
+	config.wait = true;
+
+	output_file file;
+	mp4_muxer muxer;
+	if (result) result = OutputOpen(&file, path, &config);
+	if (result && !Mp4Create(&muxer, r->tracks, r->trackCount, fragmentDuration, ReplayMuxWrite,
+							 &file)) {
+		OutputClose(&file);
+		result = false;
+	}
+
+	if (result) {
+		u64 origin[MP4_MAX_TRACKS];
+		bool started = false;
+
+		for (; index != end; ++index) {
+			replay_sample s = *ReplaySampleAt(r, index);
+
+			u64 position = s.offset % r->size;
+			u32 first = r->size - position < s.size ? (u32) (r->size - position) : s.size;
+			memcpy(r->scratch, r->data + position, first);
+			memcpy(r->scratch + first, r->data, s.size - first);
+
+			// sample was evicted while it was copied, continue from oldest GOP that is left
+			s32 tail = BOGAtomicLoad(&r->tail);
+			if ((s32) (tail - index) > 0) {
+				if ((s32) (tail - end) >= 0) break;
+				index = tail - 1;
+				continue;
+			}
+
+			// file starts at oldest IDR frame
+			if (!started) {
+				u32 timescale = r->tracks[r->primary].timescale;
+				for (u32 i = 0; i < r->trackCount; ++i) {
+					origin[i] = Mp4ConvertTime(s.decodeTime, timescale, r->tracks[i].timescale);
+				}
+				started = true;
+			}
+
+			if (s.decodeTime < origin[s.track]) continue;
+
+			u64 o = origin[s.track];
+			if (!Mp4WriteSample(&muxer, s.track, r->scratch, s.size, s.decodeTime - o,
+								s.compositionTime - o, s.sync != 0)) {
+				result = false;
+				break;
+			}
+		}
+
+		// everything was evicted before first sample could be copied
+		if (!started) result = false;
+		if (!Mp4Finish(&muxer)) result = false;
+		Mp4Destroy(&muxer);
+		if (!OutputClose(&file)) result = false;
+	}
+
+	BOGAtomicAdd(&r->flushing, -1);
+	return result;
+}
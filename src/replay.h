@@ -0,0 +1,81 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_memory.h"
+#include "bog/bog_thread.h"
+#include "mp4.h"
+#include "output.h"
+
+// keeps last seconds of encoded samples in memory, so recording can be saved after something
+// happened without writing to disk all the time
+// samples of all tracks are stored in arrival order in fixed ring of bytes with fixed ring of
+// sample entries, oldest GOPs are evicted whole so ring always starts with IDR frame
+// one thread writes, any other thread can flush ring to MP4 file at same time without locks,
+// reader copies sample & then checks it was not evicted meanwhile
+
+#define REPLAY_DEFAULT_SAMPLES 65536
+#define REPLAY_DEFAULT_MAX_SAMPLE (4 << 20)
+
+// interface
+
+typedef struct {
+	u32 duration;      // msec kept, older GOPs are evicted once newer ones cover this time
+	u64 size;          // bytes of sample data, older GOPs are evicted when it's full
+	u32 sampleCount;   // 0 uses REPLAY_DEFAULT_SAMPLES
+	u32 maxSample;     // 0 uses REPLAY_DEFAULT_MAX_SAMPLE, larger samples are rejected
+} replay_config;
+
+typedef struct {
+	u64 offset;        // in stream of all bytes ever written, data is at offset % size
+	u64 decodeTime;
+	u64 compositionTime;
+	u32 size;
+	u16 track;
+	u16 sync;
+} replay_sample;
+
+typedef struct {
+	mp4_track_config tracks[MP4_MAX_TRACKS];
+	u8 configs[MP4_MAX_TRACKS][MP4_MAX_CONFIG];
+	u32 trackCount;
+	u32 primary;       // first video track, GOPs are made of its sync samples
+
+	u8 *data;
+	u64 size;
+	replay_sample *samples;
+	u32 sampleCount;
+	u32 maxSample;
+	u64 duration;      // in timescale of primary track
+
+	// samples [tail..head) are valid, indices wrap around
+	// tail is always sync sample of primary track & moves before any data is overwritten
+	volatile s32 head;
+	volatile s32 tail;
+	u64 offset;        // writer side, end of written bytes
+	u64 stored;        // bytes of valid samples, writer side
+	u64 peak;          // largest value of stored, for reporting
+
+	u8 *scratch;       // one sample copied by flush before it is validated
+	volatile s32 flushing;
+
+	void *memory;
+	udm memorySize;
+} replay_ring;
+
+static bool ReplayCreate(replay_ring *r, const mp4_track_config *tracks, u32 trackCount,
+						 const replay_config *config);
+static void ReplayDestroy(replay_ring *r);
+
+// same as Mp4WriteSample, never allocates, only one thread may write
+// samples before first IDR frame are dropped
+static bool ReplayWriteSample(replay_ring *r, u32 track, const void *data, u32 size,
+							  u64 decodeTime, u64 compositionTime, bool sync);
+
+// writes everything in ring at time of call to file, timestamps start at 0 from oldest IDR frame
+// writer can keep writing meanwhile, if it evicts GOP that is being flushed, flush jumps to
+// next IDR frame still in ring, only one flush can run at time
+static bool ReplayFlush(replay_ring *r, const output_path *path, const output_config *output,
+						u32 fragmentDuration);
+
+#endif //REPLAY_H
@@ -0,0 +1,597 @@
+#include "resampler.h"
+
+// stopband attenuation in dB that filter length & kaiser window are designed for
+#define RESAMPLER_ATTENUATION 100.0
+#define RESAMPLER_PASSBAND 20000.0
+#define RESAMPLER_PI 3.14159265358979323846
+
+// one output frame, dot product of taps stereo frames with taps coefficient pairs
+typedef void resampler_filter(const f32 *history, const f32 *coefficients, u32 taps, f32 *out);
+
+// count values to s16 with dither
+typedef void resampler_convert(const f32 *src, s16 *dst, u32 count, resampler_dither *dither);
+
+static resampler_filter *gResamplerFilter;
+static resampler_convert *gResamplerConvert;
+static bog_cpu_level gResamplerLevel;
+
+static d64 ResamplerSin(d64 x) {
+	// to [-pi/2..pi/2], where series converges fast
+	d64 turns = x / (2 * RESAMPLER_PI);
+	x -= 2 * RESAMPLER_PI * (d64) (s64) (turns < 0 ? turns - 0.5 : turns + 0.5);
+	if (x > RESAMPLER_PI / 2) x = RESAMPLER_PI - x;
+	if (x < -RESAMPLER_PI / 2) x = -RESAMPLER_PI - x;
+
+	d64 x2 = x * x;
+	d64 term = x;
+	d64 sum = x;
+	for (u32 k = 1; k < 12; ++k) {
+		term *= -x2 / ((2 * k) * (2 * k + 1));
+		sum += term;
+	}
+	return sum;
+}
+
+static d64 ResamplerSqrt(d64 x) {
+	if (x <= 0) return 0;
+	d64 y = x > 1 ? x : 1;
+	for (u32 i = 0; i < 64; ++i) {
+		d64 next = (y + x / y) / 2;
+		if (next >= y) break;
+		y = next;
+	}
+	return y;
+}
+
+// modified bessel function of first kind, order 0
+static d64 ResamplerBessel(d64 x) {
+	d64 term = 1;
+	d64 sum = 1;
+	for (u32 k = 1; k < 64 && term > sum * 1e-17; ++k) {
+		d64 half = x / (2 * k);
+		term *= half * half;
+		sum += term;
+	}
+	return sum;
+}
+
+static void ResamplerFilterScalar(const f32 *history, const f32 *coefficients, u32 taps,
+								  f32 *out) {
+	f32 left = 0;
+	f32 right = 0;
+	for (u32 k = 0; k < 2 * taps; k += 2) {
+		left += history[k] * coefficients[k];
+		right += history[k + 1] * coefficients[k + 1];
+	}
+	out[0] = left;
+	out[1] = right;
+}
+
+static inline u32 ResamplerRandom(u32 *state) {
+	u32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+// clamps before rounding to nearest even, same as SIMD conversion, NaN becomes -32768 in both
+static inline s16 ResamplerToS16(f32 value, resampler_dither *d) {
+	// sum of two uniform values is triangular over +-1 LSB
+	u32 random = ResamplerRandom(&d->state[d->lane]);
+	d->lane = (d->lane + 1) & 7;
+	s32 triangular = (s32) (random & 0xFFFF) + (s32) (random >> 16) - 0xFFFF;
+
+	f32 scaled = value * 32768.0f + (f32) triangular * d->scale;
+	scaled = scaled > -32768.0f ? scaled : -32768.0f;
+	scaled = scaled < 32767.0f ? scaled : 32767.0f;
+	scaled = (scaled + 12582912.0f) - 12582912.0f; // 1.5 * 2^23 leaves no fraction bits
+	return (s16) (s32) scaled;
+}
+
+static void ResamplerConvertScalar(const f32 *src, s16 *dst, u32 count, resampler_dither *d) {
+	for (u32 i = 0; i < count; ++i) dst[i] = ResamplerToS16(src[i], d);
+}
+
+#ifdef BOG_X86
+BOG_TARGET_SSE2
+static inline __m128i ResamplerRandomSSE2(__m128i x) {
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+BOG_TARGET_SSE2
+static inline __m128 ResamplerDitherSSE2(__m128i random, __m128 scale) {
+	__m128i low = _mm_and_si128(random, _mm_set1_epi32(0xFFFF));
+	__m128i triangular = _mm_sub_epi32(_mm_add_epi32(low, _mm_srli_epi32(random, 16)),
+									   _mm_set1_epi32(0xFFFF));
+	return _mm_mul_ps(_mm_cvtepi32_ps(triangular), scale);
+}
+
+BOG_TARGET_SSE2
+static void ResamplerConvertSSE2(const f32 *src, s16 *dst, u32 count, resampler_dither *d) {
+	// until value that uses first generator
+	u32 i = 0;
+	for (; i < count && d->lane; ++i) dst[i] = ResamplerToS16(src[i], d);
+
+	__m128i state0 = _mm_loadu_si128((const __m128i *) d->state);
+	__m128i state1 = _mm_loadu_si128((const __m128i *) (d->state + 4));
+	__m128 scale = _mm_set1_ps(d->scale);
+	__m128 full = _mm_set1_ps(32768.0f);
+	__m128 low = _mm_set1_ps(-32768.0f);
+	__m128 high = _mm_set1_ps(32767.0f);
+	for (; i + 8 <= count; i += 8) {
+		state0 = ResamplerRandomSSE2(state0);
+		state1 = ResamplerRandomSSE2(state1);
+		__m128 value0 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), full),
+								   ResamplerDitherSSE2(state0, scale));
+		__m128 value1 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), full),
+								   ResamplerDitherSSE2(state1, scale));
+		value0 = _mm_min_ps(_mm_max_ps(value0, low), high);
+		value1 = _mm_min_ps(_mm_max_ps(value1, low), high);
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_packs_epi32(_mm_cvtps_epi32(value0),
+																 _mm_cvtps_epi32(value1)));
+	}
+	_mm_storeu_si128((__m128i *) d->state, state0);
+	_mm_storeu_si128((__m128i *) (d->state + 4), state1);
+
+	for (; i < count; ++i) dst[i] = ResamplerToS16(src[i], d);
+}
+
+BOG_TARGET_AVX2
+static void ResamplerConvertAVX2(const f32 *src, s16 *dst, u32 count, resampler_dither *d) {
+	u32 i = 0;
+	for (; i < count && d->lane; ++i) dst[i] = ResamplerToS16(src[i], d);
+
+	__m256i state = _mm256_loadu_si256((const __m256i *) d->state);
+	__m256 scale = _mm256_set1_ps(d->scale);
+	__m256 full = _mm256_set1_ps(32768.0f);
+	__m256 low = _mm256_set1_ps(-32768.0f);
+	__m256 high = _mm256_set1_ps(32767.0f);
+	__m256i mask = _mm256_set1_epi32(0xFFFF);
+	for (; i + 8 <= count; i += 8) {
+		state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+		state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+		state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+		__m256i triangular = _mm256_add_epi32(_mm256_and_si256(state, mask),
+											  _mm256_srli_epi32(state, 16));
+		triangular = _mm256_sub_epi32(triangular, mask);
+
+		__m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), full),
+									 _mm256_mul_ps(_mm256_cvtepi32_ps(triangular), scale));
+		value = _mm256_min_ps(_mm256_max_ps(value, low), high);
+		__m256i rounded = _mm256_cvtps_epi32(value);
+		_mm_storeu_si128((__m128i *) (dst + i),
+						 _mm_packs_epi32(_mm256_castsi256_si128(rounded),
+										 _mm256_extracti128_si256(rounded, 1)));
+	}
+	_mm256_storeu_si256((__m256i *) d->state, state);
+
+	for (; i < count; ++i) dst[i] = ResamplerToS16(src[i], d);
+}
+
+BOG_TARGET_SSE2
+static void ResamplerFilterSSE2(const f32 *history, const f32 *coefficients, u32 taps, f32 *out) {
+	// taps are multiple of 8, four sums so adds don't wait for each other
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	__m128 sum2 = _mm_setzero_ps();
+	__m128 sum3 = _mm_setzero_ps();
+	for (u32 k = 0; k < 2 * taps; k += 16) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(history + k),
+										   _mm_load_ps(coefficients + k)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(history + k + 4),
+										   _mm_load_ps(coefficients + k + 4)));
+		sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(history + k + 8),
+										   _mm_load_ps(coefficients + k + 8)));
+		sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(history + k + 12),
+										   _mm_load_ps(coefficients + k + 12)));
+	}
+
+	// left, right, left, right
+	__m128 sum = _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	_mm_storel_pi((__m64 *) out, sum);
+}
+
+BOG_TARGET_AVX2
+static void ResamplerFilterAVX2(const f32 *history, const f32 *coefficients, u32 taps, f32 *out) {
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	__m256 sum2 = _mm256_setzero_ps();
+	__m256 sum3 = _mm256_setzero_ps();
+	u32 k = 0;
+	for (; k + 32 <= 2 * taps; k += 32) {
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(history + k),
+												 _mm256_load_ps(coefficients + k)));
+		sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(history + k + 8),
+												 _mm256_load_ps(coefficients + k + 8)));
+		sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(_mm256_loadu_ps(history + k + 16),
+												 _mm256_load_ps(coefficients + k + 16)));
+		sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(_mm256_loadu_ps(history + k + 24),
+												 _mm256_load_ps(coefficients + k + 24)));
+	}
+	for (; k < 2 * taps; k += 16) {
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(history + k),
+												 _mm256_load_ps(coefficients + k)));
+		sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(history + k + 8),
+												 _mm256_load_ps(coefficients + k + 8)));
+	}
+
+	__m256 wide = _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3));
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(wide), _mm256_extractf128_ps(wide, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	_mm_storel_pi((__m64 *) out, sum);
+}
+#endif
+
+static void ResamplerSetLevel(bog_cpu_level level) {
+	switch (level) {
+#ifdef BOG_X86
+		case BOG_CPU_AVX2: {
+			gResamplerFilter = ResamplerFilterAVX2;
+			gResamplerConvert = ResamplerConvertAVX2;
+		} break;
+
+		case BOG_CPU_SSE2: {
+			gResamplerFilter = ResamplerFilterSSE2;
+			gResamplerConvert = ResamplerConvertSSE2;
+		} break;
+#endif
+
+		default: {
+			level = BOG_CPU_SCALAR;
+			gResamplerFilter = ResamplerFilterScalar;
+			gResamplerConvert = ResamplerConvertScalar;
+		}
+	}
+
+	gResamplerLevel = level;
+}
+
+static bog_cpu_level ResamplerGetLevel(void) {
+	return gResamplerLevel;
+}
+
+static void ResamplerInit(void) {
+	ResamplerSetLevel(BOGCpuLevel());
+}
+
+static void ResamplerConvert(const f32 *src, s16 *dst, u32 count, resampler_dither *dither) {
+	gResamplerConvert(src, dst, count, dither);
+}
+
+static u32 ResamplerGcd(u32 a, u32 b) {
+	while (b) {
+		u32 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// ITU style downmix, centre & surrounds at -3 dB, LFE is dropped
+static void ResamplerMixInit(resampler *r) {
+	const resampler_config *c = &r->config;
+	for (u32 i = 0; i < RESAMPLER_MAX_CHANNELS; ++i) {
+		r->mix[0][i] = 0;
+		r->mix[1][i] = 0;
+	}
+
+	if (c->channels == 1) {
+		r->mix[0][0] = 1;
+		r->mix[1][0] = 1;
+		return;
+	}
+
+	u32 mask = c->channelMask;
+	if (!mask) {
+		static const u32 layouts[RESAMPLER_MAX_CHANNELS + 1] = {
+			0, 0, 0x3, 0x7, 0x33, 0x37, 0x3F, 0x70F, 0x63F
+		};
+		mask = layouts[c->channels];
+	}
+
+	f32 half = 0.70710678f;
+	u32 channel = 0;
+	for (u32 bit = 0; bit < 32 && channel < c->channels; ++bit) {
+		if (!(mask & (1u << bit))) continue;
+
+		f32 left = 0;
+		f32 right = 0;
+		switch (1u << bit) {
+			case RESAMPLER_FRONT_LEFT:
+			case RESAMPLER_FRONT_LEFT_OF_CENTER: left = 1; break;
+			case RESAMPLER_FRONT_RIGHT:
+			case RESAMPLER_FRONT_RIGHT_OF_CENTER: right = 1; break;
+			case RESAMPLER_FRONT_CENTER: left = right = half; break;
+			case RESAMPLER_BACK_LEFT:
+			case RESAMPLER_SIDE_LEFT: left = half; break;
+			case RESAMPLER_BACK_RIGHT:
+			case RESAMPLER_SIDE_RIGHT: right = half; break;
+			case RESAMPLER_BACK_CENTER: left = right = 0.5f; break;
+		}
+		r->mix[0][channel] = left;
+		r->mix[1][channel] = right;
+		channel++;
+	}
+}
+
+// kaiser windowed sinc for every phase, each phase sums to exactly 1
+static void ResamplerCoefficientsInit(resampler *r) {
+	const resampler_config *c = &r->config;
+	u32 lower = c->inRate < c->outRate ? c->inRate : c->outRate;
+	d64 cutoff = 0.5 * lower / c->inRate; // cycles per input frame
+	d64 beta = 0.1102 * (RESAMPLER_ATTENUATION - 8.7);
+	d64 scale = 1 / ResamplerBessel(beta);
+	d64 half = r->taps / 2;
+
+	for (u32 phase = 0; phase < r->up; ++phase) {
+		f32 *coefficients = r->coefficients + 2 * r->taps * phase;
+		d64 offset = (d64) phase / r->up;
+
+		d64 values[RESAMPLER_MAX_TAPS];
+		d64 sum = 0;
+		for (u32 k = 0; k < r->taps; ++k) {
+			// from interpolated point, which is between taps half - 1 & half
+			d64 t = k - (half - 1) - offset;
+			d64 u = t / half;
+			d64 window = 0;
+			if (u > -1 && u < 1) window = ResamplerBessel(beta * ResamplerSqrt(1 - u * u)) * scale;
+			d64 x = 2 * cutoff * t;
+			d64 sinc = x != 0 ? ResamplerSin(RESAMPLER_PI * x) / (RESAMPLER_PI * x) : 1;
+			values[k] = 2 * cutoff * sinc * window;
+			sum += values[k];
+		}
+
+		for (u32 k = 0; k < r->taps; ++k) {
+			f32 value = (f32) (values[k] / sum);
+			coefficients[2 * k + 0] = value;
+			coefficients[2 * k + 1] = value;
+		}
+	}
+}
+
+// first output is at first input frame, so history starts with zeros before it
+static void ResamplerReset(resampler *r) {
+	r->count = r->bypass ? 0 : r->taps / 2 - 1;
+	for (u32 i = 0; i < 2 * r->count; ++i) r->history[i] = 0;
+	r->position = 0;
+	r->phase = 0;
+	r->fraction = 0;
+
+	// any nonzero seeds, different for every generator
+	for (u32 i = 0; i < 8; ++i) r->dither.state[i] = 0x9E3779B9u * (i + 1);
+	r->dither.lane = 0;
+}
+
+static bool ResamplerCreate(resampler *r, const resampler_config *config) {
+	r->config = *config;
+	const resampler_config *c = &r->config;
+	if (!c->channels || c->channels > RESAMPLER_MAX_CHANNELS || !c->inRate || !c->outRate) {
+		return false;
+	}
+
+	u32 bytes[] = { 2, 3, 4, 4 };
+	r->frameSize = c->channels * bytes[c->format];
+
+	u32 gcd = ResamplerGcd(c->inRate, c->outRate);
+	r->up = c->outRate / gcd;
+	r->down = c->inRate / gcd;
+	r->step = r->down / r->up;
+	r->stepRemainder = r->down % r->up;
+	r->adjust = 0;
+	r->taps = 0;
+
+	// more phases of same step, fraction is interpolated between neighbours
+	if (c->variable && r->up < RESAMPLER_MIN_PHASES) {
+		u32 scale = (RESAMPLER_MIN_PHASES + r->up - 1) / r->up;
+		r->up *= scale;
+		r->down *= scale;
+		r->stepRemainder *= scale;
+	}
+	r->bypass = r->up == 1 && r->down == 1;
+
+	// s16 that is only copied to both or same channels is already exact
+	ResamplerMixInit(r);
+	bool identity = c->channels == 2 && r->mix[0][0] == 1 && r->mix[1][1] == 1 &&
+					r->mix[0][1] == 0 && r->mix[1][0] == 0;
+	bool exact = r->bypass && c->format == RESAMPLER_S16 && (c->channels == 1 || identity);
+	r->direct = r->bypass && c->format == RESAMPLER_F32 && identity;
+	r->dither.scale = exact ? 0 : 1.0f / 65536;
+
+	if (!r->bypass) {
+		// transition band from passband to what would alias into passband, kaiser formula for
+		// length
+		d64 lower = c->inRate < c->outRate ? c->inRate : c->outRate;
+		d64 pass = RESAMPLER_PASSBAND < 0.45 * lower ? RESAMPLER_PASSBAND : 0.45 * lower;
+		d64 transition = (lower - 2 * pass) / c->inRate;
+		d64 length = (RESAMPLER_ATTENUATION - 7.95) / (2.285 * 2 * RESAMPLER_PI * transition) + 1;
+		r->taps = ((u32) length + 8) & ~7u;
+		if (r->taps > RESAMPLER_MAX_TAPS || r->up * r->taps > RESAMPLER_MAX_COEFFICIENTS) {
+			return false;
+		}
+	}
+
+	// bypass only needs history for mixed block
+	udm coefficientsSize = (udm) r->up * r->taps * 2 * sizeof(f32);
+	udm historySize = (udm) (r->taps + RESAMPLER_BLOCK) * 2 * sizeof(f32);
+	udm outputSize = r->bypass ? 0 : RESAMPLER_BLOCK * 2 * sizeof(f32);
+	r->memorySize = coefficientsSize + historySize + outputSize;
+	r->memory = BOGAlloc(r->memorySize);
+	if (!r->memory) return false;
+
+	r->coefficients = (f32 *) r->memory;
+	r->history = (f32 *) ((u8 *) r->memory + coefficientsSize);
+	r->output = (f32 *) ((u8 *) r->memory + coefficientsSize + historySize);
+
+	if (!r->bypass) ResamplerCoefficientsInit(r);
+	ResamplerReset(r);
+
+	if (!gResamplerFilter) ResamplerInit();
+
+	return true;
+}
+
+static void ResamplerDestroy(resampler *r) {
+	BOGFree(r->memory, r->memorySize);
+	r->memory = 0;
+}
+
+static u32 ResamplerMaxOutput(resampler *r, u32 count) {
+	u64 frames = (u64) (count + r->taps) * r->up / r->down + 1;
+	if (r->config.variable) frames += (u64) (frames * RESAMPLER_MAX_RATIO) + 1;
+	return (u32) frames;
+}
+
+static void ResamplerSetRatio(resampler *r, d64 ratio) {
+	if (!r->config.variable) return;
+	if (ratio < 1 - RESAMPLER_MAX_RATIO) ratio = 1 - RESAMPLER_MAX_RATIO;
+	if (ratio > 1 + RESAMPLER_MAX_RATIO) ratio = 1 + RESAMPLER_MAX_RATIO;
+
+	// step of down / up input frames becomes down / (up * ratio)
+	d64 adjust = (d64) r->down * 4294967296.0 * (1 / ratio - 1);
+	r->adjust = (s64) (adjust >= 0 ? adjust + 0.5 : adjust - 0.5);
+}
+
+// mixes frames of input to stereo at end of history
+static void ResamplerLoad(resampler *r, const u8 *src, u32 frames) {
+	const resampler_config *c = &r->config;
+	f32 *dst = r->history + 2 * r->count;
+	r->count += frames;
+
+	if (!src) {
+		for (u32 i = 0; i < 2 * frames; ++i) dst[i] = 0;
+		return;
+	}
+
+	for (u32 i = 0; i < frames; ++i, src += r->frameSize) {
+		f32 sample[RESAMPLER_MAX_CHANNELS];
+		for (u32 ch = 0; ch < c->channels; ++ch) {
+			switch (c->format) {
+				case RESAMPLER_S16: {
+					sample[ch] = ((const s16 *) src)[ch] * (1.0f / 32768);
+				} break;
+
+				case RESAMPLER_S24: {
+					const u8 *p = src + 3 * ch;
+					s32 value = (s32) ((u32) p[0] << 8 | (u32) p[1] << 16 | (u32) p[2] << 24);
+					sample[ch] = (f32) (value >> 8) * (1.0f / 8388608);
+				} break;
+
+				case RESAMPLER_S32: {
+					sample[ch] = (f32) ((const s32 *) src)[ch] * (1.0f / 2147483648.0f);
+				} break;
+
+				default: {
+					sample[ch] = ((const f32 *) src)[ch];
+				}
+			}
+		}
+
+		f32 left = 0;
+		f32 right = 0;
+		for (u32 ch = 0; ch < c->channels; ++ch) {
+			left += r->mix[0][ch] * sample[ch];
+			right += r->mix[1][ch] * sample[ch];
+		}
+		dst[2 * i + 0] = left;
+		dst[2 * i + 1] = right;
+	}
+}
+
+// outputs every frame whose window is in history, then keeps only what next windows need
+static u32 ResamplerRun(resampler *r, s16 *output) {
+	if (r->bypass) {
+		u32 frames = r->count;
+		gResamplerConvert(r->history, output, 2 * frames, &r->dither);
+		r->count = 0;
+		return frames;
+	}
+
+	// filtered frames are converted in blocks, variable one also needs window of next phase
+	u32 written = 0;
+	u32 pending = 0;
+	bool variable = r->config.variable;
+	while (r->position + r->taps + variable <= r->count) {
+		const f32 *coefficients = r->coefficients + 2 * r->taps * r->phase;
+		f32 *out = r->output + 2 * pending;
+		gResamplerFilter(r->history + 2 * r->position, coefficients, r->taps, out);
+		if (variable && r->fraction) {
+			// last phase is followed by first one of next input frame
+			f32 next[2];
+			bool wrap = r->phase + 1 == r->up;
+			gResamplerFilter(r->history + 2 * (r->position + wrap),
+							 wrap ? r->coefficients : coefficients + 2 * r->taps, r->taps, next);
+			f32 weight = (f32) (r->fraction * (1.0 / 4294967296.0));
+			out[0] += (next[0] - out[0]) * weight;
+			out[1] += (next[1] - out[1]) * weight;
+		}
+		if (++pending == RESAMPLER_BLOCK) {
+			gResamplerConvert(r->output, output + 2 * written, 2 * pending, &r->dither);
+			written += pending;
+			pending = 0;
+		}
+
+		// down / up without dividing every frame
+		r->position += r->step;
+		r->phase += r->stepRemainder;
+		if (variable) {
+			// carry of fraction is few phases at most, either way
+			s64 fraction = (s64) r->fraction + r->adjust;
+			s64 carry = fraction >> 32;
+			r->fraction = (u32) (fraction - (carry << 32));
+			s64 phase = (s64) r->phase + carry;
+			while (phase < 0) {
+				phase += r->up;
+				r->position--;
+			}
+			r->phase = (u32) phase;
+		}
+		while (r->phase >= r->up) {
+			r->phase -= r->up;
+			r->position++;
+		}
+	}
+	gResamplerConvert(r->output, output + 2 * written, 2 * pending, &r->dither);
+	written += pending;
+
+	// downsampling can step past end of history, rest of step is skipped in next input
+	u32 shift = r->position < r->count ? r->position : r->count;
+	f32 *history = r->history;
+	for (u32 i = 0; i < 2 * (r->count - shift); ++i) history[i] = history[i + 2 * shift];
+	r->count -= shift;
+	r->position -= shift;
+	return written;
+}
+
+static u32 ResamplerProcess(resampler *r, const void *input, u32 count, s16 *output) {
+	if (r->direct && input) {
+		gResamplerConvert((const f32 *) input, output, 2 * count, &r->dither);
+		return count;
+	}
+
+	const u8 *src = (const u8 *) input;
+	u32 written = 0;
+	while (count) {
+		u32 frames = count < RESAMPLER_BLOCK ? count : RESAMPLER_BLOCK;
+		ResamplerLoad(r, src, frames);
+		if (src) src += frames * r->frameSize;
+		count -= frames;
+		written += ResamplerRun(r, output + 2 * written);
+	}
+	return written;
+}
+
+static u32 ResamplerDrain(resampler *r, s16 *output) {
+	// zeros after last input, so its frames get to middle of window
+	u32 written = 0;
+	if (!r->bypass) {
+		ResamplerLoad(r, 0, r->taps / 2 + 1 + r->config.variable);
+		written = ResamplerRun(r, output);
+	}
+	ResamplerReset(r);
+	return written;
+}
@@ -0,0 +1,115 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_cpu.h"
+#include "bog/bog_memory.h"
+
+// converts captured audio of any sample format, channel layout & rate to stereo s16 at output rate
+// channels are mixed to stereo while samples are loaded, then polyphase filter interpolates by
+// inRate : outRate reduced to smallest integers, every phase is windowed sinc with its own taps,
+// so output sample is one dot product of consecutive input samples
+// passband goes to 20 kHz (or 0.45 of lower rate), everything that would alias below it is at
+// least 100 dB down, state is kept between calls so packets can be of any size
+// same rates skip filter, stereo float input is then converted straight from input buffer
+// conversion to s16 adds TPDF dither of +-1 LSB, so quiet signals don't turn into distortion,
+// except for s16 input that passes through unchanged
+// variable resampler can follow clock of device that is bit off its rate, step through input
+// gets 32 bit fraction below phase, output is interpolated between its two nearest phases
+
+#define RESAMPLER_MAX_CHANNELS 8
+#define RESAMPLER_MAX_TAPS 256
+#define RESAMPLER_MAX_COEFFICIENTS 65536 // phases * taps
+#define RESAMPLER_BLOCK 1024 // input frames mixed at once
+#define RESAMPLER_MIN_PHASES 256 // of variable resampler, interpolating between them stays clean
+#define RESAMPLER_MAX_RATIO 0.01 // ratio of variable resampler stays within 1 +- this
+
+// speaker bits of channel mask, same as dwChannelMask of WAVEFORMATEXTENSIBLE
+#define RESAMPLER_FRONT_LEFT    0x1
+#define RESAMPLER_FRONT_RIGHT   0x2
+#define RESAMPLER_FRONT_CENTER  0x4
+#define RESAMPLER_LFE           0x8
+#define RESAMPLER_BACK_LEFT     0x10
+#define RESAMPLER_BACK_RIGHT    0x20
+#define RESAMPLER_FRONT_LEFT_OF_CENTER  0x40
+#define RESAMPLER_FRONT_RIGHT_OF_CENTER 0x80
+#define RESAMPLER_BACK_CENTER   0x100
+#define RESAMPLER_SIDE_LEFT     0x200
+#define RESAMPLER_SIDE_RIGHT    0x400
+
+// interface
+
+typedef enum {
+	RESAMPLER_S16,
+	RESAMPLER_S24,     // packed in 3 bytes
+	RESAMPLER_S32,
+	RESAMPLER_F32,
+} resampler_format;
+
+typedef struct {
+	resampler_format format;
+	u32 channels;      // interleaved, at most RESAMPLER_MAX_CHANNELS
+	u32 channelMask;   // speaker of each channel in order of bits, 0 picks usual one for count
+	u32 inRate, outRate;
+	bool variable;     // ratio can change while running, filter stays on even for same rates
+} resampler_config;
+
+// 8 xorshift generators, value n of stream uses generator n % 8, so SIMD kernels advance all of
+// them at once & output doesn't depend on how stream was split
+typedef struct {
+	u32 state[8];
+	u32 lane;          // generator of next value
+	f32 scale;         // 0 turns dither off
+} resampler_dither;
+
+typedef struct {
+	resampler_config config;
+	f32 mix[2][RESAMPLER_MAX_CHANNELS]; // left & right gain of every input channel
+	u32 frameSize;     // bytes of input frame
+	bool bypass;       // same rates, no filter & no delay
+	bool direct;       // bypass with stereo float input, converted straight from input
+	resampler_dither dither;
+
+	u32 up, down;      // output advances input by down / up frames
+	u32 step, stepRemainder; // down == step * up + stepRemainder
+	u32 taps;          // multiple of 8
+	f32 *coefficients; // every phase has taps pairs, each value twice for left & right
+
+	// stereo input frames, window of next output starts at position
+	f32 *history;
+	u32 count;
+	u32 position;
+	u32 phase;         // of next output, in 1 / up input frames
+	u32 fraction;      // of phase, in 1 / 2^32 of it, variable resampler only
+	s64 adjust;        // added to fraction every output frame, follows ratio
+	f32 *output;       // RESAMPLER_BLOCK filtered frames before conversion
+
+	void *memory;
+	udm memorySize;
+} resampler;
+
+static void ResamplerInit(void);
+static bog_cpu_level ResamplerGetLevel(void);
+static void ResamplerSetLevel(bog_cpu_level level);
+
+// count values of [-1..1] to s16, saturates
+static void ResamplerConvert(const f32 *src, s16 *dst, u32 count, resampler_dither *dither);
+
+// false when rates can't be reduced to few enough phases or format isn't supported
+static bool ResamplerCreate(resampler *r, const resampler_config *config);
+static void ResamplerDestroy(resampler *r);
+
+// most output frames that count input frames can give
+static u32 ResamplerMaxOutput(resampler *r, u32 count);
+
+// input of 0 is silence, output is interleaved stereo, returns output frames
+static u32 ResamplerProcess(resampler *r, const void *input, u32 count, s16 *output);
+
+// end of stream, outputs what filter still holds, at most ResamplerMaxOutput(r, 0) frames
+static u32 ResamplerDrain(resampler *r, s16 *output);
+
+// variable resampler gives ratio times more output frames than outRate / inRate does, from next
+// output frame on, ratio is clamped to 1 +- RESAMPLER_MAX_RATIO
+static void ResamplerSetRatio(resampler *r, d64 ratio);
+
+#endif //RESAMPLER_H
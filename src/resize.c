@@ -0,0 +1,538 @@
+#include "resize.h"
+
+// separate horizontal & vertical kernels only do integer math, so SIMD versions produce output that is
+// bit identical to scalar ones:
+//   horizontal: (sum(w * pixel) + round) >> (RESIZE_WEIGHT_BITS - RESIZE_EXTRA_BITS), saturated to s16
+//   vertical:   (sum(w * row) + round) >> (RESIZE_WEIGHT_BITS + RESIZE_EXTRA_BITS), clamped to u8
+
+#define RESIZE_H_SHIFT (RESIZE_WEIGHT_BITS - RESIZE_EXTRA_BITS)
+#define RESIZE_V_SHIFT (RESIZE_WEIGHT_BITS + RESIZE_EXTRA_BITS)
+
+typedef void resize_horizontal(const resize_table *t, const u8 *src, s16 *dst);
+typedef void resize_vertical(const s16 *const *rows, const s16 *weights, u32 taps, u8 *dst,
+							 u32 count);
+// averages factor x factor blocks of pixels into count output pixels
+typedef void resize_box(const u8 *src, udm srcStride, u32 factor, u8 *dst, u32 count);
+
+static resize_horizontal *gResizeHorizontal;
+static resize_vertical *gResizeVertical;
+static resize_box *gResizeBox;
+static bog_cpu_level gResizeLevel;
+
+static d64 ResizeFilter(d64 x) {
+	// https://en.wikipedia.org/wiki/Mitchell%E2%80%93Netravali_filters
+	// with B=C=1/3
+
+	x = x < 0 ? -x : x;
+
+	if (x < 1.0) {
+		d64 x2 = x * x;
+		d64 x3 = x * x2;
+		return (21 * x3 - 36 * x2 + 16) / 18;
+	}
+
+	if (x < 2.0) {
+		d64 x2 = x * x;
+		d64 x3 = x * x2;
+		return (-7 * x3 + 36 * x2 - 60 * x + 32) / 18;
+	}
+
+	return 0.0;
+}
+
+static inline s32 ResizeFloor(d64 x) {
+	s32 result = (s32) x;
+	return (result > x) ? result - 1 : result;
+}
+
+// window of input samples for output sample i, same as Resize shader but filter is stretched only
+// when downscaling
+static void ResizeWindow(u32 inSize, u32 outSize, u32 i, d64 *center, s32 *first, s32 *last) {
+	d64 scale = (d64) outSize / inSize;
+	d64 support = (scale < 1.0) ? 2.0 / scale : 2.0;
+
+	// filter is zero outside of (center - 0.5 - support, center - 0.5 + support)
+	*center = (i + 0.5) / scale;
+	*first = ResizeFloor(*center - 0.5 - support) + 1;
+	*last = ResizeFloor(*center - 0.5 + support);
+
+	if (*first < 0) *first = 0;
+	if (*last > (s32) inSize - 1) *last = inSize - 1;
+}
+
+static udm ResizeTableSize(u32 inSize, u32 outSize, u32 *taps) {
+	u32 result = 1;
+	for (u32 i = 0; i < outSize; ++i) {
+		d64 center;
+		s32 first, last;
+		ResizeWindow(inSize, outSize, i, &center, &first, &last);
+		if ((u32) (last - first + 1) > result) result = last - first + 1;
+	}
+
+	*taps = result;
+	return outSize * sizeof(u32) + outSize * result * sizeof(s16);
+}
+
+static void ResizeTableInit(resize_table *t, u32 inSize, u32 outSize, u32 taps, u8 *memory) {
+	t->inSize = inSize;
+	t->outSize = outSize;
+	t->taps = taps;
+	t->start = (u32 *) memory;
+	t->weights = (s16 *) (memory + outSize * sizeof(u32));
+
+	d64 scale = (d64) outSize / inSize;
+	d64 filterScale = (scale < 1.0) ? scale : 1.0;
+
+	for (u32 i = 0; i < outSize; ++i) {
+		d64 center;
+		s32 first, last;
+		ResizeWindow(inSize, outSize, i, &center, &first, &last);
+
+		// every output sample uses same amount of taps, shift window inside of image
+		s32 start = first;
+		if (start + (s32) taps > (s32) inSize) start = inSize - taps;
+
+		d64 sum = 0;
+		for (s32 x = first; x <= last; ++x) {
+			sum += ResizeFilter((center - x - 0.5) * filterScale);
+		}
+
+		s16 *weights = t->weights + i * taps;
+		s32 total = 0;
+		u32 largest = 0;
+		for (u32 k = 0; k < taps; ++k) {
+			s32 x = start + k;
+			d64 w = (x >= first && x <= last) ? ResizeFilter((center - x - 0.5) * filterScale) : 0;
+			w = (sum > 0) ? w / sum : 0;
+
+			s32 fixed = ResizeFloor(w * (1 << RESIZE_WEIGHT_BITS) + 0.5);
+			weights[k] = (s16) fixed;
+			total += fixed;
+			if (weights[k] > weights[largest]) largest = k;
+		}
+
+		// rounding error goes to largest weight, so sum is exactly one
+		weights[largest] += (s16) ((1 << RESIZE_WEIGHT_BITS) - total);
+		t->start[i] = start;
+	}
+}
+
+static inline s16 ResizeSaturate16(s32 value) {
+	return (s16) (value < -32768 ? -32768 : value > 32767 ? 32767 : value);
+}
+
+static inline u8 ResizeSaturate8(s32 value) {
+	return (u8) (value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+static void ResizeHorizontalScalar(const resize_table *t, const u8 *src, s16 *dst) {
+	s32 round = 1 << (RESIZE_H_SHIFT - 1);
+
+	for (u32 i = 0; i < t->outSize; ++i) {
+		const u8 *p = src + t->start[i] * 4;
+		const s16 *w = t->weights + i * t->taps;
+
+		s32 b = 0, g = 0, r = 0, a = 0;
+		for (u32 k = 0; k < t->taps; ++k) {
+			b += w[k] * p[0];
+			g += w[k] * p[1];
+			r += w[k] * p[2];
+			a += w[k] * p[3];
+			p += 4;
+		}
+
+		dst[0] = ResizeSaturate16((b + round) >> RESIZE_H_SHIFT);
+		dst[1] = ResizeSaturate16((g + round) >> RESIZE_H_SHIFT);
+		dst[2] = ResizeSaturate16((r + round) >> RESIZE_H_SHIFT);
+		dst[3] = ResizeSaturate16((a + round) >> RESIZE_H_SHIFT);
+		dst += 4;
+	}
+}
+
+static void ResizeVerticalScalar(const s16 *const *rows, const s16 *weights, u32 taps, u8 *dst,
+								 u32 count) {
+	s32 round = 1 << (RESIZE_V_SHIFT - 1);
+
+	for (u32 x = 0; x < count; ++x) {
+		s32 sum = 0;
+		for (u32 k = 0; k < taps; ++k) {
+			sum += weights[k] * rows[k][x];
+		}
+
+		dst[x] = ResizeSaturate8((sum + round) >> RESIZE_V_SHIFT);
+	}
+}
+
+static void ResizeBoxScalar(const u8 *src, udm srcStride, u32 factor, u8 *dst, u32 count) {
+	// area is 4 or 16, so average is rounded shift
+	u32 shift = (factor == 2) ? 2 : 4;
+	u32 round = 1 << (shift - 1);
+
+	for (u32 x = 0; x < count; ++x) {
+		u32 b = 0, g = 0, r = 0, a = 0;
+		for (u32 ky = 0; ky < factor; ++ky) {
+			const u8 *p = src + ky * srcStride + x * factor * 4;
+			for (u32 kx = 0; kx < factor; ++kx) {
+				b += p[0];
+				g += p[1];
+				r += p[2];
+				a += p[3];
+				p += 4;
+			}
+		}
+
+		dst[0] = (u8) ((b + round) >> shift);
+		dst[1] = (u8) ((g + round) >> shift);
+		dst[2] = (u8) ((r + round) >> shift);
+		dst[3] = (u8) ((a + round) >> shift);
+		dst += 4;
+	}
+}
+
+#ifdef BOG_X86
+// two consecutive weights as one 32-bit value, layout expected by pmaddwd
+static inline s32 ResizeWeightPair(const s16 *w) {
+	return (u16) w[0] | ((u32) (u16) w[1] << 16);
+}
+
+BOG_TARGET_SSE2
+static void ResizeHorizontalSSE2(const resize_table *t, const u8 *src, s16 *dst) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i round = _mm_set1_epi32(1 << (RESIZE_H_SHIFT - 1));
+	u32 taps = t->taps;
+
+	for (u32 i = 0; i < t->outSize; ++i) {
+		const u8 *p = src + t->start[i] * 4;
+		const s16 *w = t->weights + i * taps;
+		__m128i sum = zero;
+
+		// two pixels at once, channels interleaved as B0 B1 G0 G1 R0 R1 A0 A1
+		u32 k = 0;
+		for (; k + 2 <= taps; k += 2) {
+			__m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) p), zero);
+			px = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(px, _mm_set1_epi32(ResizeWeightPair(w + k))));
+			p += 8;
+		}
+
+		if (k < taps) {
+			// odd tap count, last pixel paired with zero weight
+			__m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const s32 *) p), zero);
+			px = _mm_unpacklo_epi16(px, zero);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(px, _mm_set1_epi32((u16) w[k])));
+		}
+
+		sum = _mm_srai_epi32(_mm_add_epi32(sum, round), RESIZE_H_SHIFT);
+		_mm_storel_epi64((__m128i *) dst, _mm_packs_epi32(sum, sum));
+		dst += 4;
+	}
+}
+
+BOG_TARGET_SSE2
+static void ResizeVerticalSSE2(const s16 *const *rows, const s16 *weights, u32 taps, u8 *dst,
+							   u32 count) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i round = _mm_set1_epi32(1 << (RESIZE_V_SHIFT - 1));
+
+	u32 x = 0;
+	for (; x + 8 <= count; x += 8) {
+		__m128i lo = zero;
+		__m128i hi = zero;
+
+		// two rows at once, values interleaved as r0 r1 r0 r1 ...
+		u32 k = 0;
+		for (; k + 2 <= taps; k += 2) {
+			__m128i a = _mm_loadu_si128((const __m128i *) (rows[k] + x));
+			__m128i b = _mm_loadu_si128((const __m128i *) (rows[k + 1] + x));
+			__m128i w = _mm_set1_epi32(ResizeWeightPair(weights + k));
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+		}
+
+		if (k < taps) {
+			__m128i a = _mm_loadu_si128((const __m128i *) (rows[k] + x));
+			__m128i w = _mm_set1_epi32((u16) weights[k]);
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), w));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), w));
+		}
+
+		lo = _mm_srai_epi32(_mm_add_epi32(lo, round), RESIZE_V_SHIFT);
+		hi = _mm_srai_epi32(_mm_add_epi32(hi, round), RESIZE_V_SHIFT);
+		__m128i words = _mm_packs_epi32(lo, hi);
+		_mm_storel_epi64((__m128i *) (dst + x), _mm_packus_epi16(words, words));
+	}
+
+	if (x < count) {
+		const s16 *tail[64];
+		for (u32 k = 0; k < taps; ++k) tail[k] = rows[k] + x;
+		ResizeVerticalScalar(tail, weights, taps, dst + x, count - x);
+	}
+}
+
+// sums of 16-bit channels are at most 16 * 255, so they never overflow
+BOG_TARGET_SSE2
+static inline __m128i ResizeBoxRowSumSSE2(const u8 *src, udm srcStride, u32 rows, __m128i *hi) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i lo = zero;
+	*hi = zero;
+	for (u32 k = 0; k < rows; ++k) {
+		__m128i px = _mm_loadu_si128((const __m128i *) (src + k * srcStride));
+		lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(px, zero));
+		*hi = _mm_add_epi16(*hi, _mm_unpackhi_epi8(px, zero));
+	}
+	return lo;
+}
+
+// adds pixel pairs, a & b hold two 4-channel pixels each, result is (a0 + a1, b0 + b1)
+BOG_TARGET_SSE2
+static inline __m128i ResizeBoxPairsSSE2(__m128i a, __m128i b) {
+	return _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+}
+
+BOG_TARGET_SSE2
+static void ResizeBoxSSE2(const u8 *src, udm srcStride, u32 factor, u8 *dst, u32 count) {
+	u32 x = 0;
+
+	if (factor == 2) {
+		__m128i round = _mm_set1_epi16(2);
+
+		// 4 output pixels from 8 input pixels in each of 2 rows
+		for (; x + 4 <= count; x += 4) {
+			const u8 *p = src + x * 8;
+			__m128i s1, s3;
+			__m128i s0 = ResizeBoxRowSumSSE2(p, srcStride, 2, &s1);
+			__m128i s2 = ResizeBoxRowSumSSE2(p + 16, srcStride, 2, &s3);
+
+			__m128i lo = _mm_srli_epi16(_mm_add_epi16(ResizeBoxPairsSSE2(s0, s1), round), 2);
+			__m128i hi = _mm_srli_epi16(_mm_add_epi16(ResizeBoxPairsSSE2(s2, s3), round), 2);
+			_mm_storeu_si128((__m128i *) (dst + x * 4), _mm_packus_epi16(lo, hi));
+		}
+	} else {
+		__m128i round = _mm_set1_epi16(8);
+
+		// 4 output pixels from 16 input pixels in each of 4 rows
+		for (; x + 4 <= count; x += 4) {
+			const u8 *p = src + x * 16;
+			__m128i s[8];
+			for (u32 k = 0; k < 4; ++k) {
+				s[2 * k] = ResizeBoxRowSumSSE2(p + k * 16, srcStride, 4, &s[2 * k + 1]);
+			}
+
+			// each output pixel is sum of 4 consecutive input pixels, that is one s[k] pair
+			__m128i w0 = _mm_add_epi16(s[0], s[1]);
+			__m128i w1 = _mm_add_epi16(s[2], s[3]);
+			__m128i w2 = _mm_add_epi16(s[4], s[5]);
+			__m128i w3 = _mm_add_epi16(s[6], s[7]);
+
+			__m128i lo = _mm_srli_epi16(_mm_add_epi16(ResizeBoxPairsSSE2(w0, w1), round), 4);
+			__m128i hi = _mm_srli_epi16(_mm_add_epi16(ResizeBoxPairsSSE2(w2, w3), round), 4);
+			_mm_storeu_si128((__m128i *) (dst + x * 4), _mm_packus_epi16(lo, hi));
+		}
+	}
+
+	if (x < count) {
+		ResizeBoxScalar(src + x * factor * 4, srcStride, factor, dst + x * 4, count - x);
+	}
+}
+
+BOG_TARGET_AVX2
+static void ResizeVerticalAVX2(const s16 *const *rows, const s16 *weights, u32 taps, u8 *dst,
+							   u32 count) {
+	__m256i zero = _mm256_setzero_si256();
+	__m256i round = _mm256_set1_epi32(1 << (RESIZE_V_SHIFT - 1));
+
+	u32 x = 0;
+	for (; x + 16 <= count; x += 16) {
+		__m256i lo = zero;
+		__m256i hi = zero;
+
+		u32 k = 0;
+		for (; k + 2 <= taps; k += 2) {
+			__m256i a = _mm256_loadu_si256((const __m256i *) (rows[k] + x));
+			__m256i b = _mm256_loadu_si256((const __m256i *) (rows[k + 1] + x));
+			__m256i w = _mm256_set1_epi32(ResizeWeightPair(weights + k));
+			lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+			hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+		}
+
+		if (k < taps) {
+			__m256i a = _mm256_loadu_si256((const __m256i *) (rows[k] + x));
+			__m256i w = _mm256_set1_epi32((u16) weights[k]);
+			lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, zero), w));
+			hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, zero), w));
+		}
+
+		// in-lane unpack & pack cancel each other out, only 64-bit halves need reordering at the end
+		lo = _mm256_srai_epi32(_mm256_add_epi32(lo, round), RESIZE_V_SHIFT);
+		hi = _mm256_srai_epi32(_mm256_add_epi32(hi, round), RESIZE_V_SHIFT);
+		__m256i words = _mm256_packs_epi32(lo, hi);
+		__m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words),
+												 _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128((__m128i *) (dst + x), _mm256_castsi256_si128(bytes));
+	}
+
+	if (x < count) {
+		const s16 *tail[64];
+		for (u32 k = 0; k < taps; ++k) tail[k] = rows[k] + x;
+		ResizeVerticalSSE2(tail, weights, taps, dst + x, count - x);
+	}
+}
+#endif
+
+static void ResizeSetLevel(bog_cpu_level level) {
+	switch (level) {
+#ifdef BOG_X86
+		case BOG_CPU_AVX2: {
+			gResizeHorizontal = ResizeHorizontalSSE2;
+			gResizeVertical = ResizeVerticalAVX2;
+			gResizeBox = ResizeBoxSSE2;
+		} break;
+
+		case BOG_CPU_SSE2: {
+			gResizeHorizontal = ResizeHorizontalSSE2;
+			gResizeVertical = ResizeVerticalSSE2;
+			gResizeBox = ResizeBoxSSE2;
+		} break;
+#endif
+
+		default: {
+			level = BOG_CPU_SCALAR;
+			gResizeHorizontal = ResizeHorizontalScalar;
+			gResizeVertical = ResizeVerticalScalar;
+			gResizeBox = ResizeBoxScalar;
+		}
+	}
+
+	gResizeLevel = level;
+}
+
+static bog_cpu_level ResizeGetLevel(void) {
+	return gResizeLevel;
+}
+
+static void ResizeInit(void) {
+	ResizeSetLevel(BOGCpuLevel());
+}
+
+static inline udm ResizeBandStride(u32 outWidth) {
+	return (outWidth * 4 + BOG_CACHE_LINE - 1) & ~(udm) (BOG_CACHE_LINE - 1);
+}
+
+static bool ResizeCreate(resizer *r, u32 inWidth, u32 inHeight, u32 outWidth, u32 outHeight,
+						 u32 scratchCount) {
+	u32 tapsX, tapsY;
+	udm sizeX = ResizeTableSize(inWidth, outWidth, &tapsX);
+	udm sizeY = ResizeTableSize(inHeight, outHeight, &tapsY);
+
+	// vertical kernels keep row pointers on stack
+	if (tapsY > 64) return false;
+
+	// pad intermediate rows, so vertical SIMD loops can always read full registers
+	udm rowSize = (outWidth * 4 * sizeof(s16) + BOG_CACHE_LINE - 1) & ~(udm) (BOG_CACHE_LINE - 1);
+	udm rowsSize = tapsY * rowSize;
+	udm bandSize = 2 * ResizeBandStride(outWidth);
+	udm scratchSize = rowsSize + bandSize;
+	if (!scratchCount) scratchCount = 1;
+
+	r->memorySize = scratchCount * scratchSize + sizeX + sizeY + BOG_CACHE_LINE;
+	r->memory = BOGAlloc(r->memorySize);
+	if (!r->memory) return false;
+
+	u8 *memory = (u8 *) r->memory;
+	u8 *tables = memory + scratchCount * scratchSize;
+	r->rows = (s16 *) memory;
+	r->band = memory + rowsSize;
+	r->scratchCount = scratchCount;
+	r->scratchSize = scratchSize;
+	ResizeTableInit(&r->horizontal, inWidth, outWidth, tapsX, tables);
+	ResizeTableInit(&r->vertical, inHeight, outHeight, tapsY, tables + sizeX);
+
+	r->inWidth = inWidth;
+	r->inHeight = inHeight;
+	r->outWidth = outWidth;
+	r->outHeight = outHeight;
+
+	// exact power of two downscale gets box filter, averaged pixels then convert to NV12 as usual,
+	// so chroma comes from same accumulated 2x2 block of box averages
+	r->box = 0;
+	for (u32 factor = 2; factor <= 4; factor *= 2) {
+		if (inWidth == outWidth * factor && inHeight == outHeight * factor) r->box = factor;
+	}
+
+	if (!gResizeVertical) ResizeInit();
+
+	return true;
+}
+
+static void ResizeDestroy(resizer *r) {
+	BOGFree(r->memory, r->memorySize);
+	r->memory = 0;
+	r->inWidth = r->inHeight = 0;
+	r->outWidth = r->outHeight = 0;
+	r->box = 0;
+}
+
+// produces output row y, rows must be requested in increasing order starting with *end = 0
+static void ResizeRow(resizer *r, s16 *ring, const void *src, udm srcStride, s32 *end, u32 y,
+					  u8 *dst) {
+	if (r->box) {
+		gResizeBox((const u8 *) src + y * r->box * srcStride, srcStride, r->box, dst, r->outWidth);
+		return;
+	}
+
+	const resize_table *v = &r->vertical;
+	u32 taps = v->taps;
+	udm rowSize = ((r->outWidth * 4 * sizeof(s16) + BOG_CACHE_LINE - 1) &
+				   ~(udm) (BOG_CACHE_LINE - 1)) / sizeof(s16);
+
+	// horizontal pass results are kept in ring of taps rows, input row y lives in slot y % taps
+	// window only moves downwards, so each input row is resized horizontally only once
+	s32 start = v->start[y];
+	if (*end < start) *end = start;
+
+	for (; *end < start + (s32) taps; ++*end) {
+		gResizeHorizontal(&r->horizontal, (const u8 *) src + *end * srcStride,
+						  ring + (*end % taps) * rowSize);
+	}
+
+	const s16 *rows[64];
+	for (u32 k = 0; k < taps; ++k) {
+		rows[k] = ring + ((start + k) % taps) * rowSize;
+	}
+
+	gResizeVertical(rows, v->weights + y * taps, taps, dst, r->outWidth * 4);
+}
+
+static void ResizeImage(resizer *r, const void *src, udm srcStride, void *dst, udm dstStride) {
+	s32 end = 0;
+	for (u32 y = 0; y < r->outHeight; ++y) {
+		ResizeRow(r, r->rows, src, srcStride, &end, y, (u8 *) dst + y * dstStride);
+	}
+}
+
+static void ResizeToNV12Rows(resizer *r, u32 scratch, const convert_fixed *f, const void *src,
+							 udm srcStride, u32 y0, u32 y1, u8 *dstY, udm strideY, u8 *dstUV,
+							 udm strideUV) {
+	s16 *ring = (s16 *) ((u8 *) r->rows + scratch * r->scratchSize);
+	u8 *band = r->band + scratch * r->scratchSize;
+	udm bandStride = ResizeBandStride(r->outWidth);
+	s32 end = 0;
+
+	if (y1 > r->outHeight) y1 = r->outHeight;
+
+	// two resized rows at a time, exactly what one row of 2x2 chroma blocks needs
+	for (u32 y = y0; y < y1; y += 2) {
+		u32 count = (y + 1 < r->outHeight) ? 2 : 1;
+		for (u32 k = 0; k < count; ++k) {
+			ResizeRow(r, ring, src, srcStride, &end, y + k, band + k * bandStride);
+		}
+
+		ConvertToNV12Region(f, band, bandStride, r->outWidth, count, 0, 0, r->outWidth, count,
+							dstY + y * strideY, strideY, dstUV + (y / 2) * strideUV, strideUV);
+	}
+}
+
+static void ResizeToNV12(resizer *r, const convert_fixed *f, const void *src, udm srcStride,
+						 u8 *dstY, udm strideY, u8 *dstUV, udm strideUV) {
+	ResizeToNV12Rows(r, 0, f, src, srcStride, 0, r->outHeight, dstY, strideY, dstUV, strideUV);
+}
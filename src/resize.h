@@ -0,0 +1,70 @@
+#ifndef RESIZE_H
+#define RESIZE_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_cpu.h"
+#include "bog/bog_memory.h"
+#include "convert.h"
+
+// CPU implementation of Resize kernel from shaders.hlsl for BGRA images
+// filter is separable, so image is resized horizontally into intermediate rows and then vertically,
+// weights are computed once per input/output size pair and stored as fixed point numbers
+// exact 2:1 and 4:1 downscales use box filter instead, which is just few adds per pixel
+
+#define RESIZE_WEIGHT_BITS 14 // weights of each output sample sum to 1 << RESIZE_WEIGHT_BITS
+#define RESIZE_EXTRA_BITS 6   // extra precision of intermediate rows over 8-bit input
+
+// interface
+
+typedef struct {
+	u32 inSize, outSize;
+	u32 taps;		// weights per output sample
+	u32 *start;		// first input sample for each output sample
+	s16 *weights;	// taps weights for each output sample
+} resize_table;
+
+typedef struct {
+	u32 inWidth, inHeight;
+	u32 outWidth, outHeight;
+	resize_table horizontal;
+	resize_table vertical;
+	u32 box;		// 2 or 4 when input is exactly that many times larger, 0 otherwise
+
+	// scratch memory of first thread, every next one follows scratchSize bytes after previous
+	// ring of horizontally resized rows, as many as there are vertical taps
+	s16 *rows;
+	// two resized BGRA rows waiting for conversion to NV12
+	u8 *band;
+	u32 scratchCount;
+	udm scratchSize;
+
+	void *memory;
+	udm memorySize;
+} resizer;
+
+static void ResizeInit(void);
+static bog_cpu_level ResizeGetLevel(void);
+static void ResizeSetLevel(bog_cpu_level level);
+
+// scratchCount is how many threads can resize different rows of same image at once
+static bool ResizeCreate(resizer *r, u32 inWidth, u32 inHeight, u32 outWidth, u32 outHeight,
+						 u32 scratchCount);
+static void ResizeDestroy(resizer *r);
+
+// resizes whole BGRA image
+static void ResizeImage(resizer *r, const void *src, udm srcStride, void *dst, udm dstStride);
+
+// resizes BGRA image & converts it to NV12 in one pass, src can point at crop offset inside of larger
+// image, every source row is read only once & resized image never leaves cache
+// output is bit identical to ResizeImage followed by ConvertToNV12
+static void ResizeToNV12(resizer *r, const convert_fixed *f, const void *src, udm srcStride,
+						 u8 *dstY, udm strideY, u8 *dstUV, udm strideUV);
+
+// same as ResizeToNV12 but only output rows [y0..y1), y0 must be even
+// bands using different scratch can run in parallel, rows under filter support at band edges are
+// simply resized horizontally by both bands
+static void ResizeToNV12Rows(resizer *r, u32 scratch, const convert_fixed *f, const void *src,
+							 udm srcStride, u32 y0, u32 y1, u8 *dstY, udm strideY, u8 *dstUV,
+							 udm strideUV);
+
+#endif //RESIZE_H
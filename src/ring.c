@@ -0,0 +1,133 @@
+#include "ring.h"
+
+// in front of every block, skipped end of ring is block that is released already
+typedef struct {
+	u32 size;          // bytes of header & data, multiple of RING_ALIGN
+	volatile s32 done;
+	u8 padding[RING_ALIGN - 2 * sizeof(u32)];
+} ring_header;
+
+static u32 RingBlockSize(u32 size) {
+	return (u32) ((sizeof(ring_header) + size + RING_ALIGN - 1) & ~(udm) (RING_ALIGN - 1));
+}
+
+static ring_header *RingHeader(block_ring *r, u32 offset) {
+	return (ring_header *) (r->data + offset);
+}
+
+static bool RingCreate(block_ring *r, u32 size) {
+	size = (size + RING_ALIGN - 1) & ~(u32) (RING_ALIGN - 1);
+	if (!size) return false;
+
+	r->memorySize = size;
+	r->memory = BOGAlloc(r->memorySize);
+	if (!r->memory) return false;
+
+	r->data = (u8 *) r->memory;
+	r->size = size;
+	r->head = 0;
+	r->tail = 0;
+	r->used = 0;
+	r->peak = 0;
+	r->committed = 0;
+	r->released = 0;
+	r->producerWaiting = 0;
+
+	return true;
+}
+
+static void RingDestroy(block_ring *r) {
+	BOGFree(r->memory, r->memorySize);
+	r->memory = 0;
+}
+
+// frees released blocks from oldest on, stops at first one still in use
+static void RingReclaim(block_ring *r) {
+	while (r->used) {
+		ring_header *header = RingHeader(r, r->tail);
+		if (!BOGAtomicLoad(&header->done)) break;
+
+		r->used -= header->size;
+		r->tail += header->size;
+		if (r->tail == r->size) r->tail = 0;
+	}
+
+	// empty ring starts over, so biggest possible block fits
+	if (!r->used) {
+		r->head = 0;
+		r->tail = 0;
+	}
+}
+
+// offset where block of size bytes fits, size when it doesn't
+static u32 RingFind(block_ring *r, u32 size) {
+	if (r->used == r->size) return r->size;
+	if (r->head < r->tail) return r->tail - r->head >= size ? r->head : r->size;
+
+	// free space is at end of ring & before tail
+	if (r->size - r->head >= size) return r->head;
+	if (r->tail >= size) return 0;
+	return r->size;
+}
+
+static void *RingReserve(block_ring *r, u32 size, u32 msec) {
+	u32 blockSize = RingBlockSize(size);
+	if (blockSize > r->size) return 0;
+
+	RingReclaim(r);
+	u32 offset = RingFind(r, blockSize);
+	if (offset == r->size && msec) {
+		bool forever = msec == RING_WAIT_FOREVER;
+		u64 deadline = BOGTimeMsec() + msec;
+
+		// releasing thread checks flag after it marks block done, so either it sees flag or we
+		// see done block
+		BOGAtomicStore(&r->producerWaiting, 1);
+		for (;;) {
+			s32 released = BOGAtomicLoad(&r->released);
+			RingReclaim(r);
+			offset = RingFind(r, blockSize);
+			if (offset != r->size) break;
+
+			if (forever) {
+				BOGWaitOnAddress(&r->released, released);
+			} else {
+				u64 now = BOGTimeMsec();
+				if (now >= deadline) break;
+				BOGWaitOnAddressTimeout(&r->released, released, (u32) (deadline - now));
+			}
+		}
+		BOGAtomicStore(&r->producerWaiting, 0);
+	}
+	if (offset == r->size) return 0;
+
+	return RingHeader(r, offset) + 1;
+}
+
+static void RingCommit(block_ring *r, void *block, u32 size) {
+	ring_header *header = (ring_header *) block - 1;
+	u32 offset = (u32) ((u8 *) header - r->data);
+
+	// end of ring that block didn't fit in is skipped
+	if (offset != r->head) {
+		ring_header *skipped = RingHeader(r, r->head);
+		skipped->size = r->size - r->head;
+		skipped->done = 1;
+		r->used += skipped->size;
+	}
+
+	header->size = RingBlockSize(size);
+	header->done = 0;
+	r->head = offset + header->size;
+	if (r->head == r->size) r->head = 0;
+	r->used += header->size;
+	r->committed += size;
+	if (r->used > r->peak) r->peak = r->used;
+}
+
+static void RingRelease(block_ring *r, void *block) {
+	ring_header *header = (ring_header *) block - 1;
+	BOGAtomicStore(&header->done, 1);
+	BOGAtomicAdd(&r->released, 1);
+	if (BOGAtomicLoad(&r->producerWaiting)) BOGWakeAll(&r->released);
+}
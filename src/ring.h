@@ -0,0 +1,51 @@
+#ifndef RING_H
+#define RING_H
+
+#include "bog/bog_types.h"
+#include "bog/bog_memory.h"
+#include "bog/bog_thread.h"
+
+// ring of bytes that hands out variable sized blocks, one producer thread reserves space, fills it
+// & commits only what it used, so block is as big as what it holds & not as biggest possible one
+// any thread releases blocks in any order, producer reclaims space from oldest block on once it
+// is released, block never wraps around end of ring so it is always contiguous
+
+#define RING_WAIT_FOREVER 0xFFFFFFFF
+#define RING_ALIGN 16
+
+// interface
+
+typedef struct {
+	u8 *data;
+	u32 size;          // multiple of RING_ALIGN
+
+	// producer only
+	u32 head;          // offset where next block starts
+	u32 tail;          // offset of oldest block that is not reclaimed
+	u32 used;          // bytes from tail to head, including skipped end of ring
+	u32 peak;          // largest used, for reporting
+	u64 committed;     // bytes of all committed blocks, for reporting
+
+	volatile s32 released;        // counts releases, producer waits on it when ring is full
+	volatile s32 producerWaiting; // set by producer before it sleeps on released
+
+	void *memory;
+	udm memorySize;
+} block_ring;
+
+static bool RingCreate(block_ring *r, u32 size);
+// every block must be released before
+static void RingDestroy(block_ring *r);
+
+// producer side, space for size bytes aligned to RING_ALIGN, waits up to msec for releases when
+// ring is full, returns 0 if there is still no space
+// space is only taken by commit, reserving again without commit gives same space
+static void *RingReserve(block_ring *r, u32 size, u32 msec);
+
+// producer side, size can be smaller than reserved
+static void RingCommit(block_ring *r, void *block, u32 size);
+
+// any thread, block can be reused once this returns
+static void RingRelease(block_ring *r, void *block);
+
+#endif //RING_H
@@ -0,0 +1,204 @@
+#include "segment.h"
+
+static bool SegmentWrite(void *user, const void *data, udm size) {
+	segment_file *f = (segment_file *) user;
+	return OutputWrite(&f->file, data, size);
+}
+
+// output that doesn't wait drops whole fragment when it is full, rejected write would stop file
+static bool SegmentFits(void *user, udm size) {
+	segment_file *f = (segment_file *) user;
+	if (OutputFits(&f->file, size)) return true;
+
+	f->file.overflows++;
+	return false;
+}
+
+static bool SegmentOpen(segmenter *s, segment_file *f, const u64 *origin) {
+	output_path path[SEGMENT_MAX_PATH];
+	f->muxer.memory = 0;
+	if (!s->config.name(s->config.user, s->index, path, SEGMENT_MAX_PATH)) return false;
+	if (!OutputOpen(&f->file, path, &s->config.output)) return false;
+
+	if (!Mp4Create(&f->muxer, s->tracks, s->trackCount, s->config.fragmentDuration, SegmentWrite,
+				   f)) {
+		OutputClose(&f->file);
+		return false;
+	}
+	if (!s->config.output.wait) Mp4SetFits(&f->muxer, SegmentFits);
+
+	for (u32 i = 0; i < s->trackCount; ++i) {
+		f->origin[i] = origin[i];
+		f->end[i] = 0;
+		f->ended[i] = false;
+	}
+	f->started = false;
+	f->start = 0;
+
+	return true;
+}
+
+static bool SegmentClose(segmenter *s, segment_file *f) {
+	bool result = Mp4Finish(&f->muxer);
+	s->droppedFragments += f->muxer.droppedFragments;
+	Mp4Destroy(&f->muxer);
+	if (!OutputClose(&f->file)) result = false;
+	return result;
+}
+
+static bool SegmentStart(segmenter *s, const mp4_track_config *tracks, u32 trackCount,
+						 const segment_config *config) {
+	if (!trackCount || trackCount > MP4_MAX_TRACKS || !config->name) return false;
+
+	s->config = *config;
+	s->trackCount = trackCount;
+	s->primary = 0;
+
+	for (u32 i = 0; i < trackCount; ++i) {
+		if (tracks[i].configSize > MP4_MAX_CONFIG) return false;
+
+		s->tracks[i] = tracks[i];
+		s->tracks[i].config = s->configs[i];
+		for (u32 j = 0; j < tracks[i].configSize; ++j) {
+			s->configs[i][j] = ((const u8 *) tracks[i].config)[j];
+		}
+	}
+
+	for (u32 i = trackCount; i-- > 0; ) {
+		if (tracks[i].codec == MP4_CODEC_H264) s->primary = i;
+	}
+
+	// first file keeps timestamps as they are
+	u64 origin[MP4_MAX_TRACKS] = { 0 };
+	s->current = 0;
+	s->closing = false;
+	s->index = 0;
+	s->droppedFragments = 0;
+	s->failed = !SegmentOpen(s, &s->files[0], origin);
+
+	return !s->failed;
+}
+
+// closing file is done once every track got sample after split, or primary track got one
+// fragment past it, so silent track can't keep it open
+static void SegmentUpdateClosing(segmenter *s, u32 track, u64 decodeTime) {
+	segment_file *f = &s->files[s->current ^ 1];
+
+	if (track != s->primary && !f->ended[track]) {
+		Mp4EndTrack(&f->muxer, track, decodeTime - f->origin[track]);
+		f->ended[track] = true;
+	}
+
+	bool done = true;
+	for (u32 i = 0; i < s->trackCount; ++i) {
+		if (!f->ended[i]) done = false;
+	}
+
+	if (track == s->primary) {
+		u64 limit = (u64) s->config.fragmentDuration * s->tracks[track].timescale / 1000;
+		if (decodeTime - f->end[track] >= limit) done = true;
+	}
+
+	if (done) {
+		if (!SegmentClose(s, f)) s->failed = true;
+		s->closing = false;
+	}
+}
+
+// opens next file on IDR frame at decodeTime of primary track
+static void SegmentSplit(segmenter *s, u64 decodeTime) {
+	if (s->closing) {
+		if (!SegmentClose(s, &s->files[s->current ^ 1])) s->failed = true;
+		s->closing = false;
+	}
+
+	segment_file *previous = &s->files[s->current];
+	segment_file *next = &s->files[s->current ^ 1];
+
+	// every track starts at same instant, expressed in its own timescale
+	u64 origin[MP4_MAX_TRACKS];
+	u32 timescale = s->tracks[s->primary].timescale;
+	for (u32 i = 0; i < s->trackCount; ++i) {
+		origin[i] = Mp4ConvertTime(decodeTime, timescale, s->tracks[i].timescale);
+	}
+
+	// on failure recording simply continues in current file
+	s->index++;
+	if (!SegmentOpen(s, next, origin)) {
+		s->index--;
+		return;
+	}
+
+	Mp4ShareConfig(&next->muxer, &previous->muxer);
+
+	// last frame of previous file lasts exactly until first one of next file
+	for (u32 i = 0; i < s->trackCount; ++i) previous->end[i] = origin[i];
+	Mp4EndTrack(&previous->muxer, s->primary, decodeTime - previous->origin[s->primary]);
+	previous->ended[s->primary] = true;
+
+	s->current ^= 1;
+	s->closing = true;
+}
+
+static bool SegmentWriteSample(segmenter *s, u32 track, const void *data, u32 size, u64 decodeTime,
+							   u64 compositionTime, bool sync) {
+	if (s->failed || track >= s->trackCount) return false;
+
+	if (s->closing) {
+		segment_file *f = &s->files[s->current ^ 1];
+
+		if (track != s->primary && decodeTime < f->end[track]) {
+			u64 origin = f->origin[track];
+			return Mp4WriteSample(&f->muxer, track, data, size, decodeTime - origin,
+								  compositionTime - origin, sync);
+		}
+
+		SegmentUpdateClosing(s, track, decodeTime);
+	}
+
+	segment_file *f = &s->files[s->current];
+
+	if (track == s->primary && sync && f->started) {
+		u64 duration = (u64) s->config.duration * s->tracks[track].timescale / 1000;
+		bool split = duration && decodeTime - f->start >= duration;
+		if (s->config.size && f->file.size >= s->config.size) split = true;
+
+		if (split) {
+			SegmentSplit(s, decodeTime);
+			f = &s->files[s->current];
+		}
+	}
+
+	// sample of other track that came too late for file that was already closed
+	if (decodeTime < f->origin[track]) return true;
+
+	if (track == s->primary && !f->started) {
+		f->started = true;
+		f->start = decodeTime;
+	}
+
+	u64 origin = f->origin[track];
+	if (!Mp4WriteSample(&f->muxer, track, data, size, decodeTime - origin, compositionTime - origin,
+						sync)) {
+		return false;
+	}
+
+	return !s->failed;
+}
+
+static bool SegmentStop(segmenter *s) {
+	bool result = !s->failed;
+
+	if (s->closing) {
+		if (!SegmentClose(s, &s->files[s->current ^ 1])) result = false;
+		s->closing = false;
+	}
+
+	// memory of muxer is only set while file is open
+	if (s->files[s->current].muxer.memory) {
+		if (!SegmentClose(s, &s->files[s->current])) result = false;
+	}
+
+	s->failed = true;
+	return result;
+}
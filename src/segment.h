@@ -0,0 +1,64 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include "bog/bog_types.h"
+#include "mp4.h"
+#include "output.h"
+
+// splits recording into files of limited duration or size, every file is standalone MP4 that
+// starts with IDR frame & has its own timestamps starting at 0
+// next file is opened on IDR frame after limit is reached, previous one stays open until other
+// tracks reach same time, so samples around split go into right file & nothing is dropped
+
+#define SEGMENT_MAX_PATH 512
+
+// interface
+
+// builds name of file number index
+typedef bool segment_name(void *user, u32 index, output_path *path, u32 count);
+
+typedef struct {
+	u32 duration;         // msec, 0 for no limit
+	u64 size;             // bytes, 0 for no limit, checked against bytes written so far
+	u32 fragmentDuration; // msec, of fragments inside file
+	output_config output;
+	segment_name *name;
+	void *user;
+} segment_config;
+
+typedef struct {
+	mp4_muxer muxer;
+	output_file file;
+	u64 origin[MP4_MAX_TRACKS]; // decode time of track that is 0 in this file
+	u64 end[MP4_MAX_TRACKS];    // once file is closing, samples before this still go into it
+	bool ended[MP4_MAX_TRACKS];
+	bool started;               // primary track has first sample
+	u64 start;                  // decode time of that sample
+} segment_file;
+
+typedef struct {
+	segment_config config;
+	mp4_track_config tracks[MP4_MAX_TRACKS];
+	u8 configs[MP4_MAX_TRACKS][MP4_MAX_CONFIG]; // tracks point here, every file needs them
+	u32 trackCount;
+	u32 primary; // splits happen on its sync samples
+
+	segment_file files[2];
+	u32 current;  // file taking new samples, other one is closing or free
+	bool closing;
+	u32 index;    // number of current file
+	bool failed;
+	u32 droppedFragments; // of closed files, output without wait had no room for them
+} segmenter;
+
+static bool SegmentStart(segmenter *s, const mp4_track_config *tracks, u32 trackCount,
+						 const segment_config *config);
+
+// same as Mp4WriteSample, times are continuous across files, every file subtracts its own origin
+static bool SegmentWriteSample(segmenter *s, u32 track, const void *data, u32 size, u64 decodeTime,
+							   u64 compositionTime, bool sync);
+
+// finishes all open files, returns false if writing of any of them failed
+static bool SegmentStop(segmenter *s);
+
+#endif //SEGMENT_H
@@ -0,0 +1,144 @@
+// CLOCK_MONOTONIC is not in strict C, must be set before first system header
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "timebase.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+static time_rate TimeRate(u64 num, u64 den) {
+	time_rate rate = { .num = num, .den = den };
+	return rate;
+}
+
+#if !defined(__SIZEOF_INT128__) && !(defined(_MSC_VER) && defined(_M_X64))
+// shift & subtract, hi < div so quotient fits 64 bits
+static u64 TimeDivide128(u64 hi, u64 lo, u64 div, u64 *remainder) {
+	u64 quotient = 0;
+	for (u32 i = 0; i < 64; i++) {
+		u64 carry = hi >> 63;
+		hi = (hi << 1) | (lo >> 63);
+		lo <<= 1;
+		quotient <<= 1;
+		if (carry || hi >= div) {
+			hi -= div;
+			quotient |= 1;
+		}
+	}
+	*remainder = hi;
+	return quotient;
+}
+#endif
+
+static u64 TimeMulDiv(u64 value, u64 mul, u64 div, time_round round) {
+	if (!div) return UINT64_MAX;
+
+	u64 quotient, remainder;
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 product = (unsigned __int128) value * mul;
+	if ((product >> 64) >= div) return UINT64_MAX;
+	quotient = (u64) (product / div);
+	remainder = (u64) (product % div);
+#else
+	u64 hi, lo;
+#if defined(_MSC_VER) && defined(_M_X64)
+	lo = _umul128(value, mul, &hi);
+#else
+	// 32 bit halves, middle products can carry into high half
+	u64 a = value & 0xFFFFFFFF, b = value >> 32;
+	u64 c = mul & 0xFFFFFFFF, d = mul >> 32;
+	u64 ac = a * c, ad = a * d, bc = b * c, bd = b * d;
+	u64 middle = (ac >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF);
+	lo = (middle << 32) | (ac & 0xFFFFFFFF);
+	hi = bd + (ad >> 32) + (bc >> 32) + (middle >> 32);
+#endif
+	if (hi >= div) return UINT64_MAX;
+#if defined(_MSC_VER) && defined(_M_X64)
+	quotient = _udiv128(hi, lo, div, &remainder);
+#else
+	quotient = TimeDivide128(hi, lo, div, &remainder);
+#endif
+#endif
+
+	bool up = round == TIME_CEIL ? remainder != 0 :
+			  round == TIME_NEAREST ? remainder >= div - remainder : false;
+	if (up && quotient != UINT64_MAX) quotient++;
+	return quotient;
+}
+
+static u64 TimeConvert(u64 value, time_rate from, time_rate to, time_round round) {
+	return TimeMulDiv(value, from.den * to.num, from.num * to.den, round);
+}
+
+static u64 TimeClockSystemRead(void *user) {
+	(void) user;
+#ifdef _WIN32
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (u64) now.tv_sec * 1000000000 + (u64) now.tv_nsec;
+#endif
+}
+
+static void TimeClockSystem(time_clock *clock) {
+	clock->read = TimeClockSystemRead;
+	clock->user = 0;
+#ifdef _WIN32
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	clock->rate = TimeRate(freq.QuadPart, 1);
+#else
+	clock->rate = TimeRate(1000000000, 1);
+#endif
+}
+
+static u64 TimeClockNow(time_clock *clock) {
+	return clock->read(clock->user);
+}
+
+static void TimeFrameStart(time_frame_clock *fc, time_rate frames, time_rate ticks) {
+	fc->frames = frames;
+	fc->ticks = ticks;
+
+	// ticks of one frame are length / divisor
+	u64 length = ticks.num * frames.den;
+	fc->divisor = ticks.den * frames.num;
+	if (!fc->divisor) fc->divisor = 1;
+	fc->step = length / fc->divisor;
+	fc->stepRemainder = length % fc->divisor;
+
+	fc->index = 0;
+	fc->time = 0;
+	fc->remainder = 0;
+}
+
+static u64 TimeFrameNext(time_frame_clock *fc) {
+	u64 step = fc->step;
+	// remainder + stepRemainder could overflow, compare against what is left instead
+	if (fc->remainder >= fc->divisor - fc->stepRemainder) {
+		fc->remainder -= fc->divisor - fc->stepRemainder;
+		step++;
+	} else {
+		fc->remainder += fc->stepRemainder;
+	}
+
+	fc->index++;
+	fc->time += step;
+	return step;
+}
+
+static u64 TimeFrameAt(time_frame_clock *fc, u64 index) {
+	return TimeMulDiv(index, fc->ticks.num * fc->frames.den, fc->divisor, TIME_FLOOR);
+}
@@ -0,0 +1,68 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "bog/bog_types.h"
+
+// exact conversions between clocks & counters that tick at rational rate per second, like QPC
+// ticks, MF 100nsec units, audio samples & frame indices
+// value * rate products are done in 128 bits, so nothing overflows or loses precision before
+// final division & every conversion says how it rounds
+// frame clock steps through frame times with whole ticks & remainder, time of frame n is always
+// exactly n frames after frame 0, however long it runs
+
+// interface
+
+typedef struct {
+	u64 num, den;      // num / den ticks per second, num * den of two rates must fit 64 bits
+} time_rate;
+
+#define TIME_RATE_SECOND ((time_rate) { 1, 1 })
+#define TIME_RATE_MSEC ((time_rate) { 1000, 1 })
+#define TIME_RATE_MF ((time_rate) { 10000000, 1 })
+
+typedef enum {
+	TIME_FLOOR,
+	TIME_NEAREST,      // halves go up
+	TIME_CEIL,
+} time_round;
+
+// reads clock in ticks of rate, tests can give simulated clock instead of system one
+typedef u64 time_clock_read(void *user);
+
+typedef struct {
+	time_clock_read *read;
+	void *user;
+	time_rate rate;
+} time_clock;
+
+// steps through start of every frame
+typedef struct {
+	u64 index;         // current frame
+	u64 time;          // its start in ticks
+	u64 step, stepRemainder, remainder; // remainder & stepRemainder in 1 / divisor ticks
+	u64 divisor;
+	time_rate frames, ticks;
+} time_frame_clock;
+
+static time_rate TimeRate(u64 num, u64 den);
+
+// value * mul / div, result saturates when it doesn't fit 64 bits
+static u64 TimeMulDiv(u64 value, u64 mul, u64 div, time_round round);
+
+// value in ticks of rate from to ticks of rate to
+static u64 TimeConvert(u64 value, time_rate from, time_rate to, time_round round);
+
+// QPC on windows, CLOCK_MONOTONIC in nsec on linux
+static void TimeClockSystem(time_clock *clock);
+static u64 TimeClockNow(time_clock *clock);
+
+// frame 0 starts at tick 0, ticks of frame are from its start to start of next one
+static void TimeFrameStart(time_frame_clock *fc, time_rate frames, time_rate ticks);
+
+// moves to next frame, returns ticks of frame it leaves
+static u64 TimeFrameNext(time_frame_clock *fc);
+
+// start of any frame, same as where stepping would get to
+static u64 TimeFrameAt(time_frame_clock *fc, u64 index);
+
+#endif //TIMEBASE_H
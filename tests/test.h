@@ -0,0 +1,53 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include "bog/bog_types.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// tests of portable modules, every test is unity build of module it tests & runs on linux
+// build/test.sh builds & runs all of them, "bench" argument also runs benchmarks
+
+static u32 gTestFailures;
+
+#define Check(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		gTestFailures++; \
+	} \
+} while (0)
+
+static d64 TestSeconds(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (d64) t.tv_sec + (d64) t.tv_nsec * 1e-9;
+}
+
+// deterministic, so failure repeats on every run
+static u32 gTestRandom = 1;
+
+static u32 TestRandom(void) {
+	gTestRandom ^= gTestRandom << 13;
+	gTestRandom ^= gTestRandom >> 17;
+	gTestRandom ^= gTestRandom << 5;
+	return gTestRandom;
+}
+
+static void TestFill(void *data, udm size) {
+	u8 *bytes = (u8 *) data;
+	for (udm i = 0; i < size; ++i) bytes[i] = (u8) TestRandom();
+}
+
+static bool TestBench(int argc, char **argv) {
+	return argc > 1 && !strcmp(argv[1], "bench");
+}
+
+static int TestResult(const char *name) {
+	printf("%s: %s\n", name, gTestFailures ? "FAILED" : "ok");
+	return gTestFailures != 0;
+}
+
+#endif //TEST_H
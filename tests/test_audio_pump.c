@@ -0,0 +1,243 @@
+#include "mailbox.c"
+#include "audio_pump.c"
+#include "test.h"
+
+#define TEST_PERIOD 0.01   // seconds of device period
+#define TEST_PACKETS 4096
+
+// synthetic source signals pump every device period, drain hands packets to encoder side
+// through mailbox like capture does
+typedef struct {
+	s32 index;
+	d64 signaled;
+} test_packet;
+
+typedef struct {
+	audio_pump pump;
+	mailbox queue;
+	volatile s32 produced;
+	volatile s32 quit;
+	d64 signaled[TEST_PACKETS];
+	s32 drained;
+
+	d64 latency[TEST_PACKETS];   // signal to drain
+	d64 delivery[TEST_PACKETS];  // signal to encoder side
+	d64 drainTime[TEST_PACKETS];
+	u32 delivered;
+	u32 errors;                  // packets out of order
+	volatile s32 loadQuit;
+	volatile u64 loadSink;
+} test_state;
+
+static test_state gState;
+
+static void TestSleep(d64 seconds) {
+	struct timespec t = { (time_t) seconds, (long) ((seconds - (time_t) seconds) * 1e9) };
+	nanosleep(&t, 0);
+}
+
+static BOG_THREAD_PROC(Source) {
+	test_state *s = (test_state *) arg;
+	d64 next = TestSeconds() + TEST_PERIOD;
+	while (!BOGAtomicLoad(&s->quit)) {
+		d64 now = TestSeconds();
+		if (now < next) {
+			TestSleep(next - now);
+			continue;
+		}
+
+		s32 index = s->produced;
+		if (index < TEST_PACKETS) {
+			s->signaled[index] = TestSeconds();
+			BOGAtomicStore(&s->produced, index + 1);
+			AudioPumpSignal(&s->pump);
+		}
+		next += TEST_PERIOD;
+	}
+	return 0;
+}
+
+static void Drain(void *user) {
+	test_state *s = (test_state *) user;
+	d64 now = TestSeconds();
+	s32 produced = BOGAtomicLoad(&s->produced);
+	for (; s->drained < produced; ++s->drained) {
+		s->latency[s->drained] = now - s->signaled[s->drained];
+		s->drainTime[s->drained] = now;
+		test_packet packet = { s->drained, s->signaled[s->drained] };
+		MailboxPush(&s->queue, &packet);
+	}
+}
+
+static BOG_THREAD_PROC(Consumer) {
+	test_state *s = (test_state *) arg;
+	for (;;) {
+		test_packet packet;
+		if (!MailboxPop(&s->queue, &packet)) {
+			MailboxWait(&s->queue, MAILBOX_WAIT_FOREVER);
+			continue;
+		}
+		if (packet.index < 0) break;
+
+		s->errors += packet.index != (s32) s->delivered;
+		s->delivery[s->delivered++] = TestSeconds() - packet.signaled;
+	}
+	return 0;
+}
+
+static BOG_THREAD_PROC(Load) {
+	test_state *s = (test_state *) arg;
+	u64 x = 1;
+	while (!BOGAtomicLoad(&s->loadQuit)) {
+		for (u32 i = 0; i < 100000; ++i) x = x * 6364136223846793005ull + 1;
+		s->loadSink = x;
+	}
+	return 0;
+}
+
+static int CompareSeconds(const void *a, const void *b) {
+	d64 x = *(const d64 *) a, y = *(const d64 *) b;
+	return x < y ? -1 : x > y;
+}
+
+typedef struct {
+	d64 mean, median, p99, max; // msec
+} distribution;
+
+static distribution Distribution(d64 *values, u32 count) {
+	distribution d = { 0 };
+	if (!count) return d;
+
+	qsort(values, count, sizeof(d64), CompareSeconds);
+	for (u32 i = 0; i < count; ++i) d.mean += values[i];
+	d.mean = d.mean / count * 1000;
+	d.median = values[count / 2] * 1000;
+	d.p99 = values[count * 99 / 100] * 1000;
+	d.max = values[count - 1] * 1000;
+	return d;
+}
+
+typedef struct {
+	u32 packets;
+	distribution latency, delivery, jitter;
+	u32 wakeups, timeouts;
+} result;
+
+// source runs for seconds while load threads keep every cpu busy, nothing may be lost
+static result Run(u32 loadThreads, d64 seconds) {
+	test_state *s = &gState;
+	memset(s, 0, sizeof(*s));
+	Check(AudioPumpCreate(&s->pump));
+	mailbox_config queue = { .itemSize = sizeof(test_packet), .count = 64,
+							 .policy = MAILBOX_BLOCK, .timeout = MAILBOX_WAIT_FOREVER };
+	Check(MailboxCreate(&s->queue, &queue));
+
+	bog_thread load[8], consumer, source;
+	for (u32 i = 0; i < loadThreads; ++i) Check(BOGThreadCreate(&load[i], Load, s));
+	Check(BOGThreadCreate(&consumer, Consumer, s));
+	audio_pump_config config = { Drain, s, 20 };
+	Check(AudioPumpStart(&s->pump, &config));
+	Check(BOGThreadCreate(&source, Source, s));
+
+	TestSleep(seconds);
+	BOGAtomicStore(&s->quit, 1);
+	BOGThreadJoin(source);
+	AudioPumpStop(&s->pump);
+	Drain(s);
+	test_packet end = { -1, 0 };
+	MailboxPush(&s->queue, &end);
+	BOGThreadJoin(consumer);
+	BOGAtomicStore(&s->loadQuit, 1);
+	for (u32 i = 0; i < loadThreads; ++i) BOGThreadJoin(load[i]);
+
+	result r = { 0 };
+	r.packets = (u32) s->produced;
+	r.wakeups = s->pump.wakeups;
+	r.timeouts = s->pump.timeouts;
+	Check(s->drained == s->produced);
+	Check(s->delivered == r.packets);
+	Check(!s->errors);
+
+	// spacing of drains against device period, packets drained together count as one drain
+	static d64 jitter[TEST_PACKETS];
+	u32 spacings = 0;
+	for (u32 i = 1; i < r.packets; ++i) {
+		if (s->drainTime[i] == s->drainTime[i - 1]) continue;
+		d64 d = s->drainTime[i] - s->drainTime[i - 1] - TEST_PERIOD;
+		jitter[spacings++] = d < 0 ? -d : d;
+	}
+	r.latency = Distribution(s->latency, r.packets);
+	r.delivery = Distribution(s->delivery, s->delivered);
+	r.jitter = Distribution(jitter, spacings);
+
+	MailboxDestroy(&s->queue);
+	AudioPumpDestroy(&s->pump);
+	return r;
+}
+
+// every packet is drained right after its signal, not at next timer tick, even under load
+static void TestLatency(void) {
+	result idle = Run(0, 2);
+	Check(idle.packets >= 150);
+	Check(idle.wakeups >= idle.packets / 2);
+	Check(idle.latency.p99 < 5);
+
+	result loaded = Run(2 * BOGThreadCount(), 2);
+	Check(loaded.packets >= 150);
+	Check(loaded.latency.p99 < 30);
+}
+
+static volatile s32 gDrains;
+
+static void CountDrain(void *user) {
+	BOGAtomicAdd(&gDrains, 1);
+}
+
+// source that never signals is still drained every timeout, signal before start isn't lost &
+// without timeout nothing drains until signal
+static void TestTimeout(void) {
+	audio_pump pump;
+	Check(AudioPumpCreate(&pump));
+	audio_pump_config config = { CountDrain, 0, 20 };
+	gDrains = 0;
+	Check(AudioPumpStart(&pump, &config));
+	Check(!AudioPumpStart(&pump, &config));
+	TestSleep(0.5);
+	d64 start = TestSeconds();
+	AudioPumpStop(&pump);
+	Check(TestSeconds() - start < 0.05);
+	Check(gDrains >= 15 && gDrains <= 26);
+	Check(pump.timeouts == (u32) gDrains && !pump.wakeups);
+
+	AudioPumpSignal(&pump);
+	config.timeout = AUDIO_PUMP_WAIT_FOREVER;
+	gDrains = 0;
+	Check(AudioPumpStart(&pump, &config));
+	TestSleep(0.2);
+	AudioPumpStop(&pump);
+	Check(gDrains == 1 && pump.wakeups == 1);
+	AudioPumpDestroy(&pump);
+}
+
+static void Bench(void) {
+	u32 loads[] = { 0, 4 * BOGThreadCount() };
+	for (u32 i = 0; i < 2; ++i) {
+		result r = Run(loads[i], 10);
+		printf("audio pump with %u busy threads on %u cpus, %u packets, %u wakeups, %u timeouts\n",
+			   loads[i], BOGThreadCount(), r.packets, r.wakeups, r.timeouts);
+		const char *names[] = { "signal to drain", "signal to encoder side", "drain jitter" };
+		distribution *d[] = { &r.latency, &r.delivery, &r.jitter };
+		for (u32 k = 0; k < 3; ++k) {
+			printf("  %-22s mean %.3f msec, median %.3f, p99 %.3f, max %.3f\n", names[k],
+				   d[k]->mean, d[k]->median, d[k]->p99, d[k]->max);
+		}
+	}
+	printf("100 msec timer poll waits up to 100 msec, 50 msec on average, in bursts of 10\n");
+}
+
+int main(int argc, char **argv) {
+	TestLatency();
+	TestTimeout();
+	if (TestBench(argc, argv)) Bench();
+	return TestResult("audio_pump");
+}
@@ -0,0 +1,618 @@
+#include "convert.c"
+#include "test.h"
+
+#include <math.h>
+
+// BGRA8 to NV12 of every SIMD level must match scalar kernels byte for byte
+
+static void ConvertLevels(const convert_fixed *f, const u8 *src, udm stride, u32 width,
+						  u32 height) {
+	u32 outWidth = (width + 1) & ~1, outHeight = (height + 1) & ~1;
+	udm size = (udm) outWidth * outHeight * 3 / 2;
+	u8 *expected = malloc(size);
+	u8 *actual = malloc(size);
+
+	ConvertSetLevel(BOG_CPU_SCALAR);
+	ConvertToNV12(f, src, stride, width, height, expected, outWidth,
+				  expected + outWidth * outHeight, outWidth);
+
+	for (bog_cpu_level level = BOG_CPU_SSE2; level <= BOGCpuLevel(); ++level) {
+		memset(actual, 0, size);
+		ConvertSetLevel(level);
+		ConvertToNV12(f, src, stride, width, height, actual, outWidth,
+					  actual + outWidth * outHeight, outWidth);
+		Check(!memcmp(expected, actual, size));
+	}
+
+	// regions converted one by one give whole frame
+	ConvertSetLevel(BOGCpuLevel());
+	memset(actual, 0, size);
+	for (u32 y = 0; y < height; y += 16) {
+		for (u32 x = 0; x < width; x += 32) {
+			u32 x1 = x + 32 < width ? x + 32 : width;
+			u32 y1 = y + 16 < height ? y + 16 : height;
+			ConvertToNV12Region(f, src, stride, width, height, x, y, x1, y1, actual, outWidth,
+								actual + outWidth * outHeight, outWidth);
+		}
+	}
+	Check(!memcmp(expected, actual, size));
+
+	free(expected);
+	free(actual);
+}
+
+static void TestIdentity(const convert_fixed *f) {
+	static const u32 sizes[][2] = { { 1, 1 }, { 2, 2 }, { 3, 5 }, { 17, 9 }, { 33, 7 },
+									{ 1920, 1080 }, { 2561, 1441 } };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		u32 width = sizes[i][0], height = sizes[i][1];
+		udm stride = width * 4 + 12; // rows of captured rect are not packed
+		u8 *src = malloc(stride * height);
+		TestFill(src, stride * height);
+		ConvertLevels(f, src, stride, width, height);
+		free(src);
+	}
+}
+
+// limited range BT.709 of flat colors, same values shader gives
+static void TestReference(const convert_fixed *f) {
+	static const struct { u8 bgra[4]; u8 y, u, v; } colors[] = {
+		{ { 255, 255, 255, 255 }, 235, 128, 128 },
+		{ { 0, 0, 0, 255 }, 16, 128, 128 },
+		{ { 128, 128, 128, 255 }, 126, 128, 128 },
+		{ { 0, 0, 255, 255 }, 63, 102, 240 },
+	};
+
+	for (u32 i = 0; i < sizeof(colors) / sizeof(*colors); ++i) {
+		u8 src[2][2][4];
+		for (u32 p = 0; p < 4; ++p) memcpy(src[p / 2][p % 2], colors[i].bgra, 4);
+
+		for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+			u8 y[2][2], uv[2];
+			ConvertSetLevel(level);
+			ConvertToNV12(f, src, 8, 2, 2, y[0], 2, uv, 2);
+			Check(y[0][0] == colors[i].y && y[1][1] == colors[i].y);
+			Check(uv[0] == colors[i].u && uv[1] == colors[i].v);
+		}
+	}
+}
+
+static const char *gInputNames[] = { "BGRA8", "RGBA8", "RGB10A2", "RGBA16F", "scRGB" };
+static const char *gOutputNames[] = { "NV12", "P010" };
+
+// float to half for normal numbers & zero, rounds to nearest
+static u16 TestHalf(f32 value) {
+	union { f32 f; u32 u; } bits = { value };
+	u32 sign = (bits.u >> 16) & 0x8000;
+	s32 exponent = (s32) ((bits.u >> 23) & 0xFF) - 127 + 15;
+	if (value == 0 || exponent <= 0) return (u16) sign;
+	if (exponent >= 31) return (u16) (sign | 0x7C00);
+	return (u16) (sign | (exponent << 10) | (((bits.u & 0x7FFFFF) + 0x1000) >> 13));
+}
+
+// random pixels of input format, half floats are mostly in [-0.1..1.2] with some raw bit patterns
+static void TestFillInput(convert_input input, void *data, udm pixels) {
+	TestFill(data, pixels * ConvertInputSize(input));
+	if (input == CONVERT_INPUT_RGBA16F) {
+		u16 *halves = (u16 *) data;
+		for (udm i = 0; i < pixels * 4; ++i) {
+			if (TestRandom() % 10) halves[i] = TestHalf((f32) (TestRandom() % 2000) / 1500 - 0.1f);
+		}
+	}
+}
+
+// every specialized float kernel matches its scalar version at every level
+static void TestKernels(void) {
+	u32 width = 1001, height = 67, outWidth = 1002, outHeight = 68;
+	for (convert_input input = 0; input < CONVERT_INPUT_SCRGB; ++input) {
+		for (convert_output output = 0; output < CONVERT_OUTPUT_COUNT; ++output) {
+			u32 pixelSize = ConvertInputSize(input), sampleSize = ConvertOutputSize(output);
+			udm planeY = (udm) outWidth * outHeight * sampleSize, size = planeY * 3 / 2;
+			u8 *src = malloc((udm) width * height * pixelSize);
+			u8 *expected = malloc(size), *actual = malloc(size);
+			TestFillInput(input, src, (udm) width * height);
+
+			for (convert_colorspace cs = 0; cs < CONVERT_COLORSPACE_COUNT; ++cs) {
+				for (u32 fullRange = 0; fullRange < 2; ++fullRange) {
+					convert_matrix m;
+					ConvertMatrixFor(&m, cs, fullRange, input, output);
+
+					ConvertSetLevel(BOG_CPU_SCALAR);
+					ConvertRegion(input, output, &m, src, width * pixelSize, width, height, 0, 0,
+								  width, height, expected, outWidth * sampleSize,
+								  expected + planeY, outWidth * sampleSize);
+
+					for (bog_cpu_level level = BOG_CPU_SSE2; level <= BOGCpuLevel(); ++level) {
+						memset(actual, 0, size);
+						ConvertSetLevel(level);
+						ConvertRegion(input, output, &m, src, width * pixelSize, width, height, 0,
+									  0, width, height, actual, outWidth * sampleSize,
+									  actual + planeY, outWidth * sampleSize);
+						if (memcmp(expected, actual, size)) {
+							printf("%s to %s colorspace %d range %u level %d differs\n",
+								   gInputNames[input], gOutputNames[output], cs, fullRange, level);
+							gTestFailures++;
+						}
+					}
+				}
+			}
+
+			free(src);
+			free(expected);
+			free(actual);
+		}
+	}
+}
+
+// white, black & red of every input give same limited range BT.709 samples
+static void TestKernelReference(void) {
+	static const u8 bgra[3][4] = { { 255, 255, 255, 255 }, { 0, 0, 0, 255 }, { 0, 0, 255, 255 } };
+	static const u32 rgb10[3] = { 0xFFFFFFFF, 0xC0000000, 0xC00003FF };
+	static const u16 rgba16[3][4] = { { 0x3C00, 0x3C00, 0x3C00, 0x3C00 }, { 0, 0, 0, 0x3C00 },
+									  { 0x3C00, 0, 0, 0x3C00 } };
+	static const u32 expected[CONVERT_OUTPUT_COUNT][3][3] = {
+		{ { 235, 128, 128 }, { 16, 128, 128 }, { 63, 102, 240 } },
+		{ { 940, 512, 512 }, { 64, 512, 512 }, { 250, 409, 960 } },
+	};
+
+	for (convert_input input = 0; input < CONVERT_INPUT_SCRGB; ++input) {
+		for (convert_output output = 0; output < CONVERT_OUTPUT_COUNT; ++output) {
+			convert_matrix m;
+			ConvertMatrixFor(&m, CONVERT_BT709, false, input, output);
+
+			for (u32 color = 0; color < 3; ++color) {
+				u8 pixel[8];
+				if (input == CONVERT_INPUT_BGRA8) memcpy(pixel, bgra[color], 4);
+				if (input == CONVERT_INPUT_RGBA8) {
+					u8 rgba[4] = { bgra[color][2], bgra[color][1], bgra[color][0], 255 };
+					memcpy(pixel, rgba, 4);
+				}
+				if (input == CONVERT_INPUT_RGB10A2) memcpy(pixel, &rgb10[color], 4);
+				if (input == CONVERT_INPUT_RGBA16F) memcpy(pixel, rgba16[color], 8);
+
+				u8 src[2][16];
+				u32 pixelSize = ConvertInputSize(input);
+				for (u32 p = 0; p < 4; ++p) memcpy(src[p / 2] + p % 2 * pixelSize, pixel, pixelSize);
+
+				for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+					u16 y[2][2], uv[2];
+					ConvertSetLevel(level);
+					ConvertRegion(input, output, &m, src[0], src[1] - src[0], 2, 2, 0, 0, 2, 2, y,
+								  2 * sizeof(u16), uv, 2 * sizeof(u16));
+
+					u32 sampleY = output ? y[0][0] >> 6 : ((u8 *) y)[0];
+					u32 sampleU = output ? uv[0] >> 6 : ((u8 *) uv)[0];
+					u32 sampleV = output ? uv[1] >> 6 : ((u8 *) uv)[1];
+					Check(sampleY == expected[output][color][0]);
+					Check(sampleU == expected[output][color][1]);
+					Check(sampleV == expected[output][color][2]);
+				}
+			}
+		}
+	}
+}
+
+static d64 TestHalfValue(u16 half) {
+	s32 exponent = (half >> 10) & 31, mantissa = half & 1023;
+	d64 value = exponent ? ldexp(1024 + mantissa, exponent - 25) : ldexp(mantissa, -24);
+	return half & 0x8000 ? -value : value;
+}
+
+// same curves as ConvertTransferValue, computed with libm
+static d64 TestTransferValue(convert_transfer transfer, d64 value, d64 peak) {
+	if (transfer == CONVERT_TRANSFER_PQ) {
+		d64 m1 = 2610.0 / 16384, m2 = 2523.0 / 4096 * 128;
+		d64 c1 = 3424.0 / 4096, c2 = 2413.0 / 4096 * 32, c3 = 2392.0 / 4096 * 32;
+		d64 y = pow(value, m1);
+		return pow((c1 + c2 * y) / (1 + c3 * y), m2);
+	}
+	if (transfer == CONVERT_TRANSFER_HLG) {
+		d64 a = 0.17883277, b = 1 - 4 * a, c = 0.5 - a * log(4 * a);
+		return value <= 1.0 / 12 ? sqrt(3 * value) : a * log(12 * value - b) + c;
+	}
+	d64 knee = 0.75, l = value * peak;
+	if (l > knee && peak > 1) {
+		d64 x = (l - knee) / (1 - knee), w = (peak - knee) / (1 - knee);
+		l = knee + (1 - knee) * x * (1 + x / (w * w)) / (1 + x);
+	}
+	d64 result = l <= 0.0031308 ? 12.92 * l : 1.055 * pow(l, 1 / 2.4) - 0.055;
+	return result < 0 ? 0 : result > 1 ? 1 : result;
+}
+
+// difference of 10-bit sample in top bits of word from reference value, larger of it & maxError
+static s32 TestCodeError(s32 maxError, u16 sample, d64 reference) {
+	s32 code = (s32) floor(reference + 0.5);
+	code = code < 0 ? 0 : code > 1023 ? 1023 : code;
+	s32 error = abs((sample >> 6) - code);
+	return error > maxError ? error : maxError;
+}
+
+static const char *gTransferNames[] = { "PQ", "HLG", "SDR" };
+
+// half float scRGB with out of gamut negatives, values above peak, NaN & inf
+static void TestFillScRGB(u16 *data, udm count, d64 range) {
+	for (udm i = 0; i < count; ++i) {
+		u32 r = TestRandom() % 64;
+		if (r == 0) {
+			data[i] = (u16) TestRandom();
+		} else if (r < 4) {
+			data[i] = TestHalf(-(f32) (TestRandom() % 100) / 100);
+		} else {
+			d64 t = (d64) (TestRandom() % 1000000) / 1000000;
+			data[i] = TestHalf((f32) (exp2(t * 30 - 24) * range / 80 * 1.2));
+		}
+	}
+}
+
+static void TestPow(void) {
+	d64 maxError = 0;
+	for (u32 i = 0; i < 100000; ++i) {
+		d64 x = exp((d64) (TestRandom() % 1000000) / 1000000 * 60 - 45);
+		d64 y = (d64) (TestRandom() % 1000000) / 10000 - 50;
+		d64 expected = pow(x, y);
+		if (expected > 1e-300 && expected < 1e300) {
+			maxError = fmax(maxError, fabs(ConvertPow(x, y) - expected) / expected);
+		}
+	}
+	Check(maxError < 1e-9);
+}
+
+// scRGB to P010 of every transfer is within 1 code of double precision reference &
+// SIMD levels match scalar
+static void TestTransfer(void) {
+	static const d64 bt709[3][3] = {
+		{ 0.2126, 0.7152, 0.0722 }, { -0.1146, -0.3854, 0.5 }, { 0.5, -0.4542, -0.0458 },
+	};
+	static const d64 bt2020[3][3] = {
+		{ 0.2627, 0.678, 0.0593 }, { -0.13963, -0.36037, 0.5 }, { 0.5, -0.45979, -0.04021 },
+	};
+	static const d64 primaries[3][3] = { // BT.709 to BT.2020
+		{ 0.6274040, 0.3292820, 0.0433136 },
+		{ 0.0690970, 0.9195400, 0.0113612 },
+		{ 0.0163916, 0.0880132, 0.8955950 },
+	};
+
+	u32 width = 1024, height = 256;
+	udm planeY = (udm) width * height * 2, size = planeY * 3 / 2;
+	u16 *src = malloc((udm) width * height * 8);
+	u8 *expected = malloc(size), *actual = malloc(size);
+
+	for (convert_transfer transfer = 0; transfer < CONVERT_TRANSFER_COUNT; ++transfer) {
+		bool sdr = transfer == CONVERT_TRANSFER_SDR;
+		f32 white = sdr ? 200.0f : 203.0f, peak = sdr ? 600.0f : 1000.0f;
+		d64 range = transfer == CONVERT_TRANSFER_PQ ? 10000 : peak;
+		d64 peakRelative = sdr ? (d64) peak / white : 1;
+		const d64 (*c)[3] = sdr ? bt709 : bt2020;
+		ConvertSetTransfer(transfer, white, peak);
+		TestFillScRGB(src, (udm) width * height * 4, range);
+
+		for (u32 fullRange = 0; fullRange < 2; ++fullRange) {
+			convert_matrix m;
+			ConvertMatrixFor(&m, sdr ? CONVERT_BT709 : CONVERT_BT2020, fullRange,
+							 CONVERT_INPUT_SCRGB, CONVERT_OUTPUT_P010);
+
+			ConvertSetLevel(BOG_CPU_SCALAR);
+			ConvertRegion(CONVERT_INPUT_SCRGB, CONVERT_OUTPUT_P010, &m, src, width * 8, width,
+						  height, 0, 0, width, height, expected, width * 2, expected + planeY,
+						  width * 2);
+			for (bog_cpu_level level = BOG_CPU_SSE2; level <= BOGCpuLevel(); ++level) {
+				ConvertSetLevel(level);
+				ConvertRegion(CONVERT_INPUT_SCRGB, CONVERT_OUTPUT_P010, &m, src, width * 8, width,
+							  height, 0, 0, width, height, actual, width * 2, actual + planeY,
+							  width * 2);
+				Check(memcmp(expected, actual, size) == 0);
+			}
+
+			d64 rangeY = fullRange ? 1023 : 876, offsetY = fullRange ? 0 : 64;
+			d64 rangeUV = fullRange ? 1023 : 896;
+			s32 maxError = 0;
+			for (u32 y = 0; y < height; y += 2) {
+				u16 *rowY = (u16 *) (expected + (udm) y * width * 2);
+				u16 *rowUV = (u16 *) (expected + planeY + (udm) y / 2 * width * 2);
+				for (u32 x = 0; x < width; x += 2) {
+					d64 u = 512, v = 512;
+					for (u32 k = 0; k < 4; ++k) {
+						u16 *pixel = src + ((udm) (y + k / 2) * width + x + k % 2) * 4;
+						d64 linear[3], e[3];
+						for (u32 i = 0; i < 3; ++i) linear[i] = TestHalfValue(pixel[i]);
+						for (u32 i = 0; i < 3; ++i) {
+							d64 value = sdr ? linear[i] : 0;
+							for (u32 j = 0; j < 3 && !sdr; ++j) value += primaries[i][j] * linear[j];
+							value = value * 80 / range;
+							value = value > 0 ? (value < 1 ? value : 1) : 0; // NaN is black
+							e[i] = TestTransferValue(transfer, value, peakRelative);
+						}
+
+						d64 luma = (c[0][0] * e[0] + c[0][1] * e[1] + c[0][2] * e[2]) * rangeY;
+						u += (c[1][0] * e[0] + c[1][1] * e[1] + c[1][2] * e[2]) * rangeUV / 4;
+						v += (c[2][0] * e[0] + c[2][1] * e[1] + c[2][2] * e[2]) * rangeUV / 4;
+						maxError = TestCodeError(maxError, rowY[k / 2 * width + x + k % 2],
+												 luma + offsetY);
+					}
+					maxError = TestCodeError(maxError, rowUV[x], u);
+					maxError = TestCodeError(maxError, rowUV[x + 1], v);
+				}
+			}
+
+			if (maxError > 1) {
+				printf("%s %s range is %d codes off\n", gTransferNames[transfer],
+					   fullRange ? "full" : "limited", maxError);
+				gTestFailures++;
+			}
+		}
+	}
+
+	free(src);
+	free(expected);
+	free(actual);
+}
+
+static u32 TestSample(const void *plane, convert_output output, udm index) {
+	return output == CONVERT_OUTPUT_P010 ? ((const u16 *) plane)[index] >> 6 :
+										   ((const u8 *) plane)[index];
+}
+
+// integer kernels match their scalar versions at every level, stay within 1 code of float ones &
+// keep grey axis exact
+static void TestFixed(void) {
+	u32 width = 1001, height = 67, outWidth = 1002, outHeight = 68;
+	for (convert_input input = 0; input < CONVERT_INPUT_COUNT; ++input) {
+		if (!ConvertFixedSupported(input)) continue;
+		for (convert_output output = 0; output < CONVERT_OUTPUT_COUNT; ++output) {
+			u32 pixelSize = ConvertInputSize(input), sampleSize = ConvertOutputSize(output);
+			udm planeY = (udm) outWidth * outHeight * sampleSize, size = planeY * 3 / 2;
+			u8 *src = malloc((udm) width * height * pixelSize);
+			u8 *floats = calloc(size, 1), *expected = calloc(size, 1), *actual = calloc(size, 1);
+			TestFill(src, (udm) width * height * pixelSize);
+
+			for (convert_colorspace cs = 0; cs < CONVERT_COLORSPACE_COUNT; ++cs) {
+				for (u32 fullRange = 0; fullRange < 2; ++fullRange) {
+					convert_matrix m;
+					convert_fixed f;
+					ConvertMatrixFor(&m, cs, fullRange, input, output);
+					ConvertFixedFromMatrix(&f, &m);
+
+					ConvertSetLevel(BOG_CPU_SCALAR);
+					ConvertRegion(input, output, &m, src, width * pixelSize, width, height, 0, 0,
+								  width, height, floats, outWidth * sampleSize, floats + planeY,
+								  outWidth * sampleSize);
+					ConvertRegionFixed(input, output, &f, src, width * pixelSize, width, height, 0,
+									   0, width, height, expected, outWidth * sampleSize,
+									   expected + planeY, outWidth * sampleSize);
+
+					for (bog_cpu_level level = BOG_CPU_SSE2; level <= BOGCpuLevel(); ++level) {
+						ConvertSetLevel(level);
+						ConvertRegionFixed(input, output, &f, src, width * pixelSize, width, height,
+										   0, 0, width, height, actual, outWidth * sampleSize,
+										   actual + planeY, outWidth * sampleSize);
+						Check(memcmp(expected, actual, size) == 0);
+					}
+
+					u32 maxError = 0;
+					for (udm i = 0; i < size / sampleSize; ++i) {
+						s32 a = TestSample(floats, output, i), b = TestSample(expected, output, i);
+						if ((u32) abs(a - b) > maxError) maxError = abs(a - b);
+					}
+					if (maxError > 1) {
+						printf("fixed %s to %s colorspace %d range %u is %u codes off\n",
+							   gInputNames[input], gOutputNames[output], cs, fullRange, maxError);
+						gTestFailures++;
+					}
+
+					// every grey gives zero chroma, black & white give ends of range
+					bool p010 = output == CONVERT_OUTPUT_P010;
+					u32 maxValue = input == CONVERT_INPUT_RGB10A2 ? 1023 : 255;
+					u32 black = fullRange ? 0 : p010 ? 64 : 16;
+					u32 white = fullRange ? (p010 ? 1023 : 255) : p010 ? 940 : 235;
+					for (u32 grey = 0; grey <= maxValue; ++grey) {
+						u32 pixel = input == CONVERT_INPUT_RGB10A2 ?
+							grey | grey << 10 | grey << 20 | 3u << 30 :
+							grey | grey << 8 | grey << 16 | 0xFFu << 24;
+						u32 rows[2][2] = { { pixel, pixel }, { pixel, pixel } };
+						u16 y[2][2], uv[2];
+						gConvertFixedKernelsScalar[input][output](&f, rows[0], rows[1], y[0], y[1],
+																  uv, 1);
+						Check(TestSample(uv, output, 0) == (p010 ? 512u : 128u));
+						Check(TestSample(uv, output, 1) == (p010 ? 512u : 128u));
+						if (grey == 0) Check(TestSample(y, output, 0) == black);
+						if (grey == maxValue) Check(TestSample(y, output, 0) == white);
+					}
+				}
+			}
+
+			free(src);
+			free(floats);
+			free(expected);
+			free(actual);
+		}
+	}
+}
+
+// shader matrix made from fixed one gives same luma before rounding as integer kernel
+static void TestShaderMatrix(void) {
+	convert_matrix m, shader;
+	convert_fixed f;
+	ConvertMatrixFor(&m, CONVERT_BT709, false, CONVERT_INPUT_BGRA8, CONVERT_OUTPUT_NV12);
+	ConvertFixedFromMatrix(&f, &m);
+	ConvertMatrixFromFixed(&shader, &f, 255, 1);
+
+	for (u32 i = 0; i < 10000; ++i) {
+		u32 pixel = TestRandom() | 0xFF000000;
+		u32 rows[2][2] = { { pixel, pixel }, { pixel, pixel } };
+		u8 y[2][2], uv[2];
+		gConvertFixedKernelsScalar[CONVERT_INPUT_BGRA8][CONVERT_OUTPUT_NV12](&f, rows[0], rows[1],
+																			 y[0], y[1], uv, 1);
+
+		d64 b = (pixel & 0xFF) / 255.0, g = (pixel >> 8 & 0xFF) / 255.0;
+		d64 r = (pixel >> 16 & 0xFF) / 255.0;
+		d64 luma = shader.m[0][0] * r + shader.m[0][1] * g + shader.m[0][2] * b + shader.m[0][3];
+		Check(fabs(luma - y[0][0]) < 1);
+	}
+}
+
+static void Bench(const convert_fixed *f) {
+	static const u32 sizes[][2] = { { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		u32 width = sizes[i][0], height = sizes[i][1];
+		u8 *src = malloc((udm) width * height * 4);
+		u8 *dst = malloc((udm) width * height * 3 / 2);
+		TestFill(src, (udm) width * height * 4);
+
+		for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+			ConvertSetLevel(level);
+			u32 count = 20;
+			d64 start = TestSeconds();
+			for (u32 n = 0; n < count; ++n) {
+				ConvertToNV12(f, src, width * 4, width, height, dst, width, dst + width * height,
+							  width);
+			}
+			d64 seconds = (TestSeconds() - start) / count;
+			printf("convert %ux%u level %d: %.2f ms, %.2f GB/s\n", width, height, level,
+				   seconds * 1e3, (d64) width * height * 4 / seconds / 1e9);
+		}
+
+		free(src);
+		free(dst);
+	}
+}
+
+// 1080p frames per second of every float kernel at every level
+static void BenchKernels(void) {
+	u32 width = 1920, height = 1080;
+	for (convert_input input = 0; input < CONVERT_INPUT_SCRGB; ++input) {
+		for (convert_output output = 0; output < CONVERT_OUTPUT_COUNT; ++output) {
+			u32 pixelSize = ConvertInputSize(input), sampleSize = ConvertOutputSize(output);
+			u8 *src = malloc((udm) width * height * pixelSize);
+			u8 *dst = malloc((udm) width * height * 3 / 2 * sampleSize);
+			TestFillInput(input, src, (udm) width * height);
+
+			convert_matrix m;
+			ConvertMatrixFor(&m, CONVERT_BT709, false, input, output);
+			printf("convert %-7s to %s fps:", gInputNames[input], gOutputNames[output]);
+
+			for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+				ConvertSetLevel(level);
+				u32 count = level ? 40 : 8;
+				d64 start = TestSeconds();
+				for (u32 n = 0; n < count; ++n) {
+					ConvertRegion(input, output, &m, src, width * pixelSize, width, height, 0, 0,
+								  width, height, dst, width * sampleSize,
+								  dst + (udm) width * height * sampleSize, width * sampleSize);
+				}
+				printf(" %8.1f", count / (TestSeconds() - start));
+			}
+			printf("\n");
+
+			free(src);
+			free(dst);
+		}
+	}
+}
+
+// 4K HDR desktop frame to P010 of every transfer at every level
+static void BenchTransfer(void) {
+	u32 width = 3840, height = 2160;
+	udm planeY = (udm) width * height * 2;
+	u16 *src = malloc((udm) width * height * 8);
+	u8 *dst = malloc(planeY * 3 / 2);
+	TestFillScRGB(src, (udm) width * height * 4, 10000);
+
+	for (convert_transfer transfer = 0; transfer < CONVERT_TRANSFER_COUNT; ++transfer) {
+		bool sdr = transfer == CONVERT_TRANSFER_SDR;
+		convert_matrix m;
+		ConvertSetTransfer(transfer, 203, 1000);
+		ConvertMatrixFor(&m, sdr ? CONVERT_BT709 : CONVERT_BT2020, false, CONVERT_INPUT_SCRGB,
+						 CONVERT_OUTPUT_P010);
+
+		printf("scRGB %-3s to P010 4K ms:", gTransferNames[transfer]);
+		for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+			ConvertSetLevel(level);
+			d64 best = 1e9;
+			for (u32 n = 0; n < 5; ++n) {
+				d64 start = TestSeconds();
+				ConvertRegion(CONVERT_INPUT_SCRGB, CONVERT_OUTPUT_P010, &m, src, width * 8, width,
+							  height, 0, 0, width, height, dst, width * 2, dst + planeY, width * 2);
+				d64 time = TestSeconds() - start;
+				if (time < best) best = time;
+			}
+			printf(" %6.2f", best * 1000);
+		}
+		printf("\n");
+	}
+
+	free(src);
+	free(dst);
+}
+
+// 1080p frames per second of float & integer kernels for integer inputs
+static void BenchFixed(void) {
+	u32 width = 1920, height = 1080;
+	for (convert_input input = 0; input < CONVERT_INPUT_COUNT; ++input) {
+		if (!ConvertFixedSupported(input)) continue;
+		for (convert_output output = 0; output < CONVERT_OUTPUT_COUNT; ++output) {
+			u32 pixelSize = ConvertInputSize(input), sampleSize = ConvertOutputSize(output);
+			udm planeY = (udm) width * height * sampleSize;
+			u8 *src = malloc((udm) width * height * pixelSize);
+			u8 *dst = malloc(planeY * 3 / 2);
+			TestFill(src, (udm) width * height * pixelSize);
+
+			convert_matrix m;
+			convert_fixed f;
+			ConvertMatrixFor(&m, CONVERT_BT709, false, input, output);
+			ConvertFixedFromMatrix(&f, &m);
+			printf("%-7s to %s fps float:", gInputNames[input], gOutputNames[output]);
+
+			for (u32 fixed = 0; fixed < 2; ++fixed) {
+				if (fixed) printf(" fixed:");
+				for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+					ConvertSetLevel(level);
+					d64 best = 1e9;
+					for (u32 n = 0; n < 7; ++n) {
+						d64 start = TestSeconds();
+						if (fixed) {
+							ConvertRegionFixed(input, output, &f, src, width * pixelSize, width,
+											   height, 0, 0, width, height, dst,
+											   width * sampleSize, dst + planeY, width * sampleSize);
+						} else {
+							ConvertRegion(input, output, &m, src, width * pixelSize, width, height,
+										  0, 0, width, height, dst, width * sampleSize,
+										  dst + planeY, width * sampleSize);
+						}
+						d64 time = TestSeconds() - start;
+						if (time < best) best = time;
+					}
+					printf(" %6.0f", 1 / best);
+				}
+			}
+			printf("\n");
+
+			free(src);
+			free(dst);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	convert_matrix m;
+	convert_fixed f;
+	ConvertMatrixFor(&m, CONVERT_BT709, false, CONVERT_INPUT_BGRA8, CONVERT_OUTPUT_NV12);
+	ConvertFixedFromMatrix(&f, &m);
+
+	TestIdentity(&f);
+	TestReference(&f);
+	TestKernels();
+	TestKernelReference();
+	TestPow();
+	TestTransfer();
+	TestFixed();
+	TestShaderMatrix();
+
+	if (TestBench(argc, argv)) {
+		Bench(&f);
+		BenchKernels();
+		BenchTransfer();
+		BenchFixed();
+	}
+
+	return TestResult("convert");
+}
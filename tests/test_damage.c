@@ -0,0 +1,203 @@
+#include "convert.c"
+#include "damage.c"
+#include "test.h"
+
+// every level hashes to same values, so changed tiles don't depend on cpu
+static void TestLevels(const u8 *frame, udm stride, u32 width, u32 height) {
+	damage_map expected, actual;
+	DamageSetLevel(BOG_CPU_SCALAR);
+	Check(DamageCreate(&expected, width, height));
+	Check(DamageUpdate(&expected, frame, stride) == expected.tilesX * expected.tilesY);
+	Check(DamageUpdate(&expected, frame, stride) == 0);
+
+	for (bog_cpu_level level = BOG_CPU_SSE2; level <= BOGCpuLevel(); ++level) {
+		DamageSetLevel(level);
+		Check(DamageCreate(&actual, width, height));
+		DamageUpdate(&actual, frame, stride);
+		Check(!memcmp(expected.hashes, actual.hashes,
+					  (udm) expected.tilesX * expected.tilesY * sizeof(u64)));
+		DamageDestroy(&actual);
+	}
+
+	DamageDestroy(&expected);
+}
+
+// any single bit flip marks exactly tile it is in
+static void TestSingleChanges(u8 *frame, udm stride, u32 width, u32 height) {
+	damage_map d;
+	DamageInit();
+	Check(DamageCreate(&d, width, height));
+	DamageUpdate(&d, frame, stride);
+
+	for (u32 i = 0; i < 20000; ++i) {
+		u32 x = TestRandom() % width, y = TestRandom() % height;
+		frame[y * stride + x * 4 + TestRandom() % 4] ^= (u8) (1 << TestRandom() % 8);
+
+		Check(DamageUpdate(&d, frame, stride) == 1);
+		u32 tile = (y / DAMAGE_TILE_HEIGHT) * d.tilesX + x / DAMAGE_TILE_WIDTH;
+		Check(d.dirty[tile]);
+	}
+
+	// content moved inside of tile is change too, not just changed bytes
+	memset(frame, 0, stride * height);
+	for (u32 x = 0; x < 8; ++x) frame[x * 4] = (u8) (x + 1);
+	DamageUpdate(&d, frame, stride);
+	memmove(frame + 32, frame, 32);
+	memset(frame, 0, 32);
+	Check(DamageUpdate(&d, frame, stride) == 1);
+
+	DamageReset(&d);
+	Check(DamageUpdate(&d, frame, stride) == d.tilesX * d.tilesY);
+
+	DamageDestroy(&d);
+}
+
+// reconverting only dirty tiles into previous frame gives same frame as converting all of it
+static void TestIncremental(const convert_fixed *f) {
+	static const u32 sizes[][2] = { { 1920, 1080 }, { 333, 97 }, { 64, 16 }, { 129, 33 } };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		u32 width = sizes[i][0], height = sizes[i][1];
+		u32 outWidth = (width + 1) & ~1, outHeight = (height + 1) & ~1;
+		udm size = (udm) outWidth * outHeight * 3 / 2;
+		u8 *frame = malloc((udm) width * height * 4);
+		u8 *expected = calloc(size, 1);
+		u8 *actual = calloc(size, 1);
+		TestFill(frame, (udm) width * height * 4);
+
+		damage_map d;
+		Check(DamageCreate(&d, width, height));
+		for (u32 n = 0; n < 50; ++n) {
+			// few rectangles change between frames, some frames don't change at all
+			u32 rects = TestRandom() % 5;
+			for (u32 r = 0; r < rects; ++r) {
+				u32 x0 = TestRandom() % width, y0 = TestRandom() % height;
+				u32 x1 = x0 + 1 + TestRandom() % 100, y1 = y0 + 1 + TestRandom() % 40;
+				for (u32 y = y0; y < y1 && y < height; ++y) {
+					for (u32 x = x0; x < x1 && x < width; ++x) {
+						frame[((udm) y * width + x) * 4 + TestRandom() % 4] = (u8) TestRandom();
+					}
+				}
+			}
+
+			DamageUpdate(&d, frame, width * 4);
+			DamageConvertNV12(&d, f, frame, width * 4, actual, outWidth,
+							  actual + outWidth * outHeight, outWidth);
+			ConvertToNV12(f, frame, width * 4, width, height, expected, outWidth,
+						  expected + outWidth * outHeight, outWidth);
+			Check(!memcmp(expected, actual, size));
+		}
+		DamageDestroy(&d);
+
+		free(frame);
+		free(expected);
+		free(actual);
+	}
+}
+
+static void BenchHash(void) {
+	static const u32 sizes[][2] = { { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		u32 width = sizes[i][0], height = sizes[i][1];
+		u8 *frame = malloc((udm) width * height * 4);
+		TestFill(frame, (udm) width * height * 4);
+
+		for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+			damage_map d;
+			DamageSetLevel(level);
+			DamageCreate(&d, width, height);
+
+			u32 count = 20;
+			d64 start = TestSeconds();
+			for (u32 n = 0; n < count; ++n) DamageUpdate(&d, frame, width * 4);
+			d64 seconds = (TestSeconds() - start) / count;
+			printf("damage hash %ux%u level %d: %.2f ms, %.2f GB/s\n", width, height, level,
+				   seconds * 1e3, (d64) width * height * 4 / seconds / 1e9);
+
+			DamageDestroy(&d);
+		}
+
+		free(frame);
+	}
+}
+
+// frames with share of tiles changed, hash & reconvert against converting whole frame, shows
+// where reconverting stops paying off
+static void BenchIncremental(const convert_fixed *f) {
+	static const d64 fractions[] = { 0.001, 0.01, 0.1, 0.5, 1.0 };
+	u32 width = 1920, height = 1080;
+	u8 *frame = malloc((udm) width * height * 4);
+	u8 *dst = malloc((udm) width * height * 3 / 2);
+	TestFill(frame, (udm) width * height * 4);
+
+	u32 count = 50;
+	d64 start = TestSeconds();
+	for (u32 n = 0; n < count; ++n) {
+		ConvertToNV12(f, frame, width * 4, width, height, dst, width, dst + width * height, width);
+	}
+	d64 full = (TestSeconds() - start) / count;
+
+	damage_map d;
+	DamageCreate(&d, width, height);
+	DamageUpdate(&d, frame, width * 4);
+
+	u32 tiles = d.tilesX * d.tilesY;
+	for (u32 i = 0; i < sizeof(fractions) / sizeof(*fractions); ++i) {
+		// changed tiles spread evenly over frame, at least one
+		u32 changed = (u32) (tiles * fractions[i] + 0.5);
+		if (!changed) changed = 1;
+
+		d64 hash = 0, convert = 0;
+		u32 dirty = 0;
+		for (u32 n = 0; n < count; ++n) {
+			for (u32 k = 0; k < changed; ++k) {
+				u32 tile = (u32) ((u64) k * tiles / changed);
+				u32 x = tile % d.tilesX * DAMAGE_TILE_WIDTH;
+				u32 y = tile / d.tilesX * DAMAGE_TILE_HEIGHT;
+				frame[((udm) y * width + x) * 4] ^= 1;
+			}
+
+			start = TestSeconds();
+			dirty += DamageUpdate(&d, frame, width * 4);
+			d64 hashed = TestSeconds();
+			DamageConvertNV12(&d, f, frame, width * 4, dst, width, dst + width * height, width);
+			hash += hashed - start;
+			convert += TestSeconds() - hashed;
+		}
+		hash /= count;
+		convert /= count;
+
+		printf("damage 1080p %5.1f%% dirty (%4u tiles): hash %.3f ms + reconvert %.3f ms "
+			   "= %.3f ms, whole frame convert %.3f ms\n", fractions[i] * 100, dirty / count,
+			   hash * 1e3, convert * 1e3, (hash + convert) * 1e3, full * 1e3);
+	}
+
+	DamageDestroy(&d);
+	free(frame);
+	free(dst);
+}
+
+int main(int argc, char **argv) {
+	// odd size has partial tiles on right & bottom, rows are padded
+	u32 width = 1921, height = 1083;
+	udm stride = width * 4 + 64;
+	u8 *frame = malloc(stride * height);
+	TestFill(frame, stride * height);
+
+	TestLevels(frame, stride, width, height);
+	TestSingleChanges(frame, stride, width, height);
+	free(frame);
+
+	convert_matrix m;
+	convert_fixed f;
+	ConvertInit();
+	ConvertMatrixFor(&m, CONVERT_BT709, false, CONVERT_INPUT_BGRA8, CONVERT_OUTPUT_NV12);
+	ConvertFixedFromMatrix(&f, &m);
+	TestIncremental(&f);
+
+	if (TestBench(argc, argv)) {
+		BenchHash();
+		BenchIncremental(&f);
+	}
+
+	return TestResult("damage");
+}
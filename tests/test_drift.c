@@ -0,0 +1,138 @@
+#include "timebase.c"
+#include "drift.c"
+#include "test.h"
+
+#define TEST_RATE 48000
+#define TEST_FREQUENCY 10000000.0
+#define TEST_PACKET 480
+
+typedef struct {
+	d64 maxOffset;     // msec output frame was off from where its audio was captured
+	d64 endOffset;
+	u64 packets;
+	u32 glitches;
+	u32 flagged;       // glitches device marked as discontinuity
+	d64 seconds;       // cpu time
+} result;
+
+static d64 TestUniform(void) {
+	return (d64) TestRandom() / 4294967296.0;
+}
+
+// device runs ppm off nominal rate & starts 300 msec before recording, packet times have jitter
+// of +-msec, every glitchEvery seconds it loses 100 msec, jumps position or stalls 200 msec
+// baseline is what recording did before, packets concatenated with only start trimmed
+static result Run(drift *d, d64 ppm, d64 jitter, d64 seconds, d64 glitchEvery, bool baseline) {
+	drift_config config = { TEST_RATE, TIME_RATE_MF, 1000, 32, 1000, 1, 20 };
+	u64 start = 12345678;
+	DriftStart(d, &config, start);
+
+	d64 rate = TEST_RATE * (1 + ppm * 1e-6);
+	d64 origin = start / TEST_FREQUENCY;
+	d64 real = origin - 0.3;
+	d64 nextGlitch = glitchEvery;
+	u64 position = 1000;
+	d64 written = 0;
+	result r = { 0 };
+	d64 cpu = TestSeconds();
+
+	while (real < origin + seconds) {
+		bool discontinuity = false;
+		if (glitchEvery && real - origin > nextGlitch) {
+			nextGlitch += glitchEvery;
+			switch (r.glitches++ % 3) {
+			case 0: position += 4800; real += 4800 / rate; discontinuity = true; break;
+			case 1: position += 1000000; discontinuity = true; break;
+			case 2: real += 0.2; break;
+			}
+			r.flagged += discontinuity;
+		}
+		d64 first = real;
+		u64 time = (u64) ((real + (TestUniform() * 2 - 1) * jitter / 1000) * TEST_FREQUENCY);
+
+		d64 output;
+		u32 trim = 0;
+		if (baseline) {
+			if (time < start) {
+				d64 late = (start - time) / TEST_FREQUENCY * TEST_RATE;
+				trim = late >= TEST_PACKET ? TEST_PACKET : (u32) late;
+			}
+			output = written;
+			written += TEST_PACKET - trim;
+		} else {
+			drift_plan plan = DriftPacket(d, position, time, TEST_PACKET, discontinuity);
+			// plan always continues output where previous packet ended, resampler gives ratio
+			// times its frames, which bends at most maxPpm away from fitted line
+			d64 expected = start + written * TEST_FREQUENCY / TEST_RATE;
+			Check(plan.time >= expected - 1 && plan.time <= expected + 1);
+			d64 correction = plan.ratio / DriftRatio(d) - 1;
+			Check(correction >= -1000e-6 - 1e-12 && correction <= 1000e-6 + 1e-12);
+			trim = plan.trim;
+			output = written + plan.silence * plan.ratio;
+			written += (plan.silence + TEST_PACKET - plan.trim) * plan.ratio;
+		}
+		position += TEST_PACKET;
+		real += TEST_PACKET / rate;
+		r.packets++;
+		if (trim == TEST_PACKET) continue;
+
+		// first output frame of packet vs where it was captured, line needs few seconds to settle
+		first += trim / rate;
+		r.endOffset = (output - (first - origin) * TEST_RATE) * 1000 / TEST_RATE;
+		d64 offset = r.endOffset < 0 ? -r.endOffset : r.endOffset;
+		if (first - origin > 10 && offset > r.maxOffset) r.maxOffset = offset;
+	}
+	r.seconds = TestSeconds() - cpu;
+	return r;
+}
+
+// output stays within one video frame of capture through drift, jitter & glitches
+static void TestSync(void) {
+	static const d64 ppms[] = { -200, 0, 200 };
+	for (u32 i = 0; i < 3; ++i) {
+		for (u32 j = 0; j < 2; ++j) {
+			drift d;
+			d64 jitter = j ? 2.0 : 0.5;
+			result r = Run(&d, ppms[i], jitter, 3600, 600, false);
+			Check(r.maxOffset < 1000.0 / 60);
+			Check(r.glitches >= 5);
+			Check(d.discontinuities >= r.flagged);
+			// first packets of device that started early are trimmed, not played late
+			Check(d.trimmed >= 0.3 * TEST_RATE - TEST_PACKET);
+
+			// without glitches line converges to device rate, as close as jitter over window allows
+			r = Run(&d, ppms[i], jitter, 600, 0, false);
+			Check(r.maxOffset < 1000.0 / 60);
+			d64 error = DriftRatio(&d) * (1 + ppms[i] * 1e-6) - 1;
+			Check(error > -jitter * 40e-6 && error < jitter * 40e-6);
+			Check(!d.silenced && !d.discontinuities);
+		}
+	}
+
+	// before, hour of 200 ppm drift was 720 msec off
+	drift d;
+	result r = Run(&d, 200, 0.5, 3600, 0, true);
+	Check(r.endOffset > 500);
+}
+
+static void Bench(void) {
+	static const d64 ppms[] = { -200, 0, 200 };
+	for (u32 b = 0; b < 2; ++b) {
+		for (u32 i = 0; i < 3; ++i) {
+			for (u32 g = 0; g < 2; ++g) {
+				drift d;
+				result r = Run(&d, ppms[i], 0.5, 8 * 3600, g ? 1800 : 0, !b);
+				printf("drift %s %+4.0f ppm, %-8s 8 hours: max offset %7.3f msec, at end %8.3f "
+					   "msec, %.1f nsec per packet\n", b ? "estimator" : "baseline ",
+					   ppms[i], g ? "glitches" : "clean", r.maxOffset, r.endOffset,
+					   r.seconds * 1e9 / (d64) r.packets);
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	TestSync();
+	if (TestBench(argc, argv)) Bench();
+	return TestResult("drift");
+}
@@ -0,0 +1,252 @@
+#include "finalizer.c"
+#include "mp4.c"
+#include "output.c"
+#include "test_mp4.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct {
+	volatile s32 next;   // index item expects to have
+	volatile s32 wrongOrder;
+	volatile s32 wrongThread;
+	volatile s32 gate;   // items wait while this is 0
+	pthread_t submitter;
+	u32 sleep;           // usec each item takes
+} order_state;
+
+typedef struct {
+	order_state *state;
+	s32 index;
+} order_item;
+
+static void OrderItem(void *data) {
+	order_item *item = (order_item *) data;
+	order_state *s = item->state;
+	while (!BOGAtomicLoad(&s->gate)) BOGWaitOnAddress(&s->gate, 0);
+	if (s->sleep) {
+		struct timespec t = { 0, (long) s->sleep * 1000 };
+		nanosleep(&t, 0);
+	}
+
+	if (pthread_equal(pthread_self(), s->submitter)) BOGAtomicStore(&s->wrongThread, 1);
+	if (BOGAtomicLoad(&s->next) != item->index) BOGAtomicStore(&s->wrongOrder, 1);
+	BOGAtomicStore(&s->next, item->index + 1);
+}
+
+// more items than queue holds run in order on finalizer thread, pending counts what's left
+static void TestOrder(void) {
+	static order_item items[1000];
+	order_state s = { .submitter = pthread_self() };
+	finalizer f;
+	FinalizerCreate(&f);
+	Check(f.threaded);
+
+	// blocked items stay pending
+	for (s32 i = 0; i < FINALIZER_MAX_ITEMS; ++i) {
+		items[i] = (order_item) { &s, i };
+		FinalizerSubmit(&f, OrderItem, &items[i]);
+	}
+	Check(FinalizerPending(&f) == FINALIZER_MAX_ITEMS);
+	BOGAtomicStore(&s.gate, 1);
+	BOGWakeAll(&s.gate);
+	FinalizerWait(&f);
+	Check(FinalizerPending(&f) == 0 && s.next == FINALIZER_MAX_ITEMS);
+
+	// submit waits for free slot once queue is full
+	for (s32 i = FINALIZER_MAX_ITEMS; i < 1000; ++i) {
+		items[i] = (order_item) { &s, i };
+		FinalizerSubmit(&f, OrderItem, &items[i]);
+		Check(FinalizerPending(&f) <= FINALIZER_MAX_ITEMS);
+	}
+	FinalizerWait(&f);
+
+	Check(s.next == 1000);
+	Check(!s.wrongOrder && !s.wrongThread);
+	FinalizerDestroy(&f);
+}
+
+// destroy runs everything that is still pending
+static void TestDestroy(void) {
+	static order_item items[FINALIZER_MAX_ITEMS];
+	order_state s = { .submitter = pthread_self(), .gate = 1, .sleep = 2000 };
+	finalizer f;
+	FinalizerCreate(&f);
+	for (s32 i = 0; i < FINALIZER_MAX_ITEMS; ++i) {
+		items[i] = (order_item) { &s, i };
+		FinalizerSubmit(&f, OrderItem, &items[i]);
+	}
+	FinalizerDestroy(&f);
+	Check(s.next == FINALIZER_MAX_ITEMS && !s.wrongOrder);
+
+	// without thread items run inside submit
+	s.next = 0;
+	s.sleep = 0;
+	f.threaded = false;
+	FinalizerSubmit(&f, OrderItem, &items[0]);
+	Check(s.next == 1 && FinalizerPending(&f) == 0);
+}
+
+// recording session, muxer writes through output file like encoder sink does
+typedef struct {
+	const char *path;
+	mp4_muxer muxer;
+	output_file file;
+	u32 frames;      // written so far
+	u32 drainFrames; // encoder still gives these after stop, on finalizer thread
+	bool finished;   // finish & close succeeded
+	pthread_t finisher;
+} session;
+
+static const u8 gConfig[] = { 0, 0, 0, 1, 0x67, 0x42, 0, 0x1F, 0xAB, 0xCD,
+							  0, 0, 0, 1, 0x68, 0xCE, 0x3C, 0x80 };
+
+static bool SessionWrite(void *user, const void *data, udm size) {
+	return OutputWrite(&((session *) user)->file, data, size);
+}
+
+static bool SessionStart(session *s, const char *path, u32 drainFrames) {
+	static const mp4_track_config track = { .codec = MP4_CODEC_H264, .timescale = 90000,
+											.width = 1280, .height = 720, .bufferSize = 1 << 20 };
+	static const output_config output = { .bufferSize = 256 << 10, .bufferCount = 8,
+										   .wait = true };
+	*s = (session) { .path = path, .drainFrames = drainFrames };
+	if (!OutputOpen(&s->file, path, &output)) return false;
+	return Mp4Create(&s->muxer, &track, 1, 500, SessionWrite, s);
+}
+
+// 60 fps frame, IDR every second, payload has no zero bytes so it never looks like start code
+static bool SessionFrame(session *s) {
+	static u8 data[1 << 16];
+	bool idr = s->frames % 60 == 0;
+	u32 size = 0;
+	if (idr) {
+		memcpy(data, gConfig, sizeof(gConfig));
+		size = sizeof(gConfig);
+	}
+	static const u8 slice[] = { 0, 0, 0, 1 };
+	memcpy(data + size, slice, 4);
+	data[size + 4] = idr ? 0x65 : 0x41;
+	size += 5;
+	u32 payload = (idr ? 30000 : 1000) + TestRandom() % 4000;
+	for (u32 i = 0; i < payload; ++i) data[size++] = (u8) ((s->frames * 31 + i * 7) | 1);
+
+	u64 time = (u64) s->frames++ * 1500;
+	return Mp4WriteSample(&s->muxer, 0, data, size, time, time, idr);
+}
+
+// finalizer item, encoder drains its last frames slowly, then file is finished & closed
+static void SessionFinish(void *data) {
+	session *s = (session *) data;
+	s->finisher = pthread_self();
+	bool ok = true;
+	for (u32 i = 0; i < s->drainFrames; ++i) {
+		struct timespec t = { 0, 2000000 };
+		nanosleep(&t, 0);
+		ok &= SessionFrame(s);
+	}
+	ok &= Mp4Finish(&s->muxer);
+	ok &= OutputClose(&s->file);
+	Mp4Destroy(&s->muxer);
+	s->finished = ok;
+}
+
+// file parses to its very end & has every frame in order
+static void CheckSession(session *s) {
+	test_buffer file = { 0 };
+	Check(TestReadFile(s->path, &file));
+	unlink(s->path);
+
+	test_mp4_sample *samples = malloc(s->frames * sizeof(*samples));
+	udm ends[256];
+	u32 endSamples[256], fragments;
+	s32 count = TestReadMp4Fragments(file.data, file.size, samples, s->frames, &fragments, ends,
+									 endSamples, 256);
+	Check(count == (s32) s->frames);
+	Check(fragments > 1 && fragments <= 256 && ends[fragments - 1] == file.size);
+	for (s32 i = 0; i < count && i < (s32) s->frames; ++i) {
+		Check(samples[i].decodeTime == (u64) i * 1500 && samples[i].sync == (i % 60 == 0));
+	}
+
+	free(samples);
+	free(file.data);
+}
+
+// stopped recording drains & finalizes on finalizer thread while next one is already muxing,
+// both files come out whole
+static void TestSessions(void) {
+	finalizer f;
+	FinalizerCreate(&f);
+	session first, second;
+
+	Check(SessionStart(&first, "output/tests/finalizer-first.mp4", 50));
+	for (u32 i = 0; i < 600; ++i) Check(SessionFrame(&first));
+	FinalizerSubmit(&f, SessionFinish, &first);
+
+	// drain takes 100 ms, so second recording starts & writes long before first is done
+	Check(SessionStart(&second, "output/tests/finalizer-second.mp4", 10));
+	Check(FinalizerPending(&f) == 1);
+	for (u32 i = 0; i < 900; ++i) {
+		Check(SessionFrame(&second));
+		if (i % 60 == 0) {
+			struct timespec t = { 0, 1000000 };
+			nanosleep(&t, 0);
+		}
+	}
+	FinalizerSubmit(&f, SessionFinish, &second);
+	FinalizerWait(&f);
+
+	Check(first.finished && second.finished);
+	Check(!pthread_equal(first.finisher, pthread_self()));
+	Check(first.frames == 650 && second.frames == 910);
+	CheckSession(&first);
+	CheckSession(&second);
+	FinalizerDestroy(&f);
+}
+
+static int CompareSeconds(const void *a, const void *b) {
+	d64 x = *(const d64 *) a, y = *(const d64 *) b;
+	return x < y ? -1 : x > y;
+}
+
+// recordings stopped back to back, each taking 50 ms to finish, time from stop until next one
+// can start with & without finalizer
+static void Bench(void) {
+	static order_item items[40];
+	d64 latencies[40];
+	for (u32 threaded = 0; threaded < 2; ++threaded) {
+		order_state s = { .submitter = pthread_self(), .gate = 1, .sleep = 50000 };
+		finalizer f;
+		FinalizerCreate(&f);
+		if (!threaded) FinalizerDestroy(&f);
+
+		d64 start = TestSeconds();
+		for (s32 i = 0; i < 40; ++i) {
+			items[i] = (order_item) { &s, i };
+			d64 time = TestSeconds();
+			FinalizerSubmit(&f, OrderItem, &items[i]);
+			latencies[i] = TestSeconds() - time;
+
+			// recording takes 20 ms, so queue fills up after a while
+			struct timespec t = { 0, 20000000 };
+			nanosleep(&t, 0);
+		}
+		FinalizerWait(&f);
+		FinalizerDestroy(&f);
+		d64 seconds = TestSeconds() - start;
+
+		qsort(latencies, 40, sizeof(*latencies), CompareSeconds);
+		printf("finalizer %s: stop to start ms p50 %.3f max %.3f, total %.2f s\n",
+			   threaded ? "thread" : "inline", latencies[20] * 1000, latencies[39] * 1000, seconds);
+	}
+}
+
+int main(int argc, char **argv) {
+	TestOrder();
+	TestDestroy();
+	TestSessions();
+
+	if (TestBench(argc, argv)) Bench();
+
+	return TestResult("finalizer");
+}
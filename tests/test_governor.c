@@ -0,0 +1,190 @@
+#include "pool.c"
+#include "governor.c"
+#include "test.h"
+
+#include <math.h>
+
+// deterministic model of recording in usec ticks: desktop updates at 144 Hz, frame limiter takes
+// frames at governor frame rate, capture thread is busy for its work time, encoder handles frames
+// in order with service time scaled by output pixels & holds each one 25 ms longer for reordering
+
+#define TEST_FREQUENCY 1000000ULL
+#define TEST_QUEUE 0xFFFF
+
+// msec at time in seconds
+typedef d64 load(d64 time);
+
+static d64 Light(d64 time) { return 8; }
+static d64 Step(d64 time) { return time >= 60 && time < 240 ? 22 : 8; }
+static d64 Ramp(d64 time) { return 8 + 32 * (time < 300 ? time : 600 - time) / 300; }
+static d64 NearLimit(d64 time) { return 17 + 2 * sin(2 * 3.14159265358979 * time / 20); }
+static d64 Bursts(d64 time) { return fmod(time, 30) >= 20 && fmod(time, 30) < 22 ? 60 : 8; }
+static d64 Heavy(d64 time) { return 80; }
+static d64 LowWork(d64 time) { return 2; }
+static d64 HighWork(d64 time) { return 20; }
+
+static bool NoCreate(void *user, u32 index) { return true; }
+static void NoDestroy(void *user, u32 index) {}
+
+typedef struct {
+	u32 drops;
+	u32 frames;
+	u32 gaps;      // frames that came later than 1.5 intervals of current rate after previous one
+	u32 switches;
+	u32 rate;      // at end
+	u32 scale;     // for next recording
+	d64 fps;
+} result;
+
+// governor is 0 for fixed 60 fps
+static result Run(governor *g, load *service, load *work, u32 seconds) {
+	static u64 releaseTime[TEST_QUEUE + 1];
+	static s32 releaseIndex[TEST_QUEUE + 1];
+	buffer_pool pool;
+	pool_config config = { .minCount = 2, .maxCount = 16, .interval = TEST_FREQUENCY / 60,
+						   .window = 2 * TEST_FREQUENCY, .create = NoCreate,
+						   .destroy = NoDestroy };
+	PoolCreate(&pool, &config, 0);
+	if (g) GovernorStart(g, 0);
+
+	u32 rate = g ? GovernorFramerate(g) : 60;
+	d64 scale = g ? GovernorScale(g) / 100.0 : 1;
+	u64 nextFrame = 0, busyUntil = 0, encoderFree = 0, lastFrame = 0;
+	u32 head = 0, tail = 0;
+	result r = { 0 };
+
+	for (u64 update = 0;; ++update) {
+		u64 now = update * TEST_FREQUENCY / 144;
+		if (now >= seconds * TEST_FREQUENCY) break;
+		for (; tail != head && releaseTime[tail & TEST_QUEUE] <= now; ++tail) {
+			PoolRelease(&pool, releaseIndex[tail & TEST_QUEUE], releaseTime[tail & TEST_QUEUE]);
+		}
+
+		// limiter works in ticks * rate, so any rate divides evenly
+		if (now < busyUntil || now * rate < nextFrame) continue;
+		if (!nextFrame) nextFrame = now * rate;
+		nextFrame += TEST_FREQUENCY;
+
+		d64 time = (d64) now / TEST_FREQUENCY;
+		u64 workTicks = (u64) (work(time) * 1000);
+		s32 index = PoolAcquire(&pool, now);
+		if (index >= 0) {
+			u64 ready = now + workTicks;
+			encoderFree = (ready > encoderFree ? ready : encoderFree) +
+						  (u64) (service(time) * scale * scale * 1000);
+			releaseTime[head & TEST_QUEUE] = encoderFree + 25000;
+			releaseIndex[head & TEST_QUEUE] = index;
+			head++;
+			busyUntil = now + workTicks;
+
+			r.frames++;
+			if (lastFrame && now - lastFrame > TEST_FREQUENCY * 3 / (2 * rate)) r.gaps++;
+			lastFrame = now;
+		} else {
+			busyUntil = now + 1000;
+		}
+
+		if (g) {
+			governor_sample sample = { __builtin_popcount(pool.inFlight), pool.drops, workTicks };
+			if (GovernorFrame(g, &sample, now)) {
+				rate = GovernorFramerate(g);
+				nextFrame = 0;
+				lastFrame = 0;
+			}
+		}
+	}
+
+	r.drops = pool.drops;
+	r.fps = (d64) r.frames / seconds;
+	r.switches = g ? g->switches : 0;
+	r.rate = rate;
+	r.scale = g ? GovernorScale(g) : 100;
+	return r;
+}
+
+static void MakeGovernor(governor *g) {
+	governor_config config = {
+		.framerate = { 60, 50, 40, 30, 24, 20, 15 }, .rateCount = 7,
+		.scale = { 100, 75, 50 }, .scaleCount = 3,
+		.frequency = TEST_FREQUENCY, .window = TEST_FREQUENCY / 2, .queueHigh = 8, .busy = 80,
+		.hold = 4, .maxHold = 64,
+	};
+	GovernorCreate(g, &config);
+}
+
+static void TestLoads(void) {
+	governor g;
+
+	// nothing to do when encoder keeps up
+	MakeGovernor(&g);
+	result light = Run(&g, Light, LowWork, 60);
+	Check(light.switches == 0 && light.drops == 0 && light.rate == 60);
+
+	// slower encoder gets lower rate instead of drops, full rate comes back after it
+	MakeGovernor(&g);
+	result step = Run(&g, Step, LowWork, 330);
+	result stepFixed = Run(0, Step, LowWork, 330);
+	Check(step.drops == 0 && stepFixed.drops > 1000 && step.rate == 60);
+
+	MakeGovernor(&g);
+	result ramp = Run(&g, Ramp, LowWork, 600);
+	Check(ramp.drops == 0 && ramp.rate == 60);
+
+	// load at limit doesn't switch back & forth every few windows
+	MakeGovernor(&g);
+	result near = Run(&g, NearLimit, LowWork, 600);
+	Check(near.drops == 0 && near.switches < 60);
+
+	// short overloads drop much less than fixed rate does
+	MakeGovernor(&g);
+	result bursts = Run(&g, Bursts, LowWork, 600);
+	result burstsFixed = Run(0, Bursts, LowWork, 600);
+	Check(bursts.drops * 4 < burstsFixed.drops);
+
+	// capture thread that can't prepare 60 frames per second lowers rate too
+	MakeGovernor(&g);
+	result convert = Run(&g, Light, HighWork, 60);
+	Check(convert.drops == 0 && convert.rate == 40);
+
+	// encoder too slow even at lowest rate makes next recording smaller, which then keeps up
+	MakeGovernor(&g);
+	result heavy = Run(&g, Heavy, LowWork, 60);
+	Check(heavy.rate == 15 && heavy.scale < 100);
+	result next = Run(&g, Heavy, LowWork, 600);
+	Check(next.drops == 0 && next.fps > heavy.fps);
+}
+
+// 10 minutes of every load at fixed 60 fps & with governor
+static void Bench(void) {
+	static const struct { const char *name; load *service, *work; } loads[] = {
+		{ "light 8 ms", Light, LowWork },
+		{ "step 8 to 22 ms", Step, LowWork },
+		{ "ramp 8 to 40 ms", Ramp, LowWork },
+		{ "near limit 17 ms", NearLimit, LowWork },
+		{ "2 s bursts of 60 ms", Bursts, LowWork },
+		{ "convert 20 ms", Light, HighWork },
+		{ "heavy 80 ms", Heavy, LowWork },
+	};
+
+	for (u32 i = 0; i < sizeof(loads) / sizeof(*loads); ++i) {
+		governor g;
+		MakeGovernor(&g);
+		result fixed = Run(0, loads[i].service, loads[i].work, 600);
+		d64 start = TestSeconds();
+		result adaptive = Run(&g, loads[i].service, loads[i].work, 600);
+		d64 seconds = TestSeconds() - start;
+
+		printf("governor %-19s fixed: %5u drops %5u gaps %4.1f fps, governor: %5u drops "
+			   "%5u gaps %4.1f fps %3u switches, %.0f ns per frame\n", loads[i].name, fixed.drops,
+			   fixed.gaps, fixed.fps, adaptive.drops, adaptive.gaps, adaptive.fps,
+			   adaptive.switches, seconds * 1e9 / adaptive.frames);
+	}
+}
+
+int main(int argc, char **argv) {
+	TestLoads();
+
+	if (TestBench(argc, argv)) Bench();
+
+	return TestResult("governor");
+}
@@ -0,0 +1,140 @@
+#include "convert.c"
+#include "resize.c"
+#include "jobs.c"
+#include "test.h"
+
+#define TEST_ITEMS 1000
+#define TEST_BAND 64
+
+typedef struct {
+	u32 workerCount;
+	volatile s32 calls[TEST_ITEMS];
+	volatile s32 badWorker;
+} count_data;
+
+static void CountItem(void *data, u32 index, u32 worker) {
+	count_data *c = (count_data *) data;
+	BOGAtomicAdd(&c->calls[index], 1);
+	if (worker >= c->workerCount) BOGAtomicStore(&c->badWorker, 1);
+}
+
+// every index is processed exactly once, by worker in range, with any worker count
+static void TestCounts(void) {
+	static count_data c;
+	for (u32 workers = 1; workers <= 8; ++workers) {
+		jobs j;
+		Check(JobsCreate(&j, workers));
+		c.workerCount = j.workerCount;
+		c.badWorker = 0;
+
+		for (u32 run = 0; run < 200; ++run) {
+			u32 count = run % 7 == 0 ? 0 : TestRandom() % TEST_ITEMS;
+			memset((void *) c.calls, 0, sizeof(c.calls));
+			JobsRun(&j, CountItem, &c, count);
+
+			u32 wrong = 0;
+			for (u32 i = 0; i < TEST_ITEMS; ++i) wrong += c.calls[i] != (i < count);
+			Check(!wrong);
+		}
+		Check(!c.badWorker);
+
+		JobsDestroy(&j);
+	}
+}
+
+typedef struct {
+	const convert_fixed *f;
+	resizer *r;
+	const u8 *src;
+	udm srcStride;
+	u32 width, height;
+	u8 *dstY, *dstUV;
+	udm dstStride;
+} band_data;
+
+static void ConvertBand(void *data, u32 index, u32 worker) {
+	band_data *b = (band_data *) data;
+	u32 y0 = index * TEST_BAND;
+	u32 y1 = y0 + TEST_BAND < b->height ? y0 + TEST_BAND : b->height;
+	ConvertToNV12Region(b->f, b->src, b->srcStride, b->width, b->height, 0, y0, b->width, y1,
+						b->dstY, b->dstStride, b->dstUV, b->dstStride);
+}
+
+static void ResizeBand(void *data, u32 index, u32 worker) {
+	band_data *b = (band_data *) data;
+	ResizeToNV12Rows(b->r, worker, b->f, b->src, b->srcStride, index * TEST_BAND,
+					 (index + 1) * TEST_BAND, b->dstY, b->dstStride, b->dstUV, b->dstStride);
+}
+
+// bands on many threads give same frame as one pass, benchmark shows scaling with threads
+static void TestBands(const convert_fixed *f, bool bench) {
+	u32 width = 3840, height = 2160, outWidth = 2560, outHeight = 1439;
+	u32 nv12Height = (outHeight + 1) & ~1;
+	udm convertSize = (udm) width * height * 3 / 2, resizeSize = (udm) outWidth * nv12Height * 3 / 2;
+	u8 *src = malloc((udm) width * height * 4);
+	u8 *convertExpected = malloc(convertSize), *convertActual = malloc(convertSize);
+	u8 *resizeExpected = malloc(resizeSize), *resizeActual = malloc(resizeSize);
+	TestFill(src, (udm) width * height * 4);
+
+	ConvertToNV12(f, src, width * 4, width, height, convertExpected, width,
+				  convertExpected + width * height, width);
+
+	resizer single;
+	ResizeCreate(&single, width, height, outWidth, outHeight, 1);
+	ResizeToNV12(&single, f, src, width * 4, resizeExpected, outWidth,
+				 resizeExpected + outWidth * nv12Height, outWidth);
+	ResizeDestroy(&single);
+
+	for (u32 workers = 1; workers <= 8; workers *= 2) {
+		jobs j;
+		resizer r;
+		JobsCreate(&j, workers);
+		ResizeCreate(&r, width, height, outWidth, outHeight, j.workerCount);
+
+		band_data convert = { f, 0, src, width * 4, width, height, convertActual,
+							  convertActual + width * height, width };
+		band_data resize = { f, &r, src, width * 4, outWidth, outHeight, resizeActual,
+							 resizeActual + outWidth * nv12Height, outWidth };
+		u32 convertBands = (height + TEST_BAND - 1) / TEST_BAND;
+		u32 resizeBands = (outHeight + TEST_BAND - 1) / TEST_BAND;
+
+		u32 count = bench ? 20 : 1;
+		d64 start = TestSeconds();
+		for (u32 n = 0; n < count; ++n) JobsRun(&j, ConvertBand, &convert, convertBands);
+		d64 convertTime = (TestSeconds() - start) / count;
+		Check(!memcmp(convertExpected, convertActual, convertSize));
+
+		start = TestSeconds();
+		for (u32 n = 0; n < count; ++n) JobsRun(&j, ResizeBand, &resize, resizeBands);
+		d64 resizeTime = (TestSeconds() - start) / count;
+		Check(!memcmp(resizeExpected, resizeActual, resizeSize));
+
+		if (bench) {
+			printf("jobs %u workers: 4K convert %.2f ms, 4K to 1440p resize %.2f ms\n", workers,
+				   convertTime * 1e3, resizeTime * 1e3);
+		}
+
+		ResizeDestroy(&r);
+		JobsDestroy(&j);
+	}
+
+	free(src);
+	free(convertExpected);
+	free(convertActual);
+	free(resizeExpected);
+	free(resizeActual);
+}
+
+int main(int argc, char **argv) {
+	convert_matrix m;
+	convert_fixed f;
+	ConvertInit();
+	ResizeInit();
+	ConvertMatrixFor(&m, CONVERT_BT709, false, CONVERT_INPUT_BGRA8, CONVERT_OUTPUT_NV12);
+	ConvertFixedFromMatrix(&f, &m);
+
+	TestCounts();
+	TestBands(&f, TestBench(argc, argv));
+
+	return TestResult("jobs");
+}
@@ -0,0 +1,210 @@
+#include "mailbox.c"
+#include "test.h"
+
+// all words are equal, so torn copy is detected
+typedef struct {
+	u64 sequence[8];
+} test_item;
+
+static u32 gDropCount;
+static u64 gDropLast;
+
+static void CountDrop(void *user, const void *item) {
+	gDropCount++;
+	gDropLast = ((const test_item *) item)->sequence[0];
+}
+
+static void MakeItem(test_item *item, u64 sequence) {
+	for (u32 i = 0; i < 8; ++i) item->sequence[i] = sequence;
+}
+
+// what full ring does with every policy, dropped items are handed back to producer
+static void TestPolicies(void) {
+	test_item item;
+	mailbox m;
+	mailbox_config config = { .itemSize = sizeof(test_item), .count = 3, .drop = CountDrop };
+
+	config.policy = MAILBOX_DROP_NEWEST;
+	gDropCount = 0;
+	Check(MailboxCreate(&m, &config));
+	for (u64 i = 0; i < 6; ++i) {
+		MakeItem(&item, i);
+		Check(MailboxPush(&m, &item) == (i < 4));
+	}
+	Check(gDropCount == 2 && gDropLast == 5 && m.dropped == 2);
+	for (u64 i = 0; i < 4; ++i) Check(MailboxPop(&m, &item) && item.sequence[0] == i);
+	Check(!MailboxPop(&m, &item));
+	MailboxDestroy(&m);
+
+	config.policy = MAILBOX_REPLACE_OLDEST;
+	gDropCount = 0;
+	Check(MailboxCreate(&m, &config));
+	for (u64 i = 0; i < 6; ++i) {
+		MakeItem(&item, i);
+		Check(MailboxPush(&m, &item));
+	}
+	Check(gDropCount == 2 && gDropLast == 1);
+	for (u64 i = 2; i < 6; ++i) Check(MailboxPop(&m, &item) && item.sequence[0] == i);
+	MailboxDestroy(&m);
+
+	// with one slot consumer always gets latest
+	config.count = 1;
+	Check(MailboxCreate(&m, &config));
+	for (u64 i = 0; i < 100; ++i) {
+		MakeItem(&item, i);
+		MailboxPush(&m, &item);
+	}
+	Check(MailboxPop(&m, &item) && item.sequence[0] == 99);
+	Check(!MailboxPop(&m, &item));
+	MailboxDestroy(&m);
+
+	// blocking push gives up after timeout when nobody pops
+	config.policy = MAILBOX_BLOCK;
+	config.timeout = 20;
+	gDropCount = 0;
+	Check(MailboxCreate(&m, &config));
+	Check(MailboxPush(&m, &item));
+	d64 start = TestSeconds();
+	Check(!MailboxPush(&m, &item));
+	d64 waited = TestSeconds() - start;
+	Check(waited > 0.015 && waited < 1 && gDropCount == 1);
+	Check(MailboxWait(&m, 0) && MailboxPop(&m, &item));
+	start = TestSeconds();
+	Check(!MailboxWait(&m, 20));
+	Check(TestSeconds() - start > 0.015);
+	MailboxDestroy(&m);
+}
+
+typedef struct {
+	mailbox m;
+	bool wait;        // consumer sleeps in MailboxWait instead of spinning
+	u32 delay;        // usec consumer spends on every item
+	volatile s32 done;
+	u64 popped;
+	u64 last;
+	u32 errors;       // torn items or items out of order
+} pair;
+
+static void Spin(u32 usec) {
+	d64 end = TestSeconds() + usec * 1e-6;
+	while (TestSeconds() < end) {}
+}
+
+static BOG_THREAD_PROC(Consumer) {
+	pair *p = (pair *) arg;
+	bool lossless = p->m.policy == MAILBOX_BLOCK && p->m.timeout == MAILBOX_WAIT_FOREVER;
+	test_item item;
+
+	for (;;) {
+		if (!MailboxPop(&p->m, &item)) {
+			if (!BOGAtomicLoad(&p->done)) {
+				if (p->wait) MailboxWait(&p->m, 5);
+				continue;
+			}
+			// producer could push last item right before done was set
+			if (!MailboxPop(&p->m, &item)) break;
+		}
+
+		for (u32 i = 1; i < 8; ++i) p->errors += item.sequence[i] != item.sequence[0];
+		if (p->popped) p->errors += item.sequence[0] <= p->last;
+		if (lossless) p->errors += item.sequence[0] != p->popped;
+		p->last = item.sequence[0];
+		p->popped++;
+		if (p->delay) Spin(p->delay);
+	}
+
+	return 0;
+}
+
+// producer & consumer threads, every item arrives whole & in order, nothing is lost without
+// being counted as dropped, returns millions of items per second
+static d64 RunPair(mailbox_policy policy, u32 count, u32 timeout, u64 items, bool wait,
+				   u32 delay) {
+	static pair p;
+	memset(&p, 0, sizeof(p));
+	mailbox_config config = { .itemSize = sizeof(test_item), .count = count, .policy = policy,
+							  .timeout = timeout };
+	Check(MailboxCreate(&p.m, &config));
+	p.wait = wait;
+	p.delay = delay;
+
+	bog_thread thread;
+	Check(BOGThreadCreate(&thread, Consumer, &p));
+	d64 start = TestSeconds();
+	for (u64 i = 0; i < items; ++i) {
+		test_item item;
+		MakeItem(&item, i);
+		MailboxPush(&p.m, &item);
+	}
+	BOGAtomicStore(&p.done, 1);
+	BOGWakeAll(&p.m.head);
+	BOGThreadJoin(thread);
+	d64 seconds = TestSeconds() - start;
+
+	Check(p.errors == 0);
+	Check(p.popped + p.m.dropped == items);
+	// newest item is never dropped when oldest ones are replaced or producer waits for slot
+	if (policy == MAILBOX_REPLACE_OLDEST || timeout == MAILBOX_WAIT_FOREVER) {
+		Check(p.last == items - 1);
+	}
+	MailboxDestroy(&p.m);
+	return items / seconds / 1e6;
+}
+
+static void TestThreads(void) {
+	RunPair(MAILBOX_BLOCK, 1024, MAILBOX_WAIT_FOREVER, 500000, false, 0);
+	RunPair(MAILBOX_BLOCK, 64, MAILBOX_WAIT_FOREVER, 200000, true, 0);
+	RunPair(MAILBOX_DROP_NEWEST, 1024, 0, 2000000, false, 0);
+	RunPair(MAILBOX_REPLACE_OLDEST, 1024, 0, 2000000, false, 0);
+	RunPair(MAILBOX_REPLACE_OLDEST, 1, 0, 2000000, false, 0);
+	RunPair(MAILBOX_DROP_NEWEST, 8, 0, 20000, true, 5);
+	RunPair(MAILBOX_REPLACE_OLDEST, 8, 0, 20000, true, 5);
+	RunPair(MAILBOX_BLOCK, 8, 1, 2000, true, 2000);
+}
+
+// push & pop pair on one thread, cost of ring itself without any cache line moving
+static void Bench(void) {
+	static const char *policies[] = { "drop newest", "replace oldest", "block" };
+	u32 sizes[] = { 8, 64 };
+	for (u32 s = 0; s < 2; ++s) {
+		for (mailbox_policy policy = 0; policy <= MAILBOX_BLOCK; ++policy) {
+			mailbox m;
+			mailbox_config config = { .itemSize = sizes[s], .count = 256, .policy = policy };
+			MailboxCreate(&m, &config);
+
+			u8 item[64] = { 0 };
+			u64 count = 20000000, sum = 0;
+			d64 start = TestSeconds();
+			for (u64 i = 0; i < count; i += 16) {
+				for (u32 k = 0; k < 16; ++k) {
+					item[0] = (u8) k;
+					MailboxPush(&m, item);
+				}
+				for (u32 k = 0; k < 16; ++k) {
+					MailboxPop(&m, item);
+					sum += item[0];
+				}
+			}
+			d64 seconds = TestSeconds() - start;
+			Check(sum == count / 16 * 120);
+
+			printf("mailbox %2u byte items, %-14s: %.2f ns per push or pop\n", sizes[s],
+				   policies[policy], seconds / count / 2 * 1e9);
+			MailboxDestroy(&m);
+		}
+	}
+
+	printf("mailbox threads, 64 byte items: block %.1f, drop %.1f, replace %.1f M items/s\n",
+		   RunPair(MAILBOX_BLOCK, 1024, MAILBOX_WAIT_FOREVER, 2000000, false, 0),
+		   RunPair(MAILBOX_DROP_NEWEST, 1024, 0, 2000000, false, 0),
+		   RunPair(MAILBOX_REPLACE_OLDEST, 1024, 0, 2000000, false, 0));
+}
+
+int main(int argc, char **argv) {
+	TestPolicies();
+	TestThreads();
+
+	if (TestBench(argc, argv)) Bench();
+
+	return TestResult("mailbox");
+}
@@ -0,0 +1,342 @@
+#include "mp4.c"
+#include "test_mp4.h"
+
+typedef struct {
+	u32 track;
+	u64 decodeTime;
+	s32 offset;
+	bool sync;
+	u8 *data;     // as stored in file, length prefixed NAL units for H.264
+	u32 size;
+} expected_sample;
+
+static const u8 gSPS[] = { 0x67, 0x64, 0x00, 0x1F, 0xAC, 0x12, 0x34, 0x56 };
+static const u8 gPPS[] = { 0x68, 0xEE, 0x3C, 0x80 };
+
+static u32 AppendNal(u8 *au, u32 at, u8 *stored, u32 *storedSize, const u8 *nal, u32 size) {
+	// 3 & 4 byte start codes both have to work
+	if (TestRandom() & 1) au[at++] = 0;
+	au[at++] = 0;
+	au[at++] = 0;
+	au[at++] = 1;
+	memcpy(au + at, nal, size);
+
+	u8 *s = stored + *storedSize;
+	s[0] = (u8) (size >> 24);
+	s[1] = (u8) (size >> 16);
+	s[2] = (u8) (size >> 8);
+	s[3] = (u8) size;
+	memcpy(s + 4, nal, size);
+	*storedSize += 4 + size;
+	return at + size;
+}
+
+// Annex B access unit with AUD, SPS & PPS on IDR frames & one slice, stored gets what muxer
+// should write for it, AUD is dropped
+static u32 MakeAccessUnit(u8 *au, u8 *stored, u32 *storedSize, bool idr, u32 sliceSize) {
+	static u8 slice[1 << 20];
+	static const u8 aud[] = { 0x09, 0xF0 };
+	u32 at = 0, ignored = 0;
+	u8 audStored[16];
+	at = AppendNal(au, at, audStored, &ignored, aud, sizeof(aud));
+
+	*storedSize = 0;
+	if (idr) {
+		at = AppendNal(au, at, stored, storedSize, gSPS, sizeof(gSPS));
+		at = AppendNal(au, at, stored, storedSize, gPPS, sizeof(gPPS));
+	}
+	slice[0] = idr ? 0x65 : 0x41;
+	for (u32 i = 1; i < sliceSize; ++i) slice[i] = (u8) (1 + TestRandom() % 255);
+	at = AppendNal(au, at, stored, storedSize, slice, sliceSize);
+	if (TestRandom() & 1) au[at++] = 0; // trailing zero byte
+	return at;
+}
+
+static void CheckSamples(const u8 *file, udm size, const expected_sample *expected, u32 count) {
+	test_mp4_sample *samples = malloc(count * sizeof(*samples));
+	u32 fragments;
+	Check(TestReadMp4(file, size, samples, count, &fragments) == (s32) count);
+	Check(fragments > 1);
+
+	// fragments interleave tracks, so samples are matched in order of their track
+	u32 next[MP4_MAX_TRACKS] = { 0 };
+	for (u32 i = 0; i < count; ++i) {
+		test_mp4_sample *s = &samples[i];
+		u32 k = next[s->track];
+		while (k < count && expected[k].track != s->track) ++k;
+		if (k == count) {
+			Check(!"sample that was not written");
+			break;
+		}
+		next[s->track] = k + 1;
+
+		const expected_sample *e = &expected[k];
+		Check(s->decodeTime == e->decodeTime);
+		Check(s->offset == e->offset);
+		Check(s->sync == e->sync);
+		Check(s->size == e->size && !memcmp(s->data, e->data, e->size));
+
+		u32 after = k + 1;
+		while (after < count && expected[after].track != s->track) ++after;
+		if (after < count) Check(s->duration == expected[after].decodeTime - e->decodeTime);
+	}
+
+	free(samples);
+}
+
+// minute of variable frame rate video with reordered frames & FLAC audio comes out unchanged &
+// file cut at any byte reads up to last complete fragment
+static void TestMuxer(void) {
+	static u8 au[1 << 21];
+	u8 streaminfo[34] = { 0x10, 0x00, 0x10, 0x00 };
+	mp4_track_config tracks[2] = {
+		{ .codec = MP4_CODEC_H264, .timescale = 90000, .width = 1920, .height = 1080,
+		  .bufferSize = 4 << 20 },
+		{ .codec = MP4_CODEC_FLAC, .timescale = 48000, .channels = 2, .sampleRate = 48000,
+		  .config = streaminfo, .configSize = sizeof(streaminfo), .bufferSize = 1 << 20 },
+	};
+
+	test_buffer file = { 0 };
+	mp4_muxer m;
+	Check(Mp4Create(&m, tracks, 2, 2000, TestWriteBuffer, &file));
+
+	expected_sample *expected = calloc(100000, sizeof(*expected));
+	u32 count = 0, frame = 0;
+	u64 videoTime = 0, audioTime = 0;
+
+	// frames before first IDR frame have no config & are dropped
+	for (u32 i = 0; i < 2; ++i) {
+		u8 stored[256];
+		u32 storedSize, size = MakeAccessUnit(au, stored, &storedSize, false, 100);
+		Mp4WriteSample(&m, 0, au, size, videoTime, videoTime, false);
+		videoTime += 3000;
+	}
+
+	while (videoTime < 90000 * 60) {
+		while (audioTime * 90000 / 48000 <= videoTime) {
+			expected_sample *e = &expected[count++];
+			*e = (expected_sample) { 1, audioTime, 0, true, 0, 200 + TestRandom() % 3000 };
+			e->data = malloc(e->size);
+			TestFill(e->data, e->size);
+			Check(Mp4WriteSample(&m, 1, e->data, e->size, audioTime, audioTime, true));
+			audioTime += 4608;
+		}
+
+		bool idr = frame % 120 == 0;
+		s32 offset = idr ? 3000 : frame % 3 == 1 ? 9000 : 0;
+		expected_sample *e = &expected[count++];
+		*e = (expected_sample) { 0, videoTime, offset, idr, malloc(1 << 17), 0 };
+		u32 sliceSize = idr ? 60000 + TestRandom() % 20000 : 1 + TestRandom() % 20000;
+		u32 size = MakeAccessUnit(au, e->data, &e->size, idr, sliceSize);
+		Check(Mp4WriteSample(&m, 0, au, size, videoTime, videoTime + offset, idr));
+
+		videoTime += TestRandom() % 8 == 0 ? 6000 + TestRandom() % 9000 : 3000;
+		frame++;
+	}
+
+	// decode time going back is rejected
+	Check(!Mp4WriteSample(&m, 1, au, 100, audioTime - 4608 * 2, audioTime - 4608 * 2, true));
+	Check(Mp4Finish(&m));
+
+	const u8 *avcC = TestFindBox(file.data, file.size, "avcC");
+	Check(avcC && avcC[8] == 1 && avcC[9] == 0x64 && avcC[12] == 0xFF && avcC[13] == 0xE1);
+	Check(avcC && !memcmp(avcC + 16, gSPS, sizeof(gSPS)));
+	Check(TestFindBox(file.data, file.size, "dfLa") && TestFindBox(file.data, file.size, "trex"));
+	CheckSamples(file.data, file.size, expected, count);
+
+	// every fragment that ends inside of cut file is read, with all of its samples & no others
+	test_mp4_sample *all = malloc(count * sizeof(*all)), *cut = malloc(count * sizeof(*cut));
+	udm *ends = malloc(count * sizeof(*ends));
+	u32 *endSamples = malloc(count * sizeof(*endSamples));
+	u32 fragments, cutFragments;
+	TestReadMp4Fragments(file.data, file.size, all, count, &fragments, ends, endSamples, count);
+	Check(fragments <= count);
+	for (u32 i = 0; i < 1000 + fragments; ++i) {
+		// exactly at fragment ends too, where off by one would show
+		udm size = i < fragments ? ends[i] : TestRandom() % file.size;
+		s32 n = TestReadMp4(file.data, size, cut, count, &cutFragments);
+		u32 whole = 0;
+		while (whole < fragments && ends[whole] <= size) ++whole;
+		Check(cutFragments == whole);
+		Check(n == (s32) (whole ? endSamples[whole - 1] : 0));
+		for (s32 k = 0; k < n; ++k) {
+			Check(cut[k].data == all[k].data && cut[k].decodeTime == all[k].decodeTime);
+		}
+	}
+
+	for (u32 i = 0; i < count; ++i) free(expected[i].data);
+	free(expected);
+	free(all);
+	free(cut);
+	free(ends);
+	free(endSamples);
+	free(file.data);
+	Mp4Destroy(&m);
+}
+
+// ended track gives its last sample duration up to end time & takes nothing more
+static void TestEndTrack(void) {
+	u8 streaminfo[34] = { 0 }, data[64] = { 0 };
+	mp4_track_config track = { .codec = MP4_CODEC_FLAC, .timescale = 48000, .channels = 2,
+							   .sampleRate = 48000, .config = streaminfo, .configSize = 34 };
+	test_buffer file = { 0 };
+	mp4_muxer m;
+	Check(Mp4Create(&m, &track, 1, 1000, TestWriteBuffer, &file));
+	Check(Mp4WriteSample(&m, 0, data, sizeof(data), 0, 0, true));
+	Check(Mp4WriteSample(&m, 0, data, sizeof(data), 4608, 4608, true));
+	Check(Mp4EndTrack(&m, 0, 5000));
+	Check(!Mp4WriteSample(&m, 0, data, sizeof(data), 9216, 9216, true));
+	Check(Mp4Finish(&m));
+
+	test_mp4_sample samples[4];
+	u32 fragments;
+	Check(TestReadMp4(file.data, file.size, samples, 4, &fragments) == 2);
+	Check(samples[0].duration == 4608 && samples[1].duration == 5000 - 4608);
+
+	free(file.data);
+	Mp4Destroy(&m);
+}
+
+static u32 gFitsCalls;
+
+// output that is full for third & fourth fragment, first call is for header
+static bool FitsSometimes(void *user, udm size) {
+	gFitsCalls++;
+	return gFitsCalls != 4 && gFitsCalls != 5;
+}
+
+// fragments output has no room for are dropped whole, file still reads to its end & continues
+// with IDR frame, every sample in it is one that was written, with its own time
+static void TestDropFragments(void) {
+	static u8 au[1 << 18], stored[1 << 18], audio[512];
+	u8 streaminfo[34] = { 0x10, 0x00, 0x10, 0x00 };
+	mp4_track_config tracks[2] = {
+		{ .codec = MP4_CODEC_H264, .timescale = 90000, .width = 640, .height = 360 },
+		{ .codec = MP4_CODEC_FLAC, .timescale = 48000, .channels = 2, .sampleRate = 48000,
+		  .config = streaminfo, .configSize = sizeof(streaminfo) },
+	};
+	test_buffer file = { 0 };
+	mp4_muxer m;
+	Check(Mp4Create(&m, tracks, 2, 2000, TestWriteBuffer, &file));
+	Mp4SetFits(&m, FitsSometimes);
+	gFitsCalls = 0;
+
+	// 30 fps, IDR every 4 seconds, so every fragment starts on one
+	u32 written = 0;
+	u64 audioTime = 0;
+	for (u32 frame = 0; frame < 30 * 40; ++frame) {
+		u64 videoTime = (u64) frame * 3000;
+		while (audioTime * 90000 / 48000 <= videoTime) {
+			TestFill(audio, sizeof(audio));
+			Check(Mp4WriteSample(&m, 1, audio, sizeof(audio), audioTime, audioTime, true));
+			audioTime += 4608;
+			written++;
+		}
+		u32 storedSize, size = MakeAccessUnit(au, stored, &storedSize, frame % 120 == 0, 1000);
+		Check(Mp4WriteSample(&m, 0, au, size, videoTime, videoTime, frame % 120 == 0));
+		written++;
+	}
+	Check(Mp4Finish(&m));
+	Check(m.droppedFragments == 2 && !m.skipping);
+
+	static test_mp4_sample samples[8192];
+	udm ends[64];
+	u32 endSamples[64], fragments;
+	s32 count = TestReadMp4Fragments(file.data, file.size, samples, 8192, &fragments, ends,
+									 endSamples, 64);
+	Check(count > 0 && (u32) count + m.droppedSamples == written);
+	Check(fragments > 2 && fragments <= 64 && ends[fragments - 1] == file.size);
+
+	// times stay where samples were written, gap is in timeline & video resumes on IDR frame
+	u64 last[2] = { 0, 0 };
+	bool first[2] = { true, true }, gap = false;
+	for (s32 i = 0; i < count; ++i) {
+		test_mp4_sample *s = &samples[i];
+		u64 step = s->track ? 4608 : 3000;
+		Check(s->decodeTime % step == 0);
+		if (!first[s->track] && s->decodeTime != last[s->track] + step) {
+			Check(s->decodeTime > last[s->track]);
+			if (!s->track) Check(s->sync);
+			gap = true;
+		}
+		first[s->track] = false;
+		last[s->track] = s->decodeTime;
+	}
+	Check(gap);
+
+	free(file.data);
+	Mp4Destroy(&m);
+}
+
+static void TestConvertTime(void) {
+	Check(Mp4ConvertTime(90000, 90000, 48000) == 48000);
+	Check(Mp4ConvertTime(2, 3, 2) == 1);
+	// hours of 100ns units don't overflow
+	u64 time = 10000000ULL * 3600 * 1000;
+	Check(Mp4ConvertTime(time, 10000000, 90000) == 90000ULL * 3600 * 1000);
+}
+
+static u64 gCounted;
+
+static bool CountWrite(void *user, const void *data, udm size) {
+	gCounted += size;
+	return true;
+}
+
+// hour of 60 fps video with audio, cpu time & bytes of boxes over sample data
+static void Bench(void) {
+	static u8 units[8][1 << 18], stored[1 << 18], audio[8192];
+	u32 sizes[8], storedSizes[8];
+	for (u32 k = 0; k < 8; ++k) {
+		sizes[k] = MakeAccessUnit(units[k], stored, &storedSizes[k], k == 0,
+								  k == 0 ? 150000 : 10000 + 2000 * k);
+	}
+	TestFill(audio, sizeof(audio));
+
+	u8 streaminfo[34] = { 0x10, 0x00, 0x10, 0x00 };
+	mp4_track_config tracks[2] = {
+		{ .codec = MP4_CODEC_H264, .timescale = 90000, .width = 1920, .height = 1080 },
+		{ .codec = MP4_CODEC_FLAC, .timescale = 48000, .channels = 2, .sampleRate = 48000,
+		  .config = streaminfo, .configSize = sizeof(streaminfo) },
+	};
+
+	for (u32 reorder = 0; reorder < 2; ++reorder) {
+		mp4_muxer m;
+		Mp4Create(&m, tracks, 2, 2000, CountWrite, 0);
+		gCounted = 0;
+		u64 payload = 0, audioTime = 0;
+
+		d64 start = TestSeconds();
+		for (u32 frame = 0; frame < 60 * 3600; ++frame) {
+			while (audioTime * 60 / 48000 <= frame) {
+				u32 size = 5000 + (u32) (audioTime & 1023);
+				Mp4WriteSample(&m, 1, audio, size, audioTime, audioTime, true);
+				payload += size;
+				audioTime += 4608;
+			}
+			bool idr = frame % 240 == 0;
+			u32 k = idr ? 0 : 1 + frame % 7;
+			u64 time = (u64) frame * 1500, offset = reorder ? frame % 3 * 1500 : 0;
+			Mp4WriteSample(&m, 0, units[k], sizes[k], time, time + offset, idr);
+			payload += storedSizes[k];
+		}
+		Mp4Finish(&m);
+		d64 seconds = TestSeconds() - start;
+
+		printf("mp4 hour at 60 fps%s: %.0f ms, %.2f us/frame, boxes %.1f KB (%.4f%%)\n",
+			   reorder ? " reordered" : "", seconds * 1000, seconds * 1e6 / (60 * 3600),
+			   (d64) (gCounted - payload) / 1000, 100.0 * (d64) (gCounted - payload) / payload);
+		Mp4Destroy(&m);
+	}
+}
+
+int main(int argc, char **argv) {
+	TestMuxer();
+	TestEndTrack();
+	TestDropFragments();
+	TestConvertTime();
+
+	if (TestBench(argc, argv)) Bench();
+
+	return TestResult("mp4");
+}
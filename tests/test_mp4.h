@@ -0,0 +1,156 @@
+#ifndef TEST_MP4_H
+#define TEST_MP4_H
+
+#include "test.h"
+
+// minimal reader of fragmented MP4 written by mp4.c, so tests can check samples that came out
+// fragments are read up to first incomplete one, like player reads file cut at any point
+
+typedef struct {
+	u32 track;
+	u64 decodeTime;
+	s32 offset;   // composition time - decode time
+	u32 duration;
+	u32 size;
+	bool sync;
+	const u8 *data;
+} test_mp4_sample;
+
+typedef struct {
+	u8 *data;
+	udm size;
+	udm capacity;
+} test_buffer;
+
+static u32 TestRead32(const u8 *p) {
+	return (u32) p[0] << 24 | (u32) p[1] << 16 | (u32) p[2] << 8 | p[3];
+}
+
+static u64 TestRead64(const u8 *p) {
+	return (u64) TestRead32(p) << 32 | TestRead32(p + 4);
+}
+
+// box of type inside of [data..data+size), searched at any depth by its fourcc
+static const u8 *TestFindBox(const u8 *data, udm size, const char *type) {
+	for (udm i = 4; i + 4 <= size; ++i) {
+		if (!memcmp(data + i, type, 4)) return data + i - 4;
+	}
+	return 0;
+}
+
+// mp4_write that appends to test_buffer
+static bool TestWriteBuffer(void *user, const void *data, udm size) {
+	test_buffer *b = (test_buffer *) user;
+	if (b->size + size > b->capacity) {
+		b->capacity = (b->size + size) * 2;
+		b->data = realloc(b->data, b->capacity);
+	}
+	memcpy(b->data + b->size, data, size);
+	b->size += size;
+	return true;
+}
+
+static bool TestReadFile(const char *path, test_buffer *b) {
+	FILE *file = fopen(path, "rb");
+	if (!file) return false;
+	fseek(file, 0, SEEK_END);
+	b->size = b->capacity = (udm) ftell(file);
+	b->data = malloc(b->size + 1);
+	fseek(file, 0, SEEK_SET);
+	bool ok = fread(b->data, 1, b->size, file) == b->size;
+	fclose(file);
+	return ok;
+}
+
+// same as TestReadMp4, also gives end offset of every fragment & count of samples up to its end,
+// first maxEnds of them
+static s32 TestReadMp4Fragments(const u8 *file, udm size, test_mp4_sample *samples,
+								u32 maxSamples, u32 *fragments, udm *ends, u32 *endSamples,
+								u32 maxEnds) {
+	udm at = 0;
+	s32 count = 0;
+	bool moov = false;
+	*fragments = 0;
+
+	while (at + 8 <= size) {
+		u32 boxSize = TestRead32(file + at);
+		if (boxSize < 8 || at + boxSize > size) break;
+		if (!memcmp(file + at + 4, "ftyp", 4) || !memcmp(file + at + 4, "moov", 4)) {
+			moov |= !memcmp(file + at + 4, "moov", 4);
+			at += boxSize;
+			continue;
+		}
+		if (memcmp(file + at + 4, "moof", 4) || !moov) return -1;
+
+		udm moof = at, mdat = at + boxSize;
+		if (mdat + 8 > size) break;
+		u32 mdatSize = TestRead32(file + mdat);
+		if (memcmp(file + mdat + 4, "mdat", 4)) return -1;
+		if (mdat + mdatSize > size) break;
+
+		for (udm p = moof + 8; p < moof + boxSize; p += TestRead32(file + p)) {
+			if (memcmp(file + p + 4, "traf", 4)) continue;
+
+			u32 track = 0, defaultDuration = 0, defaultSize = 0, defaultFlags = 0;
+			u64 base = 0;
+			udm end = p + TestRead32(file + p);
+			for (udm q = p + 8; q < end; q += TestRead32(file + q)) {
+				const u8 *box = file + q;
+				if (!memcmp(box + 4, "tfhd", 4)) {
+					u32 flags = TestRead32(box + 8) & 0xFFFFFF;
+					const u8 *r = box + 12;
+					track = TestRead32(r) - 1;
+					r += 4;
+					if (flags & 0x08) defaultDuration = TestRead32(r), r += 4;
+					if (flags & 0x10) defaultSize = TestRead32(r), r += 4;
+					if (flags & 0x20) defaultFlags = TestRead32(r);
+				} else if (!memcmp(box + 4, "tfdt", 4)) {
+					base = TestRead64(box + 12);
+				} else if (!memcmp(box + 4, "trun", 4)) {
+					u32 flags = TestRead32(box + 8) & 0xFFFFFF, n = TestRead32(box + 12);
+					const u8 *r = box + 16;
+					const u8 *data = file + moof + (s32) TestRead32(r);
+					r += 4;
+					u32 firstFlags = defaultFlags;
+					if (flags & 0x04) firstFlags = TestRead32(r), r += 4;
+
+					u64 time = base;
+					for (u32 i = 0; i < n; ++i) {
+						test_mp4_sample s = { track, time, 0, defaultDuration, defaultSize, false,
+											  data };
+						u32 sampleFlags = i == 0 ? firstFlags : defaultFlags;
+						if (flags & 0x100) s.duration = TestRead32(r), r += 4;
+						if (flags & 0x200) s.size = TestRead32(r), r += 4;
+						if (flags & 0x400) sampleFlags = TestRead32(r), r += 4;
+						if (flags & 0x800) s.offset = (s32) TestRead32(r), r += 4;
+						s.sync = (sampleFlags & 0x10000) == 0;
+						if (data + s.size > file + mdat + mdatSize) return -1;
+
+						if ((u32) count < maxSamples) samples[count] = s;
+						count++;
+						data += s.size;
+						time += s.duration;
+					}
+				}
+			}
+		}
+
+		if (*fragments < maxEnds) {
+			ends[*fragments] = mdat + mdatSize;
+			endSamples[*fragments] = (u32) count;
+		}
+		(*fragments)++;
+		at = mdat + mdatSize;
+	}
+
+	return count;
+}
+
+// returns number of samples, or -1 when boxes are not ftyp, moov & moof + mdat pairs
+// samples past maxSamples are counted but not stored
+static s32 TestReadMp4(const u8 *file, udm size, test_mp4_sample *samples, u32 maxSamples,
+					   u32 *fragments) {
+	return TestReadMp4Fragments(file, size, samples, maxSamples, fragments, 0, 0, 0);
+}
+
+#endif //TEST_MP4_H
@@ -0,0 +1,131 @@
+#include "bog/bog_types.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// disk that takes size / rate for every write & sometimes stalls, rate 0 is real disk
+static d64 gDiskRate;
+static bool gDiskStalls;
+
+static ssize_t SlowWrite(int file, const void *data, size_t size, off_t offset) {
+	if (gDiskRate > 0) {
+		d64 seconds = (d64) size / gDiskRate + (gDiskStalls && rand() % 100 == 0 ? 0.4 : 0);
+		struct timespec t = { (time_t) seconds, (long) ((seconds - (time_t) seconds) * 1e9) };
+		nanosleep(&t, 0);
+	}
+	return pwrite(file, data, size, offset);
+}
+
+#define pwrite SlowWrite
+#include "output.c"
+#undef pwrite
+
+#include "test_mp4.h"
+
+#define TEST_PATH "output/tests/output.bin"
+
+// random sized writes & flushes give file with exactly bytes that were accepted
+static void TestContent(bool direct, bool wait, u32 bufferCount) {
+	static u8 expected[48 << 20], chunk[150000];
+	output_config config = { .bufferSize = 64 << 10, .bufferCount = bufferCount,
+							 .preallocate = 1 << 20, .direct = direct, .wait = wait };
+	output_file f;
+	Check(OutputOpen(&f, TEST_PATH, &config));
+
+	udm size = 0;
+	u32 rejected = 0;
+	while (size < (40 << 20)) {
+		u32 chunkSize = TestRandom() % sizeof(chunk);
+		TestFill(chunk, chunkSize);
+		if (OutputWrite(&f, chunk, chunkSize)) {
+			memcpy(expected + size, chunk, chunkSize);
+			size += chunkSize;
+		} else {
+			rejected++;
+		}
+		if (TestRandom() % 4 == 0) Check(OutputFlush(&f));
+	}
+	Check(OutputClose(&f));
+	if (wait) Check(rejected == 0);
+
+	test_buffer file = { 0 };
+	Check(TestReadFile(TEST_PATH, &file));
+	Check(file.size == size && !memcmp(file.data, expected, size));
+	free(file.data);
+	unlink(TEST_PATH);
+}
+
+static int CompareSeconds(const void *a, const void *b) {
+	d64 x = *(const d64 *) a, y = *(const d64 *) b;
+	return x < y ? -1 : x > y;
+}
+
+// 60 fps of 8 Mbit/s samples written in muxer sized pieces to disk that does 3 MB/s with 400 ms
+// stalls, latency of write call through output thread & directly
+static void Bench(void) {
+	static u8 data[1 << 16];
+	static d64 latencies[5 * 60 * 4];
+	gDiskRate = 3e6;
+	gDiskStalls = true;
+
+	for (u32 threaded = 0; threaded < 2; ++threaded) {
+		output_config config = { .bufferSize = 1 << 20, .bufferCount = 16,
+								 .preallocate = 4 << 20, .direct = true };
+		output_file f;
+		int file = -1;
+		if (threaded) {
+			OutputOpen(&f, TEST_PATH, &config);
+		} else {
+			file = open(TEST_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		}
+
+		u32 count = 0, overflows = 0;
+		u64 offset = 0;
+		d64 start = TestSeconds();
+		for (u32 frame = 0; frame < 5 * 60; ++frame) {
+			d64 wait = start + frame / 60.0 - TestSeconds();
+			if (wait > 0) {
+				struct timespec t = { 0, (long) (wait * 1e9) };
+				nanosleep(&t, 0);
+			}
+
+			u32 size = (10000 + TestRandom() % 14000) / 4;
+			for (u32 piece = 0; piece < 4; ++piece) {
+				d64 time = TestSeconds();
+				if (threaded) {
+					overflows += !OutputWrite(&f, data, size);
+				} else {
+					SlowWrite(file, data, size, (off_t) offset);
+					offset += size;
+				}
+				latencies[count++] = TestSeconds() - time;
+			}
+		}
+		d64 seconds = TestSeconds() - start;
+		if (threaded) {
+			OutputClose(&f);
+		} else {
+			close(file);
+		}
+
+		qsort(latencies, count, sizeof(*latencies), CompareSeconds);
+		printf("output %s: %.1f s for 5 s of frames, write us p50 %.1f p99 %.1f max %.1f, "
+			   "%u overflows\n", threaded ? "thread" : "pwrite", seconds,
+			   latencies[count / 2] * 1e6, latencies[count * 99 / 100] * 1e6,
+			   latencies[count - 1] * 1e6, overflows);
+	}
+
+	unlink(TEST_PATH);
+}
+
+int main(int argc, char **argv) {
+	TestContent(false, false, 8);
+	TestContent(true, false, 8);
+	TestContent(true, false, 1);
+	TestContent(true, true, 4);
+
+	if (TestBench(argc, argv)) Bench();
+
+	return TestResult("output");
+}
@@ -0,0 +1,183 @@
+#include "timebase.c"
+#include "pacer.c"
+#include "test.h"
+
+#define TEST_FREQUENCY 10000000ULL
+
+typedef struct {
+	s64 *slotFrame;    // frame shown in every slot, only when checked
+	u64 slotCapacity;
+	u64 filled;        // slots planned so far
+	u64 submits;
+	u64 drops;
+} plans;
+
+// slots have to come in order without holes & dropped frame never gets any
+static void Apply(plans *s, pacer_plan plan, s64 frame) {
+	Check(plan.first == s->filled || !plan.count);
+	for (u32 i = 0; i < plan.count; ++i) {
+		if (s->filled < s->slotCapacity) s->slotFrame[s->filled] = frame;
+		s->filled++;
+	}
+	s->submits += plan.submit;
+	s->drops += plan.drop;
+	Check(!plan.drop || !plan.count);
+}
+
+static d64 Jitter(d64 msec) {
+	return ((d64) (TestRandom() >> 8) / 8388608.0 - 1) * msec / 1000;
+}
+
+typedef struct {
+	u64 frames;
+	u64 slots;
+	u64 expected;      // slots in time between first & last frame
+	u64 notNearest;    // slots that got frame farther than jitter can explain
+	u64 minStep, maxStep; // slot durations in 100 nsec
+	u64 maxLag;        // how late idle timer filled slots
+	u64 duplicates;
+	u64 drops;
+	d64 seconds;       // cpu time
+} result;
+
+// capture at hz with jitter of +-msec, static screen for gapLength seconds every gapEvery seconds
+// gives no frames, idle timer runs every 100 ms between frames
+static result Run(d64 hz, d64 jitter, u32 num, u32 den, d64 seconds, d64 gapEvery,
+				  d64 gapLength, bool check) {
+	pacer p;
+	pacer_config config = { num, den, TEST_FREQUENCY, TEST_FREQUENCY / 10 };
+	PacerStart(&p, &config);
+
+	u64 count = (u64) (seconds * hz) + 2;
+	u64 *ideal = check ? malloc(count * sizeof(u64)) : 0;
+	plans s = { 0 };
+	if (check) {
+		s.slotCapacity = (u64) (seconds * num / den) + 16;
+		s.slotFrame = malloc(s.slotCapacity * sizeof(s64));
+	}
+
+	result r = { 0 };
+	u64 idleTime = 0, lastTime = 0, firstTime = 0;
+	s64 current = -1;
+	d64 start = TestSeconds();
+	for (u64 k = 0; k < count; ++k) {
+		d64 t = k / hz + Jitter(jitter) + 1;
+		if (gapEvery > 0 && t > 2 && t - 1 - (u64) ((t - 1) / gapEvery) * gapEvery < gapLength) {
+			continue;
+		}
+		u64 time = (u64) (t * TEST_FREQUENCY);
+		if (time <= lastTime) time = lastTime + 1;
+
+		if (!r.frames) {
+			firstTime = time;
+		} else {
+			for (; idleTime < time; idleTime += TEST_FREQUENCY / 10) {
+				Apply(&s, PacerIdle(&p, idleTime), current);
+				u64 slotTime = p.start + PacerSlotTime(&p, p.slots.index, TEST_FREQUENCY);
+				if (idleTime > slotTime && idleTime - slotTime > r.maxLag) {
+					r.maxLag = idleTime - slotTime;
+				}
+			}
+		}
+		idleTime = time + TEST_FREQUENCY / 10;
+
+		Apply(&s, PacerFrame(&p, time), current);
+		if (ideal) ideal[r.frames] = (u64) ((k / hz + 1) * TEST_FREQUENCY);
+		current = (s64) r.frames++;
+		lastTime = time;
+	}
+	Apply(&s, PacerFlush(&p), current);
+	r.seconds = TestSeconds() - start;
+
+	// stepped slot time is same as direct formula after any number of slots
+	Check(p.slots.time == PacerSlotTime(&p, p.slots.index, TEST_FREQUENCY));
+
+	r.minStep = ~0ULL;
+	for (u64 slot = 0; slot + 1 < s.filled; slot += s.filled / 100000 + 1) {
+		u64 step = PacerSlotTime(&p, slot + 1, 10000000) - PacerSlotTime(&p, slot, 10000000);
+		if (step < r.minStep) r.minStep = step;
+		if (step > r.maxStep) r.maxStep = step;
+	}
+
+	// frame of slot is one with nearest ideal time, except frames past latency, pacer only sees
+	// jittered times, so frame that is farther by up to twice jitter can look nearer, 1 ms more is
+	// left for smoothing
+	u64 tolerance = (u64) ((2 * jitter + 1) / 1000 * TEST_FREQUENCY);
+	for (u64 slot = 0, f = 0; check && slot < s.filled && slot < s.slotCapacity; ++slot) {
+		u64 time = p.start + PacerSlotTime(&p, slot, TEST_FREQUENCY);
+		while (f + 1 < r.frames && ideal[f + 1] <= time) f++;
+		u64 best = f;
+		if (f + 1 < r.frames && ideal[f + 1] - time < time - ideal[f]) best = f + 1;
+
+		u64 got = (u64) s.slotFrame[slot];
+		if (got != best) {
+			u64 a = time > ideal[got] ? time - ideal[got] : ideal[got] - time;
+			u64 b = time > ideal[best] ? time - ideal[best] : ideal[best] - time;
+			if (a > b + tolerance && b <= p.config.latency / 2) r.notNearest++;
+		}
+	}
+
+	r.slots = s.filled;
+	r.expected = (u64) ((d64) (lastTime - firstTime) / TEST_FREQUENCY * num / den + 0.5);
+	r.duplicates = p.duplicates;
+	r.drops = s.drops;
+	free(ideal);
+	free(s.slotFrame);
+	return r;
+}
+
+static void CheckResult(result r, u32 num, u32 den) {
+	Check(r.notNearest == 0);
+	Check(r.slots + 2 >= r.expected && r.slots <= r.expected + 2);
+	Check(r.maxStep - r.minStep <= 1);
+	Check(r.maxLag <= TEST_FREQUENCY / 10 + TEST_FREQUENCY * den / num);
+}
+
+// every slot gets nearest frame for capture faster, slower & near output rate, with gaps
+static void TestRates(void) {
+	result same = Run(60, 2, 60, 1, 120, 0, 0, true);
+	CheckResult(same, 60, 1);
+	// steady cadence is smoothed, so jitter doesn't cause repeat & drop pairs
+	Check(same.duplicates < 10 && same.drops < 10);
+
+	CheckResult(Run(59.94, 1, 60, 1, 120, 0, 0, true), 60, 1);
+	CheckResult(Run(60, 1, 60000, 1001, 120, 0, 0, true), 60000, 1001);
+
+	result fast = Run(144, 3, 60, 1, 120, 0, 0, true);
+	CheckResult(fast, 60, 1);
+	Check(fast.drops > fast.frames / 2);
+
+	result slow = Run(30, 4, 60, 1, 120, 0, 0, true);
+	CheckResult(slow, 60, 1);
+	Check(slow.duplicates >= slow.slots / 2 - 2);
+
+	// static screen keeps repeating last frame
+	result gaps = Run(60, 2, 60, 1, 120, 10, 2, true);
+	CheckResult(gaps, 60, 1);
+	Check(gaps.duplicates > 11 * 2 * 60);
+}
+
+// day long recordings, slots stay on exact grid & cost of pacer per frame
+static void Bench(void) {
+	static const struct { const char *name; d64 hz, jitter; u32 num, den; } runs[] = {
+		{ "60 Hz to 59.94", 60, 2, 60000, 1001 },
+		{ "144 Hz to 144", 144, 1, 144, 1 },
+		{ "60 Hz to 60", 60, 2, 60, 1 },
+	};
+	for (u32 i = 0; i < 3; ++i) {
+		result r = Run(runs[i].hz, runs[i].jitter, runs[i].num, runs[i].den, 86400, 0, 0, false);
+		CheckResult(r, runs[i].num, runs[i].den);
+		printf("pacer day of %-15s %9llu slots (%9llu expected), %7llu repeated, %7llu dropped, "
+			   "%.1f ns per frame\n", runs[i].name, (unsigned long long) r.slots,
+			   (unsigned long long) r.expected, (unsigned long long) r.duplicates,
+			   (unsigned long long) r.drops, r.seconds * 1e9 / r.frames);
+	}
+}
+
+int main(int argc, char **argv) {
+	TestRates();
+
+	if (TestBench(argc, argv)) Bench();
+
+	return TestResult("pacer");
+}
@@ -0,0 +1,180 @@
+#include "pool.c"
+#include "test.h"
+
+#include <math.h>
+
+static u32 gLive;
+static u32 gCreates;
+static bool gCreateFails;
+
+static bool CountCreate(void *user, u32 index) {
+	if (gCreateFails) return false;
+	gLive++;
+	gCreates++;
+	return true;
+}
+
+static void CountDestroy(void *user, u32 index) {
+	gLive--;
+}
+
+static d64 Uniform(void) {
+	return (TestRandom() >> 8) / 16777216.0;
+}
+
+// usec encoder takes for frame submitted at usec time
+typedef d64 encoder_time(d64 time);
+
+static d64 FastEncoder(d64 time) {
+	return 3000 + Uniform() * 2000 + (Uniform() < 0.01 ? 8000 : 0);
+}
+
+static d64 HiccupEncoder(d64 time) {
+	return 4000 + Uniform() * 2000 + (Uniform() < 0.002 ? 60000 + Uniform() * 60000 : 0);
+}
+
+// almost too slow for 60 fps & stalls for 150 ms every 8 seconds
+static d64 SlowEncoder(d64 time) {
+	return 13000 + Uniform() * 3000 + (fmod(time, 8e6) < 16667 ? 150000 : 0);
+}
+
+// too slow for 60 fps during 5 seconds of every minute
+static d64 BurstEncoder(d64 time) {
+	d64 phase = fmod(time, 60e6);
+	return phase > 20e6 && phase < 25e6 ? 17500 + Uniform() * 1000 : 6000 + Uniform() * 3000;
+}
+
+typedef struct {
+	u32 drops;
+	u32 maxCount;
+	u32 endCount;
+	d64 memory;  // average buffers allocated
+} simulation;
+
+// 60 fps capture feeding encoder that returns frames in order after encoder time, in usec ticks
+static simulation Simulate(encoder_time *encoder, u32 minCount, u32 maxCount, u32 seconds) {
+	static struct { s32 index; d64 finish; } queue[1 << 16];
+	u32 head = 0, tail = 0, frames = 0;
+	simulation result = { 0 };
+
+	gLive = 0;
+	gCreates = 0;
+	buffer_pool p;
+	pool_config config = { .minCount = minCount, .maxCount = maxCount, .bufferSize = 1,
+						   .interval = 16667, .window = 2000000, .create = CountCreate,
+						   .destroy = CountDestroy };
+	Check(PoolCreate(&p, &config, 1));
+
+	d64 busyUntil = 0;
+	for (d64 time = 16667; time < seconds * 1e6; time += 1e6 / 60) {
+		for (; tail != head && queue[tail].finish <= time; ++tail) {
+			PoolRelease(&p, queue[tail].index, (u64) queue[tail].finish);
+		}
+
+		s32 index = PoolAcquire(&p, (u64) time);
+		if (index >= 0) {
+			busyUntil = (time > busyUntil ? time : busyUntil) + encoder(time);
+			queue[head].index = index;
+			queue[head].finish = busyUntil;
+			head++;
+		}
+
+		Check(gLive == p.count && p.count >= minCount && p.count <= maxCount);
+		if (p.count > result.maxCount) result.maxCount = p.count;
+		result.memory += (d64) PoolMemory(&p);
+		frames++;
+	}
+	result.memory /= frames;
+	result.drops = p.drops;
+	result.endCount = p.count;
+
+	for (; tail != head; ++tail) PoolRelease(&p, queue[tail].index, (u64) queue[tail].finish);
+	PoolDestroy(&p);
+	Check(gLive == 0);
+	return result;
+}
+
+// acquires hand out distinct buffers, full pool drops, cancel & release make buffer free again
+static void TestBasics(void) {
+	buffer_pool p;
+	pool_config config = { .minCount = 2, .maxCount = 4, .interval = 10, .window = 1000,
+						   .create = CountCreate, .destroy = CountDestroy };
+	gLive = 0;
+	Check(PoolCreate(&p, &config, 1));
+	Check(gLive == 2);
+
+	// nothing returns, so pool grows up to max & then drops
+	u32 used = 0;
+	for (u32 i = 0; i < 4; ++i) {
+		s32 index = PoolAcquire(&p, 10 + i * 10);
+		Check(index >= 0 && index < POOL_MAX_BUFFERS && !(used & (1u << index)));
+		if (index >= 0) used |= 1u << index;
+	}
+	Check(PoolAcquire(&p, 50) < 0 && p.drops == 1 && gLive == 4);
+	Check(PoolInFlight(&p) == 4);
+
+	s32 first = __builtin_ctz(used);
+	PoolCancel(&p, first);
+	Check(PoolAcquire(&p, 60) == first);
+	PoolRelease(&p, first, 70);
+	Check(PoolAcquire(&p, 80) == first);
+	for (; used; used &= used - 1) PoolRelease(&p, __builtin_ctz(used), 90);
+	PoolDestroy(&p);
+	Check(gLive == 0);
+
+	// failed allocation stops growth instead of failing acquire of existing buffers
+	Check(PoolCreate(&p, &config, 1));
+	gCreateFails = true;
+	Check(PoolAcquire(&p, 10) >= 0 && PoolAcquire(&p, 20) >= 0);
+	Check(PoolAcquire(&p, 30) < 0 && gLive == 2);
+	gCreateFails = false;
+	PoolDestroy(&p);
+}
+
+// pool stays small for fast encoder, grows enough to never drop for slow or stalling one & goes
+// back down after burst
+static void TestAdaptive(void) {
+	simulation fast = Simulate(FastEncoder, 2, 16, 120);
+	Check(fast.drops == 0 && fast.maxCount == 2);
+
+	simulation hiccup = Simulate(HiccupEncoder, 2, 16, 600);
+	Check(hiccup.drops == 0);
+
+	simulation slow = Simulate(SlowEncoder, 2, 32, 120);
+	Check(slow.drops == 0);
+
+	// shrinking by one buffer every 2 second window takes most of minute after burst at 80 s
+	simulation burst = Simulate(BurstEncoder, 2, 32, 139);
+	Check(burst.drops == 0 && burst.maxCount > 8 && burst.endCount <= 4);
+}
+
+// 10 minutes of every encoder with fixed & adaptive pool of 4K NV12 frames
+static void Bench(void) {
+	static const struct { const char *name; encoder_time *encoder; } encoders[] = {
+		{ "fast", FastEncoder }, { "hiccup", HiccupEncoder },
+		{ "slow", SlowEncoder }, { "burst", BurstEncoder },
+	};
+	static const u32 counts[][2] = { { 8, 8 }, { 2, 16 }, { 2, 32 } };
+	d64 megabytes = 3840 * 2160 * 1.5 / 1048576;
+
+	for (u32 e = 0; e < 4; ++e) {
+		for (u32 c = 0; c < 3; ++c) {
+			d64 start = TestSeconds();
+			simulation s = Simulate(encoders[e].encoder, counts[c][0], counts[c][1], 600);
+			d64 seconds = TestSeconds() - start;
+			printf("pool %-6s %2u..%-2u: %4u drops, average %6.1f MB, max %2u buffers, "
+				   "%u allocations, %.1f ns per frame\n", encoders[e].name, counts[c][0],
+				   counts[c][1], s.drops, s.memory * megabytes, s.maxCount, gCreates,
+				   seconds * 1e9 / (600 * 60));
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	TestBasics();
+	TestAdaptive();
+
+	if (TestBench(argc, argv)) Bench();
+
+	return TestResult("pool");
+}
@@ -0,0 +1,280 @@
+#include "mp4.c"
+#include "output.c"
+#include "replay.c"
+#include "test_mp4.h"
+
+#include <unistd.h>
+
+#define TEST_PATH "output/tests/replay.mp4"
+#define TEST_TAGS (1 << 22)
+
+typedef struct {
+	u32 track;
+	u64 decodeTime;
+	bool sync;
+} tag_info;
+
+// sample written with every tag, tags count up across both tracks
+static tag_info gTags[TEST_TAGS];
+
+static const u8 gConfig[] = { 0, 0, 0, 1, 0x67, 0x42, 0, 0x1F, 0xAB, 0xCD,
+							  0, 0, 0, 1, 0x68, 0xCE, 0x3C, 0x80 };
+static u8 gStreaminfo[34] = { 0x10, 0x00, 0x10, 0x00 };
+static const mp4_track_config gTracks[2] = {
+	{ .codec = MP4_CODEC_H264, .timescale = 90000, .width = 1280, .height = 720,
+	  .bufferSize = 16 << 20 },
+	{ .codec = MP4_CODEC_FLAC, .timescale = 48000, .channels = 2, .sampleRate = 48000,
+	  .config = gStreaminfo, .configSize = sizeof(gStreaminfo), .bufferSize = 4 << 20 },
+};
+static const output_config gOutput = { .bufferSize = 1 << 20, .bufferCount = 8, .wait = true };
+
+// payload is derived from tag, so torn or misplaced sample data is detected
+static u32 MakeSample(u8 *data, u32 track, u32 tag, bool idr) {
+	u32 size = 0;
+	if (track == 0) {
+		if (idr) {
+			memcpy(data, gConfig, sizeof(gConfig));
+			size = sizeof(gConfig);
+		}
+		static const u8 slice[] = { 0, 0, 0, 1 };
+		memcpy(data + size, slice, 4);
+		data[size + 4] = idr ? 0x65 : 0x41;
+		size += 5;
+	}
+
+	// no zero bytes, so payload never looks like start code
+	for (u32 i = 0; i < 4; ++i) data[size++] = (u8) (((tag >> (7 * i)) & 0x7F) | 0x80);
+	u32 payload = track ? 100 + tag % 2000 : (idr ? 40000 : 2000) + (tag * 7919) % 8000;
+	for (u32 i = 0; i < payload; ++i) data[size++] = (u8) ((tag * 31 + i * 7) | 1);
+	return size;
+}
+
+// tag of sample read back from file, payload has to match it
+static u32 SampleTag(const test_mp4_sample *s) {
+	const u8 *p = s->data;
+	u32 size = s->size;
+	if (s->track == 0) {
+		while (p + 5 <= s->data + s->size) {
+			u32 nalSize = TestRead32(p), type = p[4] & 0x1F;
+			if (type == 1 || type == 5) {
+				size = nalSize - 1;
+				p += 5;
+				break;
+			}
+			p += 4 + nalSize;
+		}
+	}
+
+	u32 tag = 0;
+	for (u32 i = 0; i < 4; ++i) tag |= (u32) (p[i] & 0x7F) << (7 * i);
+	for (u32 i = 4; i < size; ++i) {
+		if (p[i] != (u8) ((tag * 31 + (i - 4) * 7) | 1)) return ~0u;
+	}
+	return tag % TEST_TAGS;
+}
+
+typedef struct {
+	u32 tag;
+	u64 videoTime;
+	u64 audioTime;
+	u32 frame;
+} feed;
+
+// one video frame at 60 fps with GOP of 2 seconds & audio up to its time
+static void Feed(replay_ring *r, feed *f) {
+	static u8 data[1 << 17];
+	while (f->audioTime * 90000 / 48000 <= f->videoTime) {
+		u32 tag = f->tag++ % TEST_TAGS;
+		gTags[tag] = (tag_info) { 1, f->audioTime, true };
+		u32 size = MakeSample(data, 1, tag, true);
+		Check(ReplayWriteSample(r, 1, data, size, f->audioTime, f->audioTime, true));
+		f->audioTime += 4608;
+	}
+
+	bool idr = f->frame % 120 == 0;
+	u32 tag = f->tag++ % TEST_TAGS;
+	gTags[tag] = (tag_info) { 0, f->videoTime, idr };
+	u32 size = MakeSample(data, 0, tag, idr);
+	Check(ReplayWriteSample(r, 0, data, size, f->videoTime, f->videoTime + 1500, idr));
+	f->videoTime += 1500;
+	f->frame++;
+}
+
+// flushed file starts with IDR frame at 0, samples are in order with their own timestamps & video
+// only skips frames when flush jumped to next IDR frame, returns seconds of video in file
+static d64 CheckFlush(u32 *jumps) {
+	static test_mp4_sample samples[1 << 20];
+	test_buffer file = { 0 };
+	Check(TestReadFile(TEST_PATH, &file));
+	unlink(TEST_PATH);
+
+	u32 fragments;
+	s32 count = TestReadMp4(file.data, file.size, samples, 1 << 20, &fragments);
+	Check(count > 0 && samples[0].track == 0 && samples[0].sync && samples[0].decodeTime == 0);
+
+	u64 originVideo = count > 0 ? gTags[SampleTag(&samples[0]) % TEST_TAGS].decodeTime : 0;
+	u64 origin[2] = { originVideo, Mp4ConvertTime(originVideo, 90000, 48000) };
+	s64 last[2] = { -1, -1 };
+	u64 span = 0;
+	for (s32 i = 0; i < count; ++i) {
+		u32 tag = SampleTag(&samples[i]);
+		if (tag == ~0u) {
+			Check(!"sample data is corrupted");
+			break;
+		}
+
+		tag_info *info = &gTags[tag];
+		u32 track = info->track;
+		Check(track == samples[i].track && info->sync == samples[i].sync);
+		Check(samples[i].decodeTime + origin[track] == info->decodeTime);
+		Check((s64) tag > last[track]);
+
+		// missing video frames are only allowed when flush jumped forward to IDR frame
+		if (track == 0 && last[0] >= 0) {
+			u32 next = (u32) last[0] + 1;
+			while (next < tag && gTags[next].track != 0) ++next;
+			if (next != tag) {
+				Check(info->sync);
+				if (jumps) (*jumps)++;
+			}
+		}
+
+		last[track] = tag;
+		if (track == 0) span = samples[i].decodeTime;
+	}
+
+	free(file.data);
+	return span / 90000.0;
+}
+
+// ring keeps at least duration once it's filled, never more than duration + GOP, never over
+// size & always starts on IDR frame
+static void TestDuration(void) {
+	replay_ring r;
+	replay_config config = { .duration = 20000, .size = 256 << 20 };
+	Check(ReplayCreate(&r, gTracks, 2, &config));
+
+	feed f = { 0 };
+	u64 minimum = ~0ULL, maximum = 0;
+	while (f.videoTime < 90000ULL * 90) {
+		Feed(&r, &f);
+		replay_sample *tail = ReplaySampleAt(&r, r.tail);
+		Check(tail->track == 0 && tail->sync);
+		Check(r.stored <= r.size);
+
+		u64 span = f.videoTime - 1500 - tail->decodeTime;
+		if (f.videoTime > 90000ULL * 25) {
+			if (span < minimum) minimum = span;
+			if (span > maximum) maximum = span;
+		}
+	}
+	Check(minimum >= 90000ULL * 20 - 1500 && maximum < 90000ULL * 22);
+
+	Check(ReplayFlush(&r, TEST_PATH, &gOutput, 1000));
+	d64 seconds = CheckFlush(0);
+	Check(seconds >= 20 - 1 / 60.0 && seconds < 22);
+	ReplayDestroy(&r);
+}
+
+static void TestSize(void) {
+	replay_ring r;
+	replay_config config = { .duration = 60000, .size = 8 << 20 };
+	Check(ReplayCreate(&r, gTracks, 2, &config));
+
+	feed f = { 0 };
+	while (f.videoTime < 90000ULL * 60) {
+		Feed(&r, &f);
+		replay_sample *tail = ReplaySampleAt(&r, r.tail);
+		Check(tail->track == 0 && tail->sync && r.stored <= r.size);
+	}
+	Check(r.peak <= r.size);
+
+	Check(ReplayFlush(&r, TEST_PATH, &gOutput, 1000));
+	Check(CheckFlush(0) > 2);
+	ReplayDestroy(&r);
+}
+
+typedef struct {
+	replay_ring *r;
+	volatile s32 stop;
+	u32 frames;
+} writer;
+
+static BOG_THREAD_PROC(WriterThread) {
+	writer *w = (writer *) arg;
+	feed f = { 0 };
+	while (!BOGAtomicLoad(&w->stop)) Feed(w->r, &f);
+	w->frames = f.frame;
+	return 0;
+}
+
+// flushes while writer keeps writing as fast as it can, small ring evicts GOPs that are being
+// flushed, so flush has to notice & jump over them
+static void TestConcurrentFlush(void) {
+	replay_ring r;
+	replay_config config = { .duration = 10000, .size = 6 << 20, .sampleCount = 4096 };
+	Check(ReplayCreate(&r, gTracks, 2, &config));
+
+	writer w = { &r, 0, 0 };
+	bog_thread thread;
+	Check(BOGThreadCreate(&thread, WriterThread, &w));
+	while (BOGAtomicLoad(&r.head) < 3000) usleep(1000);
+
+	u32 flushes = 0, jumps = 0;
+	for (u32 i = 0; i < 50; ++i) {
+		if (!ReplayFlush(&r, TEST_PATH, &gOutput, 1000)) continue;
+		CheckFlush(&jumps);
+		flushes++;
+	}
+	BOGAtomicStore(&w.stop, 1);
+	BOGThreadJoin(thread);
+
+	Check(flushes > 0);
+	ReplayDestroy(&r);
+}
+
+// cost of keeping 8 Mbit/s 60 fps recording in ring & of saving minute of it
+static void Bench(void) {
+	static u8 frames[8][40000], audio[1500];
+	u32 sizes[8];
+	for (u32 k = 0; k < 8; ++k) sizes[k] = MakeSample(frames[k], 0, k, k == 0);
+	MakeSample(audio, 1, 0, true);
+
+	replay_ring r;
+	replay_config config = { .duration = 60000, .size = 128 << 20 };
+	ReplayCreate(&r, gTracks, 2, &config);
+
+	u64 audioTime = 0;
+	u32 count = 60 * 600;
+	d64 start = TestSeconds();
+	for (u32 frame = 0; frame < count; ++frame) {
+		u64 videoTime = frame * 1500ULL;
+		while (audioTime * 90000 / 48000 <= videoTime) {
+			ReplayWriteSample(&r, 1, audio, sizeof(audio), audioTime, audioTime, true);
+			audioTime += 4608;
+		}
+		bool idr = frame % 120 == 0;
+		u32 k = idr ? 0 : 1 + frame % 7;
+		ReplayWriteSample(&r, 0, frames[k], sizes[k], videoTime, videoTime, idr);
+	}
+	d64 seconds = TestSeconds() - start;
+
+	start = TestSeconds();
+	ReplayFlush(&r, TEST_PATH, &gOutput, 1000);
+	d64 flush = TestSeconds() - start;
+	unlink(TEST_PATH);
+
+	printf("replay write %.2f us/frame, flush of %.1f MB minute %.0f ms\n",
+		   seconds * 1e6 / count, r.stored / 1e6, flush * 1000);
+	ReplayDestroy(&r);
+}
+
+int main(int argc, char **argv) {
+	TestDuration();
+	TestSize();
+	TestConcurrentFlush();
+
+	if (TestBench(argc, argv)) Bench();
+
+	return TestResult("replay");
+}
@@ -0,0 +1,480 @@
+#include "resampler.c"
+#include "test.h"
+
+#include <math.h>
+
+#define TEST_MAX_FRAMES 200000
+
+static f32 gInput[RESAMPLER_MAX_CHANNELS * TEST_MAX_FRAMES];
+static s16 gOutput[2 * 2 * TEST_MAX_FRAMES];
+static s16 gOther[2 * 2 * TEST_MAX_FRAMES];
+
+// amplitude of frequency in one channel of stereo output, hann window over middle 3/4 keeps
+// filter warm up & drain out of it & spreads quantization noise far below aliases
+static d64 Tone(const s16 *x, u32 frames, u32 channel, d64 frequency, d64 rate) {
+	u32 first = frames / 8, last = frames - frames / 8;
+	d64 c = 0, s = 0, sum = 0;
+	for (u32 i = first; i < last; ++i) {
+		d64 w = 0.5 - 0.5 * cos(2 * M_PI * (i - first) / (last - first));
+		d64 v = x[2 * i + channel] / 32768.0 * w;
+		c += v * cos(2 * M_PI * frequency * i / rate);
+		s += v * sin(2 * M_PI * frequency * i / rate);
+		sum += w;
+	}
+	return 2 * sqrt(c * c + s * s) / sum;
+}
+
+static d64 Decibels(d64 gain) {
+	return 20 * log10(gain + 1e-20);
+}
+
+// input in packets of random size, so state between calls is always used
+static u32 Resample(const resampler_config *config, const void *input, u32 frames, s16 *output,
+					u32 maxPacket) {
+	resampler r;
+	Check(ResamplerCreate(&r, config));
+	u32 frameSize = r.frameSize, written = 0;
+	for (u32 i = 0; i < frames;) {
+		u32 count = maxPacket > 1 ? 1 + TestRandom() % maxPacket : maxPacket;
+		if (count > frames - i) count = frames - i;
+		written += ResamplerProcess(&r, (const u8 *) input + (udm) i * frameSize, count,
+									output + 2 * written);
+		i += count;
+	}
+	written += ResamplerDrain(&r, output + 2 * written);
+	ResamplerDestroy(&r);
+	return written;
+}
+
+// second of f32 tone in one channel, others silent
+static u32 Sine(const resampler_config *config, u32 channel, d64 frequency, d64 amplitude,
+				s16 *output) {
+	u32 frames = config->inRate;
+	memset(gInput, 0, (udm) frames * config->channels * sizeof(f32));
+	for (u32 i = 0; i < frames; ++i) {
+		gInput[i * config->channels + channel] =
+			(f32) (amplitude * sin(2 * M_PI * frequency * i / config->inRate));
+	}
+	return Resample(config, gInput, frames, output, 2000);
+}
+
+typedef struct {
+	d64 ripple;        // dB between highest & lowest gain in passband
+	d64 alias;         // dB of worst alias or image that lands in passband
+	d64 aliasInput;
+} quality;
+
+// passband is flat & tones that can't be represented at output rate don't come back in it
+static quality Measure(u32 inRate, u32 outRate) {
+	resampler_config config = { RESAMPLER_F32, 2, 0, inRate, outRate, false };
+	d64 lower = inRate < outRate ? inRate : outRate;
+	d64 pass = 0.45 * lower < 20000 ? 0.45 * lower : 20000;
+	quality q = { 0, -1000, 0 };
+
+	d64 low = 1000, high = -1000;
+	for (d64 f = 20; f <= pass; f *= 1.3) {
+		u32 frames = Sine(&config, 0, f, 0.5, gOutput);
+		d64 gain = Decibels(Tone(gOutput, frames, 0, f, outRate) / 0.5);
+		low = gain < low ? gain : low;
+		high = gain > high ? gain : high;
+	}
+	q.ripple = high - low;
+
+	// downsampling folds input tones above output nyquist back, upsampling makes image of
+	// every tone at input rate - tone, that folds around output nyquist
+	bool up = inRate < outRate;
+	d64 first = up ? 100 : lower - pass, last = up ? pass : inRate / 2.0;
+	for (d64 f = first; f < last; f += (last - first) / 16) {
+		d64 alias = fmod(up ? inRate - f : f, outRate);
+		if (alias > outRate / 2.0) alias = outRate - alias;
+		if (alias > pass || fabs(alias - f) < 200) continue;
+
+		u32 frames = Sine(&config, 0, f, 0.5, gOutput);
+		d64 gain = Decibels(Tone(gOutput, frames, 0, alias, outRate) / 0.5);
+		if (gain > q.alias) {
+			q.alias = gain;
+			q.aliasInput = f;
+		}
+	}
+	return q;
+}
+
+static const u32 gRates[][2] = {
+	{ 44100, 48000 }, { 96000, 48000 }, { 192000, 48000 }, { 88200, 48000 }, { 32000, 48000 },
+	{ 48000, 44100 },
+};
+
+static void TestQuality(void) {
+	for (u32 i = 0; i < sizeof(gRates) / sizeof(*gRates); ++i) {
+		quality q = Measure(gRates[i][0], gRates[i][1]);
+		Check(q.ripple < 0.01);
+		Check(q.alias < -95);
+	}
+}
+
+// random packet sizes give exactly what one call gives & every SIMD level is within 1 LSB of
+// scalar, same dither stream everywhere
+static void TestStreaming(void) {
+	static s16 input[2 * 100000];
+	for (u32 i = 0; i < 2 * 100000; ++i) input[i] = (s16) (TestRandom() % 20000 - 10000);
+	resampler_config config = { RESAMPLER_S16, 2, 0, 44100, 48000, false };
+
+	ResamplerSetLevel(BOG_CPU_SCALAR);
+	u32 whole = Resample(&config, input, 100000, gOther, 100000);
+	Check(whole >= 100000ull * 48000 / 44100);
+	Check(whole <= 100000ull * 48000 / 44100 + 200);
+
+	for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+		ResamplerSetLevel(level);
+		u32 parts = Resample(&config, input, 100000, gOutput, 700);
+		Check(parts == whole);
+		u32 different = 0;
+		for (u32 i = 0; i < 2 * whole; ++i) {
+			s32 d = gOutput[i] - gOther[i];
+			Check(d >= -1 && d <= 1);
+			different += d != 0;
+		}
+		if (level == BOG_CPU_SCALAR) Check(!different);
+	}
+	ResamplerInit();
+}
+
+// step at input frame 20000 rises at same time in output, filter has no delay
+static void TestDelay(void) {
+	static const u32 rates[][2] = { { 44100, 48000 }, { 96000, 48000 }, { 48000, 44100 } };
+	for (u32 i = 0; i < 3; ++i) {
+		resampler_config config = { RESAMPLER_F32, 1, 0, rates[i][0], rates[i][1], false };
+		u32 frames = rates[i][0] / 2;
+		for (u32 k = 0; k < frames; ++k) gInput[k] = k >= 20000 ? 0.5f : 0;
+		u32 written = Resample(&config, gInput, frames, gOutput, 1000);
+
+		u32 rise = 0;
+		while (rise < written && gOutput[2 * rise] < 8192) rise++;
+		d64 expected = 20000.0 * rates[i][1] / rates[i][0];
+		Check(fabs(rise - expected) < 1.5);
+	}
+}
+
+// 5.1 & 7.1 to stereo at ITU gains, LFE is dropped
+static void TestDownmix(void) {
+	static const struct {
+		u32 channels, mask, channel;
+		d64 left, right;
+	} cases[] = {
+		{ 6, 0, 0, 1, 0 }, { 6, 0, 1, 0, 1 }, { 6, 0, 2, 0.7071, 0.7071 }, { 6, 0, 3, 0, 0 },
+		{ 6, 0, 4, 0.7071, 0 }, { 6, 0, 5, 0, 0.7071 }, { 8, 0, 6, 0.7071, 0 },
+		{ 8, 0, 7, 0, 0.7071 }, { 1, 0, 0, 1, 1 }, { 2, 0x3, 1, 0, 1 },
+		{ 3, RESAMPLER_FRONT_LEFT | RESAMPLER_FRONT_RIGHT | RESAMPLER_BACK_CENTER, 2, 0.5, 0.5 },
+	};
+	for (u32 i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+		resampler_config config = { RESAMPLER_F32, cases[i].channels, cases[i].mask, 48000, 48000,
+									 false };
+		u32 frames = Sine(&config, cases[i].channel, 1000, 0.5, gOutput);
+		Check(fabs(Tone(gOutput, frames, 0, 1000, 48000) / 0.5 - cases[i].left) < 0.002);
+		Check(fabs(Tone(gOutput, frames, 1, 1000, 48000) / 0.5 - cases[i].right) < 0.002);
+	}
+}
+
+// integer formats are scaled to same level as float
+static void TestFormats(void) {
+	static u8 s24[3 * 2 * 48000];
+	static s32 s32s[2 * 48000];
+	static s16 s16s[2 * 48000];
+	for (u32 i = 0; i < 2 * 48000; ++i) {
+		d64 v = 0.5 * sin(2 * M_PI * 1000 * (i / 2) / 48000.0);
+		s32 v24 = (s32) (v * 8388607);
+		s24[3 * i + 0] = (u8) v24;
+		s24[3 * i + 1] = (u8) (v24 >> 8);
+		s24[3 * i + 2] = (u8) (v24 >> 16);
+		s32s[i] = (s32) (v * 2147483647.0);
+		s16s[i] = (s16) (v * 32767);
+	}
+
+	static const resampler_format formats[] = { RESAMPLER_S16, RESAMPLER_S24, RESAMPLER_S32 };
+	const void *inputs[] = { s16s, s24, s32s };
+	for (u32 i = 0; i < 3; ++i) {
+		resampler_config config = { formats[i], 2, 0, 48000, 44100, false };
+		u32 frames = Resample(&config, inputs[i], 48000, gOutput, 2000);
+		Check(fabs(Tone(gOutput, frames, 0, 1000, 44100) / 0.5 - 1) < 0.001);
+		Check(fabs(Tone(gOutput, frames, 1, 1000, 44100) / 0.5 - 1) < 0.001);
+	}
+
+	// stereo s16 at same rate passes through unchanged
+	resampler_config config = { RESAMPLER_S16, 2, 0, 48000, 48000, false };
+	u32 frames = Resample(&config, s16s, 48000, gOutput, 2000);
+	Check(frames == 48000 && !memcmp(gOutput, s16s, sizeof(s16s)));
+
+	Check(!ResamplerCreate(&(resampler) { 0 },
+						   &(resampler_config) { RESAMPLER_F32, 9, 0, 1, 1, false }));
+}
+
+#define TEST_VALUES (2 * 48000 * 4)
+
+static d64 TestSigned(void) {
+	return TestRandom() / 2147483648.0 - 1;
+}
+
+static void TestSeed(resampler_dither *d, f32 scale) {
+	for (u32 i = 0; i < 8; ++i) d->state[i] = 0x9E3779B9u * (i + 1);
+	d->lane = 0;
+	d->scale = scale;
+}
+
+// out of range values saturate, NaN is -32768, rest is within dither of exact value
+static void TestClipping(void) {
+	static const f32 values[] = {
+		1.0f, -1.0f, 1.5f, -1.5f, 100.0f, -100.0f, 1e30f, -1e30f, INFINITY, -INFINITY, NAN,
+		0.99999f, -0.99999f, 0.0f, 0.5f, -0.5f,
+	};
+	u32 count = sizeof(values) / sizeof(*values);
+	for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+		ResamplerSetLevel(level);
+		for (u32 i = 0; i < 64; ++i) gInput[i] = values[i % count];
+		resampler_dither d;
+		TestSeed(&d, 1.0f / 65536);
+		ResamplerConvert(gInput, gOutput, 64, &d);
+
+		for (u32 i = 0; i < 64; ++i) {
+			f32 v = values[i % count];
+			if (isnan(v)) Check(gOutput[i] == -32768);
+			else if (v >= 1.0f) Check(gOutput[i] == 32767);
+			else if (v < -1.0f) Check(gOutput[i] == -32768);
+			else Check(fabs(gOutput[i] - v * 32768.0) <= 1.0001);
+		}
+	}
+	ResamplerInit();
+}
+
+// every level gives same values however stream is split, dither generators stay in step
+static void TestConvertLevels(void) {
+	for (u32 i = 0; i < TEST_VALUES; ++i) gInput[i] = (f32) (TestSigned() * 1.2);
+	resampler_dither d;
+	ResamplerSetLevel(BOG_CPU_SCALAR);
+	TestSeed(&d, 1.0f / 65536);
+	ResamplerConvert(gInput, gOther, TEST_VALUES, &d);
+
+	for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+		ResamplerSetLevel(level);
+		TestSeed(&d, 1.0f / 65536);
+		ResamplerConvert(gInput, gOutput, TEST_VALUES, &d);
+		Check(!memcmp(gOutput, gOther, TEST_VALUES * sizeof(s16)));
+
+		TestSeed(&d, 1.0f / 65536);
+		for (u32 i = 0; i < TEST_VALUES;) {
+			u32 count = TestRandom() % 37;
+			if (count > TEST_VALUES - i) count = TEST_VALUES - i;
+			ResamplerConvert(gInput + i, gOutput + i, count, &d);
+			i += count;
+		}
+		Check(!memcmp(gOutput, gOther, TEST_VALUES * sizeof(s16)));
+	}
+	ResamplerInit();
+}
+
+// TPDF error is 1/12 + 1/6 LSB^2, 0.5 LSB rms, has no mean, is white & doesn't depend on signal,
+// so tone below 1 LSB still comes out, without dither it's gone
+static void TestDither(void) {
+	resampler_dither d;
+	for (u32 k = 0; k < 2; ++k) {
+		for (u32 i = 0; i < TEST_VALUES; ++i) {
+			gInput[i] = k ? (f32) (0.1 * sin(2 * M_PI * 997 * (i / 2) / 48000.0)) : 0;
+		}
+		TestSeed(&d, 1.0f / 65536);
+		ResamplerConvert(gInput, gOutput, TEST_VALUES, &d);
+
+		d64 power = 0, mean = 0;
+		for (u32 i = 0; i < TEST_VALUES; ++i) {
+			d64 error = gOutput[i] - gInput[i] * 32768.0;
+			power += error * error;
+			mean += error;
+		}
+		Check(fabs(sqrt(power / TEST_VALUES) - 0.5) < 0.01);
+		Check(fabs(mean / TEST_VALUES) < 0.01);
+	}
+
+	for (u32 dither = 0; dither < 2; ++dither) {
+		for (u32 i = 0; i < TEST_VALUES; ++i) {
+			gInput[i] = (f32) (0.3 / 32768 * sin(2 * M_PI * 1000 * (i / 2) / 48000.0));
+		}
+		TestSeed(&d, dither ? 1.0f / 65536 : 0);
+		ResamplerConvert(gInput, gOutput, TEST_VALUES, &d);
+		d64 amplitude = Tone(gOutput, TEST_VALUES / 2, 0, 1000, 48000) * 32768;
+
+		// difference of white noise has twice its power
+		d64 power = 0, difference = 0;
+		for (u32 i = 2; i < TEST_VALUES; i += 2) {
+			d64 x = gOutput[i] - gInput[i] * 32768.0;
+			d64 y = gOutput[i - 2] - gInput[i - 2] * 32768.0;
+			power += x * x;
+			difference += (x - y) * (x - y);
+		}
+		if (dither) {
+			Check(fabs(amplitude - 0.3) < 0.03);
+			Check(fabs(difference / power - 2) < 0.05);
+		} else {
+			Check(amplitude < 0.01);
+		}
+	}
+}
+
+// same rate float stereo is converted straight from input, s16 mono only gets copied
+static void TestDirect(void) {
+	resampler r;
+	Check(ResamplerCreate(&r, &(resampler_config) { RESAMPLER_F32, 2, 0, 48000, 48000, false }));
+	Check(r.direct);
+	for (u32 i = 0; i < 2 * 48000; ++i) gInput[i] = (f32) (TestSigned() / 2);
+	u32 frames = ResamplerProcess(&r, gInput, 48000, gOutput);
+	frames += ResamplerDrain(&r, gOutput + 2 * frames);
+	Check(frames == 48000);
+
+	resampler_dither d;
+	TestSeed(&d, 1.0f / 65536);
+	ResamplerConvert(gInput, gOther, 2 * 48000, &d);
+	Check(!memcmp(gOutput, gOther, 2 * 48000 * sizeof(s16)));
+	ResamplerDestroy(&r);
+
+	static s16 mono[48000];
+	for (u32 i = 0; i < 48000; ++i) mono[i] = (s16) TestRandom();
+	resampler_config config = { RESAMPLER_S16, 1, 0, 48000, 48000, false };
+	Check(Resample(&config, mono, 48000, gOutput, 480) == 48000);
+	for (u32 i = 0; i < 48000; ++i) {
+		Check(gOutput[2 * i] == mono[i] && gOutput[2 * i + 1] == mono[i]);
+	}
+}
+
+// variable resampler without ratio is fixed one, with ratio output frame n is at input n / ratio
+// & sine stays as clean as dither lets it, whether its step carries phases up or down
+static void TestVariable(void) {
+	static const u32 rates[] = { 44100, 48000 };
+	static const d64 ratios[] = { 1.001, 0.999 };
+	for (u32 i = 0; i < 2; ++i) {
+		resampler_config fixed = { RESAMPLER_F32, 2, 0, rates[i], 48000, false };
+		resampler_config config = fixed;
+		config.variable = true;
+		for (u32 k = 0; k < rates[i]; ++k) {
+			gInput[2 * k] = gInput[2 * k + 1] = (f32) (0.5 * sin(2 * M_PI * 1000 * k / rates[i]));
+		}
+		u32 whole = Resample(&fixed, gInput, rates[i], gOther, 100000);
+		u32 frames = Resample(&config, gInput, rates[i], gOutput, 700);
+		Check(frames >= whole && frames <= whole + 1);
+		if (rates[i] != 48000) Check(!memcmp(gOutput, gOther, (udm) whole * 2 * sizeof(s16)));
+
+		for (u32 j = 0; j < 2; ++j) {
+			resampler r;
+			Check(ResamplerCreate(&r, &config));
+			ResamplerSetRatio(&r, ratios[j]);
+			frames = 0;
+			u32 packet = rates[i] / 100;
+			for (u32 k = 0; k < rates[i]; k += packet) {
+				frames += ResamplerProcess(&r, gInput + 2 * k, packet, gOutput + 2 * frames);
+			}
+			frames += ResamplerDrain(&r, gOutput + 2 * frames);
+			ResamplerDestroy(&r);
+			// last one is at last input frame
+			d64 expected = 48000 * ratios[j] + 1;
+			Check(fabs(frames - expected) < 1.5);
+
+			// against ideal sine, away from filter warm up & drain
+			d64 error = 0, power = 0;
+			for (u32 k = 4800; k < frames - 4800; ++k) {
+				d64 ideal = 0.5 * sin(2 * M_PI * 1000 * k / (48000 * ratios[j]));
+				d64 value = gOutput[2 * k] / 32768.0;
+				error += (value - ideal) * (value - ideal);
+				power += ideal * ideal;
+			}
+			Check(Decibels(sqrt(error / power)) < -84);
+		}
+	}
+}
+
+// plain loop encoder would have without kernel, rounds without dither
+static void BenchScalar(const f32 *src, s16 *dst, u32 count) {
+	for (u32 i = 0; i < count; ++i) {
+		f32 v = src[i] * 32768.0f;
+		v = v < -32768.0f ? -32768.0f : v > 32767.0f ? 32767.0f : v;
+		dst[i] = (s16) (s32) (v < 0 ? v - 0.5f : v + 0.5f);
+	}
+}
+
+static void BenchConvert(void) {
+	for (u32 i = 0; i < TEST_VALUES; ++i) gInput[i] = (f32) (TestSigned() * 0.9);
+	d64 seconds = TEST_VALUES / 2 / 48000.0;
+	u32 repeat = 20;
+
+	d64 start = TestSeconds();
+	for (u32 k = 0; k < repeat; ++k) BenchScalar(gInput, gOutput, TEST_VALUES);
+	d64 scalar = (TestSeconds() - start) / repeat;
+	printf("f32 to s16 plain loop without dither: %.0fx realtime, %.2f nsec per value\n",
+		   seconds / scalar, scalar * 1e9 / TEST_VALUES);
+
+	for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+		ResamplerSetLevel(level);
+		resampler_dither d;
+		TestSeed(&d, 1.0f / 65536);
+		start = TestSeconds();
+		for (u32 k = 0; k < repeat; ++k) ResamplerConvert(gInput, gOutput, TEST_VALUES, &d);
+		d64 elapsed = (TestSeconds() - start) / repeat;
+		printf("f32 to s16 level %u with dither: %.0fx realtime, %.2f nsec per value, %.1fx plain "
+			   "loop\n", level, seconds / elapsed, elapsed * 1e9 / TEST_VALUES, scalar / elapsed);
+	}
+	ResamplerInit();
+}
+
+static void Bench(void) {
+	for (u32 i = 0; i < sizeof(gRates) / sizeof(*gRates); ++i) {
+		quality q = Measure(gRates[i][0], gRates[i][1]);
+		printf("resampler %6u -> %u: passband ripple %.4f dB, ", gRates[i][0], gRates[i][1],
+			   q.ripple);
+		if (q.aliasInput) {
+			printf("worst alias %.1f dB from %.0f Hz\n", q.alias, q.aliasInput);
+		} else {
+			printf("no alias lands in passband\n");
+		}
+	}
+
+	static const u32 rates[] = { 44100, 96000, 48000 };
+	for (u32 i = 0; i < 2 * 96000; ++i) gInput[i] = (f32) ((TestRandom() % 2000) / 2000.0 - 0.5);
+	for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+		ResamplerSetLevel(level);
+		for (u32 k = 0; k < 4; ++k) {
+			// 10 msec packets like capture gives, last one is 7.1 downmix at same rate
+			u32 channels = k < 3 ? 2 : 8;
+			u32 rate = k < 3 ? rates[k] : 48000;
+			resampler r;
+			resampler_config config = { RESAMPLER_F32, channels, 0, rate, 48000, false };
+			ResamplerCreate(&r, &config);
+			u32 seconds = 20, packet = rate / 100;
+			d64 start = TestSeconds();
+			for (u32 s = 0; s < seconds; ++s) {
+				for (u32 p = 0; p < 100; ++p) {
+					u32 offset = (p * packet * channels) % (2 * 96000 - packet * channels);
+					ResamplerProcess(&r, gInput + offset, packet, gOutput);
+				}
+			}
+			d64 elapsed = TestSeconds() - start;
+			printf("resampler level %u %6u -> 48000 %s: %.0fx realtime\n", level, rate,
+				   channels == 2 ? "stereo" : "7.1   ", seconds / elapsed);
+			ResamplerDestroy(&r);
+		}
+	}
+	ResamplerInit();
+}
+
+int main(int argc, char **argv) {
+	ResamplerInit();
+	TestQuality();
+	TestStreaming();
+	TestDelay();
+	TestDownmix();
+	TestFormats();
+	TestClipping();
+	TestConvertLevels();
+	TestDither();
+	TestDirect();
+	TestVariable();
+	if (TestBench(argc, argv)) {
+		Bench();
+		BenchConvert();
+	}
+	return TestResult("resampler");
+}
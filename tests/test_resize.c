@@ -0,0 +1,351 @@
+#include "convert.c"
+#include "resize.c"
+#include "test.h"
+
+#include <math.h>
+
+// Mitchell-Netravali resize done in doubles straight from filter, fixed point tables may be off
+// by rounding only
+static void ReferenceResize(const u8 *src, u32 inWidth, u32 inHeight, u8 *dst, u32 outWidth,
+							u32 outHeight) {
+	d64 scaleX = (d64) outWidth / inWidth, scaleY = (d64) outHeight / inHeight;
+	d64 filterX = scaleX < 1 ? scaleX : 1, filterY = scaleY < 1 ? scaleY : 1;
+
+	for (u32 y = 0; y < outHeight; ++y) {
+		for (u32 x = 0; x < outWidth; ++x) {
+			d64 centerX, centerY;
+			s32 x0, x1, y0, y1;
+			ResizeWindow(inWidth, outWidth, x, &centerX, &x0, &x1);
+			ResizeWindow(inHeight, outHeight, y, &centerY, &y0, &y1);
+
+			d64 sumX = 0, sumY = 0;
+			for (s32 i = x0; i <= x1; ++i) sumX += ResizeFilter((centerX - i - 0.5) * filterX);
+			for (s32 j = y0; j <= y1; ++j) sumY += ResizeFilter((centerY - j - 0.5) * filterY);
+
+			d64 acc[4] = { 0 };
+			for (s32 j = y0; j <= y1; ++j) {
+				d64 wy = ResizeFilter((centerY - j - 0.5) * filterY) / sumY;
+				for (s32 i = x0; i <= x1; ++i) {
+					d64 w = wy * ResizeFilter((centerX - i - 0.5) * filterX) / sumX;
+					for (u32 c = 0; c < 4; ++c) acc[c] += w * src[((udm) j * inWidth + i) * 4 + c];
+				}
+			}
+
+			for (u32 c = 0; c < 4; ++c) {
+				d64 v = acc[c] < 0 ? 0 : acc[c] > 255 ? 255 : acc[c];
+				dst[((udm) y * outWidth + x) * 4 + c] = (u8) floor(v + 0.5);
+			}
+		}
+	}
+}
+
+static void TestTables(void) {
+	static const u32 sizes[][2] = { { 64, 32 }, { 100, 37 }, { 37, 100 }, { 1920, 1280 },
+									{ 33, 5 }, { 7, 7 } };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		resizer r;
+		Check(ResizeCreate(&r, sizes[i][0], 4, sizes[i][1], 4, 1));
+
+		// every output sample has weights summing to exactly one & reads inside of image
+		resize_table *t = &r.horizontal;
+		for (u32 x = 0; x < t->outSize; ++x) {
+			s32 sum = 0;
+			for (u32 k = 0; k < t->taps; ++k) sum += t->weights[x * t->taps + k];
+			Check(sum == 1 << RESIZE_WEIGHT_BITS);
+			Check(t->start[x] + t->taps <= t->inSize);
+		}
+
+		ResizeDestroy(&r);
+	}
+}
+
+static void TestImages(void) {
+	// sizes are not exact 2:1 or 4:1 multiples, those use box filter
+	static const u32 sizes[][4] = { { 64, 48, 40, 30 }, { 100, 80, 37, 29 }, { 200, 100, 200, 100 },
+									{ 50, 40, 120, 90 }, { 2560, 1440, 1920, 1080 },
+									{ 33, 17, 5, 3 } };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		u32 inWidth = sizes[i][0], inHeight = sizes[i][1];
+		u32 outWidth = sizes[i][2], outHeight = sizes[i][3];
+		udm inSize = (udm) inWidth * inHeight * 4, outSize = (udm) outWidth * outHeight * 4;
+
+		// smooth gradient for odd cases, noise for even ones
+		u8 *src = malloc(inSize);
+		for (udm p = 0; p < inSize; ++p) {
+			udm x = p / 4 % inWidth, y = p / 4 / inWidth;
+			src[p] = (i & 1) ? (u8) (x * 3 + y * 5 + p % 4 * 40) : (u8) TestRandom();
+		}
+
+		u8 *expected = malloc(outSize);
+		u8 *scalar = malloc(outSize);
+		u8 *actual = malloc(outSize);
+		ReferenceResize(src, inWidth, inHeight, expected, outWidth, outHeight);
+
+		resizer r;
+		ResizeSetLevel(BOG_CPU_SCALAR);
+		Check(ResizeCreate(&r, inWidth, inHeight, outWidth, outHeight, 1));
+		ResizeImage(&r, src, inWidth * 4, scalar, outWidth * 4);
+		ResizeDestroy(&r);
+
+		s32 error = 0;
+		for (udm p = 0; p < outSize; ++p) {
+			s32 d = abs(scalar[p] - expected[p]);
+			if (d > error) error = d;
+		}
+		Check(error <= 1);
+
+		for (bog_cpu_level level = BOG_CPU_SSE2; level <= BOGCpuLevel(); ++level) {
+			ResizeSetLevel(level);
+			Check(ResizeCreate(&r, inWidth, inHeight, outWidth, outHeight, 1));
+			memset(actual, 0, outSize);
+			ResizeImage(&r, src, inWidth * 4, actual, outWidth * 4);
+			Check(!memcmp(scalar, actual, outSize));
+			ResizeDestroy(&r);
+		}
+
+		free(src);
+		free(expected);
+		free(scalar);
+		free(actual);
+	}
+}
+
+// flat image stays flat, weights sum to one with any overshoot of filter
+static void TestFlat(void) {
+	u32 inWidth = 97, inHeight = 61, outWidth = 43, outHeight = 29;
+	u8 *src = malloc((udm) inWidth * inHeight * 4);
+	u8 *dst = malloc((udm) outWidth * outHeight * 4);
+	memset(src, 200, (udm) inWidth * inHeight * 4);
+
+	resizer r;
+	ResizeInit();
+	Check(ResizeCreate(&r, inWidth, inHeight, outWidth, outHeight, 1));
+	ResizeImage(&r, src, inWidth * 4, dst, outWidth * 4);
+	for (udm p = 0; p < (udm) outWidth * outHeight * 4; ++p) Check(dst[p] == 200);
+	ResizeDestroy(&r);
+
+	free(src);
+	free(dst);
+}
+
+// exact 2:1 & 4:1 downscales are rounded averages of blocks at every level
+static void TestBox(void) {
+	static const u32 sizes[][3] = { { 64, 48, 2 }, { 3840, 2160, 2 }, { 3840, 2160, 4 },
+									{ 36, 20, 4 }, { 1926, 1082, 2 } };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		u32 factor = sizes[i][2];
+		u32 inWidth = sizes[i][0], inHeight = sizes[i][1];
+		u32 outWidth = inWidth / factor, outHeight = inHeight / factor;
+		udm stride = inWidth * 4 + 16;
+		udm outSize = (udm) outWidth * outHeight * 4;
+		u8 *src = malloc(stride * inHeight);
+		u8 *dst = malloc(outSize);
+		TestFill(src, stride * inHeight);
+
+		for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+			resizer r;
+			ResizeSetLevel(level);
+			Check(ResizeCreate(&r, inWidth, inHeight, outWidth, outHeight, 1));
+			Check(r.box == factor);
+			ResizeImage(&r, src, stride, dst, outWidth * 4);
+			ResizeDestroy(&r);
+
+			u32 area = factor * factor, mismatches = 0;
+			for (u32 y = 0; y < outHeight; ++y) {
+				for (u32 x = 0; x < outWidth * 4; ++x) {
+					u32 sum = 0;
+					for (u32 k = 0; k < area; ++k) {
+						sum += src[(y * factor + k / factor) * stride +
+								   (x / 4 * factor + k % factor) * 4 + x % 4];
+					}
+					if (dst[(udm) y * outWidth * 4 + x] != (sum + area / 2) / area) mismatches++;
+				}
+			}
+			Check(!mismatches);
+		}
+
+		free(src);
+		free(dst);
+	}
+
+	// almost exact ratio is not box
+	resizer r;
+	Check(ResizeCreate(&r, 1921, 1080, 960, 540, 1));
+	Check(!r.box);
+	ResizeDestroy(&r);
+}
+
+// resize & conversion in one pass give same bytes as resizing whole image & converting it after,
+// source is crop of larger image & bands of output rows can be done by different scratch
+static void TestFused(const convert_fixed *f) {
+	static const u32 sizes[][6] = { { 37, 22, 1500, 900, 1280, 720 }, { 1, 3, 333, 97, 101, 61 },
+									{ 0, 0, 640, 360, 1001, 563 }, { 10, 10, 64, 48, 32, 24 } };
+	u32 imageWidth = 2000, imageHeight = 1200;
+	udm imageStride = imageWidth * 4;
+	u8 *image = malloc(imageStride * imageHeight);
+	TestFill(image, imageStride * imageHeight);
+
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		u32 cropX = sizes[i][0], cropY = sizes[i][1];
+		u32 inWidth = sizes[i][2], inHeight = sizes[i][3];
+		u32 outWidth = sizes[i][4], outHeight = sizes[i][5];
+		u32 nv12Width = (outWidth + 1) & ~1, nv12Height = (outHeight + 1) & ~1;
+		udm size = (udm) nv12Width * nv12Height * 3 / 2;
+		const u8 *src = image + cropY * imageStride + cropX * 4;
+
+		resizer r;
+		Check(ResizeCreate(&r, inWidth, inHeight, outWidth, outHeight, 3));
+
+		u8 *resized = malloc((udm) outWidth * outHeight * 4);
+		u8 *expected = calloc(size, 1);
+		u8 *actual = calloc(size, 1);
+		ResizeImage(&r, src, imageStride, resized, outWidth * 4);
+		ConvertToNV12(f, resized, outWidth * 4, outWidth, outHeight, expected, nv12Width,
+					  expected + nv12Width * nv12Height, nv12Width);
+
+		ResizeToNV12(&r, f, src, imageStride, actual, nv12Width,
+					 actual + nv12Width * nv12Height, nv12Width);
+		Check(!memcmp(expected, actual, size));
+
+		// three bands, split at even rows
+		memset(actual, 0, size);
+		u32 split0 = (outHeight / 3) & ~1, split1 = (outHeight * 2 / 3) & ~1;
+		u32 bands[4] = { 0, split0, split1, outHeight };
+		for (u32 b = 0; b < 3; ++b) {
+			ResizeToNV12Rows(&r, b, f, src, imageStride, bands[b], bands[b + 1], actual,
+							 nv12Width, actual + nv12Width * nv12Height, nv12Width);
+		}
+		Check(!memcmp(expected, actual, size));
+
+		ResizeDestroy(&r);
+		free(resized);
+		free(expected);
+		free(actual);
+	}
+
+	free(image);
+}
+
+static void Bench(void) {
+	static const u32 sizes[][4] = { { 3840, 2160, 2560, 1440 }, { 2560, 1440, 1920, 1080 },
+									{ 3840, 2160, 1366, 768 } };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		u32 inWidth = sizes[i][0], inHeight = sizes[i][1];
+		u32 outWidth = sizes[i][2], outHeight = sizes[i][3];
+		u8 *src = malloc((udm) inWidth * inHeight * 4);
+		u8 *dst = malloc((udm) outWidth * outHeight * 4);
+		TestFill(src, (udm) inWidth * inHeight * 4);
+
+		for (bog_cpu_level level = BOG_CPU_SCALAR; level <= BOGCpuLevel(); ++level) {
+			resizer r;
+			ResizeSetLevel(level);
+			ResizeCreate(&r, inWidth, inHeight, outWidth, outHeight, 1);
+
+			u32 count = 5;
+			d64 start = TestSeconds();
+			for (u32 n = 0; n < count; ++n) ResizeImage(&r, src, inWidth * 4, dst, outWidth * 4);
+			d64 seconds = (TestSeconds() - start) / count;
+			printf("resize %ux%u to %ux%u level %d: %.2f ms, %u x %u taps\n", inWidth, inHeight,
+				   outWidth, outHeight, level, seconds * 1e3, r.horizontal.taps, r.vertical.taps);
+
+			ResizeDestroy(&r);
+		}
+
+		free(src);
+		free(dst);
+	}
+}
+
+// fused pass against resize followed by conversion, resized image doesn't fit in cache
+static void BenchFused(const convert_fixed *f) {
+	u32 inWidth = 3840, inHeight = 2160, outWidth = 2560, outHeight = 1440;
+	u8 *src = malloc((udm) inWidth * inHeight * 4);
+	u8 *resized = malloc((udm) outWidth * outHeight * 4);
+	u8 *dst = malloc((udm) outWidth * outHeight * 3 / 2);
+	TestFill(src, (udm) inWidth * inHeight * 4);
+
+	resizer r;
+	ResizeCreate(&r, inWidth, inHeight, outWidth, outHeight, 1);
+
+	u32 count = 5;
+	d64 start = TestSeconds();
+	for (u32 n = 0; n < count; ++n) {
+		ResizeImage(&r, src, inWidth * 4, resized, outWidth * 4);
+		ConvertToNV12(f, resized, outWidth * 4, outWidth, outHeight, dst, outWidth,
+					  dst + outWidth * outHeight, outWidth);
+	}
+	d64 separate = (TestSeconds() - start) / count;
+
+	start = TestSeconds();
+	for (u32 n = 0; n < count; ++n) {
+		ResizeToNV12(&r, f, src, inWidth * 4, dst, outWidth, dst + outWidth * outHeight,
+					 outWidth);
+	}
+	d64 fused = (TestSeconds() - start) / count;
+
+	printf("resize 4K to 1440p NV12: fused %.2f ms, resize then convert %.2f ms\n",
+		   fused * 1e3, separate * 1e3);
+
+	ResizeDestroy(&r);
+	free(src);
+	free(resized);
+	free(dst);
+}
+
+// box filter against Mitchell-Netravali table of same ratio
+static void BenchBox(const convert_fixed *f) {
+	static const u32 sizes[][4] = { { 3840, 2160, 1920, 1080 }, { 3840, 2160, 960, 540 },
+									{ 5120, 2880, 2560, 1440 } };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+		u32 inWidth = sizes[i][0], inHeight = sizes[i][1];
+		u32 outWidth = sizes[i][2], outHeight = sizes[i][3];
+		u8 *src = malloc((udm) inWidth * inHeight * 4);
+		u8 *dst = malloc((udm) outWidth * outHeight * 3 / 2);
+		TestFill(src, (udm) inWidth * inHeight * 4);
+
+		resizer r;
+		ResizeInit();
+		ResizeCreate(&r, inWidth, inHeight, outWidth, outHeight, 1);
+
+		d64 times[2];
+		u32 box = r.box;
+		for (u32 pass = 0; pass < 2; ++pass) {
+			r.box = pass ? 0 : box;
+			u32 count = 10;
+			d64 start = TestSeconds();
+			for (u32 n = 0; n < count; ++n) {
+				ResizeToNV12(&r, f, src, inWidth * 4, dst, outWidth, dst + outWidth * outHeight,
+							 outWidth);
+			}
+			times[pass] = (TestSeconds() - start) / count;
+		}
+		printf("resize %ux%u to %ux%u NV12: box %.2f ms, filter %.2f ms\n", inWidth, inHeight,
+			   outWidth, outHeight, times[0] * 1e3, times[1] * 1e3);
+
+		ResizeDestroy(&r);
+		free(src);
+		free(dst);
+	}
+}
+
+int main(int argc, char **argv) {
+	convert_matrix m;
+	convert_fixed f;
+	ConvertInit();
+	ConvertMatrixFor(&m, CONVERT_BT709, false, CONVERT_INPUT_BGRA8, CONVERT_OUTPUT_NV12);
+	ConvertFixedFromMatrix(&f, &m);
+
+	TestTables();
+	TestImages();
+	TestFlat();
+	TestBox();
+	TestFused(&f);
+
+	if (TestBench(argc, argv)) {
+		Bench();
+		BenchFused(&f);
+		BenchBox(&f);
+	}
+
+	return TestResult("resize");
+}
@@ -0,0 +1,220 @@
+#include "mp4.c"
+#include "output.c"
+#include "segment.c"
+#include "test_mp4.h"
+
+#include <unistd.h>
+
+typedef struct {
+	u32 track;
+	u64 decodeTime;
+	s32 offset;
+	bool sync;
+	u32 tag;      // unique number written into sample data
+} expected_sample;
+
+static expected_sample gExpected[200000];
+static u32 gExpectedCount;
+
+static bool TestName(void *user, u32 index, output_path *path, u32 count) {
+	snprintf(path, count, "output/tests/segment-%s-%03u.mp4", (const char *) user, index);
+	return true;
+}
+
+// tag is in first 4 bytes of audio frames & right after header of slice NAL unit in video
+static u32 SampleTag(const test_mp4_sample *s) {
+	u32 tag = 0;
+	const u8 *p = s->data, *end = s->data + s->size;
+	if (s->track == 1) {
+		memcpy(&tag, p, 4);
+		return tag;
+	}
+	while (p + 5 <= end) {
+		u32 type = p[4] & 0x1F;
+		if (type == 1 || type == 5) {
+			memcpy(&tag, p + 5, 4);
+			break;
+		}
+		p += 4 + TestRead32(p);
+	}
+	return tag;
+}
+
+static void WriteSamples(segmenter *s, u32 seconds) {
+	static const u8 config[] = { 0, 0, 0, 1, 0x67, 0x42, 0, 0x1F, 0xAB, 0xCD,
+								 0, 0, 0, 1, 0x68, 0xCE, 0x3C, 0x80 };
+	static u8 data[1 << 17];
+	u64 videoTime = 0, audioTime = 0;
+	u32 frame = 0, tag = 0;
+	gExpectedCount = 0;
+
+	while (videoTime < 90000ULL * seconds) {
+		// audio arrives 250 ms after video, so file being closed keeps taking it
+		while ((audioTime + 12000) * 90000 / 48000 <= videoTime) {
+			u32 size = 100 + TestRandom() % 2000;
+			tag++;
+			TestFill(data, size);
+			memcpy(data, &tag, 4);
+			gExpected[gExpectedCount++] = (expected_sample) { 1, audioTime, 0, true, tag };
+			Check(SegmentWriteSample(s, 1, data, size, audioTime, audioTime, true));
+			audioTime += 4608;
+		}
+
+		bool idr = frame % 120 == 0;
+		u32 size = 0;
+		if (idr) {
+			memcpy(data, config, sizeof(config));
+			size = sizeof(config);
+		}
+		static const u8 slice[] = { 0, 0, 0, 1 };
+		memcpy(data + size, slice, 4);
+		data[size + 4] = idr ? 0x65 : 0x41;
+		size += 5;
+
+		// tag & payload have no zero bytes, so they can't form start code
+		tag++;
+		u32 sliceTag = tag | 0x80808080;
+		memcpy(data + size, &sliceTag, 4);
+		size += 4;
+		u32 payload = (idr ? 40000 : 2000) + TestRandom() % 8000;
+		for (u32 i = 0; i < payload; ++i) data[size++] = (u8) (1 + TestRandom() % 255);
+
+		s32 offset = frame % 3 == 1 ? 6000 : 3000;
+		gExpected[gExpectedCount++] = (expected_sample) { 0, videoTime, offset, idr, sliceTag };
+		Check(SegmentWriteSample(s, 0, data, size, videoTime, videoTime + offset, idr));
+
+		videoTime += TestRandom() % 10 == 0 ? 9000 : 3000;
+		frame++;
+	}
+}
+
+// every sample is in exactly one file, in order, with its timestamps moved by origin of file,
+// every file starts with IDR frame at 0 & tracks continue in next file where they ended
+static void TestSplit(const char *name, u32 duration, u64 size, u32 seconds) {
+	static test_mp4_sample samples[200000];
+	u8 streaminfo[34] = { 0x10, 0x00, 0x10, 0x00 };
+	mp4_track_config tracks[2] = {
+		{ .codec = MP4_CODEC_H264, .timescale = 90000, .width = 1280, .height = 720,
+		  .bufferSize = 4 << 20 },
+		{ .codec = MP4_CODEC_FLAC, .timescale = 48000, .channels = 2, .sampleRate = 48000,
+		  .config = streaminfo, .configSize = sizeof(streaminfo), .bufferSize = 1 << 20 },
+	};
+	segment_config config = { .duration = duration, .size = size, .fragmentDuration = 1000,
+							  .output = { .bufferSize = 256 << 10, .bufferCount = 64 },
+							  .name = TestName, .user = (void *) name };
+	segmenter s;
+	Check(SegmentStart(&s, tracks, 2, &config));
+	WriteSamples(&s, seconds);
+	Check(SegmentStop(&s));
+
+	u32 next[2] = { 0, 0 }, matched = 0, files = 0;
+	u64 end[2] = { 0, 0 };
+	for (;; ++files) {
+		char path[SEGMENT_MAX_PATH];
+		test_buffer file;
+		TestName((void *) name, files, path, sizeof(path));
+		if (!TestReadFile(path, &file)) break;
+		unlink(path);
+
+		u32 fragments;
+		s32 count = TestReadMp4(file.data, file.size, samples, 200000, &fragments);
+		Check(count > 0);
+		if (size) Check(file.size < size + (1 << 20));
+
+		u64 origin[2] = { 0, 0 };
+		bool first[2] = { true, true };
+		u64 firstVideo = 0, lastVideo = 0;
+		for (s32 i = 0; i < count; ++i) {
+			test_mp4_sample *got = &samples[i];
+			u32 track = got->track, k = next[track];
+			while (k < gExpectedCount && gExpected[k].track != track) ++k;
+			if (k == gExpectedCount) {
+				Check(!"sample that was not written");
+				break;
+			}
+			next[track] = k + 1;
+
+			expected_sample *e = &gExpected[k];
+			Check(SampleTag(got) == e->tag);
+			Check(got->offset == e->offset && got->sync == e->sync);
+			if (first[track]) {
+				first[track] = false;
+				origin[track] = e->decodeTime - got->decodeTime;
+				if (track == 0) Check(got->decodeTime == 0 && got->sync);
+				Check(e->decodeTime == end[track]);
+			}
+			Check(got->decodeTime + origin[track] == e->decodeTime);
+			end[track] = e->decodeTime + got->duration;
+			if (track == 0) lastVideo = e->decodeTime;
+			if (track == 0 && got->decodeTime == 0) firstVideo = e->decodeTime;
+			matched++;
+		}
+
+		// split waits for IDR frame after limit, they come every 120 frames, about 5 seconds
+		if (duration) Check(lastVideo - firstVideo < (duration / 1000 + 6) * 90000ULL);
+		free(file.data);
+	}
+
+	Check(files >= 2);
+	Check(matched == gExpectedCount);
+}
+
+// 10 minutes at 60 fps split every 30 seconds, time of every write call, so splits show up in
+// maximum
+static void Bench(void) {
+	static u8 video[4000], audio[4000];
+	TestFill(video, sizeof(video));
+	TestFill(audio, sizeof(audio));
+	video[0] = video[1] = video[2] = 0;
+	video[3] = 1;
+
+	u8 streaminfo[34] = { 0x10, 0x00, 0x10, 0x00 };
+	u8 sps[] = { 0, 0, 0, 1, 0x67, 0x42, 0, 0x1F, 0xAB, 0xCD, 0, 0, 0, 1, 0x68, 0xCE, 0x3C, 0x80 };
+	mp4_track_config tracks[2] = {
+		{ .codec = MP4_CODEC_H264, .timescale = 90000, .width = 1920, .height = 1080,
+		  .config = sps, .configSize = sizeof(sps) },
+		{ .codec = MP4_CODEC_FLAC, .timescale = 48000, .channels = 2, .sampleRate = 48000,
+		  .config = streaminfo, .configSize = sizeof(streaminfo) },
+	};
+	segment_config config = { .duration = 30000, .fragmentDuration = 1000,
+							  .output = { .bufferSize = 1 << 20, .bufferCount = 16,
+										  .wait = true },
+							  .name = TestName, .user = "bench" };
+	segmenter s;
+	SegmentStart(&s, tracks, 2, &config);
+
+	d64 slowest = 0, start = TestSeconds();
+	u64 audioTime = 0;
+	for (u32 frame = 0; frame < 60 * 600; ++frame) {
+		while (audioTime * 60 / 48000 <= frame) {
+			SegmentWriteSample(&s, 1, audio, sizeof(audio), audioTime, audioTime, true);
+			audioTime += 4608;
+		}
+		bool idr = frame % 120 == 0;
+		video[4] = idr ? 0x65 : 0x41;
+		d64 time = TestSeconds();
+		SegmentWriteSample(&s, 0, video, sizeof(video), frame * 1500ULL, frame * 1500ULL, idr);
+		time = TestSeconds() - time;
+		if (time > slowest) slowest = time;
+	}
+	Check(SegmentStop(&s));
+
+	d64 seconds = TestSeconds() - start;
+	printf("segment 10 minutes at 60 fps in %u files: %.0f ms, %.2f us/frame, slowest frame "
+		   "%.0f us\n", s.index + 1, seconds * 1000, seconds * 1e6 / (60 * 600), slowest * 1e6);
+
+	for (u32 i = 0; i <= s.index; ++i) {
+		char path[SEGMENT_MAX_PATH];
+		TestName("bench", i, path, sizeof(path));
+		unlink(path);
+	}
+}
+
+int main(int argc, char **argv) {
+	TestSplit("time", 10000, 0, 45);
+	TestSplit("size", 0, 3 << 20, 45);
+
+	if (TestBench(argc, argv)) Bench();
+
+	return TestResult("segment");
+}
@@ -0,0 +1,198 @@
+// gcc takes __int128 path, portable 64 bit halves & division are what other compilers get, so
+// timebase.c goes in twice, second copy renamed & without __int128, which stays for reference
+#include "timebase.c"
+
+#undef __SIZEOF_INT128__
+#define TimeRate PortableRate
+#define TimeDivide128 PortableDivide128
+#define TimeMulDiv PortableMulDiv
+#define TimeConvert PortableConvert
+#define TimeClockSystemRead PortableClockSystemRead
+#define TimeClockSystem PortableClockSystem
+#define TimeClockNow PortableClockNow
+#define TimeFrameStart PortableFrameStart
+#define TimeFrameNext PortableFrameNext
+#define TimeFrameAt PortableFrameAt
+#include "timebase.c"
+#undef TimeRate
+#undef TimeDivide128
+#undef TimeMulDiv
+#undef TimeConvert
+#undef TimeClockSystemRead
+#undef TimeClockSystem
+#undef TimeClockNow
+#undef TimeFrameStart
+#undef TimeFrameNext
+#undef TimeFrameAt
+
+#include "test.h"
+
+typedef u64 mul_div(u64 value, u64 mul, u64 div, time_round round);
+
+static u64 TestRandom64(void) {
+	u64 hi = TestRandom();
+	return hi << 32 | TestRandom();
+}
+
+static u64 ReferenceMulDiv(u64 value, u64 mul, u64 div, time_round round) {
+	unsigned __int128 product = (unsigned __int128) value * mul;
+	if (product / div > UINT64_MAX) return UINT64_MAX;
+	u64 quotient = (u64) (product / div);
+	u64 remainder = (u64) (product % div);
+	bool up = round == TIME_CEIL ? remainder != 0 :
+			  round == TIME_NEAREST ? (unsigned __int128) remainder * 2 >= div : false;
+	return up && quotient != UINT64_MAX ? quotient + 1 : quotient;
+}
+
+// random magnitudes, so products land below, around & above 64 bits & results saturate
+static void TestMulDiv(mul_div *f) {
+	for (u32 i = 0; i < 1000000; ++i) {
+		u64 value = TestRandom64() >> (TestRandom() % 64);
+		u64 mul = TestRandom64() >> (TestRandom() % 64);
+		u64 div = (TestRandom64() >> (TestRandom() % 64)) | 1;
+		for (u32 round = TIME_FLOOR; round <= TIME_CEIL; ++round) {
+			Check(f(value, mul, div, round) == ReferenceMulDiv(value, mul, div, round));
+		}
+	}
+
+	Check(f(1, 1, 0, TIME_FLOOR) == UINT64_MAX);
+	Check(f(UINT64_MAX, UINT64_MAX, UINT64_MAX, TIME_FLOOR) == UINT64_MAX);
+	Check(f(UINT64_MAX, 2, 2, TIME_CEIL) == UINT64_MAX);
+	Check(f(5, 1, 2, TIME_FLOOR) == 2);
+	Check(f(5, 1, 2, TIME_NEAREST) == 3);
+	Check(f(5, 1, 2, TIME_CEIL) == 3);
+	Check(f(4, 1, 3, TIME_NEAREST) == 1);
+}
+
+static void TestConvert(void) {
+
+	Check(TimeConvert(1, TIME_RATE_SECOND, TIME_RATE_MF, TIME_FLOOR) == 10000000);
+	Check(TimeConvert(1, TimeRate(60000, 1001), TIME_RATE_MF, TIME_FLOOR) == 166833);
+	Check(TimeConvert(1, TimeRate(60000, 1001), TIME_RATE_MF, TIME_CEIL) == 166834);
+	Check(TimeConvert(166834, TIME_RATE_MF, TimeRate(60000, 1001), TIME_FLOOR) == 1);
+}
+
+static const time_rate gFrameRates[] = { { 60000, 1001 }, { 60, 1 }, { 144, 1 }, { 30, 1 } };
+static const char *gFrameNames[] = { "59.94", "60", "144", "30" };
+static const time_rate gTickRates[] = { { 10000000, 1 }, { 1000000000, 1 }, { 48000, 1 } };
+static const char *gTickNames[] = { "100 nsec", "nsec", "48 kHz" };
+
+#define TEST_RATES (sizeof(gFrameRates) / sizeof(*gFrameRates))
+#define TEST_UNITS (sizeof(gTickRates) / sizeof(*gTickRates))
+
+typedef struct {
+	u64 frames;
+	u64 end, exact;
+	u64 minStep, maxStep;
+	s64 naiveDrift;    // where adding rounded frame duration gets to instead
+	d64 seconds;
+} steps;
+
+// steps through seconds of frames, end has to be exact frame count after start
+static steps Step(time_rate frames, time_rate ticks, u64 seconds) {
+	steps s = { 0 };
+	s.frames = TimeConvert(seconds, TIME_RATE_SECOND, frames, TIME_FLOOR);
+	s.minStep = UINT64_MAX;
+	u64 naiveStep = TimeConvert(1, frames, ticks, TIME_NEAREST);
+
+	time_frame_clock fc;
+	TimeFrameStart(&fc, frames, ticks);
+	u64 sum = 0;
+	d64 start = TestSeconds();
+	for (u64 i = 0; i < s.frames; ++i) {
+		u64 step = TimeFrameNext(&fc);
+		sum += step;
+		if (step < s.minStep) s.minStep = step;
+		if (step > s.maxStep) s.maxStep = step;
+		if (!(i & 0xFFFF)) Check(fc.time == TimeFrameAt(&fc, fc.index));
+	}
+	s.seconds = TestSeconds() - start;
+
+	s.end = fc.time;
+	s.exact = ReferenceMulDiv(s.frames, ticks.num * frames.den, ticks.den * frames.num,
+							  TIME_FLOOR);
+	s.naiveDrift = (s64) (naiveStep * s.frames - s.exact);
+	Check(fc.index == s.frames);
+	Check(sum == s.end);
+	Check(s.end == TimeFrameAt(&fc, s.frames));
+	return s;
+}
+
+// frame times never drift & steps differ by one tick at most
+static void TestFrameClock(void) {
+	for (u32 r = 0; r < TEST_RATES; ++r) {
+		for (u32 u = 0; u < TEST_UNITS; ++u) {
+			steps s = Step(gFrameRates[r], gTickRates[u], 3600);
+			Check(s.end == s.exact);
+			Check(s.maxStep - s.minStep <= 1);
+		}
+	}
+
+	// frame time does not divide ticks evenly, so every rounded step adds error
+	steps s = Step(TimeRate(60000, 1001), TIME_RATE_MF, 3600);
+	Check(s.naiveDrift != 0);
+
+	// divisor of 2^64 - 1, remainder + stepRemainder would overflow
+	time_frame_clock fc;
+	u64 length = UINT32_MAX - 1, divisor = UINT64_MAX;
+	TimeFrameStart(&fc, TimeRate(UINT32_MAX, 1), TimeRate(length, (u64) UINT32_MAX + 2));
+	Check(fc.divisor == divisor);
+	for (u32 i = 0; i < 100000; ++i) TimeFrameNext(&fc);
+	Check(fc.time == ReferenceMulDiv(fc.index, length, divisor, TIME_FLOOR));
+	Check(fc.time == TimeFrameAt(&fc, fc.index));
+}
+
+static void TestSystemClock(void) {
+	time_clock clock;
+	TimeClockSystem(&clock);
+	Check(clock.rate.num && clock.rate.den);
+
+	u64 last = TimeClockNow(&clock);
+	for (u32 i = 0; i < 100000; ++i) {
+		u64 now = TimeClockNow(&clock);
+		Check(now >= last);
+		last = now;
+	}
+}
+
+// random values are made up front, so only division gets timed
+static void BenchMulDiv(mul_div *f, const char *name) {
+	static u64 values[1 << 16];
+	for (u32 i = 0; i < sizeof(values) / sizeof(*values); ++i) values[i] = TestRandom64() >> 8;
+
+	u64 sum = 0;
+	d64 start = TestSeconds();
+	for (u32 i = 0; i < 10000000; ++i) {
+		sum += f(values[i & 0xFFFF], 10000000, 60000, TIME_NEAREST);
+	}
+	d64 elapsed = TestSeconds() - start;
+	printf("TimeMulDiv %-17s %.2f nsec per call (%llu)\n", name, elapsed * 100,
+		   (unsigned long long) (sum & 1));
+}
+
+static void Bench(void) {
+	for (u32 r = 0; r < TEST_RATES; ++r) {
+		for (u32 u = 0; u < TEST_UNITS; ++u) {
+			steps s = Step(gFrameRates[r], gTickRates[u], 24 * 3600);
+			printf("day of %5s fps in %-8s %9llu frames: end %llu, exact %llu, steps %llu..%llu, "
+				   "rounded steps drift %lld, %.2f nsec per frame\n",
+				   gFrameNames[r], gTickNames[u], (unsigned long long) s.frames,
+				   (unsigned long long) s.end, (unsigned long long) s.exact,
+				   (unsigned long long) s.minStep, (unsigned long long) s.maxStep,
+				   (long long) s.naiveDrift, s.seconds * 1e9 / (d64) s.frames);
+		}
+	}
+
+	BenchMulDiv(TimeMulDiv, "native __int128");
+	BenchMulDiv(PortableMulDiv, "portable fallback");
+}
+
+int main(int argc, char **argv) {
+	TestMulDiv(TimeMulDiv);
+	TestMulDiv(PortableMulDiv);
+	TestConvert();
+	TestFrameClock();
+	TestSystemClock();
+	if (TestBench(argc, argv)) Bench();
+	return TestResult("timebase");
+}